@@ -2,9 +2,23 @@
 #include <gl/GL.h>
 #include <gl/GLU.h>
 #include <math.h>
+#include <float.h>
+#include <limits.h>
+#include <algorithm>
 #include <vector>
 #include <stdio.h>
 #include <time.h> 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <intrin.h>
+#include <malloc.h>
+#include <assert.h>
+#include <new>
 
 #pragma comment (lib, "winmm.lib")
 #pragma comment (lib, "OpenGL32.lib")
@@ -12,16 +26,191 @@
 
 #define WINDOW_TITLE "OpenGL Window"
 
+// --- OpenGL Extension Definitions (not in the Windows OpenGL 1.1 headers) ---
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_TEXTURE_BASE_LEVEL
+#define GL_TEXTURE_BASE_LEVEL            0x813C
+#define GL_TEXTURE_MAX_LEVEL             0x813D
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER           0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW                   0x88E0
+#endif
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY                    0x88B9
+#endif
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER                  0x8892
+#define GL_ELEMENT_ARRAY_BUFFER          0x8893
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW                   0x88E4
+#endif
+#ifndef GL_PRIMITIVE_RESTART
+#define GL_PRIMITIVE_RESTART             0x8F9D
+#endif
+#ifndef GL_PRIMITIVE_RESTART_NV
+#define GL_PRIMITIVE_RESTART_NV          0x8558
+#endif
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT                    0x140B
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_FRAGMENT_SHADER               0x8B30
+#define GL_VERTEX_SHADER                 0x8B31
+#define GL_COMPILE_STATUS                0x8B81
+#define GL_LINK_STATUS                   0x8B82
+#endif
+#ifndef GL_PATCHES
+#define GL_PATCHES                       0x000E
+#define GL_PATCH_VERTICES                0x8E72
+#define GL_TESS_EVALUATION_SHADER        0x8E87
+#define GL_TESS_CONTROL_SHADER           0x8E88
+#endif
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER                   0x8D40
+#define GL_RENDERBUFFER                  0x8D41
+#define GL_FRAMEBUFFER_BINDING           0x8CA6
+#define GL_FRAMEBUFFER_COMPLETE          0x8CD5
+#define GL_COLOR_ATTACHMENT0             0x8CE0
+#define GL_DEPTH_ATTACHMENT              0x8D00
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24             0x81A6
+#endif
+#ifndef GL_TIME_ELAPSED
+#define GL_QUERY_RESULT                  0x8866
+#define GL_QUERY_RESULT_AVAILABLE        0x8867
+#define GL_TIME_ELAPSED                  0x88BF
+#endif
+
+typedef ptrdiff_t GLsizeiptr;
+typedef char GLchar;
+typedef unsigned long long GLuint64;
+
+typedef void (APIENTRY* PFNGLCOMPRESSEDTEXIMAGE2DPROC)(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void* data);
+typedef void (APIENTRY* PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC)(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void* data);
+typedef void (APIENTRY* PFNGLGENBUFFERSPROC)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRY* PFNGLDELETEBUFFERSPROC)(GLsizei n, const GLuint* buffers);
+typedef void (APIENTRY* PFNGLBINDBUFFERPROC)(GLenum target, GLuint buffer);
+typedef void (APIENTRY* PFNGLBUFFERDATAPROC)(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+typedef void* (APIENTRY* PFNGLMAPBUFFERPROC)(GLenum target, GLenum access);
+typedef GLboolean(APIENTRY* PFNGLUNMAPBUFFERPROC)(GLenum target);
+typedef void (APIENTRY* PFNGLPRIMITIVERESTARTINDEXPROC)(GLuint index);
+typedef GLuint(APIENTRY* PFNGLCREATESHADERPROC)(GLenum type);
+typedef void (APIENTRY* PFNGLSHADERSOURCEPROC)(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths);
+typedef void (APIENTRY* PFNGLCOMPILESHADERPROC)(GLuint shader);
+typedef void (APIENTRY* PFNGLGETSHADERIVPROC)(GLuint shader, GLenum pname, GLint* params);
+typedef void (APIENTRY* PFNGLGETSHADERINFOLOGPROC)(GLuint shader, GLsizei maxLength, GLsizei* length, GLchar* infoLog);
+typedef void (APIENTRY* PFNGLDELETESHADERPROC)(GLuint shader);
+typedef GLuint(APIENTRY* PFNGLCREATEPROGRAMPROC)();
+typedef void (APIENTRY* PFNGLATTACHSHADERPROC)(GLuint program, GLuint shader);
+typedef void (APIENTRY* PFNGLBINDATTRIBLOCATIONPROC)(GLuint program, GLuint index, const GLchar* name);
+typedef void (APIENTRY* PFNGLLINKPROGRAMPROC)(GLuint program);
+typedef void (APIENTRY* PFNGLGETPROGRAMIVPROC)(GLuint program, GLenum pname, GLint* params);
+typedef void (APIENTRY* PFNGLGETPROGRAMINFOLOGPROC)(GLuint program, GLsizei maxLength, GLsizei* length, GLchar* infoLog);
+typedef void (APIENTRY* PFNGLDELETEPROGRAMPROC)(GLuint program);
+typedef void (APIENTRY* PFNGLUSEPROGRAMPROC)(GLuint program);
+typedef GLint(APIENTRY* PFNGLGETUNIFORMLOCATIONPROC)(GLuint program, const GLchar* name);
+typedef void (APIENTRY* PFNGLUNIFORM1FPROC)(GLint location, GLfloat v0);
+typedef void (APIENTRY* PFNGLUNIFORM2FPROC)(GLint location, GLfloat v0, GLfloat v1);
+typedef void (APIENTRY* PFNGLUNIFORM3FVPROC)(GLint location, GLsizei count, const GLfloat* value);
+typedef void (APIENTRY* PFNGLVERTEXATTRIBPOINTERPROC)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
+typedef void (APIENTRY* PFNGLENABLEVERTEXATTRIBARRAYPROC)(GLuint index);
+typedef void (APIENTRY* PFNGLDISABLEVERTEXATTRIBARRAYPROC)(GLuint index);
+typedef void (APIENTRY* PFNGLPATCHPARAMETERIPROC)(GLenum pname, GLint value);
+typedef void (APIENTRY* PFNGLGENFRAMEBUFFERSPROC)(GLsizei n, GLuint* framebuffers);
+typedef void (APIENTRY* PFNGLDELETEFRAMEBUFFERSPROC)(GLsizei n, const GLuint* framebuffers);
+typedef void (APIENTRY* PFNGLBINDFRAMEBUFFERPROC)(GLenum target, GLuint framebuffer);
+typedef void (APIENTRY* PFNGLFRAMEBUFFERTEXTURE2DPROC)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+typedef GLenum(APIENTRY* PFNGLCHECKFRAMEBUFFERSTATUSPROC)(GLenum target);
+typedef void (APIENTRY* PFNGLGENRENDERBUFFERSPROC)(GLsizei n, GLuint* renderbuffers);
+typedef void (APIENTRY* PFNGLDELETERENDERBUFFERSPROC)(GLsizei n, const GLuint* renderbuffers);
+typedef void (APIENTRY* PFNGLBINDRENDERBUFFERPROC)(GLenum target, GLuint renderbuffer);
+typedef void (APIENTRY* PFNGLRENDERBUFFERSTORAGEPROC)(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRY* PFNGLFRAMEBUFFERRENDERBUFFERPROC)(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+typedef void (APIENTRY* PFNGLGENERATEMIPMAPPROC)(GLenum target);
+typedef void (APIENTRY* PFNGLGENQUERIESPROC)(GLsizei n, GLuint* ids);
+typedef void (APIENTRY* PFNGLDELETEQUERIESPROC)(GLsizei n, const GLuint* ids);
+typedef void (APIENTRY* PFNGLBEGINQUERYPROC)(GLenum target, GLuint id);
+typedef void (APIENTRY* PFNGLENDQUERYPROC)(GLenum target);
+typedef void (APIENTRY* PFNGLGETQUERYOBJECTIVPROC)(GLuint id, GLenum pname, GLint* params);
+typedef void (APIENTRY* PFNGLGETQUERYOBJECTUI64VPROC)(GLuint id, GLenum pname, GLuint64* params);
+
+PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D = nullptr;
+PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC glCompressedTexSubImage2D = nullptr;
+PFNGLGENBUFFERSPROC glGenBuffers = nullptr;
+PFNGLDELETEBUFFERSPROC glDeleteBuffers = nullptr;
+PFNGLBINDBUFFERPROC glBindBuffer = nullptr;
+PFNGLBUFFERDATAPROC glBufferData = nullptr;
+PFNGLMAPBUFFERPROC glMapBuffer = nullptr;
+PFNGLUNMAPBUFFERPROC glUnmapBuffer = nullptr;
+PFNGLPRIMITIVERESTARTINDEXPROC glPrimitiveRestartIndex = nullptr;
+PFNGLCREATESHADERPROC glCreateShader = nullptr;
+PFNGLSHADERSOURCEPROC glShaderSource = nullptr;
+PFNGLCOMPILESHADERPROC glCompileShader = nullptr;
+PFNGLGETSHADERIVPROC glGetShaderiv = nullptr;
+PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog = nullptr;
+PFNGLDELETESHADERPROC glDeleteShader = nullptr;
+PFNGLCREATEPROGRAMPROC glCreateProgram = nullptr;
+PFNGLATTACHSHADERPROC glAttachShader = nullptr;
+PFNGLBINDATTRIBLOCATIONPROC glBindAttribLocation = nullptr;
+PFNGLLINKPROGRAMPROC glLinkProgram = nullptr;
+PFNGLGETPROGRAMIVPROC glGetProgramiv = nullptr;
+PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog = nullptr;
+PFNGLDELETEPROGRAMPROC glDeleteProgram = nullptr;
+PFNGLUSEPROGRAMPROC glUseProgram = nullptr;
+PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation = nullptr;
+PFNGLUNIFORM1FPROC glUniform1f = nullptr;
+PFNGLUNIFORM2FPROC glUniform2f = nullptr;
+PFNGLUNIFORM3FVPROC glUniform3fv = nullptr;
+PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer = nullptr;
+PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray = nullptr;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray = nullptr;
+PFNGLPATCHPARAMETERIPROC glPatchParameteri = nullptr;
+PFNGLGENFRAMEBUFFERSPROC glGenFramebuffers = nullptr;
+PFNGLDELETEFRAMEBUFFERSPROC glDeleteFramebuffers = nullptr;
+PFNGLBINDFRAMEBUFFERPROC glBindFramebuffer = nullptr;
+PFNGLFRAMEBUFFERTEXTURE2DPROC glFramebufferTexture2D = nullptr;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC glCheckFramebufferStatus = nullptr;
+PFNGLGENRENDERBUFFERSPROC glGenRenderbuffers = nullptr;
+PFNGLDELETERENDERBUFFERSPROC glDeleteRenderbuffers = nullptr;
+PFNGLBINDRENDERBUFFERPROC glBindRenderbuffer = nullptr;
+PFNGLRENDERBUFFERSTORAGEPROC glRenderbufferStorage = nullptr;
+PFNGLFRAMEBUFFERRENDERBUFFERPROC glFramebufferRenderbuffer = nullptr;
+PFNGLGENERATEMIPMAPPROC glGenerateMipmap = nullptr;
+PFNGLGENQUERIESPROC glGenQueries = nullptr;
+PFNGLDELETEQUERIESPROC glDeleteQueries = nullptr;
+PFNGLBEGINQUERYPROC glBeginQuery = nullptr;
+PFNGLENDQUERYPROC glEndQuery = nullptr;
+PFNGLGETQUERYOBJECTIVPROC glGetQueryObjectiv = nullptr;
+PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v = nullptr;
+bool g_hasS3TC = false; // GL_EXT_texture_compression_s3tc is available
+bool g_hasPBO = false;  // Pixel buffer objects (GL 2.1 / GL_ARB_pixel_buffer_object) are available
+bool g_hasVBO = false;  // Vertex buffer objects (GL 1.5 / GL_ARB_vertex_buffer_object) are available
+GLenum g_primitiveRestartCap = 0; // GL_PRIMITIVE_RESTART (3.1), GL_PRIMITIVE_RESTART_NV (a client state), or 0 if unsupported
+bool g_hasGLSL = false; // GL 2.0 shader objects are available
+bool g_hasHalfFloatVertex = false; // Half-float vertex attributes (GL 3.0 / GL_ARB_half_float_vertex) are available
+bool g_hasTessellation = false; // Tessellation shaders (GL 4.0 / GL_ARB_tessellation_shader) are available
+bool g_hasFBO = false; // Framebuffer objects (GL 3.0 / GL_ARB_framebuffer_object / GL_EXT_framebuffer_object) are available
+bool g_hasTimerQuery = false; // GPU timer queries (GL 3.3 / GL_ARB_timer_query / GL_EXT_timer_query) are available
+GLint g_maxTextureSize = 0;
+
 bool g_isWeaponVisible = false;
 
 // --- Hand Animation State Variables ---
-bool g_isFistAnimating = false;    // Is the open/close animation currently running?
 bool g_isFistTargetClosed = false; // The state we are animating towards (true=closed, false=open)
-float g_fistAnimationProgress = 0.0f; // 0.0 = fully open, 1.0 = fully closed
 
 // --- Weapon State Variable ---
 int g_equippedWeapon = 0;
-GLuint g_mirrorTextureID = 0;
 
 // Define the joint angles for the open and closed poses
 const float FINGER_OPEN_ANGLES[3] = { -10.0f, -15.0f, -10.0f };
@@ -29,9 +218,6 @@ const float FINGER_CLOSED_ANGLES[3] = { -45.0f, -60.0f, -45.0f };
 const float THUMB_OPEN_ANGLE = -20.0f;
 const float THUMB_CLOSED_ANGLE = -40.0f;
 
-int g_armAnimationState = 0;
-float g_armAnimationTimer = 0.0f; // A timer for each phase of the animation
-
 // We need to store the target angles for the two main poses.
 // Format: {Shoulder Z-axis rotation, Shoulder X-axis rotation, Elbow X-axis rotation}
 const float ARM_POSE_IDLE[3] = { -10.0f, 0.0f, -25.0f };
@@ -39,15 +225,13 @@ const float ARM_POSE_CASTING[3] = { -20.0f, -80.0f, -40.0f }; // Arms raised for
 
 const float ARM_POSE_WAVE[3] = { -90.0f, -30.0f, -90.0f };
 
-// These variables will hold the CURRENT, interpolated angles for each arm during animation.
-float g_rightArmAngles[3] = { ARM_POSE_IDLE[0], ARM_POSE_IDLE[1], ARM_POSE_IDLE[2] };
-float g_leftArmAngles[3] = { -ARM_POSE_IDLE[0], ARM_POSE_IDLE[1], ARM_POSE_IDLE[2] }; // Left arm is mirrored on Z-axis
-
 // Global for braid animation
 float g_braidTime = 0.0f;
 float g_windStrength = 0.8f;
 float g_braidSegmentLength = 0.1f; // Make segments a bit shorter for more detail
 int g_numBraidSegments = 15;      // INCREASE this to make the braid longer
+const float BRAID_SEGMENT_GAP = 0.02f;
+const float BRAID_LENGTH = 15 * (0.1f + BRAID_SEGMENT_GAP); // The quality governor keeps this as it changes the segment count
 
 float g_characterPosX = 0.0f;
 float g_characterPosZ = 0.0f;
@@ -66,14 +250,6 @@ float g_haloScale = 0.38f;
 GLfloat g_initialLightPos[4] = { 5.0f, 5.0f, 5.0f, 1.0f };
 GLfloat g_animatedLightPos[4];
 
-GLuint g_shoeTextureID = 0;
-GLuint g_fireTextureID = 0;
-GLuint g_goldTextureID = 0;
-GLuint g_redTextureID = 0;
-GLuint g_skyTextureID = 0;
-GLuint g_silverTextureID = 0;
-GLuint g_orangeTextureID = 0;
-
 // --- NEW variables for Delta Time calculation ---
 LARGE_INTEGER g_timer_frequency;
 LARGE_INTEGER g_last_frame_time;
@@ -87,6 +263,8 @@ HGLRC g_hRC = nullptr; // global rendering context
 float rotateX = 15.0f;
 float rotateY = 0.0f;
 float zoomFactor = -5.0f; // Global variable for camera zoom
+int g_windowWidth = 800;  // Client area, kept up to date by WM_SIZE
+int g_windowHeight = 600;
 
 bool g_isPerspectiveView = true;
 
@@ -94,21 +272,213 @@ bool g_isPerspectiveView = true;
 bool isDragging = false;
 int lastMouseX = 0;
 int lastMouseY = 0;
+int mouseDownX = 0; // Where the left button went down, to tell a click from a drag
+int mouseDownY = 0;
+
+// --- Heap Allocation Counting ---
+// Every operator new on a thread bumps that thread's counter, so display()
+// can tell whether a frame touched the heap. After a warm-up, debug builds
+// assert on any allocation made by a frame. Containers that keep their storage
+// between frames may still grow past a high-water mark they could not reserve
+// up front; they do it inside a HighWaterGrowth scope, which is not counted.
+const unsigned int STEADY_STATE_WARMUP_FRAMES = 120; // Textures streaming in, first casts, ...
+
+thread_local unsigned int t_heapAllocations = 0;
+thread_local int t_highWaterGrowthDepth = 0;
+
+struct HighWaterGrowth {
+	HighWaterGrowth() { ++t_highWaterGrowthDepth; }
+	~HighWaterGrowth() { --t_highWaterGrowthDepth; }
+};
+
+void* operator new(size_t size)
+{
+	if (t_highWaterGrowthDepth == 0) ++t_heapAllocations;
+	void* memory = malloc(size ? size : 1);
+	if (!memory) throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+
+// push_back for storage kept between frames that has no fixed upper bound
+template <typename T>
+void pushHighWater(std::vector<T>& list, const T& value)
+{
+	HighWaterGrowth growth;
+	list.push_back(value);
+}
+
+// --- Frame Arena ---
+// Scratch memory for data that only lives until the frame is drawn (particle
+// and projectile vertices). One block is reserved at startup, sized for every
+// pool at capacity; frameAlloc bumps through it and display() rewinds it at
+// the top of each frame, so per-frame geometry never reaches the heap.
+struct FrameArena {
+	unsigned char* memory = nullptr;
+	size_t capacity = 0;
+	size_t used = 0;
+	size_t peak = 0; // Most used by any frame so far
+};
+
+FrameArena g_frameArena;
+
+void initFrameArena(size_t capacity)
+{
+	g_frameArena.memory = (unsigned char*)_aligned_malloc(capacity, 64);
+	g_frameArena.capacity = g_frameArena.memory ? capacity : 0;
+	g_frameArena.used = 0;
+}
+
+void shutdownFrameArena()
+{
+	_aligned_free(g_frameArena.memory);
+	g_frameArena = FrameArena();
+}
+
+void resetFrameArena()
+{
+	g_frameArena.used = 0;
+}
+
+// Returns nullptr if the arena is full; the caller skips whatever it was building
+void* frameAlloc(size_t bytes, size_t alignment = 16)
+{
+	FrameArena& arena = g_frameArena;
+	size_t start = (arena.used + alignment - 1) & ~(alignment - 1);
+	assert(start + bytes <= arena.capacity && "frame arena exhausted");
+	if (start + bytes > arena.capacity) return nullptr;
+	arena.used = start + bytes;
+	if (arena.used > arena.peak) arena.peak = arena.used;
+	return arena.memory + start;
+}
+
+template <typename T>
+T* frameAllocArray(size_t count)
+{
+	return (T*)frameAlloc(count * sizeof(T), alignof(T) < 16 ? 16 : alignof(T));
+}
+
+// --- Animation Scheduler ---
+// Nothing animates unless something started it. Each animation system is a
+// task with a bit in g_activeAnimTasks: whatever starts it (a key in
+// WindowProcedure, a clip player, a cast, a spawned particle) sets the bit,
+// display() ticks the set bits in task order, and a task drops out by
+// reporting that it has nothing left to do, so an idle frame does no
+// animation work. Timed phase changes are events on a min-heap rather than
+// timers polled every frame. The tick functions are listed above display().
+enum AnimTaskId {
+	TASK_CLIP_PLAYERS,      // Keyframed clips started by F, G, Q, E, V, L and M
+	TASK_POSE,              // Re-blends the pose after a clip or one of its inputs changed
+	TASK_SKILL_PROJECTILES, // G and B projectiles and the particles they shed
+	TASK_MATRIX_BLOCKS,     // M blocks: phase events, growing, shattering, motes
+	TASK_COLLISIONS,        // Spatial hash and projectile-vs-block hits
+	TASK_PARTICLES,
+	TASK_HALO,              // A: the halo flying away
+	TASK_COUNT
+};
+
+struct PhaseEvent {
+	float time;          // g_animClock at which it fires
+	int target;          // Object changing phase
+	int phase;           // Phase it enters
+	unsigned int serial; // Target's phase serial when scheduled; a mismatch means it was superseded
+};
+
+unsigned int g_activeAnimTasks = 1u << TASK_POSE; // The first frame blends the idle pose
+float g_animClock = 0.0f;                          // Seconds of animation time, advanced every frame
+std::vector<PhaseEvent> g_phaseEvents;             // Min-heap on time
+
+inline void activateAnimTask(AnimTaskId task)
+{
+	g_activeAnimTasks |= 1u << task;
+}
+
+static bool phaseEventLater(const PhaseEvent& a, const PhaseEvent& b)
+{
+	return a.time > b.time;
+}
+
+void schedulePhaseEvent(float delay, int target, int phase, unsigned int serial)
+{
+	g_phaseEvents.push_back({ g_animClock + delay, target, phase, serial });
+	std::push_heap(g_phaseEvents.begin(), g_phaseEvents.end(), phaseEventLater);
+}
+
+// Drops a target's pending events, so the heap holds at most one per target
+void cancelPhaseEvents(int target)
+{
+	size_t count = g_phaseEvents.size();
+	g_phaseEvents.erase(std::remove_if(g_phaseEvents.begin(), g_phaseEvents.end(),
+		[target](const PhaseEvent& event) { return event.target == target; }), g_phaseEvents.end());
+	if (g_phaseEvents.size() != count) std::make_heap(g_phaseEvents.begin(), g_phaseEvents.end(), phaseEventLater);
+}
+
+// Takes the earliest event off the heap if it is due
+bool popDuePhaseEvent(PhaseEvent& event)
+{
+	if (g_phaseEvents.empty() || g_phaseEvents.front().time > g_animClock) return false;
+	std::pop_heap(g_phaseEvents.begin(), g_phaseEvents.end(), phaseEventLater);
+	event = g_phaseEvents.back();
+	g_phaseEvents.pop_back();
+	return true;
+}
+
+// --- Nuwa Skill Projectile Pool ---
+// Every cast of the G skill is one projectile: a glowing 2 x 8 rectangle that
+// slides along the ground in the direction the character faced when casting.
+// Live projectiles are packed at the front of fixed-size SoA arrays so they
+// can be updated four at a time and drawn in one batch.
+const int MAX_SKILL_PROJECTILES = 4096; // Multiple of 4 for the SSE update
+const float SKILL_SPEED = 15.0f;        // How fast it travels (units per second)
+const float SKILL_MAX_LIFETIME = 3.0f;  // How long it lasts in seconds
+const float SKILL_WIDTH = 2.0f;
+const float SKILL_LENGTH = 8.0f;
+
+struct SkillProjectilePool {
+	int count = 0;
+	alignas(16) float posX[MAX_SKILL_PROJECTILES];     // Centre of the rectangle on the ground
+	alignas(16) float posZ[MAX_SKILL_PROJECTILES];
+	alignas(16) float dirX[MAX_SKILL_PROJECTILES];     // Unit direction of travel
+	alignas(16) float dirZ[MAX_SKILL_PROJECTILES];
+	alignas(16) float lifetime[MAX_SKILL_PROJECTILES]; // Seconds left
+	int spatialId[MAX_SKILL_PROJECTILES];              // Entry in the spatial hash, -1 until first synced
+};
 
-// --- Nuwa Skill Variables ---
-GLuint g_nuwaSkillTextureID = 0;
-bool g_isNuwaSkillActive = false;
-float g_nuwaSkillLifetime = 0.0f;     // How long the skill lasts in seconds
-float g_nuwaSkillDistance = 0.0f;     // How far it has travelled from the character
-float g_characterAngleOnCast = 0.0f;  // Store the character's direction when the skill is cast
-float g_characterCastPosX = 0.0f;     // Store the character's X position on cast
-float g_characterCastPosZ = 0.0f;     // Store the character's Z position on cast
+SkillProjectilePool g_skillProjectiles;
+
+// Launches a projectile from (x, z) facing angleDegrees about Y, like the
+// character's rotation. Returns false if the pool is full.
+bool castSkillProjectile(float x, float z, float angleDegrees)
+{
+	SkillProjectilePool& pool = g_skillProjectiles;
+	if (pool.count >= MAX_SKILL_PROJECTILES) return false;
+
+	// The rectangle travels along its local -Z axis
+	float angle = angleDegrees * 3.14159265f / 180.0f;
+	int i = pool.count++;
+	pool.posX[i] = x;
+	pool.posZ[i] = z;
+	pool.dirX[i] = -sinf(angle);
+	pool.dirZ[i] = -cosf(angle);
+	pool.lifetime[i] = SKILL_MAX_LIFETIME;
+	pool.spatialId[i] = -1;
+	activateAnimTask(TASK_SKILL_PROJECTILES);
+	activateAnimTask(TASK_COLLISIONS);
+	return true;
+}
 
 // --- Waving Animation Variables ---
 bool g_isLeftWaveActive = false;   // Is the left hand wave toggled on?
 bool g_isRightWaveActive = false;  // Is the right hand wave toggled on?
-float g_leftWaveProgress = 0.0f;   // Animation progress for left hand (0=down, 1=up)
-float g_rightWaveProgress = 0.0f;  // Animation progress for right hand (0=down, 1=up)
 
 // Define the "raised" pose for the elbow
 const float ARM_POSE_WAVE_ELBOW = -100.0f;
@@ -119,7 +489,6 @@ const float PEACE_THUMB_ANGLE = -60.0f;
 
 // --- Hand Pose Animation Variables ---
 int g_handPoseTarget = 0;        // 0 = Normal, 1 = Peace Sign
-float g_handPoseProgress = 0.0f; // Animation progress (0=normal, 1=peace sign)
 
 bool g_isLevitating = false;
 float g_levitationProgress = 0.0f;
@@ -129,7 +498,6 @@ float g_neckTiltAngle = 0.0f;
 const float ARM_POSE_LEVITATE[3] = { -45.0f, -20.0f, -15.0f };
 
 bool g_isWaving = false;
-float g_waveProgress = 0.0f;
 
 // --- ADD THIS NEAR THE TOP WITH OTHER GLOBAL VARIABLES ---
 
@@ -137,7 +505,9 @@ float g_waveProgress = 0.0f;
 enum MatrixBlockState {
 	SPAWNING,  // The block is just appearing
 	EXPANDING, // The block is growing to its full size
-	ACTIVE     // The block is at full size, waiting to expire
+	ACTIVE,    // The block is at full size, waiting to expire
+	SHATTERING, // Hit by a skill projectile: collapsing before it disappears
+	EXPIRED     // Gone; the slot is no longer animated or drawn
 };
 
 // Holds all the data for one instance of Nuwa's matrix skill
@@ -148,2543 +518,8730 @@ struct MatrixBlock {
 	float posX, posY, posZ;         // World position
 	float scaleX, scaleY, scaleZ;   // Current scale for the expansion animation
 
-	float lifetime;                 // How many seconds are left before it disappears
+	float expireTime;               // g_animClock at which its lifetime runs out
 	float animationTimer;           // A timer for the current state (e.g., how long it's been expanding)
+	unsigned int phaseSerial = 0;   // Bumped on every state change, to recognise stale phase events
+
+	int spatialId = -1;             // Entry in the spatial hash while active
+	float shatterScale = 0.0f;      // Scale when it was hit, for the SHATTERING collapse
 };
 
-// This vector will hold all the blocks currently on screen
+// A fixed pool: expired slots are reused, so spawning never reallocates
+const int MAX_MATRIX_BLOCKS = 256;
 std::vector<MatrixBlock> g_matrixBlocks;
-GLuint g_matrixTextureID = 0; // We'll need a new texture for the block
+std::vector<int> g_liveMatrixBlocks; // Indices of the blocks that are still animating
+std::vector<int> g_freeMatrixBlocks; // Expired slots, ready for the next spawn
+
+// --- Quality Presets ---
+// Settings that depend on how strong the host is are read once at startup
+// from Nuwa.cfg (or "--config=path"): "preset = low|medium|high|ultra"
+// picks a row of QUALITY_PRESETS, and any other "key = value" line
+// overrides one field of it, wherever it appears in the file. '#' starts a
+// comment. Without a file the high preset is used, which is how the scene
+// always looked. After loading, g_config is read-only; command-line flags
+// still override the values it seeds into other systems.
+const int QUALITY_LEVEL_COUNT = 6; // Quality governor levels, 0 being full quality
+
+struct QualityConfig {
+	const char* presetName;
+	int bestQualityLevel;   // The governor starts here and never goes above it
+	int textureMipDrop;     // Largest mip levels discarded at load, halving the size each
+	int textureBudgetMB;
+	float frameBudgetMs;
+	int crowdSize;          // 0 in every preset: a crowd is a stress test, set with "crowd = N"
+	bool useTessellation;
+	bool useSharpen;
+	int waistSides;         // A multiple of the waist's 6 gold lines
+	int sphereMaxStacks;    // At most 50
+	float blockSpawnArea;   // Side of the square around the character that M blocks land in
+	float blockLifetime;    // Seconds an M block stands before it expires
+	int mirrorSize;         // Side of the Divine Mirror's reflection texture, 0 for the static image
+	int mirrorInterval;     // Frames between reflection updates
+};
 
-void resetAnimation() {
-	g_isHaloAnimating = false;
-	g_isHaloVisible = true;
-	g_haloZ = -0.85f;
-	g_haloScale = 0.38f;
+const QualityConfig QUALITY_PRESETS[] = {
+	// name      level mips  MB   budget         crowd tess   sharpen waist stacks area   life  mirror every
+	{ "low",     3,    2,    8,   1000.0f / 30,  0,    false, false,  12,   16,    10.0f, 3.0f, 0,     4 },
+	{ "medium",  1,    1,    12,  1000.0f / 30,  0,    true,  true,   18,   30,    15.0f, 4.0f, 128,   4 },
+	{ "high",    0,    0,    12,  1000.0f / 30,  0,    true,  true,   24,   50,    15.0f, 4.0f, 256,   2 },
+	{ "ultra",   0,    0,    32,  1000.0f / 60,  0,    true,  true,   36,   50,    15.0f, 6.0f, 512,   1 },
+};
+const int QUALITY_PRESET_COUNT = sizeof(QUALITY_PRESETS) / sizeof(QUALITY_PRESETS[0]);
+const int DEFAULT_QUALITY_PRESET = 2;
 
-	// Reset the light's position
-	memcpy(g_animatedLightPos, g_initialLightPos, sizeof(GLfloat) * 4);
+static QualityConfig g_loadedConfig = QUALITY_PRESETS[DEFAULT_QUALITY_PRESET]; // Written only by loadQualityConfig
+const QualityConfig& g_config = g_loadedConfig;
 
-	// Reset all movement and character states
-	g_characterPosX = 0.0f;
-	g_characterPosZ = 0.0f;
-	g_forwardDirection = 0;
-	g_strafeDirection = 0;
-	g_characterRotationY = 0.0f; // FIX: Reset character to face front. Was 180.0f
+// Applies one override line; returns false for an unknown key or a bad value
+static bool applyConfigValue(QualityConfig& config, const char* key, const char* value)
+{
+	struct IntField { const char* key; int* field; };
+	struct FloatField { const char* key; float* field; };
+	struct BoolField { const char* key; bool* field; };
+	const IntField intFields[] = {
+		{ "quality_level", &config.bestQualityLevel }, { "texture_mip_drop", &config.textureMipDrop },
+		{ "texture_budget_mb", &config.textureBudgetMB }, { "crowd", &config.crowdSize },
+		{ "waist_sides", &config.waistSides }, { "sphere_max_stacks", &config.sphereMaxStacks },
+		{ "mirror_size", &config.mirrorSize }, { "mirror_interval", &config.mirrorInterval },
+	};
+	const FloatField floatFields[] = {
+		{ "frame_budget_ms", &config.frameBudgetMs }, { "block_spawn_area", &config.blockSpawnArea },
+		{ "block_lifetime", &config.blockLifetime },
+	};
+	const BoolField boolFields[] = {
+		{ "tessellation", &config.useTessellation }, { "sharpen", &config.useSharpen },
+	};
+
+	char* end = nullptr;
+	for (const IntField& f : intFields) {
+		if (strcmp(key, f.key) != 0) continue;
+		long number = strtol(value, &end, 10);
+		if (end == value || *end) return false;
+		*f.field = (int)number;
+		return true;
+	}
+	for (const FloatField& f : floatFields) {
+		if (strcmp(key, f.key) != 0) continue;
+		float number = strtof(value, &end);
+		if (end == value || *end) return false;
+		*f.field = number;
+		return true;
+	}
+	for (const BoolField& f : boolFields) {
+		if (strcmp(key, f.key) != 0) continue;
+		if (strcmp(value, "on") == 0 || strcmp(value, "true") == 0 || strcmp(value, "1") == 0) *f.field = true;
+		else if (strcmp(value, "off") == 0 || strcmp(value, "false") == 0 || strcmp(value, "0") == 0) *f.field = false;
+		else return false;
+		return true;
+	}
+	return false;
 }
 
-LRESULT WINAPI WindowProcedure(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
+// Splits "key = value # comment" in place; returns false for blank and comment-only lines
+static bool splitConfigLine(char* line, char*& key, char*& value)
 {
-	switch (msg)
-	{
-	case WM_DESTROY:
-		PostQuitMessage(0);
-		break;
+	char* comment = strchr(line, '#');
+	if (comment) *comment = '\0';
+	char* equals = strchr(line, '=');
+	if (!equals) return false;
+	*equals = '\0';
+	key = line;
+	value = equals + 1;
+	// Trim both fields
+	for (char** field : { &key, &value }) {
+		while (**field == ' ' || **field == '\t') ++*field;
+		char* last = *field + strlen(*field);
+		while (last > *field && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r' || last[-1] == '\n')) --last;
+		*last = '\0';
+	}
+	return *key != '\0';
+}
 
-	case WM_KEYDOWN:
-		// Exit the application
-		if (wParam == VK_ESCAPE) PostQuitMessage(0);
-		if (wParam == 'P') {
-			g_isPerspectiveView = !g_isPerspectiveView;
+static QualityConfig readQualityConfig(const char* path)
+{
+	char buffer[256];
+	QualityConfig config = QUALITY_PRESETS[DEFAULT_QUALITY_PRESET];
+	FILE* file;
+	fopen_s(&file, path, "r");
+	if (!file) {
+		sprintf_s(buffer, "No %s, using the %s preset.\n", path, config.presetName);
+		OutputDebugStringA(buffer);
+		return config;
+	}
+
+	// Two passes: the preset first, so overrides apply on top of it wherever they are in the file
+	char line[256];
+	char* key;
+	char* value;
+	while (fgets(line, sizeof(line), file)) {
+		if (!splitConfigLine(line, key, value) || strcmp(key, "preset") != 0) continue;
+		int preset = 0;
+		while (preset < QUALITY_PRESET_COUNT && _stricmp(value, QUALITY_PRESETS[preset].presetName) != 0) ++preset;
+		if (preset < QUALITY_PRESET_COUNT) config = QUALITY_PRESETS[preset];
+		else {
+			sprintf_s(buffer, "Warning: %s: unknown preset \"%s\".\n", path, value);
+			OutputDebugStringA(buffer);
 		}
+	}
+	sprintf_s(buffer, "%s: %s preset\n", path, config.presetName);
+	OutputDebugStringA(buffer);
 
-		// --- Handle Arrow Key Presses to START movement ---
-		if (wParam == VK_UP)    g_forwardDirection = 1;
-		if (wParam == VK_DOWN)  g_forwardDirection = -1;
-		if (wParam == VK_RIGHT)  g_strafeDirection = -1;
-		if (wParam == VK_LEFT) g_strafeDirection = 1;
+	rewind(file);
+	int lineNumber = 0;
+	while (fgets(line, sizeof(line), file)) {
+		++lineNumber;
+		if (!splitConfigLine(line, key, value) || strcmp(key, "preset") == 0) continue;
+		if (applyConfigValue(config, key, value)) sprintf_s(buffer, "  %s = %s\n", key, value);
+		else sprintf_s(buffer, "Warning: %s(%d): ignoring \"%s = %s\".\n", path, lineNumber, key, value);
+		OutputDebugStringA(buffer);
+	}
+	fclose(file);
+
+	// Keep every field in the range the code that reads it can handle
+	config.bestQualityLevel = max(0, min(QUALITY_LEVEL_COUNT - 1, config.bestQualityLevel));
+	config.textureMipDrop = max(0, min(8, config.textureMipDrop));
+	config.textureBudgetMB = max(1, config.textureBudgetMB);
+	if (config.frameBudgetMs <= 0.0f) config.frameBudgetMs = QUALITY_PRESETS[DEFAULT_QUALITY_PRESET].frameBudgetMs;
+	config.crowdSize = max(0, config.crowdSize);
+	config.waistSides = max(6, min(96, (config.waistSides + 3) / 6 * 6));
+	config.sphereMaxStacks = max(4, min(50, config.sphereMaxStacks));
+	config.blockSpawnArea = max(0.0f, config.blockSpawnArea);
+	config.blockLifetime = max(0.5f, config.blockLifetime);
+	config.mirrorSize = config.mirrorSize <= 0 ? 0 : max(32, min(2048, config.mirrorSize));
+	config.mirrorInterval = max(1, config.mirrorInterval);
+	return config;
+}
 
-		// --- NEW: Add Light Position Controls ---
-		if (wParam == 'W') g_animatedLightPos[1] += 0.5f; // Move light up
-		if (wParam == 'S') g_animatedLightPos[1] -= 0.5f; // Move light down
-		if (wParam == 'C') g_animatedLightPos[0] -= 0.5f; // Move light left
-		if (wParam == 'D') g_animatedLightPos[0] += 0.5f; // Move light right
-		if (wParam == 'Z') g_animatedLightPos[2] += 0.5f; // Move light near
-		if (wParam == 'X') g_animatedLightPos[2] -= 0.5f; // Move light far
+// Called once from WinMain, before anything reads g_config
+void loadQualityConfig(const char* path)
+{
+	g_loadedConfig = readQualityConfig(path);
+}
 
+// --- Random Numbers ---
+// A small xorshift generator per thread, so particle code running on the
+// worker pool never contends on (or races with) the CRT's rand() state.
+std::atomic<unsigned int> g_randomSeed(0x9e3779b9u);
 
-		// --- Other keybinds (unchanged) ---
-		if (wParam == 'A') g_isHaloAnimating = true;
-		if (wParam == 'F') {
-			g_isFistAnimating = true;
-			g_isFistTargetClosed = !g_isFistTargetClosed;
-		}
-		if (wParam == 'G') {
-			if (g_armAnimationState == 0) {
-				g_armAnimationState = 1;
-				g_armAnimationTimer = 0.0f;
-
-				g_isNuwaSkillActive = true;
-				g_nuwaSkillLifetime = 3.0f;
-				g_nuwaSkillDistance = 0.0f;
-				g_characterAngleOnCast = rotateY;
-				g_characterCastPosX = g_characterPosX;
-				g_characterCastPosZ = g_characterPosZ;
-			}
-		}
+void seedRandom(unsigned int seed)
+{
+	g_randomSeed = seed;
+}
 
-		// --- Waving Toggles ---
-		if (wParam == 'Q') {
-			g_isLeftWaveActive = !g_isLeftWaveActive;
-		}
-		if (wParam == 'E') {
-			g_isRightWaveActive = !g_isRightWaveActive;
-		}
+unsigned int randomUInt()
+{
+	thread_local unsigned int state = 0;
+	if (state == 0) {
+		// Each thread scrambles its own step of the shared seed
+		unsigned int seed = g_randomSeed.fetch_add(0x9e3779b9u);
+		seed ^= seed >> 16; seed *= 0x7feb352du;
+		seed ^= seed >> 15; seed *= 0x846ca68bu;
+		seed ^= seed >> 16;
+		state = seed ? seed : 1;
+	}
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
 
-		// --- Peace Sign Toggle ---
-		if (wParam == 'V') {
-			g_handPoseTarget = (g_handPoseTarget == 0) ? 1 : 0; // Toggle target
-		}
+// Uniform in [min, max)
+float randomFloat(float min, float max)
+{
+	return min + (max - min) * (float)(randomUInt() >> 8) * (1.0f / 16777216.0f);
+}
 
-		// --- Toggle Weapon Visibility ---
-		if (wParam == 'H') {
-			g_equippedWeapon++;
-			if (g_equippedWeapon > 2) { // Cycle through 0, 1, 2
-				g_equippedWeapon = 0;
-			}
-		}
+// --- Animation Clips ---
+// Every motion is a clip: a set of tracks, each a curve for one animation
+// channel (a joint angle or a layer weight for the blend tree). Clips are
+// authored below as plain functions of time. At startup each one is sampled
+// at ANIM_FIT_RATE and fitted to the fewest linear keys that stay within
+// ANIM_FIT_TOLERANCE of its range, then stored as 16-bit time/value pairs.
+// A player keeps a cursor per track, so advancing frame by frame in either
+// direction only ever steps to a neighbouring key.
+enum AnimChannel {
+	ANIM_RIGHT_SHOULDER_Z,
+	ANIM_RIGHT_SHOULDER_X,
+	ANIM_RIGHT_ELBOW,
+	ANIM_LEFT_SHOULDER_Z,
+	ANIM_LEFT_SHOULDER_X,
+	ANIM_LEFT_ELBOW,
+	ANIM_FIST,       // 0 = open, 1 = closed
+	ANIM_HANDS_OPEN, // Casting: how far both hands are forced open
+	ANIM_HAND_POSE,  // 0 = normal, 1 = peace sign
+	ANIM_LEFT_WAVE,  // 0 = down, 1 = raised
+	ANIM_RIGHT_WAVE,
+	ANIM_CHANNEL_COUNT
+};
 
-		if (wParam == 'M') {
-			if (g_armAnimationState == 0) {
-				g_armAnimationState = 1;
-				g_armAnimationTimer = 0.0f;
-
-				MatrixBlock newBlock;
-				newBlock.isActive = true;
-				newBlock.lifetime = 4.0f;
-				newBlock.state = SPAWNING;
-				newBlock.animationTimer = 0.0f;
-				newBlock.scaleX = newBlock.scaleY = newBlock.scaleZ = 0.1f;
-
-				const float spawnAreaSize = 15.0f;
-				float halfArea = spawnAreaSize / 2.0f;
-				float offsetX = -halfArea + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / spawnAreaSize));
-				float offsetZ = -halfArea + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / spawnAreaSize));
-
-				newBlock.posX = g_characterPosX + offsetX;
-				newBlock.posZ = g_characterPosZ + offsetZ;
-				newBlock.posY = 1.0f;
-
-				g_matrixBlocks.push_back(newBlock);
-			}
-			break;
-		}
-		if (wParam == 'L') {
-			g_isLevitating = !g_isLevitating;
-		}
-		if (wParam == 'H') g_isWeaponVisible = !g_isWeaponVisible;
-		if (wParam == VK_SPACE) {
-			resetAnimation();
-			g_isLeftWaveActive = false;
-			g_isRightWaveActive = false;
-			g_handPoseTarget = 0;
-			g_handPoseProgress = 0.0f;
-			g_equippedWeapon = 0;
-			g_isLevitating = false;
-		}
-		break;
+enum AnimClipId {
+	CLIP_CAST,
+	CLIP_FIST,
+	CLIP_PEACE,
+	CLIP_LEFT_WAVE,
+	CLIP_RIGHT_WAVE,
+	CLIP_WAVE_RAISE,
+	CLIP_WAVE_LOOP,
+	CLIP_COUNT
+};
 
-	case WM_KEYUP:
-		// --- Handle Key Releases to STOP movement ---
-		if (wParam == VK_UP && g_forwardDirection == 1)    g_forwardDirection = 0;
-		if (wParam == VK_DOWN && g_forwardDirection == -1)  g_forwardDirection = 0;
-		if (wParam == VK_RIGHT && g_strafeDirection == -1)  g_strafeDirection = 0;
-		if (wParam == VK_LEFT && g_strafeDirection == 1) g_strafeDirection = 0;
-		break;
+const float ANIM_FIT_RATE = 240.0f;       // Samples per second the authored curves are fitted from
+const float ANIM_FIT_TOLERANCE = 0.002f;  // Largest fitting error, as a fraction of the track's range
 
-	case WM_LBUTTONDOWN:
-	{
-		isDragging = true;
-		lastMouseX = LOWORD(lParam);
-		lastMouseY = HIWORD(lParam);
-		break;
-	}
+typedef float (*AnimCurveFn)(float t);
 
-	case WM_LBUTTONUP:
-	{
-		isDragging = false;
-		break;
+struct AnimCurveDesc {
+	AnimChannel channel;
+	AnimCurveFn curve;
+};
+
+struct AnimClipDesc {
+	const char* name;
+	float duration;
+	bool looping;
+	const AnimCurveDesc* curves;
+	int curveCount;
+};
+
+struct AnimKey {
+	unsigned short time;  // Fraction of the clip's duration, 0..65535
+	unsigned short value; // Fraction of the track's value range, 0..65535
+};
+
+struct AnimTrack {
+	AnimChannel channel;
+	int firstKey;
+	int keyCount;
+	float minValue;
+	float valueScale; // Value range / 65535
+};
+
+struct AnimClip {
+	const char* name;
+	float duration;
+	bool looping;
+	int firstTrack;
+	int trackCount;
+};
+
+std::vector<AnimKey> g_animKeys;     // Every clip's keys, track after track
+std::vector<AnimTrack> g_animTracks; // Every clip's tracks, clip after clip
+AnimClip g_animClips[CLIP_COUNT];
+float g_animClipReference[CLIP_COUNT][ANIM_CHANNEL_COUNT]; // Each clip's first frame; channels it lacks stay 0
+
+struct AnimPlayer {
+	AnimClipId clip = CLIP_CAST;
+	float time = 0.0f; // Seconds into the clip
+	float rate = 0.0f; // Playback speed; negative plays it backwards
+	bool playing = false;
+	bool scheduled = false; // In g_scheduledPlayers
+	int cursor[ANIM_CHANNEL_COUNT] = {}; // Per track: the key at or before the last sampled time
+	float channels[ANIM_CHANNEL_COUNT] = {}; // Last sampled value of every channel
+};
+
+AnimPlayer g_castAnimation;
+AnimPlayer g_fistAnimation;
+AnimPlayer g_handPoseAnimation;
+AnimPlayer g_leftWaveAnimation;
+AnimPlayer g_rightWaveAnimation;
+AnimPlayer g_waveRaiseAnimation;
+AnimPlayer g_waveLoopAnimation;
+
+// 0 before start, 1 after end, linear in between
+static float rampBetween(float t, float start, float end)
+{
+	if (t <= start) return 0.0f;
+	if (t >= end) return 1.0f;
+	return (t - start) / (end - start);
+}
+
+// Cast: raise both arms over 0.4 s, hold for 0.8 s, lower over 0.6 s.
+// The hands open as the arms rise and go back to how they were as they fall.
+static float castRaise(float t) { return rampBetween(t, 0.0f, 0.4f) - rampBetween(t, 1.2f, 1.8f); }
+static float castArm(float t, int joint) { return ARM_POSE_IDLE[joint] + (ARM_POSE_CASTING[joint] - ARM_POSE_IDLE[joint]) * castRaise(t); }
+
+const AnimCurveDesc CAST_CURVES[] = {
+	{ ANIM_RIGHT_SHOULDER_Z, [](float t) { return castArm(t, 0); } },
+	{ ANIM_RIGHT_SHOULDER_X, [](float t) { return castArm(t, 1); } },
+	{ ANIM_RIGHT_ELBOW, [](float t) { return castArm(t, 2); } },
+	{ ANIM_LEFT_SHOULDER_Z, [](float t) { return -castArm(t, 0); } },
+	{ ANIM_LEFT_SHOULDER_X, [](float t) { return castArm(t, 1); } },
+	{ ANIM_LEFT_ELBOW, [](float t) { return castArm(t, 2); } },
+	{ ANIM_HANDS_OPEN, [](float t) { return castRaise(t); } },
+};
+
+// Toggles played forwards to turn on and backwards to turn off
+const AnimCurveDesc FIST_CURVES[] = { { ANIM_FIST, [](float t) { return rampBetween(t, 0.0f, 0.4f); } } };
+const AnimCurveDesc PEACE_CURVES[] = { { ANIM_HAND_POSE, [](float t) { return rampBetween(t, 0.0f, 0.2f); } } };
+const AnimCurveDesc LEFT_WAVE_CURVES[] = { { ANIM_LEFT_WAVE, [](float t) { return rampBetween(t, 0.0f, 1.0f / 3.0f); } } };
+const AnimCurveDesc RIGHT_WAVE_CURVES[] = { { ANIM_RIGHT_WAVE, [](float t) { return rampBetween(t, 0.0f, 1.0f / 3.0f); } } };
+
+// Greeting wave: raise the right arm over 0.5 s, then swing it from the elbow
+static float waveRaiseArm(float t, int joint) { return ARM_POSE_IDLE[joint] + (ARM_POSE_WAVE[joint] - ARM_POSE_IDLE[joint]) * rampBetween(t, 0.0f, 0.5f); }
+
+const AnimCurveDesc WAVE_RAISE_CURVES[] = {
+	{ ANIM_RIGHT_SHOULDER_Z, [](float t) { return waveRaiseArm(t, 0); } },
+	{ ANIM_RIGHT_SHOULDER_X, [](float t) { return waveRaiseArm(t, 1); } },
+	{ ANIM_RIGHT_ELBOW, [](float t) { return waveRaiseArm(t, 2); } },
+};
+const AnimCurveDesc WAVE_LOOP_CURVES[] = { { ANIM_RIGHT_ELBOW, [](float t) { return ARM_POSE_WAVE[2] + sinf(t * 10.0f) * 20.0f; } } };
+
+const AnimClipDesc ANIM_CLIP_DESCS[CLIP_COUNT] = {
+	{ "cast", 1.8f, false, CAST_CURVES, sizeof(CAST_CURVES) / sizeof(CAST_CURVES[0]) },
+	{ "fist", 0.4f, false, FIST_CURVES, 1 },
+	{ "peace sign", 0.2f, false, PEACE_CURVES, 1 },
+	{ "left wave", 1.0f / 3.0f, false, LEFT_WAVE_CURVES, 1 },
+	{ "right wave", 1.0f / 3.0f, false, RIGHT_WAVE_CURVES, 1 },
+	{ "wave raise", 0.5f, false, WAVE_RAISE_CURVES, sizeof(WAVE_RAISE_CURVES) / sizeof(WAVE_RAISE_CURVES[0]) },
+	{ "wave loop", 2.0f * 3.14159265f / 10.0f, true, WAVE_LOOP_CURVES, 1 },
+};
+
+// True if the straight line between samples first and last passes within
+// tolerance of every sample in between
+static bool animLineFits(const std::vector<float>& samples, int first, int last, float tolerance)
+{
+	float step = (samples[last] - samples[first]) / (float)(last - first);
+	for (int i = first + 1; i < last; ++i) {
+		if (fabsf(samples[first] + step * (float)(i - first) - samples[i]) > tolerance) return false;
 	}
+	return true;
+}
 
-	case WM_MOUSEMOVE:
-	{
-		if (isDragging)
-		{
-			int currentMouseX = LOWORD(lParam);
-			int currentMouseY = HIWORD(lParam);
-			float deltaX = (float)(currentMouseX - lastMouseX);
-			float deltaY = (float)(currentMouseY - lastMouseY);
-			rotateY += deltaX * 0.2f;
-			rotateX += deltaY * 0.2f;
-			lastMouseX = currentMouseX;
-			lastMouseY = currentMouseY;
-		}
-		break;
+static void fitAnimTrack(const AnimCurveDesc& desc, float duration, AnimTrack& track)
+{
+	int sampleCount = (int)ceilf(duration * ANIM_FIT_RATE) + 1;
+	std::vector<float> samples(sampleCount);
+	float lo = FLT_MAX, hi = -FLT_MAX;
+	for (int i = 0; i < sampleCount; ++i) {
+		samples[i] = desc.curve(duration * (float)i / (float)(sampleCount - 1));
+		if (samples[i] < lo) lo = samples[i];
+		if (samples[i] > hi) hi = samples[i];
 	}
+	track.channel = desc.channel;
+	track.minValue = lo;
+	track.valueScale = (hi - lo) / 65535.0f;
+	track.firstKey = (int)g_animKeys.size();
+
+	float tolerance = (hi - lo) * ANIM_FIT_TOLERANCE;
+	auto addKey = [&](int sample) {
+		AnimKey key;
+		key.time = (unsigned short)(65535.0f * (float)sample / (float)(sampleCount - 1) + 0.5f);
+		key.value = track.valueScale > 0.0f ? (unsigned short)((samples[sample] - lo) / track.valueScale + 0.5f) : 0;
+		g_animKeys.push_back(key);
+	};
 
-	case WM_MOUSEWHEEL:
-	{
-		int zDelta = GET_WHEEL_DELTA_WPARAM(wParam);
-		if (zDelta > 0)
-		{
-			zoomFactor += 0.5f;
-		}
-		else if (zDelta < 0)
-		{
-			zoomFactor -= 0.5f;
-		}
-		if (zoomFactor > -2.0f) zoomFactor = -2.0f;
-		if (zoomFactor < -20.0f) zoomFactor = -20.0f;
-		break;
+	// Greedy: from each key, reach as far as one straight segment still fits
+	int anchor = 0;
+	addKey(anchor);
+	while (anchor < sampleCount - 1) {
+		int end = anchor + 1;
+		while (end + 1 < sampleCount && animLineFits(samples, anchor, end + 1, tolerance)) ++end;
+		addKey(end);
+		anchor = end;
 	}
+	track.keyCount = (int)g_animKeys.size() - track.firstKey;
+}
 
-	default:
-		break;
+void initAnimationClips()
+{
+	g_animKeys.clear();
+	g_animTracks.clear();
+	size_t sampleBytes = 0;
+	for (int c = 0; c < CLIP_COUNT; ++c) {
+		const AnimClipDesc& desc = ANIM_CLIP_DESCS[c];
+		AnimClip& clip = g_animClips[c];
+		clip.name = desc.name;
+		clip.duration = desc.duration;
+		clip.looping = desc.looping;
+		clip.firstTrack = (int)g_animTracks.size();
+		clip.trackCount = desc.curveCount;
+		for (int i = 0; i < desc.curveCount; ++i) {
+			AnimTrack track;
+			fitAnimTrack(desc.curves[i], desc.duration, track);
+			g_animTracks.push_back(track);
+			g_animClipReference[c][track.channel] = desc.curves[i].curve(0.0f);
+			sampleBytes += ((size_t)ceilf(desc.duration * ANIM_FIT_RATE) + 1) * sizeof(float);
+		}
 	}
 
-	return DefWindowProc(hWnd, msg, wParam, lParam);
+	char buffer[160];
+	sprintf_s(buffer, "Animation clips: %d clips, %zu tracks, %zu keys in %zu bytes (%zu bytes as float samples)\n",
+		(int)CLIP_COUNT, g_animTracks.size(), g_animKeys.size(),
+		g_animKeys.size() * sizeof(AnimKey) + g_animTracks.size() * sizeof(AnimTrack), sampleBytes);
+	OutputDebugStringA(buffer);
 }
 
-bool initPixelFormat(HDC hdc)
+// Value of a track at time (in 1/65535ths of the clip), starting the key
+// search from where the last sample of this track left off
+static float sampleAnimTrack(const AnimTrack& track, float time, int& cursor)
 {
-	PIXELFORMATDESCRIPTOR pfd;
-	ZeroMemory(&pfd, sizeof(PIXELFORMATDESCRIPTOR));
-	pfd.cAlphaBits = 8;
-	pfd.cColorBits = 32;
-	pfd.cDepthBits = 24;
-	pfd.cStencilBits = 0;
-	pfd.dwFlags = PFD_DOUBLEBUFFER | PFD_SUPPORT_OPENGL | PFD_DRAW_TO_WINDOW;
-	pfd.iLayerType = PFD_MAIN_PLANE;
-	pfd.iPixelType = PFD_TYPE_RGBA;
-	pfd.nSize = sizeof(PIXELFORMATDESCRIPTOR);
-	pfd.nVersion = 1;
-	int n = ChoosePixelFormat(hdc, &pfd);
-	if (SetPixelFormat(hdc, n, &pfd))
-	{
-		return true;
+	const AnimKey* keys = &g_animKeys[track.firstKey];
+	int lastSegment = track.keyCount - 2;
+	if (cursor > lastSegment) cursor = lastSegment;
+	while (cursor > 0 && keys[cursor].time > time) --cursor;
+	while (cursor < lastSegment && keys[cursor + 1].time <= time) ++cursor;
+
+	const AnimKey& a = keys[cursor];
+	const AnimKey& b = keys[cursor + 1];
+	float f = (time - a.time) / (float)(b.time - a.time);
+	if (f < 0.0f) f = 0.0f;
+	if (f > 1.0f) f = 1.0f;
+	return track.minValue + ((float)a.value + ((float)b.value - (float)a.value) * f) * track.valueScale;
+}
+
+static void sampleAnimPlayer(AnimPlayer& player)
+{
+	const AnimClip& clip = g_animClips[player.clip];
+	float time = player.time / clip.duration * 65535.0f;
+	for (int i = 0; i < clip.trackCount; ++i) {
+		const AnimTrack& track = g_animTracks[clip.firstTrack + i];
+		player.channels[track.channel] = sampleAnimTrack(track, time, player.cursor[i]);
 	}
-	else
-	{
-		return false;
+}
+
+// Moves the player on; returns true if it was playing and so needs sampling
+static bool advanceAnimPlayer(AnimPlayer& player, float deltaTime)
+{
+	if (!player.playing) return false;
+	const AnimClip& clip = g_animClips[player.clip];
+	player.time += player.rate * deltaTime;
+	if (clip.looping) {
+		if (player.time >= clip.duration || player.time < 0.0f) {
+			player.time = fmodf(player.time, clip.duration);
+			if (player.time < 0.0f) player.time += clip.duration;
+			// Wrapped around: restart the cursors at the end playback re-enters from
+			for (int i = 0; i < clip.trackCount; ++i) {
+				player.cursor[i] = player.rate > 0.0f ? 0 : INT_MAX; // Clamped to the last segment when sampled
+			}
+		}
+	}
+	else if (player.time >= clip.duration) {
+		player.time = clip.duration;
+		player.playing = false;
+	}
+	else if (player.time <= 0.0f) {
+		player.time = 0.0f;
+		player.playing = false;
 	}
+	return true;
 }
 
-GLuint loadTextureBMP(const char* imagepath) {
-	// Use OutputDebugStringA for logging in a Win32 application
-	char buffer[256];
-	sprintf_s(buffer, "Reading image %s\n", imagepath);
-	OutputDebugStringA(buffer);
+std::vector<AnimPlayer*> g_scheduledPlayers; // Players with time left to play
 
-	unsigned char header[54];
-	unsigned int dataPos;
-	unsigned int width, height;
-	unsigned int imageSize;
-	unsigned char* data;
+static void scheduleAnimPlayer(AnimPlayer& player)
+{
+	if (!player.scheduled) {
+		player.scheduled = true;
+		g_scheduledPlayers.push_back(&player);
+	}
+	activateAnimTask(TASK_CLIP_PLAYERS);
+}
 
-	FILE* file;
-	fopen_s(&file, imagepath, "rb");
-	if (!file) {
-		OutputDebugStringA("Error: Image could not be opened.\n");
-		return 0;
+// Plays a clip from the start
+void playAnimClip(AnimPlayer& player, AnimClipId clip)
+{
+	player.clip = clip;
+	player.time = 0.0f;
+	player.rate = 1.0f;
+	player.playing = true;
+	for (int i = 0; i < ANIM_CHANNEL_COUNT; ++i) {
+		player.cursor[i] = 0;
+		player.channels[i] = g_animClipReference[clip][i];
 	}
+	scheduleAnimPlayer(player);
+}
 
-	if (fread(header, 1, 54, file) != 54) {
-		OutputDebugStringA("Error: Not a correct BMP file (header read failed).\n");
-		fclose(file);
-		return 0;
+// Plays a toggle clip towards its end (on) or its start (off) from wherever it is now
+void playAnimToward(AnimPlayer& player, AnimClipId clip, bool forwards)
+{
+	if (player.clip != clip) {
+		playAnimClip(player, clip);
 	}
-	if (header[0] != 'B' || header[1] != 'M') {
-		OutputDebugStringA("Error: Not a correct BMP file (magic number mismatch).\n");
-		fclose(file);
-		return 0;
+	player.rate = forwards ? 1.0f : -1.0f;
+	player.playing = forwards ? player.time < g_animClips[clip].duration : player.time > 0.0f;
+	if (player.playing) {
+		scheduleAnimPlayer(player);
 	}
+}
 
-	// Read important information from the header
-	dataPos = *(int*)&(header[0x0A]);
-	imageSize = *(int*)&(header[0x22]);
-	width = *(int*)&(header[0x12]);
-	height = *(int*)&(header[0x16]);
-	unsigned short bitsPerPixel = *(unsigned short*)&(header[0x1C]);
-
-	// --- NEW: Handle both 24-bit (RGB) and 32-bit (RGBA) BMPs ---
-	GLenum internalFormat;
-	GLenum pixelFormat;
-	int bytesPerPixel;
-
-	if (bitsPerPixel == 32) {
-		internalFormat = GL_RGBA;
-		pixelFormat = GL_BGRA_EXT; // Windows BMPs store alpha channels in BGRA format
-		bytesPerPixel = 4;
+void stopAnimPlayer(AnimPlayer& player)
+{
+	player.time = 0.0f;
+	player.playing = false;
+	for (int i = 0; i < ANIM_CHANNEL_COUNT; ++i) {
+		player.channels[i] = g_animClipReference[player.clip][i];
 	}
-	else if (bitsPerPixel == 24) {
-		internalFormat = GL_RGB;
-		pixelFormat = GL_BGR_EXT;  // Windows BMPs store colors in BGR format
-		bytesPerPixel = 3;
+	activateAnimTask(TASK_POSE);
+}
+
+// The greeting wave raises the right arm, then swings it from the elbow until it is turned off
+void setGreetingWave(bool waving)
+{
+	g_isWaving = waving;
+	playAnimToward(g_waveRaiseAnimation, CLIP_WAVE_RAISE, waving);
+	if (!waving) {
+		g_waveLoopAnimation.playing = false;
 	}
-	else {
-		sprintf_s(buffer, "Error: Unsupported BMP format (%d bits per pixel).\n", bitsPerPixel);
-		OutputDebugStringA(buffer);
-		fclose(file);
-		return 0;
+}
+
+// Clips that lead into another when they finish
+static void onAnimPlayerFinished(AnimPlayer& player)
+{
+	if (&player == &g_waveRaiseAnimation && player.rate > 0.0f && g_isWaving) {
+		playAnimClip(g_waveLoopAnimation, CLIP_WAVE_LOOP);
 	}
+}
 
-	// Some BMP files may leave these fields as 0
-	if (imageSize == 0) { imageSize = width * height * bytesPerPixel; }
-	if (dataPos == 0) { dataPos = 54; } // The size of the header
+// TASK_CLIP_PLAYERS: advances the scheduled players. A player leaves the
+// schedule once it stops, and the task once no player is left.
+bool tickClipPlayers(float deltaTime)
+{
+	for (size_t i = 0; i < g_scheduledPlayers.size();) {
+		AnimPlayer& player = *g_scheduledPlayers[i];
+		if (advanceAnimPlayer(player, deltaTime)) {
+			sampleAnimPlayer(player);
+			if (!player.playing) {
+				onAnimPlayerFinished(player);
+			}
+		}
+		if (player.playing) {
+			++i;
+			continue;
+		}
+		player.scheduled = false;
+		g_scheduledPlayers[i] = g_scheduledPlayers.back();
+		g_scheduledPlayers.pop_back();
+	}
+	activateAnimTask(TASK_POSE);
+	return !g_scheduledPlayers.empty();
+}
 
-	// Create a buffer to hold the data
-	data = new unsigned char[imageSize];
+// --- Animation Blend Tree ---
+// Joint rotations are quaternions, stored SoA so that one SSE instruction
+// blends four joints. The clip players feed the tree. Clips that move the
+// arms are layered additively, relative to their own first frame, so a cast
+// during a greeting wave adds to the raised arm instead of snapping over it.
+// Toggles become the weights of lerp layers masked to an arm or a hand.
+// evaluateBlendTree() runs the nodes in order and leaves the finished pose
+// in g_characterPose, which the draw code reads joint by joint.
+const int HAND_JOINT_COUNT = 13; // Three per finger, then the thumb
+const int HAND_THUMB_JOINT = 12;
+
+enum PoseJoint {
+	JOINT_RIGHT_SHOULDER,
+	JOINT_RIGHT_ELBOW,
+	JOINT_LEFT_SHOULDER,
+	JOINT_LEFT_ELBOW,
+	JOINT_RIGHT_HAND,
+	JOINT_LEFT_HAND = JOINT_RIGHT_HAND + HAND_JOINT_COUNT,
+	JOINT_COUNT = JOINT_LEFT_HAND + HAND_JOINT_COUNT
+};
 
-	// Read the actual image data from the file
-	fseek(file, dataPos, SEEK_SET);
-	size_t readResult = fread(data, 1, imageSize, file);
+const int POSE_CAPACITY = (JOINT_COUNT + 3) & ~3; // Whole SSE lanes
 
-	// Error check after reading
-	if (readResult != imageSize) {
-		OutputDebugStringA("Error: Could not read all pixel data from file.\n");
-		fclose(file);
-		delete[] data; // IMPORTANT: Free memory on failure
-		return 0;
-	}
+struct alignas(16) Pose {
+	float x[POSE_CAPACITY], y[POSE_CAPACITY], z[POSE_CAPACITY], w[POSE_CAPACITY];
+};
 
-	fclose(file); // File is no longer needed
+enum PoseSlot {
+	// Fixed poses, built once
+	POSE_IDLE,       // Arms down, hands open
+	POSE_FIST,       // Both hands closed
+	POSE_PEACE,      // Both hands making the peace sign
+	POSE_WAVE_ELBOW, // Both elbows bent up to wave
+	// Additive poses refreshed from the clip players every frame
+	POSE_CAST_DELTA,
+	POSE_WAVE_RAISE_DELTA,
+	POSE_WAVE_SWING_DELTA,
+	POSE_INPUT_COUNT
+};
 
-	// --- Create one OpenGL texture ---
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
+enum BlendNodeType { BLEND_LERP, BLEND_ADDITIVE };
+enum BlendMask { MASK_HANDS, MASK_RIGHT_HAND, MASK_LEFT_ELBOW, MASK_RIGHT_ELBOW, MASK_ARMS, MASK_COUNT };
 
-	// Give the image to OpenGL
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, pixelFormat, GL_UNSIGNED_BYTE, data);
+struct BlendNode {
+	BlendNodeType type;
+	int input;      // Pose blended onto: a PoseSlot, or POSE_INPUT_COUNT + an earlier node
+	int source;     // Pose blended in (the target of a lerp, the delta of an additive layer)
+	BlendMask mask; // Joints the layer applies to
+	float weight;   // Set every frame from the players
+};
 
-	// Set Texture filtering and wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+enum BlendNodeId {
+	NODE_FIST,
+	NODE_GRIP,
+	NODE_PEACE,
+	NODE_CAST_HANDS,
+	NODE_CAST,
+	NODE_WAVE_RAISE,
+	NODE_WAVE_SWING,
+	NODE_LEFT_WAVE,
+	NODE_RIGHT_WAVE,
+	NODE_COUNT
+};
 
-	// Generate Mipmaps for the texture
-	gluBuild2DMipmaps(GL_TEXTURE_2D, internalFormat, width, height, pixelFormat, GL_UNSIGNED_BYTE, data);
+BlendNode g_blendTree[NODE_COUNT] = {
+	{ BLEND_LERP, POSE_IDLE, POSE_FIST, MASK_HANDS, 0.0f },                                       // F: close both hands
+	{ BLEND_LERP, POSE_INPUT_COUNT + NODE_FIST, POSE_FIST, MASK_RIGHT_HAND, 0.0f },              // Holding the staff
+	{ BLEND_LERP, POSE_INPUT_COUNT + NODE_GRIP, POSE_PEACE, MASK_HANDS, 0.0f },                  // V: peace sign
+	{ BLEND_LERP, POSE_INPUT_COUNT + NODE_PEACE, POSE_IDLE, MASK_HANDS, 0.0f },                  // Casting opens the hands
+	{ BLEND_ADDITIVE, POSE_INPUT_COUNT + NODE_CAST_HANDS, POSE_CAST_DELTA, MASK_ARMS, 0.0f },     // G/M: cast
+	{ BLEND_ADDITIVE, POSE_INPUT_COUNT + NODE_CAST, POSE_WAVE_RAISE_DELTA, MASK_ARMS, 0.0f },     // Greeting wave: arm up
+	{ BLEND_ADDITIVE, POSE_INPUT_COUNT + NODE_WAVE_RAISE, POSE_WAVE_SWING_DELTA, MASK_ARMS, 0.0f }, // Greeting wave: swing
+	{ BLEND_LERP, POSE_INPUT_COUNT + NODE_WAVE_SWING, POSE_WAVE_ELBOW, MASK_LEFT_ELBOW, 0.0f },  // Q: left wave
+	{ BLEND_LERP, POSE_INPUT_COUNT + NODE_LEFT_WAVE, POSE_WAVE_ELBOW, MASK_RIGHT_ELBOW, 0.0f },  // E: right wave
+};
 
-	// Once the texture is loaded into VRAM, we can free the host RAM
-	delete[] data;
+Pose g_blendPoses[POSE_INPUT_COUNT + NODE_COUNT - 1]; // Inputs, then every node's result but the last
+Pose g_characterPose;                                 // The last node's result
+alignas(16) float g_blendMasks[MASK_COUNT][POSE_CAPACITY];
 
-	return textureID;
+static void quatMultiply(const float a[4], const float b[4], float out[4])
+{
+	float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+	float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+	float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+	out[0] = x; out[1] = y; out[2] = z; out[3] = w;
 }
-//--------------------------------------------------------------------
 
-// --- Helper Functions to Draw Body Parts ---
+// Same rotation as glRotatef(degrees, x, y, z) about a unit axis
+static void quatFromAxisAngle(float degrees, float x, float y, float z, float out[4])
+{
+	float half = degrees * (3.14159265f / 360.0f);
+	float s = sinf(half);
+	out[0] = x * s; out[1] = y * s; out[2] = z * s; out[3] = cosf(half);
+}
 
-void drawCuboid(float width, float height, float depth)
+// Shoulders turn about Z, then X, like the glRotatef pair they replace
+static void shoulderQuat(float angleZ, float angleX, float out[4])
 {
-	float w = width / 2.0f;
-	float h = height / 2.0f;
-	float d = depth / 2.0f;
+	float qz[4], qx[4];
+	quatFromAxisAngle(angleZ, 0.0f, 0.0f, 1.0f, qz);
+	quatFromAxisAngle(angleX, 1.0f, 0.0f, 0.0f, qx);
+	quatMultiply(qz, qx, out);
+}
 
-	glBegin(GL_QUADS);
-	// Front Face
-	glNormal3f(0.0f, 0.0f, 1.0f);
-	glVertex3f(-w, -h, d); glVertex3f(w, -h, d); glVertex3f(w, h, d); glVertex3f(-w, h, d);
-	// Back Face
-	glNormal3f(0.0f, 0.0f, -1.0f);
-	glVertex3f(-w, -h, -d); glVertex3f(-w, h, -d); glVertex3f(w, h, -d); glVertex3f(w, -h, -d);
-	// Top Face
-	glNormal3f(0.0f, 1.0f, 0.0f);
-	glVertex3f(-w, h, -d); glVertex3f(-w, h, d); glVertex3f(w, h, d); glVertex3f(w, h, -d);
-	// Bottom Face
-	glNormal3f(0.0f, -1.0f, 0.0f);
-	glVertex3f(-w, -h, -d); glVertex3f(w, -h, -d); glVertex3f(w, -h, d); glVertex3f(-w, -h, d);
-	// Right face
-	glNormal3f(1.0f, 0.0f, 0.0f);
-	glVertex3f(w, -h, -d); glVertex3f(w, h, -d); glVertex3f(w, h, d); glVertex3f(w, -h, d);
-	// Left Face
-	glNormal3f(-1.0f, 0.0f, 0.0f);
-	glVertex3f(-w, -h, -d); glVertex3f(-w, -h, d); glVertex3f(-w, h, d); glVertex3f(-w, h, -d);
-	glEnd();
+static void setPoseJoint(Pose& pose, int joint, const float q[4])
+{
+	pose.x[joint] = q[0]; pose.y[joint] = q[1]; pose.z[joint] = q[2]; pose.w[joint] = q[3];
 }
 
-void drawCurvedShoulderPads()
+static void getPoseJoint(const Pose& pose, int joint, float q[4])
 {
-	// Set material properties for the shoulder pads
-	GLfloat mat_ambient[] = { 0.45f, 0.38f, 0.1f, 1.0f };
-	GLfloat mat_diffuse[] = { 1.0f, 0.84f, 0.0f, 1.0f };
-	GLfloat mat_specular[] = { 1.0f, 1.0f, 0.8f, 1.0f };
-	GLfloat mat_shininess[] = { 100.0f };
-	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+	q[0] = pose.x[joint]; q[1] = pose.y[joint]; q[2] = pose.z[joint]; q[3] = pose.w[joint];
+}
 
-	// --- NEW: Enable and apply the Silver texture ---
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, g_silverTextureID);
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+static void setPoseJointX(Pose& pose, int joint, float degrees)
+{
+	float q[4];
+	quatFromAxisAngle(degrees, 1.0f, 0.0f, 0.0f, q);
+	setPoseJoint(pose, joint, q);
+}
 
-	// Set the base colour to white for proper texturing
-	glColor3f(1.0f, 1.0f, 1.0f);
+static void setIdentityPose(Pose& pose)
+{
+	for (int j = 0; j < POSE_CAPACITY; ++j) {
+		pose.x[j] = pose.y[j] = pose.z[j] = 0.0f;
+		pose.w[j] = 1.0f;
+	}
+}
 
-	auto drawOneShoulder = [&](bool isLeft) {
-		glPushMatrix();
-		glTranslatef(isLeft ? -0.38f : 0.38f, 0.7f, 0.0f);
-		glRotatef(isLeft ? 20.0f : -20.0f, 0.0f, 0.0f, 1.0f);
-		glRotatef(-25.0f, 1.0f, 0.0f, 0.0f);
+// Arm joints from the six arm channels of a clip (shoulder Z/X and elbow, right then left)
+static void setArmPose(Pose& pose, const float* channels)
+{
+	float q[4];
+	shoulderQuat(channels[ANIM_RIGHT_SHOULDER_Z], channels[ANIM_RIGHT_SHOULDER_X], q);
+	setPoseJoint(pose, JOINT_RIGHT_SHOULDER, q);
+	setPoseJointX(pose, JOINT_RIGHT_ELBOW, channels[ANIM_RIGHT_ELBOW]);
+	shoulderQuat(channels[ANIM_LEFT_SHOULDER_Z], channels[ANIM_LEFT_SHOULDER_X], q);
+	setPoseJoint(pose, JOINT_LEFT_SHOULDER, q);
+	setPoseJointX(pose, JOINT_LEFT_ELBOW, channels[ANIM_LEFT_ELBOW]);
+}
 
-		// The cuboids will now be textured since texturing is enabled.
-		// We can add texture coordinates to the cuboid function for better mapping,
-		// but for a simple metal texture, the default mapping will work fine.
+// Finger segments and thumb of one hand; straight[] picks per finger between two angle sets
+static void setHandPose(Pose& pose, int handJoint, const float* fingerAngles, const float* otherAngles, const bool* useOther, float thumbAngle)
+{
+	for (int finger = 0; finger < 4; ++finger) {
+		const float* angles = useOther[finger] ? otherAngles : fingerAngles;
+		for (int segment = 0; segment < 3; ++segment) {
+			setPoseJointX(pose, handJoint + finger * 3 + segment, angles[segment]);
+		}
+	}
+	setPoseJointX(pose, handJoint + HAND_THUMB_JOINT, thumbAngle);
+}
 
-		// --- Bottom Layer (Largest, Darker Panel) ---
-		glPushMatrix();
-		glTranslatef(0.0f, 0.0f, -0.05f);
-		glScalef(1.2f, 0.8f, 0.1f);
-		glRotatef(isLeft ? 10.0f : -10.0f, 0.0f, 1.0f, 0.0f);
-		drawCuboid(0.4f, 0.2f, 1.0f);
-		glPopMatrix();
+void initBlendTree()
+{
+	float idleChannels[ANIM_CHANNEL_COUNT] = {};
+	idleChannels[ANIM_RIGHT_SHOULDER_Z] = ARM_POSE_IDLE[0];
+	idleChannels[ANIM_RIGHT_SHOULDER_X] = ARM_POSE_IDLE[1];
+	idleChannels[ANIM_RIGHT_ELBOW] = ARM_POSE_IDLE[2];
+	idleChannels[ANIM_LEFT_SHOULDER_Z] = -ARM_POSE_IDLE[0]; // Left arm is mirrored on Z
+	idleChannels[ANIM_LEFT_SHOULDER_X] = ARM_POSE_IDLE[1];
+	idleChannels[ANIM_LEFT_ELBOW] = ARM_POSE_IDLE[2];
+
+	const bool none[4] = { false, false, false, false };
+	Pose& idle = g_blendPoses[POSE_IDLE];
+	setIdentityPose(idle);
+	setArmPose(idle, idleChannels);
+	setHandPose(idle, JOINT_RIGHT_HAND, FINGER_OPEN_ANGLES, FINGER_OPEN_ANGLES, none, THUMB_OPEN_ANGLE);
+	setHandPose(idle, JOINT_LEFT_HAND, FINGER_OPEN_ANGLES, FINGER_OPEN_ANGLES, none, THUMB_OPEN_ANGLE);
+
+	Pose& fist = g_blendPoses[POSE_FIST];
+	fist = idle;
+	setHandPose(fist, JOINT_RIGHT_HAND, FINGER_CLOSED_ANGLES, FINGER_CLOSED_ANGLES, none, THUMB_CLOSED_ANGLE);
+	setHandPose(fist, JOINT_LEFT_HAND, FINGER_CLOSED_ANGLES, FINGER_CLOSED_ANGLES, none, THUMB_CLOSED_ANGLE);
+
+	// The left hand straightens its first two fingers, the right hand its last two
+	const bool leftStraight[4] = { true, true, false, false };
+	const bool rightStraight[4] = { false, false, true, true };
+	Pose& peace = g_blendPoses[POSE_PEACE];
+	peace = idle;
+	setHandPose(peace, JOINT_RIGHT_HAND, PEACE_CURLED_ANGLES, PEACE_STRAIGHT_ANGLES, rightStraight, PEACE_THUMB_ANGLE);
+	setHandPose(peace, JOINT_LEFT_HAND, PEACE_CURLED_ANGLES, PEACE_STRAIGHT_ANGLES, leftStraight, PEACE_THUMB_ANGLE);
+
+	Pose& waveElbow = g_blendPoses[POSE_WAVE_ELBOW];
+	waveElbow = idle;
+	setPoseJointX(waveElbow, JOINT_RIGHT_ELBOW, ARM_POSE_WAVE_ELBOW);
+	setPoseJointX(waveElbow, JOINT_LEFT_ELBOW, ARM_POSE_WAVE_ELBOW);
+
+	for (int slot = POSE_CAST_DELTA; slot < POSE_INPUT_COUNT; ++slot) {
+		setIdentityPose(g_blendPoses[slot]);
+	}
 
-		// --- Middle Layer (Main Panel) ---
-		glPushMatrix();
-		glTranslatef(0.0f, 0.02f, 0.0f);
-		glScalef(1.0f, 0.9f, 0.12f);
-		glRotatef(isLeft ? -5.0f : 5.0f, 0.0f, 1.0f, 0.0f);
-		drawCuboid(0.4f, 0.2f, 1.0f);
-		glPopMatrix();
+	memset(g_blendMasks, 0, sizeof(g_blendMasks));
+	for (int j = 0; j < HAND_JOINT_COUNT; ++j) {
+		g_blendMasks[MASK_HANDS][JOINT_RIGHT_HAND + j] = 1.0f;
+		g_blendMasks[MASK_HANDS][JOINT_LEFT_HAND + j] = 1.0f;
+		g_blendMasks[MASK_RIGHT_HAND][JOINT_RIGHT_HAND + j] = 1.0f;
+	}
+	g_blendMasks[MASK_LEFT_ELBOW][JOINT_LEFT_ELBOW] = 1.0f;
+	g_blendMasks[MASK_RIGHT_ELBOW][JOINT_RIGHT_ELBOW] = 1.0f;
+	for (int j = JOINT_RIGHT_SHOULDER; j <= JOINT_LEFT_ELBOW; ++j) {
+		g_blendMasks[MASK_ARMS][j] = 1.0f;
+	}
+}
 
-		// --- Top Layer (Smaller, More Angular Panel) ---
-		glPushMatrix();
-		glTranslatef(0.0f, 0.05f, 0.05f);
-		glScalef(0.8f, 0.8f, 0.15f);
-		drawCuboid(0.4f, 0.2f, 1.0f);
-		glPopMatrix();
+// out = normalize(lerp(a, b, weight)) per joint, taking the shorter way round
+static void blendLerp(const Pose& a, const Pose& b, const float* weights, Pose& out)
+{
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	for (int j = 0; j < POSE_CAPACITY; j += 4) {
+		__m128 ax = _mm_load_ps(&a.x[j]), ay = _mm_load_ps(&a.y[j]), az = _mm_load_ps(&a.z[j]), aw = _mm_load_ps(&a.w[j]);
+		__m128 bx = _mm_load_ps(&b.x[j]), by = _mm_load_ps(&b.y[j]), bz = _mm_load_ps(&b.z[j]), bw = _mm_load_ps(&b.w[j]);
+		__m128 t = _mm_load_ps(&weights[j]);
+
+		// Flip b onto a's hemisphere where they point apart
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 flip = _mm_and_ps(dot, signBit);
+		bx = _mm_xor_ps(bx, flip); by = _mm_xor_ps(by, flip); bz = _mm_xor_ps(bz, flip); bw = _mm_xor_ps(bw, flip);
+
+		__m128 rx = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), t));
+		__m128 ry = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), t));
+		__m128 rz = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), t));
+		__m128 rw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), t));
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw)));
+		__m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSq));
+		_mm_store_ps(&out.x[j], _mm_mul_ps(rx, invLength));
+		_mm_store_ps(&out.y[j], _mm_mul_ps(ry, invLength));
+		_mm_store_ps(&out.z[j], _mm_mul_ps(rz, invLength));
+		_mm_store_ps(&out.w[j], _mm_mul_ps(rw, invLength));
+	}
+}
 
-		glPopMatrix();
-		};
+// out = base * nlerp(identity, delta, weight) per joint: the delta applied in the joint's own frame
+static void blendAdditive(const Pose& base, const Pose& delta, const float* weights, Pose& out)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (int j = 0; j < POSE_CAPACITY; j += 4) {
+		__m128 t = _mm_load_ps(&weights[j]);
+		// Scale the delta towards identity (0, 0, 0, 1), then renormalize
+		__m128 dx = _mm_mul_ps(_mm_load_ps(&delta.x[j]), t);
+		__m128 dy = _mm_mul_ps(_mm_load_ps(&delta.y[j]), t);
+		__m128 dz = _mm_mul_ps(_mm_load_ps(&delta.z[j]), t);
+		__m128 dw = _mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&delta.w[j]), one), t));
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_add_ps(_mm_mul_ps(dz, dz), _mm_mul_ps(dw, dw)));
+		__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+		dx = _mm_mul_ps(dx, invLength); dy = _mm_mul_ps(dy, invLength); dz = _mm_mul_ps(dz, invLength); dw = _mm_mul_ps(dw, invLength);
+
+		__m128 ax = _mm_load_ps(&base.x[j]), ay = _mm_load_ps(&base.y[j]), az = _mm_load_ps(&base.z[j]), aw = _mm_load_ps(&base.w[j]);
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, dx), _mm_mul_ps(ax, dw)), _mm_sub_ps(_mm_mul_ps(ay, dz), _mm_mul_ps(az, dy)));
+		__m128 ry = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, dy), _mm_mul_ps(ax, dz)), _mm_add_ps(_mm_mul_ps(ay, dw), _mm_mul_ps(az, dx)));
+		__m128 rz = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, dz), _mm_mul_ps(ay, dx)), _mm_add_ps(_mm_mul_ps(ax, dy), _mm_mul_ps(az, dw)));
+		__m128 rw = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, dw), _mm_mul_ps(ax, dx)), _mm_add_ps(_mm_mul_ps(ay, dy), _mm_mul_ps(az, dz)));
+		_mm_store_ps(&out.x[j], rx);
+		_mm_store_ps(&out.y[j], ry);
+		_mm_store_ps(&out.z[j], rz);
+		_mm_store_ps(&out.w[j], rw);
+	}
+}
 
-	drawOneShoulder(true);
-	drawOneShoulder(false);
+// Delta that takes a clip's first frame to its current one on the arm joints
+static void updateClipDelta(const AnimPlayer& player, Pose& delta)
+{
+	Pose reference, current;
+	setArmPose(reference, g_animClipReference[player.clip]);
+	setArmPose(current, player.channels);
+	for (int j = JOINT_RIGHT_SHOULDER; j <= JOINT_LEFT_ELBOW; ++j) {
+		float r[4], c[4], d[4];
+		getPoseJoint(reference, j, r);
+		getPoseJoint(current, j, c);
+		r[0] = -r[0]; r[1] = -r[1]; r[2] = -r[2]; // Inverse of a unit quaternion
+		quatMultiply(r, c, d);
+		setPoseJoint(delta, j, d);
+	}
+}
 
-	// --- NEW: Disable texturing after drawing ---
-	glDisable(GL_TEXTURE_2D);
+void evaluateBlendTree()
+{
+	alignas(16) float weights[POSE_CAPACITY];
+	for (int n = 0; n < NODE_COUNT; ++n) {
+		const BlendNode& node = g_blendTree[n];
+		const Pose& input = g_blendPoses[node.input]; // Always an input or an earlier node, never the last
+		Pose& out = n == NODE_COUNT - 1 ? g_characterPose : g_blendPoses[POSE_INPUT_COUNT + n];
+		if (node.weight <= 0.0f) {
+			out = input;
+			continue;
+		}
+		const float* mask = g_blendMasks[node.mask];
+		for (int j = 0; j < POSE_CAPACITY; ++j) {
+			weights[j] = mask[j] * node.weight;
+		}
+		if (node.type == BLEND_LERP) {
+			blendLerp(input, g_blendPoses[node.source], weights, out);
+		}
+		else {
+			blendAdditive(input, g_blendPoses[node.source], weights, out);
+		}
+	}
 }
 
-void drawLathedObject(float profile[][2], int num_points, int sides)
+// Feeds the players' current state into the tree and evaluates it. With
+// snapHands the finger layers jump straight to whichever pose is nearer.
+void updateBlendTree(bool snapHands)
 {
-	float EPSILON = 0.0001f;
-	for (int i = 0; i < num_points - 1; ++i)
-	{
-		glBegin(GL_TRIANGLE_STRIP);
-		for (int j = 0; j <= sides; ++j)
-		{
-			float angle_rad = (float)j / (float)sides * 2.0f * 3.14159f;
-			float cos_angle = cos(angle_rad);
-			float sin_angle = sin(angle_rad);
-			float dx = profile[i + 1][0] - profile[i][0];
-			float dy = profile[i + 1][1] - profile[i][1];
+	g_blendTree[NODE_FIST].weight = g_fistAnimation.channels[ANIM_FIST];
+	g_blendTree[NODE_GRIP].weight = g_equippedWeapon == 1 ? 1.0f : 0.0f;
+	g_blendTree[NODE_PEACE].weight = g_handPoseAnimation.channels[ANIM_HAND_POSE];
+	g_blendTree[NODE_CAST_HANDS].weight = g_castAnimation.playing ? g_castAnimation.channels[ANIM_HANDS_OPEN] : 0.0f;
+	if (snapHands) {
+		for (BlendNodeId node : { NODE_FIST, NODE_PEACE, NODE_CAST_HANDS }) {
+			g_blendTree[node].weight = g_blendTree[node].weight < 0.5f ? 0.0f : 1.0f;
+		}
+	}
+	g_blendTree[NODE_LEFT_WAVE].weight = g_leftWaveAnimation.channels[ANIM_LEFT_WAVE];
+	g_blendTree[NODE_RIGHT_WAVE].weight = g_rightWaveAnimation.channels[ANIM_RIGHT_WAVE];
+
+	// Additive layers only cost a delta when their clip is off its first frame
+	struct { const AnimPlayer* player; bool active; BlendNodeId node; PoseSlot delta; } layers[] = {
+		{ &g_castAnimation, g_castAnimation.playing, NODE_CAST, POSE_CAST_DELTA },
+		{ &g_waveRaiseAnimation, g_waveRaiseAnimation.time > 0.0f, NODE_WAVE_RAISE, POSE_WAVE_RAISE_DELTA },
+		{ &g_waveLoopAnimation, g_waveLoopAnimation.playing, NODE_WAVE_SWING, POSE_WAVE_SWING_DELTA },
+	};
+	for (const auto& layer : layers) {
+		g_blendTree[layer.node].weight = layer.active ? 1.0f : 0.0f;
+		if (layer.active) {
+			updateClipDelta(*layer.player, g_blendPoses[layer.delta]);
+		}
+	}
 
-			// --- REVERTED NORMALS ---
-			float normal_x_profile = -dy; // Revert to -dy
-			float normal_y_profile = dx;  // Revert to dx
+	evaluateBlendTree();
+}
 
-			float normal_len_2d = sqrt(normal_x_profile * normal_x_profile + normal_y_profile * normal_y_profile);
-			if (normal_len_2d > EPSILON) {
-				normal_x_profile /= normal_len_2d;
-				normal_y_profile /= normal_len_2d;
-			}
-			else {
-				normal_x_profile = 0.0f;
-				normal_y_profile = 1.0f;
-			}
-			float normal_x_3d = normal_x_profile * cos_angle;
-			float normal_z_3d = normal_x_profile * sin_angle;
+// Multiplies the current matrix by a joint's rotation in g_characterPose
+void applyPoseJoint(int joint)
+{
+	const Pose& p = g_characterPose;
+	float x = p.x[joint], y = p.y[joint], z = p.z[joint], w = p.w[joint];
+	GLfloat m[16] = {
+		1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f,
+		2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f,
+		2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	};
+	glMultMatrixf(m);
+}
 
-			// Add texture coordinates
-			float u = (float)j / sides;
-			float v1 = (float)i / (num_points - 1);
-			float v2 = (float)(i + 1) / (num_points - 1);
+// --- Baked Motion Tables ---
+// The looping motions (walk cycle, braid sway, sash ripple, mirror bob, halo
+// shimmer) are sampled into tables once at startup and read back with a linear
+// interpolation, instead of calling sin/cos per leg, segment and vertex every
+// frame. Phases are measured in cycles and every table has one guard sample at
+// the end, so a lookup is two neighbouring loads and never wraps mid-lerp. The
+// tables are read-only after the bake and small enough to stay in L1, so any
+// number of characters can sample them.
+const int SINE_TABLE_SIZE = 1024;   // Samples per cycle; powers of two so the index wraps with a mask
+const int WALK_TABLE_SIZE = 256;
+const float INV_TWO_PI = 0.159154943f;
+const float WALK_SPEED = 5.0f;           // Radians of walk cycle per second of g_animationTime
+const float HIP_SWING_AMPLITUDE = 40.0f;
+const float KNEE_BEND_AMPLITUDE = 70.0f;
+
+// One whole leg pose per sample, so the walk cycle is a single 16-byte lerp
+struct alignas(16) WalkSample {
+	float rightHip;
+	float leftHip;
+	float rightKnee;
+	float leftKnee;
+};
 
-			glTexCoord2f(u, v1); // Texture coord for the first vertex
-			glVertex3f(profile[i][0] * cos_angle, profile[i][1], profile[i][0] * sin_angle);
-			glNormal3f(normal_x_3d, normal_y_profile, normal_z_3d);
+float g_sineTable[SINE_TABLE_SIZE + 1];
+WalkSample g_walkTable[WALK_TABLE_SIZE + 1];
 
-			glTexCoord2f(u, v2); // Texture coord for the second vertex
-			glVertex3f(profile[i + 1][0] * cos_angle, profile[i + 1][1], profile[i + 1][0] * sin_angle);
-			glNormal3f(normal_x_3d, normal_y_profile, normal_z_3d);
-		}
-		glEnd();
+void initMotionTables()
+{
+	const double TWO_PI = 6.283185307179586;
+	for (int i = 0; i <= SINE_TABLE_SIZE; ++i) {
+		g_sineTable[i] = (float)sin(TWO_PI * i / SINE_TABLE_SIZE);
+	}
+	// A forward step; the knee only bends while its leg swings back
+	for (int i = 0; i <= WALK_TABLE_SIZE; ++i) {
+		float s = (float)sin(TWO_PI * i / WALK_TABLE_SIZE);
+		WalkSample& w = g_walkTable[i];
+		w.rightHip = s * HIP_SWING_AMPLITUDE;
+		w.leftHip = -w.rightHip;
+		w.rightKnee = max(0.0f, s) * KNEE_BEND_AMPLITUDE;
+		w.leftKnee = max(0.0f, -s) * KNEE_BEND_AMPLITUDE;
 	}
 }
 
-/* void drawHand(bool isLeftHand)
+// Splits a phase in cycles into a table index and the fraction towards the next sample
+static inline int motionTableIndex(float cycles, int size, float& fraction)
 {
-	glColor3f(1.0f, 0.84f, 0.0f); // Golden yellow
+	float x = cycles * size;
+	int i = (int)x;
+	if (x < (float)i) --i; // The cast truncates towards zero; we want floor
+	fraction = x - (float)i;
+	return i & (size - 1);
+}
 
-	// --- 1. Draw the Palm ---
-	glPushMatrix();
-	// Position the palm correctly at the wrist
-	glTranslatef(0.0f, -0.05f, 0.0f);
-	glRotatef(10.0f, 1.0f, 0.0f, 0.0f); // Slight downward angle for the palm
-	// Draw a flattened cuboid for the palm (Width, Height, Depth)
-	drawCuboid(0.18f, 0.22f, 0.06f);
-	glPopMatrix();
+float motionSin(float radians)
+{
+	float f;
+	int i = motionTableIndex(radians * INV_TWO_PI, SINE_TABLE_SIZE, f);
+	return g_sineTable[i] + (g_sineTable[i + 1] - g_sineTable[i]) * f;
+}
 
+float motionCos(float radians)
+{
+	float f;
+	int i = motionTableIndex(radians * INV_TWO_PI + 0.25f, SINE_TABLE_SIZE, f);
+	return g_sineTable[i] + (g_sineTable[i + 1] - g_sineTable[i]) * f;
+}
 
-	// --- 2. Draw the Four Fingers ---
-	for (int i = 0; i < 4; i++)
-	{
-		glPushMatrix(); // Save the wrist's state
-
-		// --- Knuckle Placement ---
-		// Position each finger's knuckle on the bottom edge of the palm
-		float xPos = isLeftHand ? (-0.0675f + i * 0.045f) : (0.0675f - i * 0.045f);
-		glTranslatef(xPos, -0.15f, 0.01f);
-		// Base rotation for the whole finger to make it curl slightly
-		glRotatef(20.0f, 1.0f, 0.0f, 0.0f);
-
-		// --- Finger Segment 1 (Base) ---
-		float seg1_len = 0.07f;
-		glTranslatef(0.0f, -seg1_len / 2.0f, 0.0f); // Move to the center of the segment
-		drawCuboid(0.035f, seg1_len, 0.04f);      // Draw the segment
-
-		// --- Finger Segment 2 (Middle) ---
-		glTranslatef(0.0f, -seg1_len / 2.0f, 0.0f); // Move to the joint at the end of the first segment
-		glRotatef(25.0f, 1.0f, 0.0f, 0.0f);      // Rotate the joint
-		float seg2_len = 0.06f;
-		glTranslatef(0.0f, -seg2_len / 2.0f, 0.0f); // Move to the center of the second segment
-		drawCuboid(0.032f, seg2_len, 0.037f);     // Draw the segment
-
-		// --- Finger Segment 3 (Tip) ---
-		glTranslatef(0.0f, -seg2_len / 2.0f, 0.0f); // Move to the joint at the end of the second segment
-		glRotatef(25.0f, 1.0f, 0.0f, 0.0f);      // Rotate the joint
-		float seg3_len = 0.05f;
-		glTranslatef(0.0f, -seg3_len / 2.0f, 0.0f); // Move to the center of the third segment
-		drawCuboid(0.03f, seg3_len, 0.034f);      // Draw the segment
-
-		glPopMatrix(); // Restore to the wrist's state for the next finger
-	}
-
-	// --- 3. Draw the Thumb ---
-	glPushMatrix(); // Save the wrist's state
-
-	// Position the thumb's base on the side of the palm
-	glTranslatef(isLeftHand ? -0.1f : 0.1f, -0.08f, -0.01f);
-	glRotatef(isLeftHand ? 40.0f : -40.0f, 0.0f, 1.0f, 0.0f); // Rotate it outwards
-	glRotatef(30.0f, 0.0f, 0.0f, isLeftHand ? 1.0f : -1.0f); // Angle it across the palm
-
-	// --- Thumb Segment 1 (Base) ---
-	float thumb1_len = 0.06f;
-	glTranslatef(0.0f, -thumb1_len / 2.0f, 0.0f);
-	drawCuboid(0.04f, thumb1_len, 0.04f);
-
-	// --- Thumb Segment 2 (Tip) ---
-	glTranslatef(0.0f, -thumb1_len / 2.0f, 0.0f);
-	glRotatef(30.0f, 1.0f, 0.0f, 0.0f);
-	float thumb2_len = 0.05f;
-	glTranslatef(0.0f, -thumb2_len / 2.0f, 0.0f);
-	drawCuboid(0.037f, thumb2_len, 0.037f);
+// Leg angles at a point of the walk cycle. Walking backwards is the forward
+// cycle half a period on, since sin(x + PI) = -sin(x).
+void sampleWalkCycle(float radians, float direction, WalkSample& out)
+{
+	float f;
+	int i = motionTableIndex(radians * INV_TWO_PI + (direction < 0.0f ? 0.5f : 0.0f), WALK_TABLE_SIZE, f);
+	__m128 a = _mm_load_ps(&g_walkTable[i].rightHip);
+	__m128 b = _mm_load_ps(&g_walkTable[i + 1].rightHip);
+	_mm_store_ps(&out.rightHip, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(f))));
+}
 
-	glPopMatrix(); // Restore to the wrist's state
-} */
+// The halo and braid share one slowly cycling rainbow colour
+void sampleRainbowColour(float rgb[3])
+{
+	float phase = g_rainbow_offset * 2.0f;
+	rgb[0] = 0.5f * (1.0f + motionSin(phase));
+	rgb[1] = 0.5f * (1.0f + motionSin(phase + 2.0f));
+	rgb[2] = 0.5f * (1.0f + motionSin(phase + 4.0f));
+}
 
-// --- Low-poly human hand (game-style), shape-only update ---
-// Keeps the same local origin & overall size so your arm code doesn't need changes.
-static void drawTrapezoidPrism(float w_back, float w_wrist, float h, float d) {
-	// back = knuckle side, wrist = forearm side
-	float hb = h * 0.5f;
-	float db = d * 0.5f;
-	float wb = w_back * 0.5f;
-	float ww = w_wrist * 0.5f;
+void resetAnimation() {
+	g_isHaloAnimating = false;
+	g_isHaloVisible = true;
+	g_haloZ = -0.85f;
+	g_haloScale = 0.38f;
 
-	glBegin(GL_QUADS);
-	// Top
-	glNormal3f(0, 1, 0);
-	glVertex3f(-ww, hb, db); glVertex3f(ww, hb, db);
-	glVertex3f(wb, hb, -db); glVertex3f(-wb, hb, -db);
-	// Bottom
-	glNormal3f(0, -1, 0);
-	glVertex3f(-ww, -hb, db); glVertex3f(-wb, -hb, -db);
-	glVertex3f(wb, -hb, -db); glVertex3f(ww, -hb, db);
-	// Front (palm)
-	glNormal3f(0, 0, 1);
-	glVertex3f(-ww, -hb, db); glVertex3f(ww, -hb, db);
-	glVertex3f(ww, hb, db); glVertex3f(-ww, hb, db);
-	// Back (knuckles)
-	glNormal3f(0, 0, -1);
-	glVertex3f(-wb, -hb, -db); glVertex3f(-wb, hb, -db);
-	glVertex3f(wb, hb, -db); glVertex3f(wb, -hb, -db);
-	// Left
-	glNormal3f(-1, 0, 0);
-	glVertex3f(-ww, -hb, db); glVertex3f(-ww, hb, db);
-	glVertex3f(-wb, hb, -db); glVertex3f(-wb, -hb, -db);
-	// Right
-	glNormal3f(1, 0, 0);
-	glVertex3f(ww, -hb, db); glVertex3f(wb, -hb, -db);
-	glVertex3f(wb, hb, -db); glVertex3f(ww, hb, db);
-	glEnd();
-}
+	// Reset the light's position
+	memcpy(g_animatedLightPos, g_initialLightPos, sizeof(GLfloat) * 4);
 
-static void drawBox(float w, float h, float d) { // small helper
-	float hw = w * 0.5f, hh = h * 0.5f, hd = d * 0.5f;
-	glBegin(GL_QUADS);
-	glNormal3f(0, 0, 1);
-	glVertex3f(-hw, -hh, hd); glVertex3f(hw, -hh, hd); glVertex3f(hw, hh, hd); glVertex3f(-hw, hh, hd);
-	glNormal3f(0, 0, -1);
-	glVertex3f(-hw, -hh, -hd); glVertex3f(-hw, hh, -hd); glVertex3f(hw, hh, -hd); glVertex3f(hw, -hh, -hd);
-	glNormal3f(0, 1, 0);
-	glVertex3f(-hw, hh, -hd); glVertex3f(-hw, hh, hd); glVertex3f(hw, hh, hd); glVertex3f(hw, hh, -hd);
-	glNormal3f(0, -1, 0);
-	glVertex3f(-hw, -hh, -hd); glVertex3f(hw, -hh, -hd); glVertex3f(hw, -hh, hd); glVertex3f(-hw, -hh, hd);
-	glNormal3f(1, 0, 0);
-	glVertex3f(hw, -hh, -hd); glVertex3f(hw, hh, -hd); glVertex3f(hw, hh, hd); glVertex3f(hw, -hh, hd);
-	glNormal3f(-1, 0, 0);
-	glVertex3f(-hw, -hh, -hd); glVertex3f(-hw, -hh, hd); glVertex3f(-hw, hh, hd); glVertex3f(-hw, hh, -hd);
-	glEnd();
+	// Reset all movement and character states
+	g_characterPosX = 0.0f;
+	g_characterPosZ = 0.0f;
+	g_forwardDirection = 0;
+	g_strafeDirection = 0;
+	g_characterRotationY = 0.0f; // FIX: Reset character to face front. Was 180.0f
 }
 
-// ---------- helpers ----------
-static void box6(float w, float h, float d) { // hard-edged box
-	float x = w * 0.5f, y = h * 0.5f, z = d * 0.5f;
-	glBegin(GL_QUADS);
-	glNormal3f(0, 0, 1);  glVertex3f(-x, -y, z); glVertex3f(x, -y, z); glVertex3f(x, y, z); glVertex3f(-x, y, z);
-	glNormal3f(0, 0, -1); glVertex3f(-x, -y, -z); glVertex3f(-x, y, -z); glVertex3f(x, y, -z); glVertex3f(x, -y, -z);
-	glNormal3f(0, 1, 0);  glVertex3f(-x, y, -z); glVertex3f(-x, y, z); glVertex3f(x, y, z); glVertex3f(x, y, -z);
-	glNormal3f(0, -1, 0); glVertex3f(-x, -y, -z); glVertex3f(x, -y, -z); glVertex3f(x, -y, z); glVertex3f(-x, -y, z);
-	glNormal3f(1, 0, 0);  glVertex3f(x, -y, -z); glVertex3f(x, y, -z); glVertex3f(x, y, z); glVertex3f(x, -y, z);
-	glNormal3f(-1, 0, 0); glVertex3f(-x, -y, -z); glVertex3f(-x, -y, z); glVertex3f(-x, y, z); glVertex3f(-x, y, -z);
-	glEnd();
-}
+void pickAtCursor(int mouseX, int mouseY); // Defined with the rest of Mouse Picking below
+bool spawnMatrixBlock(float x, float z);     // Defined with the rest of the matrix block code below
 
-static void drawPalmWedge(float wKnuckle, float wWrist, float thick, float depth)
+LRESULT WINAPI WindowProcedure(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
-	float hk = thick * 0.5f;
-	float dz = depth * 0.5f;
-	float wk = wKnuckle * 0.5f;
-	float ww = wWrist * 0.5f;
-
-	glBegin(GL_QUADS);
-	// top 
-	glNormal3f(0, 1, 0);
-	glVertex3f(-ww, hk, dz);
-	glVertex3f(ww, hk, dz);
-	glVertex3f(wk, hk * 0.7f, -dz);
-	glVertex3f(-wk, hk * 0.7f, -dz);
+	switch (msg)
+	{
+	case WM_DESTROY:
+		PostQuitMessage(0);
+		break;
 
-	// bottom
-	glNormal3f(0, -1, 0);
-	glVertex3f(-ww, -hk, dz);
-	glVertex3f(-wk, -hk, -dz);
-	glVertex3f(wk, -hk, -dz);
-	glVertex3f(ww, -hk, dz);
+	case WM_SIZE:
+		// Minimising reports 0x0; keep the last real size
+		if (LOWORD(lParam) > 0 && HIWORD(lParam) > 0) {
+			g_windowWidth = LOWORD(lParam);
+			g_windowHeight = HIWORD(lParam);
+		}
+		break;
 
-	// front 
-	glNormal3f(0, 0, 1);
-	glVertex3f(-ww, -hk, dz);
-	glVertex3f(ww, -hk, dz);
-	glVertex3f(ww, hk, dz);
-	glVertex3f(-ww, hk, dz);
+	case WM_KEYDOWN:
+		// Exit the application
+		if (wParam == VK_ESCAPE) PostQuitMessage(0);
+		if (wParam == 'P') {
+			g_isPerspectiveView = !g_isPerspectiveView;
+		}
 
-	// back 
-	glNormal3f(0, 0, -1);
-	glVertex3f(-wk, -hk, -dz);
-	glVertex3f(-wk, hk * 0.7f, -dz);
-	glVertex3f(wk, hk * 0.7f, -dz);
-	glVertex3f(wk, -hk, -dz);
+		// --- Handle Arrow Key Presses to START movement ---
+		if (wParam == VK_UP)    g_forwardDirection = 1;
+		if (wParam == VK_DOWN)  g_forwardDirection = -1;
+		if (wParam == VK_RIGHT)  g_strafeDirection = -1;
+		if (wParam == VK_LEFT) g_strafeDirection = 1;
 
-	// left
-	glNormal3f(-1, 0, 0);
-	glVertex3f(-ww, -hk, dz);
-	glVertex3f(-ww, hk, dz);
-	glVertex3f(-wk, hk * 0.7f, -dz);
-	glVertex3f(-wk, -hk, -dz);
+		// --- NEW: Add Light Position Controls ---
+		if (wParam == 'W') g_animatedLightPos[1] += 0.5f; // Move light up
+		if (wParam == 'S') g_animatedLightPos[1] -= 0.5f; // Move light down
+		if (wParam == 'C') g_animatedLightPos[0] -= 0.5f; // Move light left
+		if (wParam == 'D') g_animatedLightPos[0] += 0.5f; // Move light right
+		if (wParam == 'Z') g_animatedLightPos[2] += 0.5f; // Move light near
+		if (wParam == 'X') g_animatedLightPos[2] -= 0.5f; // Move light far
 
-	// right
-	glNormal3f(1, 0, 0);
-	glVertex3f(ww, -hk, dz);
-	glVertex3f(wk, -hk, -dz);
-	glVertex3f(wk, hk * 0.7f, -dz);
-	glVertex3f(ww, hk, dz);
-	glEnd();
-}
 
-// ---------- main ----------
-void drawHand(bool isLeftHand)
-{
-	// NOTE: This function now INHERITS the color and texture state from its caller (drawSmoothArms)
-	// All glColor, glEnable, glBindTexture, glDisable calls have been removed.
+		// --- Other keybinds (unchanged) ---
+		if (wParam == 'A') {
+			g_isHaloAnimating = true;
+			activateAnimTask(TASK_HALO);
+		}
+		if (wParam == 'F') {
+			g_isFistTargetClosed = !g_isFistTargetClosed;
+			playAnimToward(g_fistAnimation, CLIP_FIST, g_isFistTargetClosed);
+		}
+		if (wParam == 'G') {
+			// Every press casts; the arm only plays its casting animation if it is free
+			castSkillProjectile(g_characterPosX, g_characterPosZ, rotateY);
+			if (!g_castAnimation.playing) {
+				playAnimClip(g_castAnimation, CLIP_CAST);
+			}
+		}
+		if (wParam == 'B') {
+			// Stress test: a ring of casts in every direction at once
+			for (int i = 0; i < 360; ++i) {
+				castSkillProjectile(g_characterPosX, g_characterPosZ, (float)i);
+			}
+		}
 
-	glPushMatrix();
-	glTranslatef(0.0f, -0.05f, 0.0f);
-	glRotatef(1.0f, 1, 0, 0);
+		// --- Waving Toggles ---
+		if (wParam == 'Q') {
+			g_isLeftWaveActive = !g_isLeftWaveActive;
+			playAnimToward(g_leftWaveAnimation, CLIP_LEFT_WAVE, g_isLeftWaveActive);
+		}
+		if (wParam == 'E') {
+			g_isRightWaveActive = !g_isRightWaveActive;
+			playAnimToward(g_rightWaveAnimation, CLIP_RIGHT_WAVE, g_isRightWaveActive);
+		}
 
-	// ===== 1) Palm & Knuckles =====
-	const float PALM_W_K = 0.205f;
-	const float PALM_W_W = 0.155f;
-	const float PALM_H = 0.14f;
-	const float PALM_D = 0.05f;
-	drawPalmWedge(PALM_W_K, PALM_W_W, PALM_H, PALM_D);
-	glPushMatrix();
-	glTranslatef(0.0f, PALM_H * 0.47f, -PALM_D * 0.48f);
-	box6(PALM_W_K * 0.95f, 0.018f, 0.026f);
-	glPopMatrix();
+		// --- Peace Sign Toggle ---
+		if (wParam == 'V') {
+			g_handPoseTarget = (g_handPoseTarget == 0) ? 1 : 0; // Toggle target
+			playAnimToward(g_handPoseAnimation, CLIP_PEACE, g_handPoseTarget == 1);
+		}
 
-	// ===== 2) Fingers =====
-	struct F { float x, yawDeg, len; float w, d; };
-	F fingers[4] = {
-		{ -0.060f, -9.0f, 0.072f, 0.030f, 0.034f }, // i=0
-		{ -0.020f, -3.0f, 0.078f, 0.032f, 0.036f }, // i=1
-		{  0.020f,  3.0f, 0.074f, 0.031f, 0.035f }, // i=2
-		{  0.058f,  9.0f, 0.064f, 0.028f, 0.033f }, // i=3
-	};
+		// --- Toggle Weapon Visibility ---
+		if (wParam == 'H') {
+			g_equippedWeapon++;
+			if (g_equippedWeapon > 2) { // Cycle through 0, 1, 2
+				g_equippedWeapon = 0;
+			}
+			activateAnimTask(TASK_POSE); // The staff changes the right hand's grip
+		}
 
-	float angle1, angle2, angle3;
+		if (wParam == 'M') {
+			if (!g_castAnimation.playing) {
+				playAnimClip(g_castAnimation, CLIP_CAST);
 
-	for (int i = 0; i < 4; ++i) {
-		bool should_be_straight = false;
-		if (isLeftHand) {
-			if (i == 0 || i == 1) should_be_straight = true;
+				float halfArea = g_config.blockSpawnArea / 2.0f;
+				float offsetX = randomFloat(-halfArea, halfArea);
+				float offsetZ = randomFloat(-halfArea, halfArea);
+				spawnMatrixBlock(g_characterPosX + offsetX, g_characterPosZ + offsetZ);
+			}
+			break;
 		}
-		else {
-			if (i == 2 || i == 3) should_be_straight = true;
+		if (wParam == 'L') {
+			g_isLevitating = !g_isLevitating;
 		}
+		if (wParam == 'H') g_isWeaponVisible = !g_isWeaponVisible;
+		if (wParam == VK_SPACE) {
+			resetAnimation();
+			g_isLeftWaveActive = false;
+			g_isRightWaveActive = false;
+			playAnimToward(g_leftWaveAnimation, CLIP_LEFT_WAVE, false);
+			playAnimToward(g_rightWaveAnimation, CLIP_RIGHT_WAVE, false);
+			g_handPoseTarget = 0;
+			stopAnimPlayer(g_handPoseAnimation);
+			g_equippedWeapon = 0;
+			g_isLevitating = false;
+			activateAnimTask(TASK_POSE);
+		}
+		break;
 
-		float normal_angle1 = FINGER_OPEN_ANGLES[0] + (FINGER_CLOSED_ANGLES[0] - FINGER_OPEN_ANGLES[0]) * g_fistAnimationProgress;
-		float normal_angle2 = FINGER_OPEN_ANGLES[1] + (FINGER_CLOSED_ANGLES[1] - FINGER_OPEN_ANGLES[1]) * g_fistAnimationProgress;
-		float normal_angle3 = FINGER_OPEN_ANGLES[2] + (FINGER_CLOSED_ANGLES[2] - FINGER_OPEN_ANGLES[2]) * g_fistAnimationProgress;
+	case WM_KEYUP:
+		// --- Handle Key Releases to STOP movement ---
+		if (wParam == VK_UP && g_forwardDirection == 1)    g_forwardDirection = 0;
+		if (wParam == VK_DOWN && g_forwardDirection == -1)  g_forwardDirection = 0;
+		if (wParam == VK_RIGHT && g_strafeDirection == -1)  g_strafeDirection = 0;
+		if (wParam == VK_LEFT && g_strafeDirection == 1) g_strafeDirection = 0;
+		break;
 
-		float peace_angle1 = should_be_straight ? PEACE_STRAIGHT_ANGLES[0] : PEACE_CURLED_ANGLES[0];
-		float peace_angle2 = should_be_straight ? PEACE_STRAIGHT_ANGLES[1] : PEACE_CURLED_ANGLES[1];
-		float peace_angle3 = should_be_straight ? PEACE_STRAIGHT_ANGLES[2] : PEACE_CURLED_ANGLES[2];
+	case WM_LBUTTONDOWN:
+	{
+		isDragging = true;
+		lastMouseX = mouseDownX = LOWORD(lParam);
+		lastMouseY = mouseDownY = HIWORD(lParam);
+		break;
+	}
 
-		angle1 = normal_angle1 + (peace_angle1 - normal_angle1) * g_handPoseProgress;
-		angle2 = normal_angle2 + (peace_angle2 - normal_angle2) * g_handPoseProgress;
-		angle3 = normal_angle3 + (peace_angle3 - normal_angle3) * g_handPoseProgress;
+	case WM_LBUTTONUP:
+	{
+		isDragging = false;
+		// Released close to where it was pressed: a click, not a camera orbit
+		int mouseX = LOWORD(lParam), mouseY = HIWORD(lParam);
+		if (abs(mouseX - mouseDownX) + abs(mouseY - mouseDownY) <= 3) {
+			pickAtCursor(mouseX, mouseY);
+		}
+		break;
+	}
 
-		glPushMatrix();
-		glTranslatef(fingers[i].x, -PALM_H * 0.24f, -PALM_D * 0.50f);
-		float yaw = fingers[i].yawDeg;
-		if (!isLeftHand) yaw = -yaw;
-		glRotatef(yaw, 0, 1, 0);
-		glRotatef(angle1, 1, 0, 0);
-
-		float L1 = fingers[i].len, W1 = fingers[i].w, D1 = fingers[i].d;
-		glTranslatef(0, -L1 * 0.5f, 0); box6(W1, L1, D1);
-		float L2 = L1 * 0.86f, W2 = W1 * 0.92f, D2 = D1 * 0.92f;
-		glTranslatef(0, -L1 * 0.5f, 0);
-		glRotatef(angle2, 1, 0, 0);
-		glTranslatef(0, -L2 * 0.5f, 0); box6(W2, L2, D2);
-		float L3 = L2 * 0.80f, W3 = W2 * 0.88f, D3 = D2 * 0.90f;
-		glTranslatef(0, -L2 * 0.5f, 0);
-		glRotatef(angle3, 1, 0, 0);
-		glTranslatef(0, -L3 * 0.5f, 0); box6(W3, L3, D3);
-		glPopMatrix();
+	case WM_MOUSEMOVE:
+	{
+		if (isDragging)
+		{
+			int currentMouseX = LOWORD(lParam);
+			int currentMouseY = HIWORD(lParam);
+			float deltaX = (float)(currentMouseX - lastMouseX);
+			float deltaY = (float)(currentMouseY - lastMouseY);
+			rotateY += deltaX * 0.2f;
+			rotateX += deltaY * 0.2f;
+			lastMouseX = currentMouseX;
+			lastMouseY = currentMouseY;
+		}
+		break;
 	}
 
-	// ===== 3) Thumb =====
-	glPushMatrix();
-	glTranslatef(isLeftHand ? -PALM_W_W * 0.56f : PALM_W_W * 0.56f, -PALM_H * 0.02f, -PALM_D * 0.12f);
-	glRotatef(52.f, 0, (isLeftHand ? 1 : -1), 0);
-	glRotatef(10.f, 0, 0, 1);
-	glRotatef(18.f, 1, 0, 0);
-
-	float T1L = 0.074f, T1W = 0.044f, T1D = 0.046f;
-	glTranslatef(0, -T1L * 0.5f, 0); box6(T1W, T1L, T1D);
-
-	float thumb_normal_angle = THUMB_OPEN_ANGLE + (THUMB_CLOSED_ANGLE - THUMB_OPEN_ANGLE) * g_fistAnimationProgress;
-	float thumb_peace_angle = PEACE_THUMB_ANGLE;
-	float thumb_angle = thumb_normal_angle + (thumb_peace_angle - thumb_normal_angle) * g_handPoseProgress;
-
-	float T2L = 0.060f, T2W = T1W * 0.90f, T2D = T1D * 0.92f;
-	glTranslatef(0, -T1L * 0.5f, 0);
-	glRotatef(thumb_angle, 1, 0, 0);
-	glTranslatef(0, -T2L * 0.5f, 0); box6(T2W, T2L, T2D);
-	glPopMatrix();
+	case WM_MOUSEWHEEL:
+	{
+		int zDelta = GET_WHEEL_DELTA_WPARAM(wParam);
+		if (zDelta > 0)
+		{
+			zoomFactor += 0.5f;
+		}
+		else if (zDelta < 0)
+		{
+			zoomFactor -= 0.5f;
+		}
+		if (zoomFactor > -2.0f) zoomFactor = -2.0f;
+		if (zoomFactor < -20.0f) zoomFactor = -20.0f;
+		break;
+	}
 
-	// ===== 4) Palm bevel =====
-	glPushMatrix();
-	glTranslatef(0.0f, -PALM_H * 0.40f, PALM_D * 0.30f);
-	glScalef(1.0f, 1.0f, 0.6f);
-	box6(PALM_W_W * 0.90f, 0.020f, 0.040f);
-	glPopMatrix();
+	default:
+		break;
+	}
 
-	glPopMatrix();
+	return DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
-void drawSmoothChest()
+bool initPixelFormat(HDC hdc)
 {
-	// Set the base colour to white so the texture is not tinted
-	glColor3f(1.0f, 1.0f, 1.0f);
-
-	// Enable and apply the texture
-	glEnable(GL_TEXTURE_2D);
+	PIXELFORMATDESCRIPTOR pfd;
+	ZeroMemory(&pfd, sizeof(PIXELFORMATDESCRIPTOR));
+	pfd.cAlphaBits = 8;
+	pfd.cColorBits = 32;
+	pfd.cDepthBits = 24;
+	pfd.cStencilBits = 0;
+	pfd.dwFlags = PFD_DOUBLEBUFFER | PFD_SUPPORT_OPENGL | PFD_DRAW_TO_WINDOW;
+	pfd.iLayerType = PFD_MAIN_PLANE;
+	pfd.iPixelType = PFD_TYPE_RGBA;
+	pfd.nSize = sizeof(PIXELFORMATDESCRIPTOR);
+	pfd.nVersion = 1;
+	int n = ChoosePixelFormat(hdc, &pfd);
+	if (SetPixelFormat(hdc, n, &pfd))
+	{
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
 
-	// --- MODIFIED: Changed from g_goldTextureID to g_silverTextureID ---
-	glBindTexture(GL_TEXTURE_2D, g_silverTextureID);
+// --- OpenGL Extension Entry Points ---
+// Windows only exports OpenGL 1.1 from OpenGL32.lib; anything newer has to be
+// fetched through wglGetProcAddress once a context is current.
+bool hasGLExtension(const char* name)
+{
+	const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+	if (!extensions) return false;
+
+	size_t nameLength = strlen(name);
+	const char* p = extensions;
+	while ((p = strstr(p, name)) != nullptr) {
+		// Make sure we matched a whole token, not a prefix of a longer extension name
+		bool startsToken = (p == extensions) || (p[-1] == ' ');
+		bool endsToken = (p[nameLength] == ' ') || (p[nameLength] == '\0');
+		if (startsToken && endsToken) return true;
+		p += nameLength;
+	}
+	return false;
+}
 
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+static PROC getGLProc(const char* name, const char* fallbackName = nullptr)
+{
+	PROC proc = wglGetProcAddress(name);
+	if (!proc && fallbackName) proc = wglGetProcAddress(fallbackName);
+	return proc;
+}
 
-	float chest_profile[][2] = {
-		{0.18f, 0.85f},
-		{0.35f, 0.70f},
-		{0.38f, 0.55f},
-		{0.30f, 0.40f},
-		{0.25f, 0.25f}
-	};
-	int chest_points = sizeof(chest_profile) / sizeof(chest_profile[0]);
-	drawLathedObject(chest_profile, chest_points, 20);
+void loadGLExtensions()
+{
+	glCompressedTexImage2D = (PFNGLCOMPRESSEDTEXIMAGE2DPROC)getGLProc("glCompressedTexImage2D", "glCompressedTexImage2DARB");
+	glCompressedTexSubImage2D = (PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC)getGLProc("glCompressedTexSubImage2D", "glCompressedTexSubImage2DARB");
+	glGenBuffers = (PFNGLGENBUFFERSPROC)getGLProc("glGenBuffers", "glGenBuffersARB");
+	glDeleteBuffers = (PFNGLDELETEBUFFERSPROC)getGLProc("glDeleteBuffers", "glDeleteBuffersARB");
+	glBindBuffer = (PFNGLBINDBUFFERPROC)getGLProc("glBindBuffer", "glBindBufferARB");
+	glBufferData = (PFNGLBUFFERDATAPROC)getGLProc("glBufferData", "glBufferDataARB");
+	glMapBuffer = (PFNGLMAPBUFFERPROC)getGLProc("glMapBuffer", "glMapBufferARB");
+	glUnmapBuffer = (PFNGLUNMAPBUFFERPROC)getGLProc("glUnmapBuffer", "glUnmapBufferARB");
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &g_maxTextureSize);
+	g_hasS3TC = glCompressedTexImage2D != nullptr && glCompressedTexSubImage2D != nullptr && hasGLExtension("GL_EXT_texture_compression_s3tc");
+
+	// PBOs are core in 2.1; check the version string as well as the extension list
+	const char* version = (const char*)glGetString(GL_VERSION);
+	bool isGL21 = version && (version[0] > '2' || (version[0] == '2' && version[2] >= '1'));
+	g_hasPBO = glGenBuffers && glDeleteBuffers && glBindBuffer && glBufferData && glMapBuffer && glUnmapBuffer &&
+		(isGL21 || hasGLExtension("GL_ARB_pixel_buffer_object"));
+	bool isGL15 = version && (version[0] > '1' || (version[0] == '1' && version[2] >= '5'));
+	g_hasVBO = glGenBuffers && glDeleteBuffers && glBindBuffer && glBufferData &&
+		(isGL15 || hasGLExtension("GL_ARB_vertex_buffer_object"));
+
+	glCreateShader = (PFNGLCREATESHADERPROC)getGLProc("glCreateShader");
+	glShaderSource = (PFNGLSHADERSOURCEPROC)getGLProc("glShaderSource");
+	glCompileShader = (PFNGLCOMPILESHADERPROC)getGLProc("glCompileShader");
+	glGetShaderiv = (PFNGLGETSHADERIVPROC)getGLProc("glGetShaderiv");
+	glGetShaderInfoLog = (PFNGLGETSHADERINFOLOGPROC)getGLProc("glGetShaderInfoLog");
+	glDeleteShader = (PFNGLDELETESHADERPROC)getGLProc("glDeleteShader");
+	glCreateProgram = (PFNGLCREATEPROGRAMPROC)getGLProc("glCreateProgram");
+	glAttachShader = (PFNGLATTACHSHADERPROC)getGLProc("glAttachShader");
+	glBindAttribLocation = (PFNGLBINDATTRIBLOCATIONPROC)getGLProc("glBindAttribLocation");
+	glLinkProgram = (PFNGLLINKPROGRAMPROC)getGLProc("glLinkProgram");
+	glGetProgramiv = (PFNGLGETPROGRAMIVPROC)getGLProc("glGetProgramiv");
+	glGetProgramInfoLog = (PFNGLGETPROGRAMINFOLOGPROC)getGLProc("glGetProgramInfoLog");
+	glDeleteProgram = (PFNGLDELETEPROGRAMPROC)getGLProc("glDeleteProgram");
+	glUseProgram = (PFNGLUSEPROGRAMPROC)getGLProc("glUseProgram");
+	glGetUniformLocation = (PFNGLGETUNIFORMLOCATIONPROC)getGLProc("glGetUniformLocation");
+	glUniform1f = (PFNGLUNIFORM1FPROC)getGLProc("glUniform1f");
+	glUniform2f = (PFNGLUNIFORM2FPROC)getGLProc("glUniform2f");
+	glUniform3fv = (PFNGLUNIFORM3FVPROC)getGLProc("glUniform3fv");
+	glVertexAttribPointer = (PFNGLVERTEXATTRIBPOINTERPROC)getGLProc("glVertexAttribPointer");
+	glEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYPROC)getGLProc("glEnableVertexAttribArray");
+	glDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYPROC)getGLProc("glDisableVertexAttribArray");
+	glPatchParameteri = (PFNGLPATCHPARAMETERIPROC)getGLProc("glPatchParameteri");
+	glGenFramebuffers = (PFNGLGENFRAMEBUFFERSPROC)getGLProc("glGenFramebuffers", "glGenFramebuffersEXT");
+	glDeleteFramebuffers = (PFNGLDELETEFRAMEBUFFERSPROC)getGLProc("glDeleteFramebuffers", "glDeleteFramebuffersEXT");
+	glBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)getGLProc("glBindFramebuffer", "glBindFramebufferEXT");
+	glFramebufferTexture2D = (PFNGLFRAMEBUFFERTEXTURE2DPROC)getGLProc("glFramebufferTexture2D", "glFramebufferTexture2DEXT");
+	glCheckFramebufferStatus = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)getGLProc("glCheckFramebufferStatus", "glCheckFramebufferStatusEXT");
+	glGenRenderbuffers = (PFNGLGENRENDERBUFFERSPROC)getGLProc("glGenRenderbuffers", "glGenRenderbuffersEXT");
+	glDeleteRenderbuffers = (PFNGLDELETERENDERBUFFERSPROC)getGLProc("glDeleteRenderbuffers", "glDeleteRenderbuffersEXT");
+	glBindRenderbuffer = (PFNGLBINDRENDERBUFFERPROC)getGLProc("glBindRenderbuffer", "glBindRenderbufferEXT");
+	glRenderbufferStorage = (PFNGLRENDERBUFFERSTORAGEPROC)getGLProc("glRenderbufferStorage", "glRenderbufferStorageEXT");
+	glFramebufferRenderbuffer = (PFNGLFRAMEBUFFERRENDERBUFFERPROC)getGLProc("glFramebufferRenderbuffer", "glFramebufferRenderbufferEXT");
+	glGenerateMipmap = (PFNGLGENERATEMIPMAPPROC)getGLProc("glGenerateMipmap", "glGenerateMipmapEXT");
+	glGenQueries = (PFNGLGENQUERIESPROC)getGLProc("glGenQueries", "glGenQueriesARB");
+	glDeleteQueries = (PFNGLDELETEQUERIESPROC)getGLProc("glDeleteQueries", "glDeleteQueriesARB");
+	glBeginQuery = (PFNGLBEGINQUERYPROC)getGLProc("glBeginQuery", "glBeginQueryARB");
+	glEndQuery = (PFNGLENDQUERYPROC)getGLProc("glEndQuery", "glEndQueryARB");
+	glGetQueryObjectiv = (PFNGLGETQUERYOBJECTIVPROC)getGLProc("glGetQueryObjectiv", "glGetQueryObjectivARB");
+	glGetQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VPROC)getGLProc("glGetQueryObjectui64v", "glGetQueryObjectui64vEXT");
+
+	bool isGL20 = version && version[0] >= '2';
+	bool isGL30 = version && version[0] >= '3';
+	bool isGL31 = version && (version[0] > '3' || (version[0] == '3' && version[2] >= '1'));
+	g_hasGLSL = isGL20 && glCreateShader && glShaderSource && glCompileShader && glGetShaderiv && glGetShaderInfoLog &&
+		glDeleteShader && glCreateProgram && glAttachShader && glBindAttribLocation && glLinkProgram && glGetProgramiv &&
+		glGetProgramInfoLog && glDeleteProgram && glUseProgram && glGetUniformLocation && glUniform1f && glUniform2f &&
+		glUniform3fv && glVertexAttribPointer && glEnableVertexAttribArray && glDisableVertexAttribArray;
+	g_hasHalfFloatVertex = isGL30 || hasGLExtension("GL_ARB_half_float_vertex");
+	bool isGL40 = version && version[0] >= '4';
+	g_hasTessellation = g_hasGLSL && glPatchParameteri && (isGL40 || hasGLExtension("GL_ARB_tessellation_shader"));
+	// The EXT entry points share the core ones' signatures and enums
+	g_hasFBO = glGenFramebuffers && glDeleteFramebuffers && glBindFramebuffer && glFramebufferTexture2D && glCheckFramebufferStatus &&
+		glGenRenderbuffers && glDeleteRenderbuffers && glBindRenderbuffer && glRenderbufferStorage && glFramebufferRenderbuffer && glGenerateMipmap &&
+		(isGL30 || hasGLExtension("GL_ARB_framebuffer_object") || hasGLExtension("GL_EXT_framebuffer_object"));
+	bool isGL33 = version && (version[0] > '3' || (version[0] == '3' && version[2] >= '3'));
+	g_hasTimerQuery = glGenQueries && glDeleteQueries && glBeginQuery && glEndQuery && glGetQueryObjectiv && glGetQueryObjectui64v &&
+		(isGL33 || hasGLExtension("GL_ARB_timer_query") || hasGLExtension("GL_EXT_timer_query"));
+	if (isGL31) {
+		glPrimitiveRestartIndex = (PFNGLPRIMITIVERESTARTINDEXPROC)getGLProc("glPrimitiveRestartIndex");
+		if (glPrimitiveRestartIndex) g_primitiveRestartCap = GL_PRIMITIVE_RESTART;
+	}
+	else if (hasGLExtension("GL_NV_primitive_restart")) {
+		glPrimitiveRestartIndex = (PFNGLPRIMITIVERESTARTINDEXPROC)getGLProc("glPrimitiveRestartIndexNV");
+		if (glPrimitiveRestartIndex) g_primitiveRestartCap = GL_PRIMITIVE_RESTART_NV;
+	}
 
-	// Disable texturing afterwards
-	glDisable(GL_TEXTURE_2D);
+	char buffer[512];
+	sprintf_s(buffer, "GL renderer: %s, S3TC texture compression: %s, PBO streaming: %s, VBO meshes: %s, primitive restart: %s, GLSL: %s, tessellation: %s, FBO: %s, timer queries: %s\n",
+		(const char*)glGetString(GL_RENDERER), g_hasS3TC ? "yes" : "no", g_hasPBO ? "yes" : "no", g_hasVBO ? "yes" : "no",
+		g_primitiveRestartCap ? "yes" : "no", g_hasGLSL ? "yes" : "no", g_hasTessellation ? "yes" : "no", g_hasFBO ? "yes" : "no",
+		g_hasTimerQuery ? "yes" : "no");
+	OutputDebugStringA(buffer);
 }
 
-void drawSmoothLowerBodyAndSkirt()
+// --- GLSL Programs ---
+// Compile/link failures go to the debugger output and return 0, so callers
+// can keep their fixed-function path.
+static GLuint compileShader(GLenum type, const char* source)
 {
-	// Set the base material colour to white. This allows the texture's own colours
-	// to show up correctly without being tinted yellow.
-	glColor3f(1.0f, 1.0f, 1.0f);
-
-	// --- NEW: Enable and apply the silver texture ---
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, g_silverTextureID);
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE); // Blends texture with lighting
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+	GLint compiled = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+		OutputDebugStringA("Shader compile failed:\n");
+		OutputDebugStringA(log);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
 
-	float lower_body_profile[][2] = {
-		{0.18f, -0.05f}, // Top of lower waist (below the thin waist segment)
-		{0.20f, -0.1f},  // Start of hips
-		{0.38f, -0.5f},  // Widest part of hips
-		{0.45f, -0.9f},  // Flare outwards for the skirt effect
-		{0.40f, -1.0f},  // Gently curve inwards at the very bottom
-		{0.30f, -1.0f}   // Flat bottom part for the base of the skirt
-	};
-	int lower_body_points = sizeof(lower_body_profile) / sizeof(lower_body_profile[0]);
+// attributeNames[i] is bound to generic attribute i before linking
+GLuint linkProgram(const GLuint* shaders, int shaderCount, const char* const* attributeNames, int attributeCount)
+{
+	GLuint program = glCreateProgram();
+	for (int i = 0; i < shaderCount; ++i) glAttachShader(program, shaders[i]);
+	for (int i = 0; i < attributeCount; ++i) glBindAttribLocation(program, i, attributeNames[i]);
+	glLinkProgram(program);
+	for (int i = 0; i < shaderCount; ++i) glDeleteShader(shaders[i]); // Freed with the program
+	GLint linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		char log[1024];
+		glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+		OutputDebugStringA("Shader link failed:\n");
+		OutputDebugStringA(log);
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
 
-	drawLathedObject(lower_body_profile, lower_body_points, 24);
+// Lights a vertex the way the fixed-function pipeline does for this scene:
+// GL_COLOR_MATERIAL on, point or directional lights without attenuation or
+// spots, and only LIGHT0/LIGHT1. Pasted into shaders that replace the vertex
+// stage; setFixedFunctionLightingUniforms() mirrors the enables.
+#define GLSL_FIXED_FUNCTION_LIGHTING \
+	"uniform float lighting;\n" \
+	"uniform vec2 enabledLights;\n" \
+	"vec4 applyLight(gl_LightSourceParameters light, vec3 normal, vec3 eye, vec4 colour) {\n" \
+	"	vec3 toLight = normalize(light.position.w == 0.0 ? light.position.xyz : light.position.xyz - eye);\n" \
+	"	float diffuse = max(dot(normal, toLight), 0.0);\n" \
+	"	vec4 result = light.ambient * colour + diffuse * light.diffuse * colour;\n" \
+	"	if (diffuse > 0.0) {\n" \
+	"		vec3 halfVector = normalize(toLight + vec3(0.0, 0.0, 1.0));\n" \
+	"		result += pow(max(dot(normal, halfVector), 0.0), gl_FrontMaterial.shininess) * light.specular * gl_FrontMaterial.specular;\n" \
+	"	}\n" \
+	"	return result;\n" \
+	"}\n" \
+	"vec4 litColour(vec3 normal, vec3 eye, vec4 colour) {\n" \
+	"	if (lighting < 0.5) return colour;\n" \
+	"	vec4 result = gl_FrontMaterial.emission + gl_LightModel.ambient * colour;\n" \
+	"	if (enabledLights.x > 0.5) result += applyLight(gl_LightSource[0], normal, eye, colour);\n" \
+	"	if (enabledLights.y > 0.5) result += applyLight(gl_LightSource[1], normal, eye, colour);\n" \
+	"	return vec4(clamp(result.rgb, 0.0, 1.0), colour.a);\n" \
+	"}\n"
+
+void setFixedFunctionLightingUniforms(GLint lightingLocation, GLint enabledLightsLocation)
+{
+	glUniform1f(lightingLocation, glIsEnabled(GL_LIGHTING) ? 1.0f : 0.0f);
+	glUniform2f(enabledLightsLocation, glIsEnabled(GL_LIGHT0) ? 1.0f : 0.0f, glIsEnabled(GL_LIGHT1) ? 1.0f : 0.0f);
+}
 
-	// --- NEW: Disable texturing after drawing the skirt ---
-	// This is important so the texture doesn't accidentally get applied to other objects.
-	glDisable(GL_TEXTURE_2D);
+// --- Timing Helpers ---
+double getTimeMs()
+{
+	static LARGE_INTEGER frequency = { 0 };
+	if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart * 1000.0 / (double)frequency.QuadPart;
 }
 
-void drawDiamondKneeJoint()
+// Benchmark results go to the debugger output and are appended to bench_output.txt
+void benchLog(const char* format, ...)
 {
-	glPushMatrix();
-	// NOTE: This function inherits the gold material from drawLegs()
+	char buffer[512];
+	va_list args;
+	va_start(args, format);
+	vsprintf_s(buffer, format, args);
+	va_end(args);
 
-	// --- NEW: Enable and apply the fire texture ---
-	glEnable(GL_TEXTURE_2D);
-	// We use g_fireTextureID because it already has Fire.bmp loaded
-	glBindTexture(GL_TEXTURE_2D, g_fireTextureID);
-	// This blends the fire texture with the existing gold material and lighting
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	OutputDebugStringA(buffer);
+	FILE* file;
+	fopen_s(&file, "bench_output.txt", "a");
+	if (file) {
+		fputs(buffer, file);
+		fclose(file);
+	}
+}
 
-	// Y-scale (height) is kept long to allow for overlap
-	glScalef(0.2f, 0.45f, 0.2f); // X, Y (height), Z scale
+// --- Worker Thread Pool ---
+// A small pool shared by all data-parallel CPU work. parallelFor() splits
+// [0, count) into chunks that the workers and the calling thread pull from;
+// several threads may run their own parallelFor at the same time.
+struct ParallelJob {
+	const std::function<void(int, int)>* body;
+	int count;
+	int chunkSize;
+	std::atomic<int> nextIndex;
+	int chunksLeft;  // Chunks not yet finished (guarded by the pool mutex)
+	int activeUsers; // Workers currently holding a pointer to this job
+};
 
-	// This rotation orients the diamond correctly
-	glRotatef(45.0f, 0.0f, 1.0f, 0.0f);
+struct ThreadPool {
+	std::vector<std::thread> workers;
+	std::vector<ParallelJob*> jobs;
+	std::mutex mutex;
+	std::condition_variable wakeWorkers;
+	std::condition_variable jobFinished;
+	bool quit = false;
 
-	// Define the 6 points of our diamond (an octahedron)
-	float p[6][3] = {
-		{ 0.0f,  1.0f,  0.0f}, // Top
-		{ 0.0f, -1.0f,  0.0f}, // Bottom
-		{ 1.0f,  0.0f,  0.0f}, // Right
-		{-1.0f,  0.0f,  0.0f}, // Left
-		{ 0.0f,  0.0f,  1.0f}, // Front
-		{ 0.0f,  0.0f, -1.0f}  // Back
-	};
+	~ThreadPool(); // Joins any workers still running if WinMain exits early
+};
 
-	// --- NEW: Define texture coordinates for the 6 points ---
-	// This maps points on the 2D fire image to the 3D diamond points.
-	float t[6][2] = {
-		{0.5f, 1.0f}, // Top-middle of texture
-		{0.5f, 0.0f}, // Bottom-middle of texture
-		{1.0f, 0.5f}, // Middle-right of texture
-		{0.0f, 0.5f}, // Middle-left of texture
-		{0.5f, 0.5f}, // Center of texture
-		{0.5f, 0.5f}  // Center of texture
-	};
+ThreadPool g_threadPool;
 
-	// An array to hold the calculated normals for each of the 8 faces
-	float n[8][3] = {
-		{ 0.707f,  0.707f,  0.707f}, { -0.707f,  0.707f,  0.707f},
-		{ -0.707f,  0.707f, -0.707f}, {  0.707f,  0.707f, -0.707f},
-		{ 0.707f, -0.707f,  0.707f}, { -0.707f, -0.707f,  0.707f},
-		{ -0.707f, -0.707f, -0.707f}, {  0.707f, -0.707f, -0.707f}
-	};
+// Claims and runs chunks of 'job' until none are left. Returns the number of chunks run.
+static int runParallelChunks(ParallelJob& job)
+{
+	int chunksRun = 0;
+	while (true) {
+		int begin = job.nextIndex.fetch_add(job.chunkSize);
+		if (begin >= job.count) break;
+		int end = (begin + job.chunkSize < job.count) ? begin + job.chunkSize : job.count;
+		(*job.body)(begin, end);
+		++chunksRun;
+	}
+	return chunksRun;
+}
 
-	glBegin(GL_TRIANGLES);
-	// Top-Front-Right face
-	glNormal3fv(n[0]);
-	glTexCoord2fv(t[0]); glVertex3fv(p[0]);
-	glTexCoord2fv(t[4]); glVertex3fv(p[4]);
-	glTexCoord2fv(t[2]); glVertex3fv(p[2]);
-	// Top-Front-Left face
-	glNormal3fv(n[1]);
-	glTexCoord2fv(t[0]); glVertex3fv(p[0]);
-	glTexCoord2fv(t[3]); glVertex3fv(p[3]);
-	glTexCoord2fv(t[4]); glVertex3fv(p[4]);
-	// Top-Back-Left face
-	glNormal3fv(n[2]);
-	glTexCoord2fv(t[0]); glVertex3fv(p[0]);
-	glTexCoord2fv(t[5]); glVertex3fv(p[5]);
-	glTexCoord2fv(t[3]); glVertex3fv(p[3]);
-	// Top-Back-Right face
-	glNormal3fv(n[3]);
-	glTexCoord2fv(t[0]); glVertex3fv(p[0]);
-	glTexCoord2fv(t[2]); glVertex3fv(p[2]);
-	glTexCoord2fv(t[5]); glVertex3fv(p[5]);
+static void threadPoolWorker()
+{
+	std::unique_lock<std::mutex> lock(g_threadPool.mutex);
+	while (true) {
+		g_threadPool.wakeWorkers.wait(lock, [] { return g_threadPool.quit || !g_threadPool.jobs.empty(); });
+		if (g_threadPool.quit) return;
 
-	// Bottom-Front-Right face
-	glNormal3fv(n[4]);
-	glTexCoord2fv(t[1]); glVertex3fv(p[1]);
-	glTexCoord2fv(t[2]); glVertex3fv(p[2]);
-	glTexCoord2fv(t[4]); glVertex3fv(p[4]);
-	// Bottom-Front-Left face
-	glNormal3fv(n[5]);
-	glTexCoord2fv(t[1]); glVertex3fv(p[1]);
-	glTexCoord2fv(t[4]); glVertex3fv(p[4]);
-	glTexCoord2fv(t[3]); glVertex3fv(p[3]);
-	// Bottom-Back-Left face
-	glNormal3fv(n[6]);
-	glTexCoord2fv(t[1]); glVertex3fv(p[1]);
-	glTexCoord2fv(t[3]); glVertex3fv(p[3]);
-	glTexCoord2fv(t[5]); glVertex3fv(p[5]);
-	// Bottom-Back-Right face
-	glNormal3fv(n[7]);
-	glTexCoord2fv(t[1]); glVertex3fv(p[1]);
-	glTexCoord2fv(t[5]); glVertex3fv(p[5]);
-	glTexCoord2fv(t[2]); glVertex3fv(p[2]);
-	glEnd();
+		ParallelJob* job = g_threadPool.jobs.front();
+		job->activeUsers++;
+		lock.unlock();
 
-	// --- NEW: Disable texturing so it doesn't affect other objects ---
-	glDisable(GL_TEXTURE_2D);
+		int chunksRun = runParallelChunks(*job);
 
-	glPopMatrix();
+		lock.lock();
+		// Every chunk has been claimed, so no other worker should pick this job up again
+		if (!g_threadPool.jobs.empty() && g_threadPool.jobs.front() == job) {
+			g_threadPool.jobs.erase(g_threadPool.jobs.begin());
+		}
+		job->chunksLeft -= chunksRun;
+		job->activeUsers--;
+		if (job->chunksLeft == 0 && job->activeUsers == 0) {
+			g_threadPool.jobFinished.notify_all();
+		}
+	}
 }
 
-void drawSphere(float r, int slices, int stacks)
+void startThreadPool()
 {
-	const int MAX_STACKS = 50; // adjust if needed
-	float profile[MAX_STACKS + 1][2];
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	int workerCount = (hardwareThreads > 1) ? (int)hardwareThreads - 1 : 1; // The caller works too
+	for (int i = 0; i < workerCount; ++i) {
+		g_threadPool.workers.emplace_back(threadPoolWorker);
+	}
+}
 
-	int count = 0;
-	for (int i = 0; i <= stacks; i++)
+void stopThreadPool()
+{
 	{
-		float theta = (float)i / stacks * 3.14159f; // 0 → PI
-		float y = r * cos(theta);
-		float x = r * sin(theta);
-		profile[count][0] = x;
-		profile[count][1] = y;
-		count++;
+		std::lock_guard<std::mutex> lock(g_threadPool.mutex);
+		g_threadPool.quit = true;
 	}
+	g_threadPool.wakeWorkers.notify_all();
+	for (auto& worker : g_threadPool.workers) worker.join();
+	g_threadPool.workers.clear();
+}
 
-	drawLathedObject(profile, count, slices);
+ThreadPool::~ThreadPool()
+{
+	if (!workers.empty()) stopThreadPool();
 }
 
-void drawDivineMirror() {
-	glPushMatrix();
+void parallelFor(int count, int chunkSize, const std::function<void(int begin, int end)>& body)
+{
+	if (count <= 0) return;
+	if (chunkSize < 1) chunkSize = 1;
+	if (g_threadPool.workers.empty() || count <= chunkSize) {
+		body(0, count);
+		return;
+	}
 
-	// --- 1. Position the Mirror ---
-	// We'll have it float gracefully near the character's right hand.
-	// This position is relative to the hand's location.
-	glTranslatef(0.3f, 0.2f, 0.5f);
-	glRotatef(-90.0f, 0.0f, 1.0f, 0.0f); // Face the mirror forward
-	glRotatef(-15.0f, 1.0f, 0.0f, 0.0f); // Tilt it slightly up
+	ParallelJob job;
+	job.body = &body;
+	job.count = count;
+	job.chunkSize = chunkSize;
+	job.nextIndex = 0;
+	job.chunksLeft = (count + chunkSize - 1) / chunkSize;
+	job.activeUsers = 0;
 
-	// Animate a slow, mystical rotation and hover
-	glRotatef(g_braidTime * 15.0f, 0.0f, 0.0f, 1.0f); // Slow spin
-	glTranslatef(0.0f, sin(g_braidTime) * 0.05f, 0.0f); // Gentle up-down bob
+	{
+		std::lock_guard<std::mutex> lock(g_threadPool.mutex);
+		g_threadPool.jobs.push_back(&job);
+	}
+	g_threadPool.wakeWorkers.notify_all();
 
-	// --- 2. Set Material for the Frame (Shiny Silver/Jade) ---
-	GLfloat mat_ambient[] = { 0.8f, 0.9f, 0.8f, 1.0f };
-	GLfloat mat_diffuse[] = { 0.9f, 1.0f, 0.9f, 1.0f };
-	GLfloat mat_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-	GLfloat mat_shininess[] = { 100.0f };
-	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
-	glColor3f(0.9f, 1.0f, 0.9f);
+	int chunksRun = runParallelChunks(job);
 
-	// --- 3. Draw the Octagonal Frame ---
-	const int sides = 8;
-	const float outer_radius = 0.4f;
-	const float inner_radius = 0.35f;
-	const float thickness = 0.05f;
+	std::unique_lock<std::mutex> lock(g_threadPool.mutex);
+	for (size_t i = 0; i < g_threadPool.jobs.size(); ++i) {
+		if (g_threadPool.jobs[i] == &job) {
+			g_threadPool.jobs.erase(g_threadPool.jobs.begin() + i);
+			break;
+		}
+	}
+	job.chunksLeft -= chunksRun;
+	g_threadPool.jobFinished.wait(lock, [&job] { return job.chunksLeft == 0 && job.activeUsers == 0; });
+}
 
-	for (int i = 0; i < sides; ++i) {
-		float angle1 = (float)i / sides * 2.0f * 3.14159f;
-		float angle2 = (float)(i + 1) / sides * 2.0f * 3.14159f;
+// --- BMP Reading ---
+// Decoded BMP pixels, tightly packed (BMP row padding removed) and kept in the
+// file's bottom-up BGR / BGRA order so they can be handed straight to OpenGL.
+struct BmpImage {
+	int width = 0;
+	int height = 0;
+	int bytesPerPixel = 0; // 3 = BGR, 4 = BGRA
+	std::vector<unsigned char> pixels;
+};
 
-		// Vertices for one segment of the frame
-		float v[8][3] = {
-			{ outer_radius * cos(angle1), outer_radius * sin(angle1),  thickness / 2.0f },
-			{ outer_radius * cos(angle2), outer_radius * sin(angle2),  thickness / 2.0f },
-			{ inner_radius * cos(angle2), inner_radius * sin(angle2),  thickness / 2.0f },
-			{ inner_radius * cos(angle1), inner_radius * sin(angle1),  thickness / 2.0f },
-			{ outer_radius * cos(angle1), outer_radius * sin(angle1), -thickness / 2.0f },
-			{ outer_radius * cos(angle2), outer_radius * sin(angle2), -thickness / 2.0f },
-			{ inner_radius * cos(angle2), inner_radius * sin(angle2), -thickness / 2.0f },
-			{ inner_radius * cos(angle1), inner_radius * sin(angle1), -thickness / 2.0f }
-		};
+bool readBMP(const char* imagepath, BmpImage& image)
+{
+	char buffer[256];
+	unsigned char header[54];
 
-		glBegin(GL_QUADS);
-		// Front face
-		glNormal3f(0, 0, 1);
-		glVertex3fv(v[0]); glVertex3fv(v[1]); glVertex3fv(v[2]); glVertex3fv(v[3]);
-		// Back face
-		glNormal3f(0, 0, -1);
-		glVertex3fv(v[4]); glVertex3fv(v[7]); glVertex3fv(v[6]); glVertex3fv(v[5]);
-		// Outer face
-		float nx_out = cos((angle1 + angle2) / 2.0f);
-		float ny_out = sin((angle1 + angle2) / 2.0f);
-		glNormal3f(nx_out, ny_out, 0);
-		glVertex3fv(v[0]); glVertex3fv(v[4]); glVertex3fv(v[5]); glVertex3fv(v[1]);
-		// Inner face
-		glNormal3f(-nx_out, -ny_out, 0);
-		glVertex3fv(v[3]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[7]);
-		glEnd();
+	FILE* file;
+	fopen_s(&file, imagepath, "rb");
+	if (!file) {
+		OutputDebugStringA("Error: Image could not be opened.\n");
+		return false;
 	}
 
-	// --- 4. Draw the Mirror Surface ---
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, g_mirrorTextureID); // Use the new mirror texture
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	if (fread(header, 1, 54, file) != 54) {
+		OutputDebugStringA("Error: Not a correct BMP file (header read failed).\n");
+		fclose(file);
+		return false;
+	}
+	if (header[0] != 'B' || header[1] != 'M') {
+		OutputDebugStringA("Error: Not a correct BMP file (magic number mismatch).\n");
+		fclose(file);
+		return false;
+	}
 
-	// Make the surface glow brightly
-	glDisable(GL_LIGHTING);
-	glColor3f(1.0f, 1.0f, 1.0f);
+	// Read important information from the header
+	unsigned int dataPos = *(int*)&(header[0x0A]);
+	int width = *(int*)&(header[0x12]);
+	int height = *(int*)&(header[0x16]);
+	unsigned short bitsPerPixel = *(unsigned short*)&(header[0x1C]);
 
-	glBegin(GL_POLYGON);
-	glNormal3f(0, 0, 1);
-	for (int i = 0; i < sides; ++i) {
-		float angle = (float)i / sides * 2.0f * 3.14159f;
-		// Map vertices to a circular texture coordinate space
-		float u = 0.5f + 0.5f * cos(angle);
-		float v = 0.5f + 0.5f * sin(angle);
-		glTexCoord2f(u, v);
-		glVertex3f(inner_radius * cos(angle), inner_radius * sin(angle), 0.0f);
+	if (bitsPerPixel != 24 && bitsPerPixel != 32) {
+		sprintf_s(buffer, "Error: Unsupported BMP format (%d bits per pixel).\n", bitsPerPixel);
+		OutputDebugStringA(buffer);
+		fclose(file);
+		return false;
 	}
-	glEnd();
-
-	glEnable(GL_LIGHTING);
-	glDisable(GL_TEXTURE_2D);
+	if (dataPos == 0) { dataPos = 54; } // The size of the header
 
-	glPopMatrix();
-}
+	image.width = width;
+	image.height = height;
+	image.bytesPerPixel = bitsPerPixel / 8;
 
-void drawWeapon()
-{
-	// Set material for a shiny, magical weapon
-	GLfloat mat_ambient[] = { 0.7f, 0.7f, 1.0f, 1.0f }; // Bluish ambient
-	GLfloat mat_diffuse[] = { 0.8f, 0.8f, 1.0f, 1.0f }; // Bright blue/purple diffuse
-	GLfloat mat_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f }; // Bright white highlight
-	GLfloat mat_shininess[] = { 120.0f };
-	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+	// BMP rows are padded to a multiple of 4 bytes
+	size_t rowSize = (size_t)width * image.bytesPerPixel;
+	size_t paddedRowSize = (rowSize + 3) & ~(size_t)3;
+	image.pixels.resize(rowSize * height);
 
-	glPushMatrix();
+	fseek(file, dataPos, SEEK_SET);
+	for (int y = 0; y < height; ++y) {
+		if (fread(&image.pixels[y * rowSize], 1, rowSize, file) != rowSize) {
+			OutputDebugStringA("Error: Could not read all pixel data from file.\n");
+			fclose(file);
+			return false;
+		}
+		fseek(file, (long)(paddedRowSize - rowSize), SEEK_CUR);
+	}
 
-	// --- THIS IS THE ADJUSTED TRANSFORMATION BLOCK ---
+	fclose(file); // File is no longer needed
+	return true;
+}
 
-	// Step 1: Position the staff's pivot point slightly in front of the palm's center.
-	// MODIFIED: Adjusted the Z-translation to move the staff slightly outwards.
-	glTranslatef(0.0f, 0.0f, 0.15f); // Changed from 0.05f to 0.15f
+// --- S3TC (BC1 / BC3) Block Compression ---
+// A compressed texture is a full mip chain of 4x4 blocks: 8 bytes per block for
+// BC1 (opaque RGB) and 16 bytes for BC3 (RGB + interpolated alpha), i.e. 6:1 and
+// 4:1 compared to the RGB8/RGBA8 storage the driver would otherwise use.
+struct CompressedTexture {
+	GLenum format = 0; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	int width = 0;
+	int height = 0;
+	std::vector<std::vector<unsigned char>> levels;
+};
 
-	// Step 2: Rotate it to a natural holding angle.
-	glRotatef(-75.0f, 0.0f, 0.0f, 1.0f);
-	glRotatef(30.0f, 1.0f, 0.0f, 0.0f);
+static int blockBytesFor(GLenum format) { return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16; }
 
-	// Step 3: After rotating, move the staff along its NEW down-axis to sit in the hand.
-	glTranslatef(0.0f, -0.9f, 0.0f);
+static size_t compressedLevelSize(GLenum format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytesFor(format);
+}
 
-	// --- END OF ADJUSTED BLOCK ---
+static unsigned short packRGB565(float r, float g, float b)
+{
+	int r5 = (int)(r * 31.0f / 255.0f + 0.5f);
+	int g6 = (int)(g * 63.0f / 255.0f + 0.5f);
+	int b5 = (int)(b * 31.0f / 255.0f + 0.5f);
+	r5 = r5 < 0 ? 0 : (r5 > 31 ? 31 : r5);
+	g6 = g6 < 0 ? 0 : (g6 > 63 ? 63 : g6);
+	b5 = b5 < 0 ? 0 : (b5 > 31 ? 31 : b5);
+	return (unsigned short)((r5 << 11) | (g6 << 5) | b5);
+}
 
+static void unpackRGB565(unsigned short c, int rgb[3])
+{
+	int r5 = (c >> 11) & 31, g6 = (c >> 5) & 63, b5 = c & 31;
+	rgb[0] = (r5 << 3) | (r5 >> 2);
+	rgb[1] = (g6 << 2) | (g6 >> 4);
+	rgb[2] = (b5 << 3) | (b5 >> 2);
+}
 
-	// Now, draw the staff parts (this code remains the same)
-	// --- 1. Draw the Staff Shaft ---
-	glColor3f(0.3f, 0.2f, 0.4f);
-	float shaft_profile[][2] = { {0.04f, 0.0f}, {0.04f, 1.8f} };
-	drawLathedObject(shaft_profile, 2, 12);
+// Encodes one 4x4 block of RGB colours (block[i] = {r, g, b}) into 8 bytes.
+// Endpoints are the extreme pixels along the block's principal axis, pulled in
+// slightly to reduce the error of the interpolated palette entries.
+static void encodeBC1ColorBlock(const unsigned char block[16][4], unsigned char* out)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 3; ++c) mean[c] += block[i][c];
+	for (int c = 0; c < 3; ++c) mean[c] /= 16.0f;
+
+	// Covariance of the block colours
+	float cov[6] = { 0 }; // rr, rg, rb, gg, gb, bb
+	for (int i = 0; i < 16; ++i) {
+		float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
 
-	// --- 2. Draw the Crystal Topper ---
-	glPushMatrix();
-	glTranslatef(0.0f, 1.95f, 0.0f);
-	glScalef(1.0f, 1.5f, 1.0f);
+	// Principal axis by power iteration
+	float axis[3] = { 0.577f, 0.577f, 0.577f };
+	for (int iter = 0; iter < 6; ++iter) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float len = sqrt(x * x + y * y + z * z);
+		if (len < 1e-6f) break; // Flat colour block, any axis will do
+		axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+	}
 
-	glDisable(GL_LIGHTING);
-	glColor3f(0.8f, 0.9f, 1.0f);
-	drawDiamondKneeJoint();
-	glEnable(GL_LIGHTING);
-	glPopMatrix();
+	float minProj = 1e9f, maxProj = -1e9f;
+	for (int i = 0; i < 16; ++i) {
+		float p = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+		if (p < minProj) minProj = p;
+		if (p > maxProj) maxProj = p;
+	}
+	float inset = (maxProj - minProj) / 16.0f;
+	minProj += inset;
+	maxProj -= inset;
 
-	// --- 3. Draw Decorative Elements ---
-	glColor3f(1.0f, 0.84f, 0.0f);
+	unsigned short c0 = packRGB565(mean[0] + axis[0] * maxProj, mean[1] + axis[1] * maxProj, mean[2] + axis[2] * maxProj);
+	unsigned short c1 = packRGB565(mean[0] + axis[0] * minProj, mean[1] + axis[1] * minProj, mean[2] + axis[2] * minProj);
 
-	// Top holder for the crystal
-	glPushMatrix();
-	glTranslatef(0.0f, 1.85f, 0.0f);
-	drawSphere(0.1f, 16, 16);
-	glPopMatrix();
+	unsigned int indices = 0;
+	if (c0 == c1) {
+		// Single colour: every pixel uses palette entry 0
+	}
+	else {
+		// c0 > c1 selects the opaque four-colour mode
+		if (c0 < c1) { unsigned short t = c0; c0 = c1; c1 = t; }
+
+		int palette[4][3];
+		unpackRGB565(c0, palette[0]);
+		unpackRGB565(c1, palette[1]);
+		for (int c = 0; c < 3; ++c) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
 
-	// Bottom pommel
-	glPushMatrix();
-	glTranslatef(0.0f, 0.0f, 0.0f);
-	drawSphere(0.08f, 16, 16);
-	glPopMatrix();
+		for (int i = 0; i < 16; ++i) {
+			int best = 0, bestDist = 1 << 30;
+			for (int p = 0; p < 4; ++p) {
+				int dr = block[i][0] - palette[p][0];
+				int dg = block[i][1] - palette[p][1];
+				int db = block[i][2] - palette[p][2];
+				int dist = dr * dr + dg * dg + db * db;
+				if (dist < bestDist) { bestDist = dist; best = p; }
+			}
+			indices |= (unsigned int)best << (2 * i);
+		}
+	}
 
-	glPopMatrix();
+	out[0] = (unsigned char)(c0 & 0xFF); out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xFF); out[3] = (unsigned char)(c1 >> 8);
+	out[4] = (unsigned char)(indices & 0xFF); out[5] = (unsigned char)((indices >> 8) & 0xFF);
+	out[6] = (unsigned char)((indices >> 16) & 0xFF); out[7] = (unsigned char)(indices >> 24);
 }
 
-void drawSmoothArms()
+// Encodes the alpha channel of a 4x4 block (block[i][3]) into the 8-byte BC3 alpha block.
+static void encodeBC3AlphaBlock(const unsigned char block[16][4], unsigned char* out)
 {
-	// This function will first draw the left arm completely,
-	// then draw the right arm and conditionally draw the weapon with it.
-
-	// --- Left Arm ---
-	glPushMatrix();
-	{
-		glColor3f(1.0f, 1.0f, 1.0f);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, g_orangeTextureID);
-		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-
-		glTranslatef(-0.6f, 0.7f, 0.0f);
-		glRotatef(g_leftArmAngles[0], 0.0f, 0.0f, 1.0f);
-		glRotatef(g_leftArmAngles[1], 1.0f, 0.0f, 0.0f);
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; ++i) {
+		if (block[i][3] > a0) a0 = block[i][3];
+		if (block[i][3] < a1) a1 = block[i][3];
+	}
 
-		float upper_arm_profile[][2] = { {0.08f, 0.0f}, {0.08f, -0.5f} };
-		drawLathedObject(upper_arm_profile, 2, 12);
-		glTranslatef(0.0f, -0.5f, 0.0f);
+	unsigned long long indices = 0;
+	if (a0 > a1) {
+		// Eight-alpha mode: index 0 = a0, 1 = a1, 2..7 = six steps from a0 towards a1
+		for (int i = 0; i < 16; ++i) {
+			int step = (int)((float)(a0 - block[i][3]) * 7.0f / (float)(a0 - a1) + 0.5f);
+			int index = (step == 0) ? 0 : (step == 7 ? 1 : step + 1);
+			indices |= (unsigned long long)index << (3 * i);
+		}
+	}
 
-		float finalLeftElbowAngle = g_leftArmAngles[2] + (ARM_POSE_WAVE_ELBOW - g_leftArmAngles[2]) * g_leftWaveProgress;
-		glRotatef(finalLeftElbowAngle, 1.0f, 0.0f, 0.0f);
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int b = 0; b < 6; ++b) {
+		out[2 + b] = (unsigned char)((indices >> (8 * b)) & 0xFF);
+	}
+}
 
-		float lower_arm_profile[][2] = { {0.07f, 0.0f}, {0.07f, -0.4f} };
-		drawLathedObject(lower_arm_profile, 2, 12);
-		glTranslatef(0.0f, -0.4f, 0.0f);
+// Compresses one BGR / BGRA image level. Blocks that run off the edge of a
+// small mip level (2x2, 1x1) repeat the last row / column.
+static void compressImageLevel(const unsigned char* pixels, int width, int height, int bytesPerPixel, GLenum format, unsigned char* out)
+{
+	int blockBytes = blockBytesFor(format);
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4) {
+			unsigned char block[16][4];
+			for (int y = 0; y < 4; ++y) {
+				int sy = (by + y < height) ? by + y : height - 1;
+				for (int x = 0; x < 4; ++x) {
+					int sx = (bx + x < width) ? bx + x : width - 1;
+					const unsigned char* src = pixels + ((size_t)sy * width + sx) * bytesPerPixel;
+					block[y * 4 + x][0] = src[2]; // R
+					block[y * 4 + x][1] = src[1]; // G
+					block[y * 4 + x][2] = src[0]; // B
+					block[y * 4 + x][3] = (bytesPerPixel == 4) ? src[3] : 255;
+				}
+			}
 
-		glRotatef(70.0f, 0.0f, 1.0f, 0.0f);
-		drawHand(true);
+			if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+				encodeBC3AlphaBlock(block, out);
+				encodeBC1ColorBlock(block, out + 8);
+			}
+			else {
+				encodeBC1ColorBlock(block, out);
+			}
+			out += blockBytes;
+		}
 	}
-	glPopMatrix();
+}
 
-	// --- Right Arm & Weapon ---
-	glPushMatrix();
-	{
-		glColor3f(1.0f, 1.0f, 1.0f);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, g_orangeTextureID);
-		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+// Largest power of two not above 'size' - the same size gluBuild2DMipmaps picks
+static int floorPowerOfTwo(int size)
+{
+	int pot = 1;
+	while (pot * 2 <= size) pot *= 2;
+	return pot;
+}
 
-		glTranslatef(0.6f, 0.7f, 0.0f);
-		glRotatef(g_rightArmAngles[0], 0.0f, 0.0f, 1.0f);
-		glRotatef(g_rightArmAngles[1], 1.0f, 0.0f, 0.0f);
+// --- Mipmap Generation ---
+// Replaces gluBuild2DMipmaps. The BMP is decoded once into linear-light floats
+// (one SSE register per B, G, R, A pixel), resampled to the same power-of-two
+// size GLU would pick, then halved with a 2x2 box filter per level. Colour is
+// averaged in linear space and re-encoded to sRGB so mips don't darken; alpha
+// is averaged as-is. Rows are split across the thread pool.
+struct MipChain {
+	int width = 0;         // Size of level 0
+	int height = 0;
+	int bytesPerPixel = 0; // 3 = BGR, 4 = BGRA, same as the source BMP
+	std::vector<std::vector<unsigned char>> levels;
+};
 
-		float upper_arm_profile[][2] = { {0.08f, 0.0f}, {0.08f, -0.5f} };
-		drawLathedObject(upper_arm_profile, 2, 12);
-		glTranslatef(0.0f, -0.5f, 0.0f);
+static float g_srgbToLinear[256];
+static unsigned char g_linearToSrgb[4096];
 
-		float finalRightElbowAngle = g_rightArmAngles[2] + (ARM_POSE_WAVE_ELBOW - g_rightArmAngles[2]) * g_rightWaveProgress;
-		glRotatef(finalRightElbowAngle, 1.0f, 0.0f, 0.0f);
+static void initSrgbTables()
+{
+	// Mip chains are generated on the texture loader thread, so guard the one-time fill
+	static std::once_flag initialised;
+	std::call_once(initialised, [] {
+		for (int i = 0; i < 256; ++i) {
+			float c = i / 255.0f;
+			g_srgbToLinear[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 4096; ++i) {
+			float l = i / 4095.0f;
+			float c = (l <= 0.0031308f) ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+			g_linearToSrgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+		}
+	});
+}
 
-		float lower_arm_profile[][2] = { {0.07f, 0.0f}, {0.07f, -0.4f} };
-		drawLathedObject(lower_arm_profile, 2, 12);
-		glTranslatef(0.0f, -0.4f, 0.0f);
+// Chooses the base level size like gluBuild2DMipmaps: the largest power of two
+// not above the image size, halved until it fits GL_MAX_TEXTURE_SIZE.
+void getMipBaseSize(int imageWidth, int imageHeight, int maxTextureSize, int& width, int& height)
+{
+	width = floorPowerOfTwo(imageWidth);
+	height = floorPowerOfTwo(imageHeight);
+	while (maxTextureSize > 0 && (width > maxTextureSize || height > maxTextureSize)) {
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+}
 
-		glRotatef(-70.0f, 0.0f, 1.0f, 0.0f);
+static void decodeRowToLinear(const unsigned char* src, int width, int bytesPerPixel, float* dst)
+{
+	for (int x = 0; x < width; ++x, src += bytesPerPixel, dst += 4) {
+		dst[0] = g_srgbToLinear[src[0]];
+		dst[1] = g_srgbToLinear[src[1]];
+		dst[2] = g_srgbToLinear[src[2]];
+		dst[3] = (bytesPerPixel == 4) ? src[3] / 255.0f : 1.0f;
+	}
+}
 
-		// --- NEW LOGIC: Force hand to grip when weapon is visible ---
-		float original_fist_progress = g_fistAnimationProgress; // Save the current hand state
-		if (g_equippedWeapon == 1) {
-			g_fistAnimationProgress = 1.0f; // Force the hand to be fully closed
-		}
+static void encodeRowFromLinear(const float* src, int width, int bytesPerPixel, unsigned char* dst)
+{
+	const __m128 scale = _mm_set_ps(255.0f, 4095.0f, 4095.0f, 4095.0f); // Alpha is stored linearly
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i maxIndex = _mm_set_epi32(255, 4095, 4095, 4095);
+	for (int x = 0; x < width; ++x, src += 4, dst += bytesPerPixel) {
+		__m128i index = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src), scale), half));
+		// Clamp to [0, max] (SSE2 has no 32-bit min/max, so compare and select)
+		index = _mm_and_si128(index, _mm_cmpgt_epi32(index, zero));
+		__m128i tooBig = _mm_cmpgt_epi32(index, maxIndex);
+		index = _mm_or_si128(_mm_andnot_si128(tooBig, index), _mm_and_si128(tooBig, maxIndex));
+
+		alignas(16) int i[4];
+		_mm_store_si128((__m128i*)i, index);
+		dst[0] = g_linearToSrgb[i[0]];
+		dst[1] = g_linearToSrgb[i[1]];
+		dst[2] = g_linearToSrgb[i[2]];
+		if (bytesPerPixel == 4) dst[3] = (unsigned char)i[3];
+	}
+}
 
-		drawHand(false);
+// Box-filter weights for resampling 'srcSize' texels onto 'dstSize' texels.
+// Each destination texel covers a (possibly fractional) span of source texels.
+struct ResampleTap { int first; int count; int weightOffset; };
 
-		g_fistAnimationProgress = original_fist_progress; // Restore the hand state
-		// --- END OF NEW LOGIC ---
+static void buildResampleTaps(int srcSize, int dstSize, std::vector<ResampleTap>& taps, std::vector<float>& weights)
+{
+	float ratio = (float)srcSize / (float)dstSize;
+	taps.resize(dstSize);
+	weights.clear();
+	for (int d = 0; d < dstSize; ++d) {
+		float start = d * ratio, end = (d + 1) * ratio;
+		int first = (int)start;
+		int last = (int)ceilf(end) - 1;
+		if (last >= srcSize) last = srcSize - 1;
+		taps[d].first = first;
+		taps[d].count = last - first + 1;
+		taps[d].weightOffset = (int)weights.size();
+		for (int s = first; s <= last; ++s) {
+			float coverage = ((s + 1 < end) ? s + 1 : end) - ((s > start) ? s : start);
+			weights.push_back(coverage / ratio);
+		}
+	}
+}
 
-		// Draw the weapon if it's visible
-		if (g_equippedWeapon == 1) {
-			drawWeapon();
+// Separable box resample of a linear float image (4 floats per pixel)
+static void resampleLinear(const std::vector<float>& src, int srcWidth, int srcHeight,
+	std::vector<float>& dst, int dstWidth, int dstHeight)
+{
+	std::vector<ResampleTap> xTaps, yTaps;
+	std::vector<float> xWeights, yWeights;
+	buildResampleTaps(srcWidth, dstWidth, xTaps, xWeights);
+	buildResampleTaps(srcHeight, dstHeight, yTaps, yWeights);
+
+	// Horizontal pass: srcWidth x srcHeight -> dstWidth x srcHeight
+	std::vector<float> temp((size_t)dstWidth * srcHeight * 4);
+	parallelFor(srcHeight, 16, [&](int begin, int end) {
+		for (int y = begin; y < end; ++y) {
+			const float* row = &src[(size_t)y * srcWidth * 4];
+			float* out = &temp[(size_t)y * dstWidth * 4];
+			for (int x = 0; x < dstWidth; ++x) {
+				const ResampleTap& tap = xTaps[x];
+				__m128 sum = _mm_setzero_ps();
+				for (int k = 0; k < tap.count; ++k) {
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + (tap.first + k) * 4), _mm_set1_ps(xWeights[tap.weightOffset + k])));
+				}
+				_mm_storeu_ps(out + x * 4, sum);
+			}
 		}
-		else if (g_equippedWeapon == 2) { // If Mirror is equipped
-			drawDivineMirror();
+	});
+
+	// Vertical pass: dstWidth x srcHeight -> dstWidth x dstHeight, accumulating whole rows
+	dst.assign((size_t)dstWidth * dstHeight * 4, 0.0f);
+	parallelFor(dstHeight, 16, [&](int begin, int end) {
+		for (int y = begin; y < end; ++y) {
+			const ResampleTap& tap = yTaps[y];
+			float* out = &dst[(size_t)y * dstWidth * 4];
+			for (int k = 0; k < tap.count; ++k) {
+				const float* row = &temp[(size_t)(tap.first + k) * dstWidth * 4];
+				__m128 weight = _mm_set1_ps(yWeights[tap.weightOffset + k]);
+				for (int x = 0; x < dstWidth; ++x) {
+					_mm_storeu_ps(out + x * 4, _mm_add_ps(_mm_loadu_ps(out + x * 4), _mm_mul_ps(_mm_loadu_ps(row + x * 4), weight)));
+				}
+			}
 		}
-	}
-	glPopMatrix();
+	});
+}
 
-	// Final cleanup
-	glDisable(GL_TEXTURE_2D);
+// 2x2 box filter from one level to the next. Odd or 1-texel dimensions clamp.
+static void downsampleLinear(const std::vector<float>& src, int srcWidth, int srcHeight,
+	std::vector<float>& dst, int dstWidth, int dstHeight)
+{
+	dst.resize((size_t)dstWidth * dstHeight * 4);
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	parallelFor(dstHeight, 16, [&](int begin, int end) {
+		for (int y = begin; y < end; ++y) {
+			int y0 = (2 * y < srcHeight) ? 2 * y : srcHeight - 1;
+			int y1 = (2 * y + 1 < srcHeight) ? 2 * y + 1 : srcHeight - 1;
+			const float* row0 = &src[(size_t)y0 * srcWidth * 4];
+			const float* row1 = &src[(size_t)y1 * srcWidth * 4];
+			float* out = &dst[(size_t)y * dstWidth * 4];
+			for (int x = 0; x < dstWidth; ++x) {
+				int x0 = (2 * x < srcWidth) ? 2 * x : srcWidth - 1;
+				int x1 = (2 * x + 1 < srcWidth) ? 2 * x + 1 : srcWidth - 1;
+				__m128 sum = _mm_add_ps(
+					_mm_add_ps(_mm_loadu_ps(row0 + x0 * 4), _mm_loadu_ps(row0 + x1 * 4)),
+					_mm_add_ps(_mm_loadu_ps(row1 + x0 * 4), _mm_loadu_ps(row1 + x1 * 4)));
+				_mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, quarter));
+			}
+		}
+	});
 }
 
-void drawWaistWithVerticalLines()
+static void encodeLevel(const std::vector<float>& linear, int width, int height, int bytesPerPixel, std::vector<unsigned char>& out)
 {
-	float waist_top_y = 0.25f;
-	float waist_bottom_y = -0.05f;
-	float top_radius = 0.25f;
-	float bottom_radius = 0.18f;
-	int sides = 24;
-	int num_lines = 6;
+	out.resize((size_t)width * height * bytesPerPixel);
+	parallelFor(height, 32, [&](int begin, int end) {
+		for (int y = begin; y < end; ++y) {
+			encodeRowFromLinear(&linear[(size_t)y * width * 4], width, bytesPerPixel, &out[(size_t)y * width * bytesPerPixel]);
+		}
+	});
+}
 
-	glBegin(GL_QUADS);
-	for (int i = 0; i < sides; ++i)
-	{
-		float angle1 = (float)i / (float)sides * 2.0f * 3.14159f;
-		float angle2 = (float)(i + 1) / (float)sides * 2.0f * 3.14159f;
-		bool isLineSegment = (i % (sides / num_lines) == 0);
+// Builds the complete mip chain (down to 1x1) for a BMP. Does not touch OpenGL.
+void generateMipChain(const BmpImage& image, int maxTextureSize, MipChain& chain)
+{
+	initSrgbTables();
 
-		if (isLineSegment) {
-			glColor3f(0.8f, 0.6f, 0.0f);
-		}
-		else {
-			glColor3f(1.0f, 0.84f, 0.0f);
+	chain.bytesPerPixel = image.bytesPerPixel;
+	getMipBaseSize(image.width, image.height, maxTextureSize, chain.width, chain.height);
+	chain.levels.clear();
+
+	std::vector<float> source((size_t)image.width * image.height * 4);
+	parallelFor(image.height, 32, [&](int begin, int end) {
+		for (int y = begin; y < end; ++y) {
+			decodeRowToLinear(&image.pixels[(size_t)y * image.width * image.bytesPerPixel], image.width, image.bytesPerPixel,
+				&source[(size_t)y * image.width * 4]);
 		}
+	});
 
-		float v1x = top_radius * cos(angle1);
-		float v1z = top_radius * sin(angle1);
-		float v2x = top_radius * cos(angle2);
-		float v2z = top_radius * sin(angle2);
-		float v3x = bottom_radius * cos(angle2);
-		float v3z = bottom_radius * sin(angle2);
-		float v4x = bottom_radius * cos(angle1);
-		float v4z = bottom_radius * sin(angle1);
+	std::vector<float> current, next;
+	if (chain.width == image.width && chain.height == image.height) {
+		current.swap(source);
+	}
+	else {
+		resampleLinear(source, image.width, image.height, current, chain.width, chain.height);
+	}
 
-		float avg_angle = (angle1 + angle2) / 2.0f;
-		glNormal3f(cos(avg_angle), 0.0f, sin(avg_angle));
-		glVertex3f(v1x, waist_top_y, v1z);
-		glVertex3f(v2x, waist_top_y, v2z);
-		glVertex3f(v3x, waist_bottom_y, v3z);
-		glVertex3f(v4x, waist_bottom_y, v4z);
+	int width = chain.width, height = chain.height;
+	while (true) {
+		chain.levels.emplace_back();
+		encodeLevel(current, width, height, chain.bytesPerPixel, chain.levels.back());
+
+		if (width == 1 && height == 1) break;
+		int nextWidth = width > 1 ? width / 2 : 1;
+		int nextHeight = height > 1 ? height / 2 : 1;
+		downsampleLinear(current, width, height, next, nextWidth, nextHeight);
+		current.swap(next);
+		width = nextWidth;
+		height = nextHeight;
 	}
-	glEnd();
 }
 
-void drawWaistBelt()
+// Uploads every level of a mip chain exactly once
+void uploadMipChain(const MipChain& chain)
 {
-	glColor3f(0.8f, 0.6f, 0.2f); // Darker gold for the belt strap
+	GLenum internalFormat = (chain.bytesPerPixel == 4) ? GL_RGBA : GL_RGB;
+	GLenum pixelFormat = (chain.bytesPerPixel == 4) ? GL_BGRA_EXT : GL_BGR_EXT;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Levels are tightly packed
+	int width = chain.width, height = chain.height;
+	for (size_t i = 0; i < chain.levels.size(); ++i) {
+		glTexImage2D(GL_TEXTURE_2D, (GLint)i, internalFormat, width, height, 0, pixelFormat, GL_UNSIGNED_BYTE, chain.levels[i].data());
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+}
 
-	// --- Define the geometry of the V-shaped belt ---
-	float belt_y_start = -0.05f;
-	float belt_y_end = -0.20f;
-	float belt_width = 0.1f;
-	int segments = 10; // Segments for EACH strap (front-right, front-left, back)
-	const float PI = 3.14159f;
+// Builds the full compressed mip chain for a BMP from the same mip chain the
+// uncompressed path uploads, encoding rows of 4x4 blocks in parallel.
+bool compressBMPImage(const BmpImage& image, CompressedTexture& texture)
+{
+	MipChain chain;
+	generateMipChain(image, g_maxTextureSize, chain);
+
+	texture.format = (image.bytesPerPixel == 4) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	texture.width = chain.width;
+	texture.height = chain.height;
+	texture.levels.clear();
+
+	int levelWidth = chain.width, levelHeight = chain.height;
+	for (const auto& level : chain.levels) {
+		texture.levels.emplace_back(compressedLevelSize(texture.format, levelWidth, levelHeight));
+		unsigned char* out = texture.levels.back().data();
+
+		int blockRows = (levelHeight + 3) / 4;
+		size_t blockRowBytes = compressedLevelSize(texture.format, levelWidth, 4);
+		parallelFor(blockRows, 4, [&](int begin, int end) {
+			for (int row = begin; row < end; ++row) {
+				int rowHeight = (levelHeight - row * 4 < 4) ? levelHeight - row * 4 : 4;
+				compressImageLevel(&level[(size_t)row * 4 * levelWidth * chain.bytesPerPixel], levelWidth, rowHeight,
+					chain.bytesPerPixel, texture.format, out + row * blockRowBytes);
+			}
+		});
 
-	float SURFACE_OFFSET = 0.02f;
+		levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+	}
+	return true;
+}
 
-	float radius_at_y_start = 0.18f;
-	float radius_at_y_end = 0.22f;
+// --- DDS Cache Files ---
+// Compressed textures are stored next to their BMP as a standard DXT1/DXT5 .dds
+// so the encoder only runs once (or offline via --compress-textures).
+static const unsigned int DDS_MAGIC = 0x20534444;      // "DDS "
+static const unsigned int DDS_FOURCC_DXT1 = 0x31545844; // "DXT1"
+static const unsigned int DDS_FOURCC_DXT5 = 0x35545844; // "DXT5"
+static const unsigned int DDS_MAX_DIMENSION = 16384;      // Larger sides mean a corrupt header
+
+struct DDSHeader {
+	unsigned int size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+	unsigned int reserved1[11];
+	unsigned int pfSize, pfFlags, pfFourCC, pfRGBBitCount, pfRBitMask, pfGBitMask, pfBBitMask, pfABitMask;
+	unsigned int caps, caps2, caps3, caps4, reserved2;
+};
 
-	// --- Draw Right Front Strap (V-shape) ---
-	glBegin(GL_QUAD_STRIP);
-	for (int i = 0; i <= segments; i++) {
-		float t = (float)i / segments;
-		float current_y = belt_y_start + t * (belt_y_end - belt_y_start);
-		float current_radius = radius_at_y_start + t * (radius_at_y_end - radius_at_y_start);
-		float angle = t * (PI / 2.0f);
+static void getDDSPath(const char* imagepath, char* ddsPath, size_t ddsPathSize)
+{
+	sprintf_s(ddsPath, ddsPathSize, "%s", imagepath);
+	char* extension = strrchr(ddsPath, '.');
+	if (extension && (size_t)(extension - ddsPath) + 4 < ddsPathSize) strcpy_s(extension, 5, ".dds");
+}
 
-		float x = cos(angle) * (current_radius + SURFACE_OFFSET);
-		float z = sin(angle) * (current_radius + SURFACE_OFFSET);
+bool writeDDS(const char* ddsPath, const CompressedTexture& texture)
+{
+	FILE* file;
+	fopen_s(&file, ddsPath, "wb");
+	if (!file) return false;
+
+	DDSHeader header;
+	ZeroMemory(&header, sizeof(header));
+	header.size = 124;
+	header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mip count, linear size
+	header.height = texture.height;
+	header.width = texture.width;
+	header.pitchOrLinearSize = (unsigned int)texture.levels[0].size();
+	header.mipMapCount = (unsigned int)texture.levels.size();
+	header.pfSize = 32;
+	header.pfFlags = 0x4; // DDPF_FOURCC
+	header.pfFourCC = (texture.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? DDS_FOURCC_DXT1 : DDS_FOURCC_DXT5;
+	header.caps = 0x1000 | 0x400000 | 0x8; // texture, mipmap, complex
+
+	fwrite(&DDS_MAGIC, 4, 1, file);
+	fwrite(&header, sizeof(header), 1, file);
+	for (const auto& level : texture.levels) {
+		fwrite(level.data(), 1, level.size(), file);
+	}
+	fclose(file);
+	return true;
+}
 
-		glNormal3f(cos(angle), 0.2f, sin(angle));
-		glVertex3f(x, current_y + belt_width / 2.0f, z);
-		glVertex3f(x, current_y - belt_width / 2.0f, z);
+bool readDDS(const char* ddsPath, CompressedTexture& texture)
+{
+	FILE* file;
+	fopen_s(&file, ddsPath, "rb");
+	if (!file) return false;
+
+	unsigned int magic = 0;
+	DDSHeader header;
+	if (fread(&magic, 4, 1, file) != 1 || magic != DDS_MAGIC ||
+		fread(&header, sizeof(header), 1, file) != 1 || header.size != 124) {
+		fclose(file);
+		return false;
 	}
-	glEnd();
 
-	// --- Draw Left Front Strap (V-shape) ---
-	glBegin(GL_QUAD_STRIP);
-	for (int i = 0; i <= segments; i++) {
-		float t = (float)i / segments;
-		float current_y = belt_y_start + t * (belt_y_end - belt_y_start);
-		float current_radius = radius_at_y_start + t * (radius_at_y_end - radius_at_y_start);
-		float angle = PI - (t * (PI / 2.0f));
+	if (header.pfFourCC == DDS_FOURCC_DXT1) texture.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	else if (header.pfFourCC == DDS_FOURCC_DXT5) texture.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	else { fclose(file); return false; }
+
+	// A corrupt or truncated cache is rejected, and the caller rebuilds it from the BMP
+	unsigned int maxSize = g_maxTextureSize > 0 ? min((unsigned int)g_maxTextureSize, DDS_MAX_DIMENSION) : DDS_MAX_DIMENSION;
+	unsigned int fullChainLength = 1;
+	for (unsigned int size = max(header.width, header.height); size > 1; size /= 2) ++fullChainLength;
+	if (header.width == 0 || header.height == 0 || header.width > maxSize || header.height > maxSize ||
+		header.mipMapCount > fullChainLength) {
+		char buffer[256];
+		sprintf_s(buffer, "Warning: ignoring the corrupt texture cache %s.\n", ddsPath);
+		OutputDebugStringA(buffer);
+		fclose(file);
+		return false;
+	}
 
-		float x = cos(angle) * (current_radius + SURFACE_OFFSET);
-		float z = sin(angle) * (current_radius + SURFACE_OFFSET);
+	texture.width = header.width;
+	texture.height = header.height;
+	texture.levels.clear();
+
+	int levelWidth = texture.width, levelHeight = texture.height;
+	unsigned int levelCount = header.mipMapCount > 0 ? header.mipMapCount : 1;
+	for (unsigned int i = 0; i < levelCount; ++i) {
+		texture.levels.emplace_back(compressedLevelSize(texture.format, levelWidth, levelHeight));
+		if (fread(texture.levels.back().data(), 1, texture.levels.back().size(), file) != texture.levels.back().size()) {
+			fclose(file);
+			return false;
+		}
+		levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+	}
+	fclose(file);
+	return true;
+}
 
-		glNormal3f(cos(angle), 0.2f, sin(angle));
-		glVertex3f(x, current_y + belt_width / 2.0f, z);
-		glVertex3f(x, current_y - belt_width / 2.0f, z);
+// The cache is only trusted if it is at least as new as the BMP it was built from
+static bool isCacheFresh(const char* imagepath, const char* ddsPath)
+{
+	WIN32_FILE_ATTRIBUTE_DATA imageInfo, cacheInfo;
+	if (!GetFileAttributesExA(imagepath, GetFileExInfoStandard, &imageInfo)) return true; // BMP gone, cache is all we have
+	if (!GetFileAttributesExA(ddsPath, GetFileExInfoStandard, &cacheInfo)) return false;
+	return CompareFileTime(&cacheInfo.ftLastWriteTime, &imageInfo.ftLastWriteTime) >= 0;
+}
+
+// Encodes a BMP and writes its .dds cache. Used by both the texture loader
+// thread and the offline --compress-textures mode.
+bool compressTextureFile(const char* imagepath, CompressedTexture& texture)
+{
+	BmpImage image;
+	if (!readBMP(imagepath, image)) return false;
+	if (!compressBMPImage(image, texture)) return false;
+
+	char ddsPath[MAX_PATH];
+	getDDSPath(imagepath, ddsPath, sizeof(ddsPath));
+	if (!writeDDS(ddsPath, texture)) {
+		OutputDebugStringA("Warning: Could not write the compressed texture cache.\n");
 	}
-	glEnd();
+	return true;
+}
 
-	// --- Draw the back half of the belt ---
-	glBegin(GL_QUAD_STRIP);
-	for (int i = 0; i <= segments; i++) {
-		float t = (float)i / segments;
-		// Angle from 180 (PI) to 360 (2*PI)
-		float angle = PI + t * PI;
-		float x = cos(angle) * (radius_at_y_start + SURFACE_OFFSET);
-		float z = sin(angle) * (radius_at_y_start + SURFACE_OFFSET);
+// --- Texture Residency ---
+// Textures are loaded on first use by a background thread (file I/O, mip
+// generation and S3TC encoding) and uploaded on the GL thread once ready.
+// Until then a 1x1 white placeholder is bound, which just shows the material
+// colour. Effect textures are only loaded when an effect needs them and are
+// evicted least-recently-used first when resident memory exceeds the budget.
+enum TextureSlotId {
+	TEX_GOLD, TEX_RED, TEX_SKY, TEX_SHOE, TEX_SILVER, TEX_ORANGE, TEX_MIRROR,
+	TEX_COUNT
+};
 
-		glNormal3f(cos(angle), 0.0f, sin(angle));
-		// The Y position is constant for the back strap
-		glVertex3f(x, belt_y_start + belt_width / 2.0f, z);
-		glVertex3f(x, belt_y_start - belt_width / 2.0f, z);
+enum TextureResidency {
+	TEXTURE_UNLOADED, // Not requested yet, or evicted
+	TEXTURE_LOADING,  // Queued on / being decoded by the loader thread
+	TEXTURE_RESIDENT, // Uploaded and bindable
+	TEXTURE_MISSING   // Failed to load; the placeholder is used for good
+};
+
+// CPU-side result of a background load, ready to upload
+struct TexturePayload {
+	bool loaded = false;
+	bool isCompressed = false;
+	CompressedTexture compressed;
+	MipChain chain;
+};
+
+struct TextureSlot {
+	const char* path;
+	bool isEffect;                 // Only needed once an effect or weapon shows: lazy and evictable
+	TextureResidency state;
+	GLuint textureID;
+	size_t residentBytes;
+	unsigned int lastUsedFrame;
+	TexturePayload payload;        // Written by the loader thread while state == TEXTURE_LOADING
+	bool isStreaming;              // Levels are still being uploaded from payload
+	int streamLevel;               // Level currently uploading, counting down to 0
+	int streamRow;                 // Next row (or row of 4x4 blocks) within streamLevel
+	double streamStartMs;
+};
+
+TextureSlot g_textureSlots[TEX_COUNT] = {
+	{ "Textures/Gold.bmp",      false, TEXTURE_UNLOADED, 0, 0, 0 },
+	{ "Textures/Red.bmp",       false, TEXTURE_UNLOADED, 0, 0, 0 },
+	{ "Textures/Sky.bmp",       false, TEXTURE_UNLOADED, 0, 0, 0 },
+	{ "Textures/Shoe.bmp",      false, TEXTURE_UNLOADED, 0, 0, 0 },
+	{ "Textures/Silver.bmp",    false, TEXTURE_UNLOADED, 0, 0, 0 },
+	{ "Textures/Orange.bmp",    false, TEXTURE_UNLOADED, 0, 0, 0 },
+	{ "Textures/Mirror.bmp",    true,  TEXTURE_UNLOADED, 0, 0, 0 },
+};
+
+struct TextureLoader {
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<int> requests;  // Slots waiting to be decoded
+	std::vector<int> completed; // Slots whose payload is ready for upload
+	bool quit = false;
+};
+
+TextureLoader g_textureLoader;
+GLuint g_placeholderTextureID = 0;
+size_t g_textureBudgetBytes = 12 * 1024 * 1024; // Set from Nuwa.cfg; override with --texture-budget-mb=N
+size_t g_residentTextureBytes = 0;
+size_t g_textureStreamBytesPerFrame = 256 * 1024; // Upload budget per frame, split into chunks
+const size_t TEXTURE_STREAM_CHUNK_BYTES = 64 * 1024;
+GLuint g_streamPBO = 0;
+unsigned int g_frameIndex = 0;
+double g_startupTimeMs = 0.0;
+
+// Discards the largest levels of a chain, for hosts configured with textureMipDrop
+template <typename Texture>
+static void dropTopMipLevels(Texture& texture, int count)
+{
+	count = min(count, (int)texture.levels.size() - 1); // The smallest level always stays
+	if (count <= 0) return;
+	texture.levels.erase(texture.levels.begin(), texture.levels.begin() + count);
+	texture.width = max(1, texture.width >> count);
+	texture.height = max(1, texture.height >> count);
+}
+
+// Runs on the loader thread: everything except the OpenGL calls
+static void prepareTexturePayload(const char* imagepath, TexturePayload& payload)
+{
+	char buffer[256];
+	sprintf_s(buffer, "Reading image %s\n", imagepath);
+	OutputDebugStringA(buffer);
+
+	payload.loaded = false;
+
+	// --- Compressed path: use (or build) the .dds cache when S3TC is available ---
+	if (g_hasS3TC) {
+		char ddsPath[MAX_PATH];
+		getDDSPath(imagepath, ddsPath, sizeof(ddsPath));
+
+		if ((isCacheFresh(imagepath, ddsPath) && readDDS(ddsPath, payload.compressed)) || compressTextureFile(imagepath, payload.compressed)) {
+			dropTopMipLevels(payload.compressed, g_config.textureMipDrop); // The cache on disk keeps every level
+			payload.isCompressed = true;
+			payload.loaded = true;
+			return;
+		}
+		OutputDebugStringA("Warning: Falling back to an uncompressed texture.\n");
 	}
-	glEnd();
 
-	// --- Buckle (only at the front) ---
-	glPushMatrix();
-	float t_mid = 0.5f;
-	float buckle_y = belt_y_start + t_mid * (belt_y_end - belt_y_start);
-	float radius_at_buckle = radius_at_y_start + t_mid * (radius_at_y_end - radius_at_y_start);
-	float buckle_z = radius_at_buckle + SURFACE_OFFSET + 0.02f;
-	glTranslatef(0.0f, buckle_y, buckle_z);
+	BmpImage image;
+	if (!readBMP(imagepath, image)) {
+		return;
+	}
+	generateMipChain(image, g_maxTextureSize, payload.chain);
+	dropTopMipLevels(payload.chain, g_config.textureMipDrop);
+	payload.isCompressed = false;
+	payload.loaded = true;
+}
 
-	glColor3f(0.8f, 0.6f, 0.2f);
-	float buckle_outer_radius = 0.11f;
-	float buckle_inner_radius = 0.08f;
-	float buckle_depth = 0.03f;
+static void textureLoaderThread()
+{
+	std::unique_lock<std::mutex> lock(g_textureLoader.mutex);
+	while (true) {
+		g_textureLoader.wake.wait(lock, [] { return g_textureLoader.quit || !g_textureLoader.requests.empty(); });
+		if (g_textureLoader.quit) return;
 
-	glBegin(GL_QUAD_STRIP);
-	for (int i = 0; i <= 20; i++) {
-		float angle_buckle = (float)i / 20.0f * 2.0f * PI;
-		glNormal3f(cos(angle_buckle), sin(angle_buckle), 0.0f);
-		glVertex3f(buckle_outer_radius * cos(angle_buckle), buckle_outer_radius * sin(angle_buckle), buckle_depth / 2.0f);
-		glVertex3f(buckle_outer_radius * cos(angle_buckle), buckle_outer_radius * sin(angle_buckle), -buckle_depth / 2.0f);
+		int slotIndex = g_textureLoader.requests.front();
+		g_textureLoader.requests.erase(g_textureLoader.requests.begin());
+		lock.unlock();
+
+		prepareTexturePayload(g_textureSlots[slotIndex].path, g_textureSlots[slotIndex].payload);
+
+		lock.lock();
+		g_textureLoader.completed.push_back(slotIndex);
 	}
-	glEnd();
-	glBegin(GL_QUAD_STRIP);
-	for (int i = 0; i <= 20; i++) {
-		float angle_buckle = (float)i / 20.0f * 2.0f * PI;
-		glNormal3f(-cos(angle_buckle), -sin(angle_buckle), 0.0f);
-		glVertex3f(buckle_inner_radius * cos(angle_buckle), buckle_inner_radius * sin(angle_buckle), -buckle_depth / 2.0f);
-		glVertex3f(buckle_inner_radius * cos(angle_buckle), buckle_inner_radius * sin(angle_buckle), buckle_depth / 2.0f);
+}
+
+static void requestTextureLoad(TextureSlotId id)
+{
+	g_textureSlots[id].state = TEXTURE_LOADING;
+	{
+		std::lock_guard<std::mutex> lock(g_textureLoader.mutex);
+		g_textureLoader.requests.push_back(id);
 	}
-	glEnd();
-	glBegin(GL_QUAD_STRIP);
-	glNormal3f(0.0f, 0.0f, 1.0f);
-	for (int i = 0; i <= 20; i++) {
-		float angle_buckle = (float)i / 20.0f * 2.0f * PI;
-		glVertex3f(buckle_outer_radius * cos(angle_buckle), buckle_outer_radius * sin(angle_buckle), buckle_depth / 2.0f);
-		glVertex3f(buckle_inner_radius * cos(angle_buckle), buckle_inner_radius * sin(angle_buckle), buckle_depth / 2.0f);
+	g_textureLoader.wake.notify_one();
+}
+
+// Binds a texture for drawing, loading it on first use
+void bindTexture(TextureSlotId id)
+{
+	TextureSlot& slot = g_textureSlots[id];
+	slot.lastUsedFrame = g_frameIndex;
+	if (slot.state == TEXTURE_UNLOADED) {
+		requestTextureLoad(id);
 	}
-	glEnd();
+	glBindTexture(GL_TEXTURE_2D, slot.state == TEXTURE_RESIDENT ? slot.textureID : g_placeholderTextureID);
+}
 
-	glColor3f(0.9f, 0.9f, 0.9f);
-	glPushMatrix();
-	glTranslatef(0.0f, 0.0f, buckle_depth / 2.0f + 0.005f);
-	glBegin(GL_TRIANGLES);
-	glNormal3f(0.0f, 0.0f, 1.0f);
-	glVertex3f(0.0f, -buckle_inner_radius * 0.7f, 0.0f);
-	glVertex3f(buckle_inner_radius * 0.6f, buckle_inner_radius * 0.5f, 0.0f);
-	glVertex3f(-buckle_inner_radius * 0.6f, buckle_inner_radius * 0.5f, 0.0f);
-	glEnd();
-	glPopMatrix();
+// --- Texture Streaming ---
+// Uploads are spread across frames in fixed-size chunks, smallest mip level
+// first. GL_TEXTURE_BASE_LEVEL points at the largest level that is complete,
+// so the texture is drawable as soon as its 1x1 level lands and sharpens as
+// bigger levels arrive. With PBOs each chunk is copied into an orphaned pixel
+// buffer and the driver does the transfer asynchronously.
+static int getPayloadLevelCount(const TexturePayload& payload)
+{
+	return (int)(payload.isCompressed ? payload.compressed.levels.size() : payload.chain.levels.size());
+}
 
-	glPopMatrix();
+static void getLevelSize(int baseWidth, int baseHeight, int level, int& width, int& height)
+{
+	width = baseWidth >> level;
+	height = baseHeight >> level;
+	if (width < 1) width = 1;
+	if (height < 1) height = 1;
 }
 
-void drawArmorCollar()
+// Creates the texture object with storage for every level, but no pixels yet
+static void beginTextureStream(TextureSlot& slot)
 {
-	glColor3f(0.8f, 0.6f, 0.0f);
-	float lower_collar_profile[][2] = {
-		{0.20f, 0.85f}, {0.38f, 0.88f}, {0.38f, 0.84f}, {0.20f, 0.82f}
-	};
-	int lower_collar_points = sizeof(lower_collar_profile) / sizeof(lower_collar_profile[0]);
-	drawLathedObject(lower_collar_profile, lower_collar_points, 24);
+	const TexturePayload& payload = slot.payload;
+	int levelCount = getPayloadLevelCount(payload);
+	int baseWidth = payload.isCompressed ? payload.compressed.width : payload.chain.width;
+	int baseHeight = payload.isCompressed ? payload.compressed.height : payload.chain.height;
+
+	glGenTextures(1, &slot.textureID);
+	glBindTexture(GL_TEXTURE_2D, slot.textureID);
+
+	slot.residentBytes = 0;
+	for (int level = 0; level < levelCount; ++level) {
+		int width, height;
+		getLevelSize(baseWidth, baseHeight, level, width, height);
+		if (payload.isCompressed) {
+			GLsizei levelBytes = (GLsizei)payload.compressed.levels[level].size();
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, payload.compressed.format, width, height, 0, levelBytes, nullptr);
+			slot.residentBytes += levelBytes;
+		}
+		else {
+			GLenum internalFormat = (payload.chain.bytesPerPixel == 4) ? GL_RGBA : GL_RGB;
+			GLenum pixelFormat = (payload.chain.bytesPerPixel == 4) ? GL_BGRA_EXT : GL_BGR_EXT;
+			glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, pixelFormat, GL_UNSIGNED_BYTE, nullptr);
+			slot.residentBytes += (size_t)width * height * 4; // Drivers store RGB8 as RGBA8
+		}
+	}
 
-	glColor3f(0.9f, 0.7f, 0.1f);
-	float upper_collar_profile[][2] = {
-		{0.18f, 0.88f}, {0.24f, 0.90f}, {0.24f, 0.87f}, {0.18f, 0.86f}
-	};
-	int upper_collar_points = sizeof(upper_collar_profile) / sizeof(upper_collar_profile[0]);
-	drawLathedObject(upper_collar_profile, upper_collar_points, 20);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
 
-	// The old neck part is removed from here
-	// No more: glColor3f(1.0f, 0.84f, 0.0f); float neck_profile[][2] = {{0.17f, 0.88f}, {0.17f, 0.95f}}; drawLathedObject(neck_profile, 2, 16);
+	slot.isStreaming = true;
+	slot.streamLevel = levelCount - 1;
+	slot.streamRow = 0;
+	slot.streamStartMs = getTimeMs();
+	g_residentTextureBytes += slot.residentBytes;
+
+	char buffer[256];
+	sprintf_s(buffer, "Streaming %s: %dx%d %s, %zu KB with mips (total %zu KB)\n", slot.path, baseWidth, baseHeight,
+		!payload.isCompressed ? "RGB8" : payload.compressed.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? "BC1" : "BC3",
+		slot.residentBytes / 1024, g_residentTextureBytes / 1024);
+	OutputDebugStringA(buffer);
 }
 
-void drawBackSashes()
+// Copies a chunk into the streaming PBO and returns the pointer to hand to
+// glTexSubImage2D, which is then an offset into the bound buffer
+static const void* stageStreamChunk(const unsigned char* data, size_t size)
 {
-	const float PI = 3.14159f;
-	GLUquadric* quad = gluNewQuadric();
+	if (!g_hasPBO) return data;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_streamPBO);
+	// Orphan the previous chunk so we never wait for the GPU to finish reading it
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)size, nullptr, GL_STREAM_DRAW);
+	void* mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	if (mapped) {
+		memcpy(mapped, data, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		return nullptr;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return data;
+}
 
-	float base_sash_width = 0.18f;
-	float sash_length = 2.5f;
-	float flare_factor = 1.2f;
-	int   segments = 30;
+// Uploads the next chunk of a streaming texture and returns the bytes sent
+static size_t streamTextureChunk(TextureSlot& slot)
+{
+	const TexturePayload& payload = slot.payload;
+	int level = slot.streamLevel;
+	int baseWidth = payload.isCompressed ? payload.compressed.width : payload.chain.width;
+	int baseHeight = payload.isCompressed ? payload.compressed.height : payload.chain.height;
+	int width, height;
+	getLevelSize(baseWidth, baseHeight, level, width, height);
+
+	glBindTexture(GL_TEXTURE_2D, slot.textureID);
+
+	// Compressed levels are streamed in rows of 4x4 blocks, uncompressed ones in rows of texels
+	size_t rowBytes;
+	int rowCount, rowHeight;
+	const unsigned char* levelData;
+	if (payload.isCompressed) {
+		rowBytes = (size_t)((width + 3) / 4) * blockBytesFor(payload.compressed.format);
+		rowCount = (height + 3) / 4;
+		rowHeight = 4;
+		levelData = payload.compressed.levels[level].data();
+	}
+	else {
+		rowBytes = (size_t)width * payload.chain.bytesPerPixel;
+		rowCount = height;
+		rowHeight = 1;
+		levelData = payload.chain.levels[level].data();
+	}
 
-	float belt_top_back_y = -0.05f;
-	float belt_back_radius = 0.18f;
-	float start_x_offset = base_sash_width / 2.0f;
+	int rows = (int)(TEXTURE_STREAM_CHUNK_BYTES / rowBytes);
+	if (rows < 1) rows = 1;
+	if (rows > rowCount - slot.streamRow) rows = rowCount - slot.streamRow;
 
-	const float TILT_DOWNWARD_X = 25.0f;
-	const float FLARE_SIDEWAYS_Y = 35.0f;
-	const float SURFACE_OFFSET = 0.02f;
-	const float ZBIAS = 0.003f;
+	size_t chunkBytes = rows * rowBytes;
+	int y = slot.streamRow * rowHeight;
+	int chunkHeight = rows * rowHeight;
+	if (chunkHeight > height - y) chunkHeight = height - y;
 
-	auto drawOneSash = [&](bool isLeftSash)
-		{
-			glPushMatrix();
+	const void* pixels = stageStreamChunk(levelData + slot.streamRow * rowBytes, chunkBytes);
+	if (payload.isCompressed) {
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, chunkHeight, payload.compressed.format, (GLsizei)chunkBytes, pixels);
+	}
+	else {
+		GLenum pixelFormat = (payload.chain.bytesPerPixel == 4) ? GL_BGRA_EXT : GL_BGR_EXT;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Rows are tightly packed
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, chunkHeight, pixelFormat, GL_UNSIGNED_BYTE, pixels);
+	}
+	if (g_hasPBO) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	slot.streamRow += rows;
+	if (slot.streamRow == rowCount) {
+		// This level is complete: let sampling use it, then move on to the next larger one
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+		slot.state = TEXTURE_RESIDENT;
+		slot.streamRow = 0;
+		slot.streamLevel--;
+
+		if (slot.streamLevel < 0) {
+			slot.isStreaming = false;
+			slot.payload = TexturePayload(); // Free the CPU copy
+
+			char buffer[256];
+			sprintf_s(buffer, "Resident %s after %.1f ms of streaming\n", slot.path, getTimeMs() - slot.streamStartMs);
+			OutputDebugStringA(buffer);
+		}
+	}
+	return chunkBytes;
+}
 
-			glTranslatef(isLeftSash ? -start_x_offset : +start_x_offset, belt_top_back_y, -belt_back_radius);
-			glRotatef(isLeftSash ? +FLARE_SIDEWAYS_Y : -FLARE_SIDEWAYS_Y, 0, 1, 0);
-			glRotatef(TILT_DOWNWARD_X, 1, 0, 0);
+static void evictTexture(TextureSlot& slot)
+{
+	glDeleteTextures(1, &slot.textureID);
+	slot.textureID = 0;
+	g_residentTextureBytes -= slot.residentBytes;
+	slot.residentBytes = 0;
+	slot.state = TEXTURE_UNLOADED;
+	slot.isStreaming = false;
+	slot.payload = TexturePayload();
 
-			const float nx = isLeftSash ? 0.45f : -0.45f, ny = 0.5f, nz = -0.75f;
+	char buffer[256];
+	sprintf_s(buffer, "Evicted %s (resident: %zu KB of %zu KB)\n", slot.path, g_residentTextureBytes / 1024, g_textureBudgetBytes / 1024);
+	OutputDebugStringA(buffer);
+}
 
-			// --- NEW: Waving Animation Parameters ---
-			const float wave_amplitude_multiplier = 0.3f; // How WIDE the wave is
-			const float wave_speed = 3.0f;                // How FAST the wave is
-			const float wave_ripples = 5.0f;              // How many BENDS are in the cloth
+// Called once per frame on the GL thread: starts streaming finished loads,
+// uploads up to g_textureStreamBytesPerFrame of pending levels, then evicts
+// least-recently-used effect textures while over budget. Textures bound in the
+// current or previous frame are never evicted, so an over-budget working set
+// is allowed to overshoot rather than thrash.
+void updateTextureResidency()
+{
+	// Kept between frames and swapped with the loader's list, so both keep their storage
+	static std::vector<int> completed;
+	completed.clear();
+	{
+		std::lock_guard<std::mutex> lock(g_textureLoader.mutex);
+		completed.swap(g_textureLoader.completed);
+	}
 
-			// --- Helper lambda to calculate vertex positions with wave ---
-			auto getWavedVertex = [&](float t, float half_w_offset, float z_base, float& outX, float& outY, float& outZ)
-				{
-					// Base positions (same as before)
-					float static_y = -t * sash_length;
-					float static_z = z_base + (-0.5f * t * t);
-					float current_width = base_sash_width + t * flare_factor;
-					float static_x_offset = sin(t * PI) * (isLeftSash ? -0.2f : 0.2f);
-					float static_x = static_x_offset + half_w_offset * current_width;
+	for (int slotIndex : completed) {
+		TextureSlot& slot = g_textureSlots[slotIndex];
+		if (slot.payload.loaded) {
+			beginTextureStream(slot);
+		}
+		else {
+			slot.state = TEXTURE_MISSING;
+			slot.payload = TexturePayload();
+			char buffer[256];
+			sprintf_s(buffer, "Warning: Could not load %s, using the placeholder texture.\n", slot.path);
+			OutputDebugStringA(buffer);
+		}
+	}
 
-					// --- NEW: Calculate the wave offset ---
-					float wave_amplitude = t * wave_amplitude_multiplier; // Amplitude is 0 at top, max at bottom
-					float wave_phase = t * wave_ripples;
-					float wave_offset_x = wave_amplitude * sin(g_braidTime * wave_speed + wave_phase);
-					float wave_offset_z = wave_amplitude * 0.5f * cos(g_braidTime * wave_speed * 0.8f + wave_phase);
+	// Round-robin one chunk per streaming texture so they all sharpen together
+	size_t streamedBytes = 0;
+	bool anyStreaming = true;
+	while (anyStreaming && streamedBytes < g_textureStreamBytesPerFrame) {
+		anyStreaming = false;
+		for (auto& slot : g_textureSlots) {
+			if (!slot.isStreaming || streamedBytes >= g_textureStreamBytesPerFrame) continue;
+			streamedBytes += streamTextureChunk(slot);
+			anyStreaming = true;
+		}
+	}
 
-					outX = static_x + wave_offset_x;
-					outY = static_y;
-					outZ = static_z + wave_offset_z;
-				};
+	while (g_residentTextureBytes > g_textureBudgetBytes) {
+		TextureSlot* victim = nullptr;
+		for (auto& slot : g_textureSlots) {
+			if (!slot.isEffect || slot.state != TEXTURE_RESIDENT || slot.lastUsedFrame + 1 >= g_frameIndex) continue;
+			if (!victim || slot.lastUsedFrame < victim->lastUsedFrame) victim = &slot;
+		}
+		if (!victim) break;
+		evictTexture(*victim);
+	}
+}
 
-			// The rest of the function now uses the helper lambda to get vertex positions
+void initTextureResidency()
+{
+	// 1x1 white placeholder: with GL_MODULATE the surface just shows its material colour
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+	glGenTextures(1, &g_placeholderTextureID);
+	glBindTexture(GL_TEXTURE_2D, g_placeholderTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-			// =============== 1) BASE CLOTH (textured red) ===============
-			glColor3f(1, 1, 1);
-			glEnable(GL_TEXTURE_2D);
-			glBindTexture(GL_TEXTURE_2D, g_redTextureID);
-			glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	if (g_hasPBO) glGenBuffers(1, &g_streamPBO);
 
-			float vx1, vy1, vz1, vx2, vy2, vz2;
-			glBegin(GL_QUAD_STRIP);
-			for (int i = 0; i <= segments; ++i) {
-				float t = (float)i / segments;
-				glNormal3f(nx, ny, nz);
+	g_textureLoader.thread = std::thread(textureLoaderThread);
+
+	// The character's own textures are always on screen, so start them right away
+	for (int i = 0; i < TEX_COUNT; ++i) {
+		if (!g_textureSlots[i].isEffect) requestTextureLoad((TextureSlotId)i);
+	}
+}
+
+void shutdownTextureResidency()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_textureLoader.mutex);
+		g_textureLoader.quit = true;
+	}
+	g_textureLoader.wake.notify_all();
+	if (g_textureLoader.thread.joinable()) g_textureLoader.thread.join();
+
+	if (g_streamPBO) glDeleteBuffers(1, &g_streamPBO);
+	g_streamPBO = 0;
+}
+
+// --- Procedural Effect Textures ---
+// The fire, digital-rain and skill-glyph textures are generated on the CPU
+// into small RGBA textures instead of being loaded from large BMPs. Each one
+// is regenerated (at most PROCEDURAL_TEXTURE_HZ times a second) only on frames
+// where something actually binds it, using g_braidTime as the animation clock.
+// The generators work on four horizontally adjacent texels at a time with SSE2.
+enum ProceduralTextureId { PROC_FIRE, PROC_DIGITAL_RAIN, PROC_SKILL_GLYPH, PROC_COUNT };
+
+struct ProceduralTexture {
+	int size;                          // Square, power of two; tiles in both directions
+	GLuint textureID;
+	float generatedTime;               // Animation time of the last regeneration
+	std::vector<unsigned char> pixels; // RGBA, rows bottom-up like every other texture here
+};
+
+ProceduralTexture g_proceduralTextures[PROC_COUNT] = {
+	{ 128, 0, -1.0f },
+	{ 128, 0, -1.0f },
+	{ 128, 0, -1.0f },
+};
+
+const float PROCEDURAL_TEXTURE_HZ = 30.0f;
+
+// SSE2 has no 32-bit multiply-low, so build it from two 32x32->64 multiplies
+static inline __m128i mulLo32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Integer lattice hash -> [0, 1)
+static inline __m128 hashLattice(__m128i x, __m128i y, __m128i seed)
+{
+	__m128i h = _mm_add_epi32(mulLo32(x, _mm_set1_epi32(0x27d4eb2d)), mulLo32(y, _mm_set1_epi32(0x165667b1)));
+	h = _mm_xor_si128(h, seed);
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+	h = mulLo32(h, _mm_set1_epi32(0x2c1b3c6d));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+	h = mulLo32(h, _mm_set1_epi32(0x297a2d39));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+static inline unsigned int hashScalar(unsigned int x, unsigned int y, unsigned int seed)
+{
+	unsigned int h = (x * 0x27d4eb2du + y * 0x165667b1u) ^ seed;
+	h ^= h >> 15; h *= 0x2c1b3c6du;
+	h ^= h >> 12; h *= 0x297a2d39u;
+	h ^= h >> 15;
+	return h;
+}
+
+static inline __m128 floorPs(__m128 v)
+{
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(v, t), _mm_set1_ps(1.0f)));
+}
+
+static inline __m128 clamp01Ps(__m128 v)
+{
+	return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+// Smoothly interpolated value noise that wraps every `period` lattice cells (a power of two)
+static __m128 valueNoise(__m128 x, __m128 y, int period, int seed)
+{
+	__m128 fx = floorPs(x), fy = floorPs(y);
+	__m128 tx = _mm_sub_ps(x, fx), ty = _mm_sub_ps(y, fy);
+	// Smoothstep weights
+	tx = _mm_mul_ps(_mm_mul_ps(tx, tx), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(tx, tx)));
+	ty = _mm_mul_ps(_mm_mul_ps(ty, ty), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(ty, ty)));
+
+	__m128i mask = _mm_set1_epi32(period - 1), one = _mm_set1_epi32(1), seedV = _mm_set1_epi32(seed);
+	__m128i ix0 = _mm_and_si128(_mm_cvtps_epi32(fx), mask), iy0 = _mm_and_si128(_mm_cvtps_epi32(fy), mask);
+	__m128i ix1 = _mm_and_si128(_mm_add_epi32(ix0, one), mask), iy1 = _mm_and_si128(_mm_add_epi32(iy0, one), mask);
+
+	__m128 v00 = hashLattice(ix0, iy0, seedV), v10 = hashLattice(ix1, iy0, seedV);
+	__m128 v01 = hashLattice(ix0, iy1, seedV), v11 = hashLattice(ix1, iy1, seedV);
+	__m128 bottom = _mm_add_ps(v00, _mm_mul_ps(tx, _mm_sub_ps(v10, v00)));
+	__m128 top = _mm_add_ps(v01, _mm_mul_ps(tx, _mm_sub_ps(v11, v01)));
+	return _mm_add_ps(bottom, _mm_mul_ps(ty, _mm_sub_ps(top, bottom)));
+}
+
+// Packs four RGBA float texels in [0, 1] into 16 bytes
+static inline void storeRGBA4(unsigned char* out, __m128 r, __m128 g, __m128 b, __m128 a)
+{
+	__m128 scale = _mm_set1_ps(255.0f);
+	__m128i ri = _mm_cvtps_epi32(_mm_mul_ps(clamp01Ps(r), scale));
+	__m128i gi = _mm_cvtps_epi32(_mm_mul_ps(clamp01Ps(g), scale));
+	__m128i bi = _mm_cvtps_epi32(_mm_mul_ps(clamp01Ps(b), scale));
+	__m128i ai = _mm_cvtps_epi32(_mm_mul_ps(clamp01Ps(a), scale));
+	__m128i rgba = _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)), _mm_or_si128(_mm_slli_epi32(bi, 16), _mm_slli_epi32(ai, 24)));
+	_mm_storeu_si128((__m128i*)out, rgba);
+}
+
+// Rising turbulent flames: four octaves of value noise scrolled upwards,
+// faded towards the top and mapped through a black-red-yellow-white ramp
+static void generateFireTexture(ProceduralTexture& texture, float time)
+{
+	const int size = texture.size;
+	const float invSize = 1.0f / size;
+	const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	for (int y = 0; y < size; ++y) {
+		float v = (y + 0.5f) * invSize;
+		unsigned char* row = &texture.pixels[(size_t)y * size * 4];
+		for (int x = 0; x < size; x += 4) {
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_set1_ps((float)x), lane), _mm_set1_ps(0.5f)), _mm_set1_ps(invSize));
+			__m128 scrolledV = _mm_set1_ps(v - time * 0.6f);
+
+			// Turbulence: sum of octaves, each twice the frequency and half the amplitude
+			__m128 sum = _mm_setzero_ps();
+			float amplitude = 0.5f;
+			int period = 4;
+			for (int octave = 0; octave < 4; ++octave) {
+				__m128 n = valueNoise(_mm_mul_ps(u, _mm_set1_ps((float)period)), _mm_mul_ps(scrolledV, _mm_set1_ps((float)period)), period, octave * 101);
+				sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+				amplitude *= 0.5f;
+				period *= 2;
+			}
+
+			// Bright at the bottom of the texture, dying out towards the top
+			__m128 heat = _mm_sub_ps(_mm_mul_ps(sum, _mm_set1_ps(1.6f)), _mm_set1_ps(v * 0.9f));
+			heat = clamp01Ps(_mm_mul_ps(heat, _mm_set1_ps(1.5f)));
+			__m128 three = _mm_mul_ps(heat, _mm_set1_ps(3.0f));
+			__m128 r = three;
+			__m128 g = _mm_sub_ps(three, _mm_set1_ps(1.0f));
+			__m128 b = _mm_sub_ps(three, _mm_set1_ps(2.0f));
+			storeRGBA4(row + x * 4, r, g, b, _mm_set1_ps(1.0f));
+		}
+	}
+}
+
+// Falling columns of flickering glyphs: each 8x8 cell shows a random 5x7
+// glyph that changes a few times a second, lit by a trail below its column's head
+static void generateDigitalRainTexture(ProceduralTexture& texture, float time)
+{
+	const int size = texture.size;
+	const int CELL = 8;
+	const int cells = size / CELL;
+	for (int y = 0; y < size; ++y) {
+		int cellY = y / CELL, glyphRow = y % CELL;
+		unsigned char* row = &texture.pixels[(size_t)y * size * 4];
+		for (int x = 0; x < size; x += 4) {
+			int cellX = x / CELL;
+
+			// Per-column speed and phase; the head wraps so the texture tiles vertically
+			unsigned int columnHash = hashScalar(cellX, 0, 0x9e3779b9u);
+			float speed = 0.25f + (columnHash & 0xff) / 255.0f * 0.5f;
+			float head = (columnHash >> 8 & 0xff) / 255.0f - time * speed;
+			head -= floorf(head);
+			float distance = (float)(cells - cellY) / cells - head; // Trail extends upwards from the head
+			distance -= floorf(distance);
+			float trail = 1.0f - distance;
+			trail *= trail;
+			trail *= trail;
+			float headGlow = distance < 1.0f / cells ? 1.0f : 0.0f;
+
+			// 5x7 glyph bitmask inside the cell, with a one-texel border
+			unsigned int glyph = hashScalar(cellX, cellY, (unsigned int)(time * 6.0f + (columnHash >> 16 & 0xff)));
+			// Columns are mirrored around the centre so glyphs look like characters rather than static
+			float lit[4];
+			for (int i = 0; i < 4; ++i) {
+				int glyphX = (x + i) % CELL;
+				bool inside = glyphX >= 1 && glyphX <= 5 && glyphRow >= 1;
+				int mirroredX = (glyphX - 1 < 5 - glyphX) ? glyphX - 1 : 5 - glyphX;
+				lit[i] = inside && (glyph >> ((glyphRow - 1) * 3 + mirroredX) & 1) ? 1.0f : 0.0f;
+			}
+
+			__m128 on = _mm_loadu_ps(lit);
+			__m128 brightness = _mm_mul_ps(on, _mm_set1_ps(trail));
+			__m128 white = _mm_mul_ps(on, _mm_set1_ps(headGlow));
+			// Faint cell grid so blocks read as a screen even between glyphs
+			__m128 grid = _mm_set1_ps((glyphRow == 0 ? 0.15f : 0.0f) + 0.05f * trail);
+			if (x % CELL == 0) grid = _mm_add_ps(grid, _mm_set_ps(0.0f, 0.0f, 0.0f, 0.15f));
+
+			__m128 r = _mm_add_ps(_mm_mul_ps(brightness, _mm_set1_ps(0.2f)), white);
+			__m128 g = _mm_add_ps(_mm_add_ps(brightness, white), grid);
+			__m128 b = _mm_add_ps(_mm_mul_ps(brightness, _mm_set1_ps(0.45f)), white);
+			storeRGBA4(row + x * 4, r, g, b, _mm_max_ps(g, _mm_set1_ps(0.1f)));
+		}
+	}
+}
+
+// A repeating sigil: pulsing ring, diamond and diagonal cross inside each
+// tile, with chevrons scrolling along the skill's direction of travel
+static void generateSkillGlyphTexture(ProceduralTexture& texture, float time)
+{
+	const int size = texture.size;
+	const float invSize = 1.0f / size;
+	const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	float ringRadius = 0.78f + 0.06f * sinf(time * 4.0f);
+	float diamondRadius = 0.55f + 0.05f * sinf(time * 4.0f + 1.5f);
+	for (int y = 0; y < size; ++y) {
+		float py = ((y + 0.5f) * invSize - 0.5f) * 2.0f;
+		__m128 vy = _mm_set1_ps(py);
+		__m128 ay = _mm_set1_ps(fabsf(py));
+		float chevronPhase = (y + 0.5f) * invSize * 2.0f - time * 1.5f;
+		unsigned char* row = &texture.pixels[(size_t)y * size * 4];
+		for (int x = 0; x < size; x += 4) {
+			__m128 px = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_set1_ps((float)x), lane), _mm_set1_ps(0.5f)), _mm_set1_ps(invSize)), _mm_set1_ps(0.5f)), _mm_set1_ps(2.0f));
+			__m128 ax = _mm_and_ps(px, absMask);
+
+			// Thin lines: 1 - |distance| * sharpness
+			__m128 radius = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(vy, vy)));
+			__m128 ring = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_and_ps(_mm_sub_ps(radius, _mm_set1_ps(ringRadius)), absMask), _mm_set1_ps(18.0f)));
+			__m128 manhattan = _mm_add_ps(ax, ay);
+			__m128 diamond = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_and_ps(_mm_sub_ps(manhattan, _mm_set1_ps(diamondRadius)), absMask), _mm_set1_ps(14.0f)));
+			__m128 cross = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_and_ps(_mm_sub_ps(ax, ay), absMask), _mm_set1_ps(12.0f)));
+			cross = _mm_mul_ps(clamp01Ps(cross), _mm_set1_ps(0.6f));
+
+			// Chevrons pointing along +v: phase bends with |x| and repeats twice per tile
+			__m128 chevron = _mm_sub_ps(_mm_set1_ps(chevronPhase), _mm_mul_ps(ax, _mm_set1_ps(0.5f)));
+			chevron = _mm_sub_ps(chevron, floorPs(chevron));
+			chevron = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_and_ps(_mm_sub_ps(chevron, _mm_set1_ps(0.5f)), absMask), _mm_set1_ps(10.0f)));
+			chevron = _mm_mul_ps(clamp01Ps(chevron), _mm_set1_ps(0.35f));
+
+			__m128 intensity = _mm_max_ps(_mm_max_ps(clamp01Ps(ring), clamp01Ps(diamond)), _mm_max_ps(cross, chevron));
+			storeRGBA4(row + x * 4, intensity, intensity, intensity, intensity);
+		}
+	}
+}
+
+// Binds a procedural texture, regenerating it first if it is due
+void bindProceduralTexture(ProceduralTextureId id)
+{
+	ProceduralTexture& texture = g_proceduralTextures[id];
+	if (texture.textureID == 0) {
+		texture.pixels.resize((size_t)texture.size * texture.size * 4);
+		glGenTextures(1, &texture.textureID);
+		glBindTexture(GL_TEXTURE_2D, texture.textureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.size, texture.size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	}
+	else {
+		glBindTexture(GL_TEXTURE_2D, texture.textureID);
+	}
+
+	float time = g_braidTime;
+	if (texture.generatedTime >= 0.0f && time - texture.generatedTime < 1.0f / PROCEDURAL_TEXTURE_HZ) return;
+	texture.generatedTime = time;
+
+	switch (id) {
+	case PROC_FIRE:         generateFireTexture(texture, time); break;
+	case PROC_DIGITAL_RAIN: generateDigitalRainTexture(texture, time); break;
+	case PROC_SKILL_GLYPH:  generateSkillGlyphTexture(texture, time); break;
+	default: break;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture.size, texture.size, GL_RGBA, GL_UNSIGNED_BYTE, texture.pixels.data());
+}
+
+void deleteProceduralTextures()
+{
+	for (auto& texture : g_proceduralTextures) {
+		if (texture.textureID) glDeleteTextures(1, &texture.textureID);
+		texture.textureID = 0;
+	}
+}
+//--------------------------------------------------------------------
+
+// --- Mouse Picking ---
+// A click (press and release without dragging) casts a ray from the cursor
+// into a 4-wide BVH over everything selectable. Leaves are boxes captured
+// while drawing: each character part records its local bounds together with
+// the modelview it was drawn under, and the blocks share the modelview of the
+// block pass. The tree lives in eye space, is refitted every frame and only
+// rebuilt when its leaf set changes or refitting has let it grow loose.
+enum PickPart {
+	PICK_LEFT_HAND,
+	PICK_RIGHT_HAND,
+	PICK_WEAPON,
+	PICK_MIRROR,
+	PICK_HEAD,
+	PICK_HALO,
+	PICK_PART_COUNT
+};
+
+const char* PICK_PART_NAMES[PICK_PART_COUNT] = { "left hand", "right hand", "weapon", "mirror", "head", "halo" };
+const int PICK_BLOCK_MATRIX = PICK_PART_COUNT; // Matrix slot shared by every block
+const int PICK_NO_CHILD = INT_MIN;             // Unused BVH child slot
+const float PICK_EMPTY = FLT_MAX;              // Bounds of a leaf that was not drawn: min = +EMPTY, max = -EMPTY
+
+struct PickMatrix {
+	float modelview[16];
+	float inverse[16]; // Takes eye-space rays back into the space the leaf was drawn in
+};
+
+struct PickLeaf {
+	float localMin[3], localMax[3]; // Bounds in the space the leaf was drawn in
+	float eyeMin[3], eyeMax[3];     // Axis-aligned eye-space box around them
+	int matrix = -1;                // Slot in g_pickMatrices, -1 if not drawn this frame
+	bool inTree = false;            // Included in the last BVH build
+};
+
+// Four children's boxes side by side so one SSE slab test covers them all
+struct alignas(16) PickNode {
+	float minX[4], minY[4], minZ[4];
+	float maxX[4], maxY[4], maxZ[4];
+	int child[4]; // >= 0: inner node, PICK_NO_CHILD: unused, otherwise ~leaf index
+};
+
+struct PickBVH {
+	std::vector<PickNode> nodes; // Pre-order, so every child comes after its parent
+	std::vector<PickLeaf> leaves; // Parts first, then one per entry of g_matrixBlocks
+	std::vector<int> buildLeaves; // Scratch for the build
+	float builtArea = 0.0f;       // Summed node surface area right after the last build
+	int inTreeCount = 0;
+};
+
+PickMatrix g_pickMatrices[PICK_PART_COUNT + 1];
+PickBVH g_pickBVH;
+int g_selectedPickLeaf = -1;
+
+// Camera state of the last frame, for turning a click into an eye-space ray
+GLdouble g_pickProjection[16];
+GLint g_pickViewport[4];
+
+static void invertAffineMatrix(const float m[16], float out[16])
+{
+	// Column-major like OpenGL: the upper 3x3 is m[0..2], m[4..6], m[8..10]
+	float c00 = m[5] * m[10] - m[9] * m[6];
+	float c01 = m[8] * m[6] - m[4] * m[10];
+	float c02 = m[4] * m[9] - m[8] * m[5];
+	float det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+	float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+
+	out[0] = c00 * invDet;
+	out[4] = c01 * invDet;
+	out[8] = c02 * invDet;
+	out[1] = (m[9] * m[2] - m[1] * m[10]) * invDet;
+	out[5] = (m[0] * m[10] - m[8] * m[2]) * invDet;
+	out[9] = (m[8] * m[1] - m[0] * m[9]) * invDet;
+	out[2] = (m[1] * m[6] - m[5] * m[2]) * invDet;
+	out[6] = (m[4] * m[2] - m[0] * m[6]) * invDet;
+	out[10] = (m[0] * m[5] - m[4] * m[1]) * invDet;
+	for (int i = 0; i < 3; ++i) {
+		out[12 + i] = -(out[i] * m[12] + out[4 + i] * m[13] + out[8 + i] * m[14]);
+		out[3 + i * 4] = 0.0f;
+	}
+	out[15] = 1.0f;
+}
+
+// Sets a leaf's local bounds and derives its eye-space box from the centre
+// and the absolute value of the matrix applied to the half extents
+static void setPickLeaf(int leafIndex, int matrix, float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+{
+	PickLeaf& leaf = g_pickBVH.leaves[leafIndex];
+	const float* m = g_pickMatrices[matrix].modelview;
+	leaf.matrix = matrix;
+	leaf.localMin[0] = minX; leaf.localMin[1] = minY; leaf.localMin[2] = minZ;
+	leaf.localMax[0] = maxX; leaf.localMax[1] = maxY; leaf.localMax[2] = maxZ;
+
+	float cx = (minX + maxX) * 0.5f, cy = (minY + maxY) * 0.5f, cz = (minZ + maxZ) * 0.5f;
+	float ex = (maxX - minX) * 0.5f, ey = (maxY - minY) * 0.5f, ez = (maxZ - minZ) * 0.5f;
+	for (int i = 0; i < 3; ++i) {
+		float centre = m[i] * cx + m[4 + i] * cy + m[8 + i] * cz + m[12 + i];
+		float extent = fabsf(m[i]) * ex + fabsf(m[4 + i]) * ey + fabsf(m[8 + i]) * ez;
+		leaf.eyeMin[i] = centre - extent;
+		leaf.eyeMax[i] = centre + extent;
+	}
+}
+
+static void clearPickLeaf(PickLeaf& leaf)
+{
+	leaf.matrix = -1;
+	for (int i = 0; i < 3; ++i) {
+		leaf.eyeMin[i] = PICK_EMPTY;
+		leaf.eyeMax[i] = -PICK_EMPTY;
+	}
+}
+
+// Called before drawing: every leaf starts the frame empty until captured
+void beginPickCapture()
+{
+	std::vector<PickLeaf>& leaves = g_pickBVH.leaves;
+	leaves.resize(PICK_PART_COUNT + g_matrixBlocks.size());
+	for (PickLeaf& leaf : leaves) {
+		clearPickLeaf(leaf);
+	}
+}
+
+// Records a character part's local box under the current modelview
+void capturePickPart(PickPart part, float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+{
+	PickMatrix& m = g_pickMatrices[part];
+	glGetFloatv(GL_MODELVIEW_MATRIX, m.modelview);
+	invertAffineMatrix(m.modelview, m.inverse);
+	setPickLeaf(part, part, minX, minY, minZ, maxX, maxY, maxZ);
+}
+
+// Records every active block; they are all drawn under the same modelview
+void capturePickBlocks()
+{
+	PickMatrix& m = g_pickMatrices[PICK_BLOCK_MATRIX];
+	glGetFloatv(GL_MODELVIEW_MATRIX, m.modelview);
+	invertAffineMatrix(m.modelview, m.inverse);
+	for (int i = 0; i < (int)g_matrixBlocks.size(); ++i) {
+		const MatrixBlock& block = g_matrixBlocks[i];
+		if (!block.isActive) continue;
+		float halfX = block.scaleX * 0.5f, halfY = block.scaleY * 0.5f, halfZ = block.scaleZ * 0.5f;
+		setPickLeaf(PICK_PART_COUNT + i, PICK_BLOCK_MATRIX, block.posX - halfX, block.posY - halfY, block.posZ - halfZ,
+			block.posX + halfX, block.posY + halfY, block.posZ + halfZ);
+	}
+}
+
+// Twice the eye-space centre; only ever compared against other centres
+static float pickLeafCentre(int leafIndex, int axis)
+{
+	const PickLeaf& leaf = g_pickBVH.leaves[leafIndex];
+	return leaf.eyeMin[axis] + leaf.eyeMax[axis];
+}
+
+// Splits leaves[0..count) into up to four groups along the widest axis of
+// their centres; groups of one become leaf children, larger ones subtrees
+static int buildPickNode(int* leaves, int count)
+{
+	std::vector<PickNode>& nodes = g_pickBVH.nodes;
+	int nodeIndex = (int)nodes.size();
+	nodes.emplace_back();
+	for (int slot = 0; slot < 4; ++slot) {
+		nodes[nodeIndex].child[slot] = PICK_NO_CHILD;
+	}
+
+	int groupStart[5];
+	int groupCount = count < 4 ? count : 4;
+	for (int g = 0; g <= groupCount; ++g) {
+		groupStart[g] = count * g / groupCount;
+	}
+	if (count > 4) {
+		float lo[3] = { PICK_EMPTY, PICK_EMPTY, PICK_EMPTY }, hi[3] = { -PICK_EMPTY, -PICK_EMPTY, -PICK_EMPTY };
+		for (int i = 0; i < count; ++i) {
+			for (int axis = 0; axis < 3; ++axis) {
+				float c = pickLeafCentre(leaves[i], axis);
+				if (c < lo[axis]) lo[axis] = c;
+				if (c > hi[axis]) hi[axis] = c;
+			}
+		}
+		int axis = 0;
+		if (hi[1] - lo[1] > hi[axis] - lo[axis]) axis = 1;
+		if (hi[2] - lo[2] > hi[axis] - lo[axis]) axis = 2;
+		auto byCentre = [axis](int a, int b) { return pickLeafCentre(a, axis) < pickLeafCentre(b, axis); };
+		std::nth_element(leaves, leaves + groupStart[2], leaves + count, byCentre);
+		std::nth_element(leaves, leaves + groupStart[1], leaves + groupStart[2], byCentre);
+		std::nth_element(leaves + groupStart[2], leaves + groupStart[3], leaves + count, byCentre);
+	}
+
+	for (int g = 0; g < groupCount; ++g) {
+		int groupSize = groupStart[g + 1] - groupStart[g];
+		// Index rather than reference: the recursion may grow the node array
+		int child = groupSize == 1 ? ~leaves[groupStart[g]] : buildPickNode(leaves + groupStart[g], groupSize);
+		nodes[nodeIndex].child[g] = child;
+	}
+	return nodeIndex;
+}
+
+// Pulls leaf boxes up through the tree, children before parents. Returns the
+// summed surface area of every child box as a measure of how tight it is.
+static float refitPickBVH()
+{
+	PickBVH& bvh = g_pickBVH;
+	float totalArea = 0.0f;
+	for (int n = (int)bvh.nodes.size() - 1; n >= 0; --n) {
+		PickNode& node = bvh.nodes[n];
+		for (int slot = 0; slot < 4; ++slot) {
+			int child = node.child[slot];
+			float lo[3] = { PICK_EMPTY, PICK_EMPTY, PICK_EMPTY }, hi[3] = { -PICK_EMPTY, -PICK_EMPTY, -PICK_EMPTY };
+			if (child >= 0) {
+				const PickNode& c = bvh.nodes[child];
+				for (int k = 0; k < 4; ++k) {
+					if (c.minX[k] < lo[0]) lo[0] = c.minX[k];
+					if (c.minY[k] < lo[1]) lo[1] = c.minY[k];
+					if (c.minZ[k] < lo[2]) lo[2] = c.minZ[k];
+					if (c.maxX[k] > hi[0]) hi[0] = c.maxX[k];
+					if (c.maxY[k] > hi[1]) hi[1] = c.maxY[k];
+					if (c.maxZ[k] > hi[2]) hi[2] = c.maxZ[k];
+				}
+			}
+			else if (child != PICK_NO_CHILD) {
+				const PickLeaf& leaf = bvh.leaves[~child];
+				for (int axis = 0; axis < 3; ++axis) {
+					lo[axis] = leaf.eyeMin[axis];
+					hi[axis] = leaf.eyeMax[axis];
+				}
+			}
+			node.minX[slot] = lo[0]; node.minY[slot] = lo[1]; node.minZ[slot] = lo[2];
+			node.maxX[slot] = hi[0]; node.maxY[slot] = hi[1]; node.maxZ[slot] = hi[2];
+			if (lo[0] <= hi[0]) {
+				float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+				totalArea += dx * dy + dy * dz + dz * dx;
+			}
+		}
+	}
+	return totalArea;
+}
+
+static void buildPickBVH()
+{
+	PickBVH& bvh = g_pickBVH;
+	bvh.nodes.clear();
+	bvh.buildLeaves.clear();
+	for (int i = 0; i < (int)bvh.leaves.size(); ++i) {
+		PickLeaf& leaf = bvh.leaves[i];
+		leaf.inTree = leaf.matrix >= 0;
+		if (leaf.inTree) bvh.buildLeaves.push_back(i);
+	}
+	bvh.inTreeCount = (int)bvh.buildLeaves.size();
+	if (bvh.inTreeCount > 0) {
+		buildPickNode(bvh.buildLeaves.data(), bvh.inTreeCount);
+	}
+	bvh.builtArea = refitPickBVH();
+}
+
+// Called after drawing, once every leaf has been captured for this frame
+void updatePickBVH()
+{
+	PickBVH& bvh = g_pickBVH;
+	// Rebuild when something drawn is missing from the tree, or when most of
+	// what is in it (expired blocks, hidden weapons) is no longer drawn
+	int missing = 0, stale = 0;
+	for (const PickLeaf& leaf : bvh.leaves) {
+		if (leaf.matrix >= 0 && !leaf.inTree) ++missing;
+		if (leaf.matrix < 0 && leaf.inTree) ++stale;
+	}
+	if (missing > 0 || stale * 2 > bvh.inTreeCount) {
+		buildPickBVH();
+		return;
+	}
+	// Refitting keeps the topology; once the boxes have ballooned, start over
+	if (refitPickBVH() > bvh.builtArea * 2.0f) {
+		buildPickBVH();
+	}
+}
+
+// Exact test of an eye-space ray against a leaf's box in the space it was drawn in
+static bool pickLeafHit(const PickLeaf& leaf, const float origin[3], const float dir[3], float& t)
+{
+	const float* inv = g_pickMatrices[leaf.matrix].inverse;
+	float tNear = 0.0f, tFar = t;
+	for (int axis = 0; axis < 3; ++axis) {
+		float o = inv[axis] * origin[0] + inv[4 + axis] * origin[1] + inv[8 + axis] * origin[2] + inv[12 + axis];
+		float d = inv[axis] * dir[0] + inv[4 + axis] * dir[1] + inv[8 + axis] * dir[2];
+		if (fabsf(d) < 1e-12f) {
+			if (o < leaf.localMin[axis] || o > leaf.localMax[axis]) return false;
+			continue;
+		}
+		float t0 = (leaf.localMin[axis] - o) / d;
+		float t1 = (leaf.localMax[axis] - o) / d;
+		if (t0 > t1) { float swap = t0; t0 = t1; t1 = swap; }
+		if (t0 > tNear) tNear = t0;
+		if (t1 < tFar) tFar = t1;
+		if (tNear > tFar) return false;
+	}
+	t = tNear;
+	return true;
+}
+
+// Returns the closest leaf hit by origin + t * dir for t in [0, maxT], or -1
+int pickRayCast(const float origin[3], const float dir[3], float maxT)
+{
+	const PickBVH& bvh = g_pickBVH;
+	if (bvh.nodes.empty()) return -1;
+
+	// Each axis tests against the near plane first, chosen once by the ray's
+	// sign. Empty boxes (min > max) then give near > far and always miss.
+	bool negX = dir[0] < 0.0f, negY = dir[1] < 0.0f, negZ = dir[2] < 0.0f;
+	const __m128 originX = _mm_set1_ps(origin[0]), originY = _mm_set1_ps(origin[1]), originZ = _mm_set1_ps(origin[2]);
+	const __m128 invX = _mm_set1_ps(1.0f / dir[0]), invY = _mm_set1_ps(1.0f / dir[1]), invZ = _mm_set1_ps(1.0f / dir[2]);
+
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	float bestT = maxT;
+	int bestLeaf = -1;
+	while (stackSize > 0) {
+		const PickNode& node = bvh.nodes[stack[--stackSize]];
+		__m128 nearX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negX ? node.maxX : node.minX), originX), invX);
+		__m128 nearY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negY ? node.maxY : node.minY), originY), invY);
+		__m128 nearZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negZ ? node.maxZ : node.minZ), originZ), invZ);
+		__m128 farX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negX ? node.minX : node.maxX), originX), invX);
+		__m128 farY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negY ? node.minY : node.maxY), originY), invY);
+		__m128 farZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(negZ ? node.minZ : node.maxZ), originZ), invZ);
+		__m128 tNear = _mm_max_ps(_mm_max_ps(nearX, nearY), _mm_max_ps(nearZ, _mm_setzero_ps()));
+		__m128 tFar = _mm_min_ps(_mm_min_ps(farX, farY), _mm_min_ps(farZ, _mm_set1_ps(bestT)));
+		int hitMask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+
+		while (hitMask) {
+			unsigned long slot;
+			_BitScanForward(&slot, (unsigned long)hitMask);
+			hitMask &= hitMask - 1;
+			int child = node.child[slot];
+			if (child >= 0) {
+				if (stackSize < 64) stack[stackSize++] = child;
+			}
+			else if (child != PICK_NO_CHILD) {
+				float t = bestT;
+				if (pickLeafHit(bvh.leaves[~child], origin, dir, t) && t < bestT) {
+					bestT = t;
+					bestLeaf = ~child;
+				}
+			}
+		}
+	}
+	return bestLeaf;
+}
+
+// Selects whatever is under the cursor, or clears the selection on a miss
+void pickAtCursor(int mouseX, int mouseY)
+{
+	double start = getTimeMs();
+
+	// Unprojecting with an identity modelview gives the ray in eye space
+	const GLdouble identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	GLdouble winY = (GLdouble)(g_pickViewport[3] - mouseY);
+	GLdouble nearPoint[3], farPoint[3];
+	if (!gluUnProject(mouseX, winY, 0.0, identity, g_pickProjection, g_pickViewport, &nearPoint[0], &nearPoint[1], &nearPoint[2]) ||
+		!gluUnProject(mouseX, winY, 1.0, identity, g_pickProjection, g_pickViewport, &farPoint[0], &farPoint[1], &farPoint[2])) {
+		return;
+	}
+	float origin[3] = { (float)nearPoint[0], (float)nearPoint[1], (float)nearPoint[2] };
+	float dir[3] = { (float)(farPoint[0] - nearPoint[0]), (float)(farPoint[1] - nearPoint[1]), (float)(farPoint[2] - nearPoint[2]) };
+	g_selectedPickLeaf = pickRayCast(origin, dir, 1.0f);
+
+	char buffer[128];
+	if (g_selectedPickLeaf < 0) {
+		sprintf_s(buffer, "Picked nothing (%.1f us)\n", (getTimeMs() - start) * 1000.0);
+	}
+	else if (g_selectedPickLeaf < PICK_PART_COUNT) {
+		sprintf_s(buffer, "Picked %s (%.1f us)\n", PICK_PART_NAMES[g_selectedPickLeaf], (getTimeMs() - start) * 1000.0);
+	}
+	else {
+		sprintf_s(buffer, "Picked matrix block %d (%.1f us)\n", g_selectedPickLeaf - PICK_PART_COUNT, (getTimeMs() - start) * 1000.0);
+	}
+	OutputDebugStringA(buffer);
+}
+
+// Wire box around the selection, in the space it was drawn in this frame
+void drawPickSelection()
+{
+	if (g_selectedPickLeaf < 0 || g_selectedPickLeaf >= (int)g_pickBVH.leaves.size()) return;
+	const PickLeaf& leaf = g_pickBVH.leaves[g_selectedPickLeaf];
+	if (leaf.matrix < 0) return; // Not drawn this frame: hidden, or an expired block
+
+	const float* lo = leaf.localMin;
+	const float* hi = leaf.localMax;
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LINE_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_DEPTH_TEST);
+	glPushMatrix();
+	glLoadMatrixf(g_pickMatrices[leaf.matrix].modelview);
+	glLineWidth(2.0f);
+	glColor3f(1.0f, 1.0f, 0.2f);
+	glBegin(GL_LINES);
+	for (int axis = 0; axis < 3; ++axis) {
+		// The four edges parallel to this axis
+		int u = (axis + 1) % 3, v = (axis + 2) % 3;
+		for (int corner = 0; corner < 4; ++corner) {
+			float p[3];
+			p[u] = (corner & 1) ? hi[u] : lo[u];
+			p[v] = (corner & 2) ? hi[v] : lo[v];
+			p[axis] = lo[axis];
+			glVertex3fv(p);
+			p[axis] = hi[axis];
+			glVertex3fv(p);
+		}
+	}
+	glEnd();
+	glPopMatrix();
+	glPopAttrib();
+}
+
+// --- Animation LOD ---
+// How much secondary motion is worth paying for depends on how big the
+// character is on screen. Each frame measures the projected size of one world
+// unit at the character; small characters refresh the braid, sashes and halo
+// every few frames from cached samples, and snap the finger layers to their
+// nearest pose. The secondary motions update on different frames so the cost
+// of a refresh never lands on one frame.
+enum SecondaryMotion {
+	MOTION_BRAID,
+	MOTION_SASHES,
+	MOTION_HALO,
+	MOTION_COUNT
+};
+
+struct AnimLODLevel {
+	float minPixelsPerUnit; // Chosen when a world unit at the character projects to at least this many pixels
+	int interval;           // Secondary motion refreshes every this many frames
+	bool snapHands;         // Finger and thumb layers snap to fully on or off
+};
+
+// Finger segments are about 0.05 units long, so they fall below 2 px at 40 px/unit
+const AnimLODLevel ANIM_LOD_LEVELS[] = {
+	{ 60.0f, 1, false },
+	{ 40.0f, 2, false },
+	{ 25.0f, 3, true },
+	{ 0.0f, 4, true },
+};
+const int ANIM_LOD_LEVEL_COUNT = sizeof(ANIM_LOD_LEVELS) / sizeof(ANIM_LOD_LEVELS[0]);
+const int SASH_SEGMENTS = 30;
+const int HALO_RING_SEGMENTS = 60;
+int g_sashSegments = SASH_SEGMENTS;   // Rows drawn; a divisor of SASH_SEGMENTS, lowered by the quality governor
+int g_haloRingStep = 1;               // Ring samples skipped between vertices; a divisor of HALO_RING_SEGMENTS
+const float SASH_WAVE_AMPLITUDE = 0.3f; // How WIDE the wave is at the bottom of the sash
+const float SASH_WAVE_SPEED = 3.0f;     // How FAST the wave is
+const float SASH_WAVE_RIPPLES = 5.0f;   // How many BENDS are in the cloth
+
+struct AnimLOD {
+	int level = 0;
+	float pixelsPerUnit = 0.0f;
+	bool primed[MOTION_COUNT] = {}; // Cache has been filled at least once
+};
+
+AnimLOD g_animLOD;
+std::vector<float> g_braidSway;               // Per segment: sin of the Y sway, half the cos of the X sway
+float g_sashWaveX[SASH_SEGMENTS + 1];         // Wave offset of each sash row
+float g_sashWaveZ[SASH_SEGMENTS + 1];
+float g_haloBrightness[HALO_RING_SEGMENTS + 1];
+float g_rainbowColour[3];
+
+// Reads the size of a world unit at the character's origin off the current
+// modelview and the projection captured for picking; used from the next frame
+void measureAnimationLOD()
+{
+	GLfloat modelview[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	const GLdouble* p = g_pickProjection;
+	double w = p[11] * modelview[14] + p[15]; // Clip w of the origin: -z for perspective, 1 for ortho
+	g_animLOD.pixelsPerUnit = w > 0.0 ? (float)(p[5] * g_pickViewport[3] * 0.5 / w) : 0.0f;
+	int level = 0;
+	while (level < ANIM_LOD_LEVEL_COUNT - 1 && g_animLOD.pixelsPerUnit < ANIM_LOD_LEVELS[level].minPixelsPerUnit) {
+		++level;
+	}
+	if (ANIM_LOD_LEVELS[level].snapHands != ANIM_LOD_LEVELS[g_animLOD.level].snapHands) {
+		activateAnimTask(TASK_POSE);
+	}
+	g_animLOD.level = level;
+}
+
+// Each motion refreshes on its own frame of the interval
+static bool isSecondaryMotionDue(SecondaryMotion motion)
+{
+	int interval = ANIM_LOD_LEVELS[g_animLOD.level].interval;
+	return !g_animLOD.primed[motion] || (g_frameIndex + motion) % interval == 0;
+}
+
+void updateSecondaryMotion()
+{
+	if (isSecondaryMotionDue(MOTION_BRAID)) {
+		g_braidSway.resize(g_numBraidSegments * 2);
+		for (int i = 0; i < g_numBraidSegments; ++i) {
+			g_braidSway[i * 2] = motionSin(g_braidTime * 2.5f + i * 0.5f);
+			g_braidSway[i * 2 + 1] = motionCos(g_braidTime * 3.0f + i * 0.7f) * 0.5f;
+		}
+		g_animLOD.primed[MOTION_BRAID] = true;
+	}
+	if (isSecondaryMotionDue(MOTION_SASHES)) {
+		// The wave's amplitude is 0 at the belt and grows towards the hem
+		for (int i = 0; i <= SASH_SEGMENTS; ++i) {
+			float t = (float)i / SASH_SEGMENTS;
+			float amplitude = t * SASH_WAVE_AMPLITUDE;
+			float phase = t * SASH_WAVE_RIPPLES;
+			g_sashWaveX[i] = amplitude * motionSin(g_braidTime * SASH_WAVE_SPEED + phase);
+			g_sashWaveZ[i] = amplitude * 0.5f * motionCos(g_braidTime * SASH_WAVE_SPEED * 0.8f + phase);
+		}
+		g_animLOD.primed[MOTION_SASHES] = true;
+	}
+	if (isSecondaryMotionDue(MOTION_HALO)) {
+		for (int i = 0; i <= HALO_RING_SEGMENTS; ++i) {
+			float angle = (float)i / HALO_RING_SEGMENTS * 2.0f * 3.14159f;
+			g_haloBrightness[i] = 0.7f + 0.3f * motionSin(angle * 4.0f + g_rainbow_offset);
+		}
+		sampleRainbowColour(g_rainbowColour);
+		g_animLOD.primed[MOTION_HALO] = true;
+	}
+}
+
+// --- Baked Meshes ---
+// The fixed character parts (lathed torso, limbs and staff, the knee diamond,
+// head, lips, palm and the box that fingers, shoulder plates and matrix blocks
+// are built from) are generated once by "--bake-meshes" into NuwaCharacter.mesh
+// as welded, indexed triangle lists with a range and bounds per part. At
+// startup the file is memory-mapped and uploaded into one vertex and one index
+// buffer. The generators emit through meshBegin()/meshVertex()/..., which go
+// straight to immediate mode unless a bake is capturing them, so without the
+// file the parts are simply drawn the old way.
+// Vertices are stored packed (PackedVertex, 16 bytes against 32 as floats) and
+// unpacked by a small vertex shader; without GLSL they are decoded once at load.
+// Every part is baked at each of MESH_LOD_PERCENT, and drawBakedPart() picks
+// the level for the current g_meshDetailPercent, so the quality governor and
+// the offscreen passes thin baked parts as they do directly drawn ones.
+// Re-run --bake-meshes after changing a generator.
+static const char* MESH_FILE_PATH = "NuwaCharacter.mesh";
+static const unsigned int MESH_FILE_MAGIC = 0x4D57554E; // "NUWM"
+static const unsigned int MESH_FILE_VERSION = 4;
+static const unsigned short MESH_RESTART_INDEX = 0xFFFF; // Separates the bands of a strip part
+
+enum BakedPartId {
+	PART_BOX,          // Unit box, scaled into place by drawCuboid/drawBox/box6
+	PART_CHEST,
+	PART_LOWER_BODY,
+	PART_NECK,
+	PART_LOWER_COLLAR,
+	PART_UPPER_COLLAR,
+	PART_UPPER_ARM,
+	PART_LOWER_ARM,
+	PART_STAFF_SHAFT,
+	PART_STAFF_HOLDER,
+	PART_STAFF_POMMEL,
+	PART_EAR,
+	PART_KNEE_DIAMOND, // Also the staff's crystal
+	PART_HEAD,
+	PART_LIPS,
+	PART_PALM,
+	BAKED_PART_COUNT
+};
+
+static const int MESH_LOD_COUNT = 3;
+static const int MESH_LOD_PERCENT[MESH_LOD_COUNT] = { 100, 75, 50 }; // Generator detail of each level
+static const int MESH_RECORD_COUNT = BAKED_PART_COUNT * MESH_LOD_COUNT; // Record of a level: part * MESH_LOD_COUNT + level
+
+static const unsigned int MESH_PART_TEXCOORDS = 1; // Otherwise the current texture coordinate applies, as in immediate mode
+static const unsigned int MESH_PART_STRIP = 2;     // One GL_TRIANGLE_STRIP, bands split by MESH_RESTART_INDEX
+
+struct BakedVertex {
+	float position[3];
+	float normal[3];
+	float texCoord[2];
+};
+
+// Position: int16 across the part's bounds (see getPartQuantization).
+// Normal: octahedral-encoded unit vector in snorm16. TexCoord: half floats.
+struct PackedVertex {
+	short position[3];
+	short padding;
+	short normal[2];
+	unsigned short texCoord[2];
+};
+
+struct MeshFileHeader {
+	unsigned int magic, version;
+	unsigned int partCount, lodCount, vertexCount, indexCount;
+	unsigned int vertexOffset, indexOffset; // Byte offsets from the start of the file
+};
+
+// Indices are absolute (GL 1.1 has no base vertex), so firstVertex/vertexCount
+// just describe the part's slice of the vertex buffer
+struct MeshPartRecord {
+	unsigned int firstIndex, indexCount;
+	unsigned int firstVertex, vertexCount;
+	unsigned int flags;
+	float boundsMin[3], boundsMax[3];
+};
+
+struct BakedMeshes {
+	bool loaded = false;
+	GLuint vertexBuffer = 0, indexBuffer = 0;
+	// Without VBOs the arrays are drawn straight out of the mapped file
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	const void* view = nullptr;
+	const void* vertices = nullptr; // PackedVertex with the program, else BakedVertex; null (an offset of 0) once uploaded
+	const unsigned short* indices = nullptr;
+	MeshPartRecord parts[MESH_RECORD_COUNT];
+	float positionScale[MESH_RECORD_COUNT][3], positionOffset[MESH_RECORD_COUNT][3];
+	std::vector<unsigned short> expandedIndices; // Strip parts turned back into lists when restart is unsupported
+	std::vector<BakedVertex> decodedVertices;    // The packed vertices unpacked on the CPU when there is no program
+	GLuint program = 0;
+	GLint positionScaleLocation = -1, positionOffsetLocation = -1;
+	GLint lightingLocation = -1, enabledLightsLocation = -1, hasTexCoordsLocation = -1;
+};
+BakedMeshes g_bakedMeshes;
+
+// --- Vertex Packing ---
+// p = q * scale + offset, with q in [-32767, 32767] spanning the part's bounds
+static void getPartQuantization(const MeshPartRecord& record, float scale[3], float offset[3])
+{
+	for (int k = 0; k < 3; ++k) {
+		offset[k] = 0.5f * (record.boundsMin[k] + record.boundsMax[k]);
+		scale[k] = 0.5f * (record.boundsMax[k] - record.boundsMin[k]) / 32767.0f;
+	}
+}
+
+static short quantizeSnorm16(float value)
+{
+	return (short)lroundf(max(-1.0f, min(1.0f, value)) * 32767.0f);
+}
+
+// Projects the normal onto the octahedron |x|+|y|+|z| = 1 and folds the lower
+// half over the diagonals, so two components cover the whole sphere
+static void encodeOctahedral(const float normal[3], short out[2])
+{
+	float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	if (length == 0.0f) { out[0] = 0; out[1] = 0; return; } // Decodes to +z
+	float x = normal[0] / length, y = normal[1] / length;
+	if (normal[2] < 0.0f) {
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	out[0] = quantizeSnorm16(x);
+	out[1] = quantizeSnorm16(y);
+}
+
+static void decodeOctahedral(const short in[2], float normal[3])
+{
+	float x = max(in[0] / 32767.0f, -1.0f), y = max(in[1] / 32767.0f, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f) {
+		float unfoldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float unfoldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+	float length = sqrtf(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+// IEEE half precision, rounding to nearest; texture coordinates stay well inside its range
+static unsigned short floatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFF;
+	if (exponent <= 0) {
+		if (exponent < -10) return (unsigned short)sign;
+		mantissa |= 0x800000;
+		unsigned int shift = (unsigned int)(14 - exponent);
+		unsigned int half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1) ++half;
+		return (unsigned short)(sign | half);
+	}
+	if (exponent >= 31) return (unsigned short)(sign | 0x7C00);
+	unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000) ++half; // A carry into the exponent still gives the right value
+	return (unsigned short)half;
+}
+
+static float halfToFloat(unsigned short half)
+{
+	int exponent = (half >> 10) & 0x1F;
+	unsigned int mantissa = half & 0x3FF;
+	float value;
+	if (exponent == 0) value = ldexpf((float)mantissa, -24);
+	else if (exponent == 31) value = mantissa ? NAN : INFINITY;
+	else value = ldexpf((float)(mantissa | 0x400), exponent - 25);
+	return (half & 0x8000) ? -value : value;
+}
+
+static void packVertex(const BakedVertex& vertex, const float scale[3], const float offset[3], PackedVertex& packed)
+{
+	for (int k = 0; k < 3; ++k) {
+		float q = scale[k] > 0.0f ? (vertex.position[k] - offset[k]) / scale[k] : 0.0f;
+		packed.position[k] = (short)lroundf(max(-32767.0f, min(32767.0f, q)));
+	}
+	packed.padding = 0;
+	encodeOctahedral(vertex.normal, packed.normal);
+	packed.texCoord[0] = floatToHalf(vertex.texCoord[0]);
+	packed.texCoord[1] = floatToHalf(vertex.texCoord[1]);
+}
+
+static void unpackVertex(const PackedVertex& packed, const float scale[3], const float offset[3], BakedVertex& vertex)
+{
+	for (int k = 0; k < 3; ++k) vertex.position[k] = packed.position[k] * scale[k] + offset[k];
+	decodeOctahedral(packed.normal, vertex.normal);
+	vertex.texCoord[0] = halfToFloat(packed.texCoord[0]);
+	vertex.texCoord[1] = halfToFloat(packed.texCoord[1]);
+}
+
+// Unpacks PackedVertex and lights it like the fixed-function pipeline. The
+// normal comes out of the encoding at unit length, so GL_NORMALIZE has nothing
+// left to do here; the fragment stage stays fixed-function, so texturing is unchanged.
+enum PackedAttribute { PACKED_POSITION, PACKED_NORMAL, PACKED_TEXCOORD };
+static const char* const PACKED_ATTRIBUTE_NAMES[] = { "packedPosition", "packedNormal", "packedTexCoord" };
+static const char* PACKED_MESH_VERTEX_SHADER =
+	"#version 120\n"
+	"attribute vec3 packedPosition;\n"
+	"attribute vec2 packedNormal;\n"
+	"attribute vec2 packedTexCoord;\n"
+	"uniform vec3 positionScale;\n"
+	"uniform vec3 positionOffset;\n"
+	"uniform float hasTexCoords;\n"
+	GLSL_FIXED_FUNCTION_LIGHTING
+	"vec3 decodeOctahedral(vec2 e) {\n"
+	"	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+	"	if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+	"	return normalize(n);\n"
+	"}\n"
+	"void main() {\n"
+	"	vec4 eye = gl_ModelViewMatrix * vec4(packedPosition * positionScale + positionOffset, 1.0);\n"
+	"	gl_Position = gl_ProjectionMatrix * eye;\n"
+	"	gl_ClipVertex = eye;\n"
+	"	gl_TexCoord[0] = hasTexCoords > 0.5 ? vec4(packedTexCoord, 0.0, 1.0) : gl_MultiTexCoord0;\n"
+	"	vec3 normal = normalize(gl_NormalMatrix * decodeOctahedral(packedNormal));\n"
+	"	gl_FrontColor = litColour(normal, eye.xyz, gl_Color);\n"
+	"}\n";
+
+static GLuint createPackedMeshProgram()
+{
+	GLuint shader = compileShader(GL_VERTEX_SHADER, PACKED_MESH_VERTEX_SHADER);
+	if (!shader) return 0;
+	GLuint program = linkProgram(&shader, 1, PACKED_ATTRIBUTE_NAMES, 3);
+	if (!program) return 0;
+	g_bakedMeshes.positionScaleLocation = glGetUniformLocation(program, "positionScale");
+	g_bakedMeshes.positionOffsetLocation = glGetUniformLocation(program, "positionOffset");
+	g_bakedMeshes.lightingLocation = glGetUniformLocation(program, "lighting");
+	g_bakedMeshes.enabledLightsLocation = glGetUniformLocation(program, "enabledLights");
+	g_bakedMeshes.hasTexCoordsLocation = glGetUniformLocation(program, "hasTexCoords");
+	return program;
+}
+
+// While baking, the generators record here instead of drawing
+struct CapturedStrip {
+	int firstTriangle, triangleCount;
+};
+
+struct MeshCapture {
+	std::vector<BakedVertex> triangles; // Unwelded triangle list of the part being baked
+	std::vector<BakedVertex> primitive; // Vertices since meshBegin()
+	std::vector<CapturedStrip> strips;  // Where each GL_TRIANGLE_STRIP landed in the triangle list
+	GLenum mode = GL_TRIANGLES;
+	BakedVertex current = {};           // Current normal and texcoord, as immediate mode keeps them
+	bool hasTexCoords = false;
+	bool onlyStrips = true;             // Every primitive of the part was a triangle strip
+	int detailPercent = 100;            // Detail of the level being baked
+};
+MeshCapture* g_meshCapture = nullptr;
+
+// Generators drawn directly (no baked mesh file) drop detail with the quality
+// governor; a bake captures them at the detail of the level it is baking
+int g_meshDetailPercent = 100;
+
+static int scaledDetail(int count, int minimum)
+{
+	int percent = g_meshCapture ? g_meshCapture->detailPercent : g_meshDetailPercent;
+	return max(minimum, count * percent / 100);
+}
+
+void meshBegin(GLenum mode)
+{
+	if (!g_meshCapture) { glBegin(mode); return; }
+	g_meshCapture->mode = mode;
+	g_meshCapture->primitive.clear();
+}
+
+void meshNormal(float x, float y, float z)
+{
+	if (!g_meshCapture) { glNormal3f(x, y, z); return; }
+	float* normal = g_meshCapture->current.normal;
+	normal[0] = x; normal[1] = y; normal[2] = z;
+}
+
+void meshTexCoord(float u, float v)
+{
+	if (!g_meshCapture) { glTexCoord2f(u, v); return; }
+	g_meshCapture->current.texCoord[0] = u;
+	g_meshCapture->current.texCoord[1] = v;
+	g_meshCapture->hasTexCoords = true;
+}
+
+void meshVertex(float x, float y, float z)
+{
+	if (!g_meshCapture) { glVertex3f(x, y, z); return; }
+	float* position = g_meshCapture->current.position;
+	position[0] = x; position[1] = y; position[2] = z;
+	g_meshCapture->primitive.push_back(g_meshCapture->current);
+}
+
+void meshNormalv(const float* n) { meshNormal(n[0], n[1], n[2]); }
+void meshTexCoordv(const float* t) { meshTexCoord(t[0], t[1]); }
+void meshVertexv(const float* p) { meshVertex(p[0], p[1], p[2]); }
+
+// Breaks the finished primitive into triangles with the winding GL would give them
+void meshEnd()
+{
+	if (!g_meshCapture) { glEnd(); return; }
+	MeshCapture& capture = *g_meshCapture;
+	const std::vector<BakedVertex>& p = capture.primitive;
+	int count = (int)p.size();
+	auto emit = [&](int a, int b, int c) {
+		capture.triangles.push_back(p[a]);
+		capture.triangles.push_back(p[b]);
+		capture.triangles.push_back(p[c]);
+		};
+
+	if (capture.mode == GL_TRIANGLE_STRIP && count >= 3) {
+		capture.strips.push_back({ (int)capture.triangles.size() / 3, count - 2 });
+	}
+	else if (capture.mode != GL_TRIANGLE_STRIP) {
+		capture.onlyStrips = false;
+	}
+
+	switch (capture.mode) {
+	case GL_TRIANGLES:
+		for (int i = 0; i + 2 < count; i += 3) emit(i, i + 1, i + 2);
+		break;
+	case GL_QUADS:
+		for (int i = 0; i + 3 < count; i += 4) { emit(i, i + 1, i + 2); emit(i, i + 2, i + 3); }
+		break;
+	case GL_TRIANGLE_STRIP:
+		for (int i = 0; i + 2 < count; ++i) {
+			if (i & 1) emit(i + 1, i, i + 2);
+			else emit(i, i + 1, i + 2);
+		}
+		break;
+	case GL_QUAD_STRIP:
+		for (int i = 0; i + 3 < count; i += 2) { emit(i, i + 1, i + 3); emit(i, i + 3, i + 2); }
+		break;
+	case GL_TRIANGLE_FAN:
+	case GL_POLYGON:
+		for (int i = 1; i + 1 < count; ++i) emit(0, i, i + 1);
+		break;
+	}
+	capture.primitive.clear();
+}
+
+void emitBakedPart(BakedPartId part); // Runs the part's generator; defined with the Mesh Baker below
+
+const int STAFF_SPHERE_STACKS = 16;
+
+// The detail a part would be generated at now. The staff spheres also keep to
+// sphere_max_stacks, which drawSphere applies when they are drawn directly.
+static int bakedPartDetailPercent(BakedPartId part)
+{
+	int percent = g_meshDetailPercent;
+	if (part == PART_STAFF_HOLDER || part == PART_STAFF_POMMEL) {
+		percent = min(percent, g_config.sphereMaxStacks * 100 / STAFF_SPHERE_STACKS);
+	}
+	return percent;
+}
+
+void drawBakedPart(BakedPartId part)
+{
+	if (!g_bakedMeshes.loaded || g_meshCapture) {
+		emitBakedPart(part);
+		return;
+	}
+
+	// The coarsest level with at least the detail asked for, else the coarsest there is
+	int percent = bakedPartDetailPercent(part);
+	int lod = MESH_LOD_COUNT - 1;
+	while (lod > 0 && MESH_LOD_PERCENT[lod] < percent) --lod;
+	int recordIndex = part * MESH_LOD_COUNT + lod;
+	const MeshPartRecord& record = g_bakedMeshes.parts[recordIndex];
+	const char* vertices = (const char*)g_bakedMeshes.vertices;
+	const char* indices = (const char*)g_bakedMeshes.indices;
+	if (g_bakedMeshes.vertexBuffer) {
+		glBindBuffer(GL_ARRAY_BUFFER, g_bakedMeshes.vertexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_bakedMeshes.indexBuffer);
+	}
+
+	bool hasTexCoords = (record.flags & MESH_PART_TEXCOORDS) != 0;
+	bool isStrip = (record.flags & MESH_PART_STRIP) != 0;
+	if (g_bakedMeshes.program) {
+		glUseProgram(g_bakedMeshes.program);
+		glUniform3fv(g_bakedMeshes.positionScaleLocation, 1, g_bakedMeshes.positionScale[recordIndex]);
+		glUniform3fv(g_bakedMeshes.positionOffsetLocation, 1, g_bakedMeshes.positionOffset[recordIndex]);
+		setFixedFunctionLightingUniforms(g_bakedMeshes.lightingLocation, g_bakedMeshes.enabledLightsLocation);
+		glUniform1f(g_bakedMeshes.hasTexCoordsLocation, hasTexCoords ? 1.0f : 0.0f);
+		glEnableVertexAttribArray(PACKED_POSITION);
+		glEnableVertexAttribArray(PACKED_NORMAL);
+		glVertexAttribPointer(PACKED_POSITION, 3, GL_SHORT, GL_FALSE, sizeof(PackedVertex), vertices + offsetof(PackedVertex, position));
+		glVertexAttribPointer(PACKED_NORMAL, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), vertices + offsetof(PackedVertex, normal));
+		if (hasTexCoords) {
+			glEnableVertexAttribArray(PACKED_TEXCOORD);
+			glVertexAttribPointer(PACKED_TEXCOORD, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), vertices + offsetof(PackedVertex, texCoord));
+		}
+	}
+	else {
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(BakedVertex), vertices + offsetof(BakedVertex, position));
+		glNormalPointer(GL_FLOAT, sizeof(BakedVertex), vertices + offsetof(BakedVertex, normal));
+		if (hasTexCoords) {
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glTexCoordPointer(2, GL_FLOAT, sizeof(BakedVertex), vertices + offsetof(BakedVertex, texCoord));
+		}
+	}
+
+	if (isStrip) {
+		if (g_primitiveRestartCap == GL_PRIMITIVE_RESTART) glEnable(GL_PRIMITIVE_RESTART);
+		else glEnableClientState(GL_PRIMITIVE_RESTART_NV);
+	}
+	glDrawElements(isStrip ? GL_TRIANGLE_STRIP : GL_TRIANGLES, record.indexCount, GL_UNSIGNED_SHORT, indices + record.firstIndex * sizeof(unsigned short));
+	if (isStrip) {
+		if (g_primitiveRestartCap == GL_PRIMITIVE_RESTART) glDisable(GL_PRIMITIVE_RESTART);
+		else glDisableClientState(GL_PRIMITIVE_RESTART_NV);
+	}
+
+	if (g_bakedMeshes.program) {
+		if (hasTexCoords) glDisableVertexAttribArray(PACKED_TEXCOORD);
+		glDisableVertexAttribArray(PACKED_NORMAL);
+		glDisableVertexAttribArray(PACKED_POSITION);
+		glUseProgram(0);
+	}
+	else {
+		if (hasTexCoords) glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+	}
+	// Particles and projectiles pass client pointers, which only works with no buffer bound
+	if (g_bakedMeshes.vertexBuffer) {
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+}
+
+// The box generators all make the same hard-edged box, so once baked they share
+// the unit PART_BOX. The shader (or GL_NORMALIZE) fixes up the normals after the scale.
+static bool drawBakedBox(float width, float height, float depth)
+{
+	if (!g_bakedMeshes.loaded || g_meshCapture) return false;
+	glPushMatrix();
+	glScalef(width, height, depth);
+	drawBakedPart(PART_BOX);
+	glPopMatrix();
+	return true;
+}
+
+static bool isMeshFileValid(const unsigned char* data, unsigned long long size)
+{
+	const MeshFileHeader* header = (const MeshFileHeader*)data;
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION || header->partCount != BAKED_PART_COUNT ||
+		header->lodCount != MESH_LOD_COUNT) return false;
+	if (header->vertexOffset < sizeof(MeshFileHeader) + sizeof(MeshPartRecord) * MESH_RECORD_COUNT) return false;
+	if ((unsigned long long)header->vertexOffset + (unsigned long long)header->vertexCount * sizeof(PackedVertex) > header->indexOffset) return false;
+	if ((unsigned long long)header->indexOffset + (unsigned long long)header->indexCount * sizeof(unsigned short) > size) return false;
+
+	// A corrupt range or index would otherwise be read by the driver
+	const MeshPartRecord* parts = (const MeshPartRecord*)(data + sizeof(MeshFileHeader));
+	const unsigned short* indices = (const unsigned short*)(data + header->indexOffset);
+	for (int i = 0; i < MESH_RECORD_COUNT; ++i) {
+		if ((unsigned long long)parts[i].firstIndex + parts[i].indexCount > header->indexCount) return false;
+		if ((unsigned long long)parts[i].firstVertex + parts[i].vertexCount > header->vertexCount) return false;
+		bool isStrip = (parts[i].flags & MESH_PART_STRIP) != 0;
+		for (unsigned int j = parts[i].firstIndex; j < parts[i].firstIndex + parts[i].indexCount; ++j) {
+			if (indices[j] >= header->vertexCount && !(isStrip && indices[j] == MESH_RESTART_INDEX)) return false;
+		}
+	}
+	return true;
+}
+
+// Without primitive restart the strip parts are drawn as the triangle lists
+// they stand for, so the index buffer is rebuilt at load
+static void expandStripParts(const unsigned short* indices)
+{
+	std::vector<unsigned short>& expanded = g_bakedMeshes.expandedIndices;
+	expanded.clear();
+	for (MeshPartRecord& record : g_bakedMeshes.parts) {
+		const unsigned short* strip = indices + record.firstIndex;
+		unsigned int first = (unsigned int)expanded.size();
+		if (!(record.flags & MESH_PART_STRIP)) {
+			expanded.insert(expanded.end(), strip, strip + record.indexCount);
+		}
+		else {
+			int run = 0;
+			for (unsigned int i = 0; i < record.indexCount; ++i) {
+				if (strip[i] == MESH_RESTART_INDEX) { run = 0; continue; }
+				if (++run < 3) continue;
+				// Every other strip triangle is flipped to keep the winding
+				bool isOdd = (run & 1) == 0;
+				expanded.push_back(strip[isOdd ? i - 1 : i - 2]);
+				expanded.push_back(strip[isOdd ? i - 2 : i - 1]);
+				expanded.push_back(strip[i]);
+			}
+		}
+		record.firstIndex = first;
+		record.indexCount = (unsigned int)expanded.size() - first;
+		record.flags &= ~MESH_PART_STRIP;
+	}
+}
+
+static void closeMeshFile()
+{
+	if (g_bakedMeshes.view) UnmapViewOfFile(g_bakedMeshes.view);
+	if (g_bakedMeshes.mapping) CloseHandle(g_bakedMeshes.mapping);
+	if (g_bakedMeshes.file != INVALID_HANDLE_VALUE) CloseHandle(g_bakedMeshes.file);
+	g_bakedMeshes.view = nullptr;
+	g_bakedMeshes.mapping = nullptr;
+	g_bakedMeshes.file = INVALID_HANDLE_VALUE;
+}
+
+bool loadBakedMeshes(const char* path)
+{
+	g_bakedMeshes.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (g_bakedMeshes.file == INVALID_HANDLE_VALUE) {
+		OutputDebugStringA("No baked meshes, drawing the generators directly (run --bake-meshes).\n");
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(g_bakedMeshes.file, &size) && size.QuadPart >= (LONGLONG)sizeof(MeshFileHeader)) {
+		g_bakedMeshes.mapping = CreateFileMappingA(g_bakedMeshes.file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (g_bakedMeshes.mapping) g_bakedMeshes.view = MapViewOfFile(g_bakedMeshes.mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+	const unsigned char* data = (const unsigned char*)g_bakedMeshes.view;
+	if (!data || !isMeshFileValid(data, (unsigned long long)size.QuadPart)) {
+		OutputDebugStringA("Warning: NuwaCharacter.mesh is unreadable or from another version, re-run --bake-meshes.\n");
+		closeMeshFile();
+		return false;
+	}
+
+	const MeshFileHeader* header = (const MeshFileHeader*)data;
+	unsigned int vertexCount = header->vertexCount;
+	unsigned int indexCount = header->indexCount;
+	memcpy(g_bakedMeshes.parts, data + sizeof(MeshFileHeader), sizeof(g_bakedMeshes.parts));
+	const void* vertices = data + header->vertexOffset;
+	const void* indices = data + header->indexOffset;
+	for (int i = 0; i < MESH_RECORD_COUNT; ++i) {
+		getPartQuantization(g_bakedMeshes.parts[i], g_bakedMeshes.positionScale[i], g_bakedMeshes.positionOffset[i]);
+	}
+	if (g_hasGLSL && g_hasHalfFloatVertex) g_bakedMeshes.program = createPackedMeshProgram();
+	size_t vertexSize = sizeof(PackedVertex);
+	if (!g_bakedMeshes.program) {
+		// No shader to unpack them, so expand to the float layout the client arrays take
+		const PackedVertex* packed = (const PackedVertex*)vertices;
+		g_bakedMeshes.decodedVertices.resize(vertexCount);
+		for (int i = 0; i < MESH_RECORD_COUNT; ++i) {
+			const MeshPartRecord& record = g_bakedMeshes.parts[i];
+			for (unsigned int v = record.firstVertex; v < record.firstVertex + record.vertexCount; ++v) {
+				unpackVertex(packed[v], g_bakedMeshes.positionScale[i], g_bakedMeshes.positionOffset[i], g_bakedMeshes.decodedVertices[v]);
+			}
+		}
+		vertices = g_bakedMeshes.decodedVertices.data();
+		vertexSize = sizeof(BakedVertex);
+	}
+	if (g_primitiveRestartCap) {
+		glPrimitiveRestartIndex(MESH_RESTART_INDEX);
+	}
+	else {
+		expandStripParts((const unsigned short*)indices);
+		indices = g_bakedMeshes.expandedIndices.data();
+		indexCount = (unsigned int)g_bakedMeshes.expandedIndices.size();
+	}
+
+	if (g_hasVBO) {
+		glGenBuffers(1, &g_bakedMeshes.vertexBuffer);
+		glGenBuffers(1, &g_bakedMeshes.indexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, g_bakedMeshes.vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertexCount * vertexSize), vertices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_bakedMeshes.indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCount * sizeof(unsigned short), indices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		closeMeshFile();
+		std::vector<BakedVertex>().swap(g_bakedMeshes.decodedVertices);
+		g_bakedMeshes.vertices = nullptr;
+		g_bakedMeshes.indices = nullptr;
+	}
+	else {
+		g_bakedMeshes.vertices = vertices;
+		g_bakedMeshes.indices = (const unsigned short*)indices;
+	}
+	g_bakedMeshes.loaded = true;
+
+	char buffer[160];
+	sprintf_s(buffer, "Baked meshes: %u vertices (%s), %u indices, %s\n",
+		vertexCount, g_bakedMeshes.program ? "packed, unpacked by the vertex shader" : "decoded to floats at load",
+		indexCount, g_hasVBO ? "uploaded to buffer objects" : "drawn from memory");
+	OutputDebugStringA(buffer);
+	return true;
+}
+
+void unloadBakedMeshes()
+{
+	if (g_bakedMeshes.vertexBuffer) glDeleteBuffers(1, &g_bakedMeshes.vertexBuffer);
+	if (g_bakedMeshes.indexBuffer) glDeleteBuffers(1, &g_bakedMeshes.indexBuffer);
+	g_bakedMeshes.vertexBuffer = 0;
+	g_bakedMeshes.indexBuffer = 0;
+	if (g_bakedMeshes.program) glDeleteProgram(g_bakedMeshes.program);
+	g_bakedMeshes.program = 0;
+	closeMeshFile();
+	g_bakedMeshes.expandedIndices.clear();
+	g_bakedMeshes.decodedVertices.clear();
+	g_bakedMeshes.loaded = false;
+}
+
+// --- Tessellated Lathes ---
+// The chest and skirt are the largest lathed parts, so their quality is the
+// one worth scaling with the view. With GL 4 tessellation only their profile
+// control points are uploaded, one two-point patch per profile segment; the
+// control shader picks how many sides each ring gets from the ring's projected
+// circumference and the evaluation shader revolves and lights the result.
+// Levels are worked out per ring rather than per patch so neighbouring
+// segments agree on the ring they share and no cracks open between them.
+// Without tessellation the baked parts are drawn as before.
+static const float chest_profile[][2] = {
+	{0.18f, 0.85f},
+	{0.35f, 0.70f},
+	{0.38f, 0.55f},
+	{0.30f, 0.40f},
+	{0.25f, 0.25f}
+};
+
+static const float lower_body_profile[][2] = {
+	{0.18f, -0.05f}, // Top of lower waist (below the thin waist segment)
+	{0.20f, -0.1f},  // Start of hips
+	{0.38f, -0.5f},  // Widest part of hips
+	{0.45f, -0.9f},  // Flare outwards for the skirt effect
+	{0.40f, -1.0f},  // Gently curve inwards at the very bottom
+	{0.30f, -1.0f}   // Flat bottom part for the base of the skirt
+};
+
+enum TessellatedLatheId {
+	LATHE_CHEST,
+	LATHE_LOWER_BODY,
+	TESSELLATED_LATHE_COUNT
+};
+
+struct TessellatedLatheProfile {
+	const float (*points)[2];
+	int pointCount;
+};
+
+static const TessellatedLatheProfile TESSELLATED_LATHE_PROFILES[TESSELLATED_LATHE_COUNT] = {
+	{ chest_profile, sizeof(chest_profile) / sizeof(chest_profile[0]) },
+	{ lower_body_profile, sizeof(lower_body_profile) / sizeof(lower_body_profile[0]) },
+};
+
+struct TessellatedLathes {
+	GLuint program = 0;
+	GLuint buffer = 0; // (radius, height, texture v) per patch vertex
+	GLint viewportHalfHeightLocation = -1, maxSidesLocation = -1, lightingLocation = -1, enabledLightsLocation = -1;
+	int firstVertex[TESSELLATED_LATHE_COUNT], vertexCount[TESSELLATED_LATHE_COUNT];
+};
+TessellatedLathes g_tessellatedLathes;
+
+static const char* const LATHE_ATTRIBUTE_NAMES[] = { "controlPoint" };
+static const char* LATHE_VERTEX_SHADER =
+	"#version 400 compatibility\n"
+	"in vec3 controlPoint;\n"
+	"out vec3 vertexControlPoint;\n"
+	"out vec4 vertexColour;\n"
+	"void main() {\n"
+	"	vertexControlPoint = controlPoint;\n"
+	"	vertexColour = gl_Color;\n"
+	"}\n";
+
+// A side every 8 pixels of circumference, from 12 far away to 64 close up
+// (the CPU lathe always uses 20-24); the quality governor lowers the cap
+static const char* LATHE_CONTROL_SHADER =
+	"#version 400 compatibility\n"
+	"layout(vertices = 2) out;\n"
+	"in vec3 vertexControlPoint[];\n"
+	"in vec4 vertexColour[];\n"
+	"out vec3 patchControlPoint[];\n"
+	"out vec4 patchColour[];\n"
+	"uniform float viewportHalfHeight;\n"
+	"uniform float maxSides;\n"
+	"const float PIXELS_PER_SIDE = 8.0;\n"
+	"const float MIN_SIDES = 12.0;\n"
+	"float ringSides(vec3 point) {\n"
+	"	vec4 centre = gl_ModelViewMatrix * vec4(0.0, point.y, 0.0, 1.0);\n"
+	"	float w = max((gl_ProjectionMatrix * centre).w, 0.001);\n"
+	"	float pixelsPerUnit = gl_ProjectionMatrix[1][1] * viewportHalfHeight / w;\n"
+	"	float circumference = 6.2831853 * point.x * length(gl_ModelViewMatrix[0].xyz) * pixelsPerUnit;\n"
+	"	return clamp(circumference / PIXELS_PER_SIDE, MIN_SIDES, max(maxSides, MIN_SIDES));\n"
+	"}\n"
+	"void main() {\n"
+	"	patchControlPoint[gl_InvocationID] = vertexControlPoint[gl_InvocationID];\n"
+	"	patchColour[gl_InvocationID] = vertexColour[gl_InvocationID];\n"
+	"	if (gl_InvocationID == 0) {\n"
+	"		float top = ringSides(vertexControlPoint[0]);\n"
+	"		float bottom = ringSides(vertexControlPoint[1]);\n"
+	"		gl_TessLevelOuter[0] = 1.0;\n"
+	"		gl_TessLevelOuter[1] = top;\n"
+	"		gl_TessLevelOuter[2] = 1.0;\n"
+	"		gl_TessLevelOuter[3] = bottom;\n"
+	"		gl_TessLevelInner[0] = max(top, bottom);\n"
+	"		gl_TessLevelInner[1] = 1.0;\n"
+	"	}\n"
+	"}\n";
+
+// u runs around the axis and v down the segment; "cw" keeps the winding of
+// drawLathedObject's strips, and the normal is the same per-segment one
+static const char* LATHE_EVALUATION_SHADER =
+	"#version 400 compatibility\n"
+	"layout(quads, equal_spacing, cw) in;\n"
+	"in vec3 patchControlPoint[];\n"
+	"in vec4 patchColour[];\n"
+	GLSL_FIXED_FUNCTION_LIGHTING
+	"void main() {\n"
+	"	vec3 a = patchControlPoint[0];\n"
+	"	vec3 b = patchControlPoint[1];\n"
+	"	vec3 point = mix(a, b, gl_TessCoord.y);\n"
+	"	float angle = gl_TessCoord.x * 6.2831853;\n"
+	"	float c = cos(angle);\n"
+	"	float s = sin(angle);\n"
+	"	vec2 profileNormal = vec2(a.y - b.y, b.x - a.x);\n"
+	"	profileNormal = length(profileNormal) > 0.0001 ? normalize(profileNormal) : vec2(0.0, 1.0);\n"
+	"	vec4 eye = gl_ModelViewMatrix * vec4(point.x * c, point.y, point.x * s, 1.0);\n"
+	"	gl_Position = gl_ProjectionMatrix * eye;\n"
+	"	gl_ClipVertex = eye;\n"
+	"	gl_TexCoord[0] = vec4(gl_TessCoord.x, point.z, 0.0, 1.0);\n"
+	"	vec3 normal = normalize(gl_NormalMatrix * vec3(profileNormal.x * c, profileNormal.y, profileNormal.x * s));\n"
+	"	gl_FrontColor = litColour(normal, eye.xyz, patchColour[0]);\n"
+	"}\n";
+
+void initTessellatedLathes()
+{
+	if (!g_hasTessellation || !g_hasVBO || !g_config.useTessellation) return;
+	GLuint shaders[3] = {
+		compileShader(GL_VERTEX_SHADER, LATHE_VERTEX_SHADER),
+		compileShader(GL_TESS_CONTROL_SHADER, LATHE_CONTROL_SHADER),
+		compileShader(GL_TESS_EVALUATION_SHADER, LATHE_EVALUATION_SHADER),
+	};
+	if (!shaders[0] || !shaders[1] || !shaders[2]) {
+		for (GLuint shader : shaders) if (shader) glDeleteShader(shader);
+		return;
+	}
+	GLuint program = linkProgram(shaders, 3, LATHE_ATTRIBUTE_NAMES, 1);
+	if (!program) return;
+
+	// Each segment is its own patch: its two profile points with their texture v
+	std::vector<float> controlPoints;
+	for (int lathe = 0; lathe < TESSELLATED_LATHE_COUNT; ++lathe) {
+		const TessellatedLatheProfile& profile = TESSELLATED_LATHE_PROFILES[lathe];
+		g_tessellatedLathes.firstVertex[lathe] = (int)controlPoints.size() / 3;
+		for (int i = 0; i < profile.pointCount - 1; ++i) {
+			for (int end = i; end <= i + 1; ++end) {
+				controlPoints.push_back(profile.points[end][0]);
+				controlPoints.push_back(profile.points[end][1]);
+				controlPoints.push_back((float)end / (profile.pointCount - 1));
+			}
+		}
+		g_tessellatedLathes.vertexCount[lathe] = (int)controlPoints.size() / 3 - g_tessellatedLathes.firstVertex[lathe];
+	}
+	glGenBuffers(1, &g_tessellatedLathes.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, g_tessellatedLathes.buffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(controlPoints.size() * sizeof(float)), controlPoints.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	g_tessellatedLathes.program = program;
+	g_tessellatedLathes.viewportHalfHeightLocation = glGetUniformLocation(program, "viewportHalfHeight");
+	g_tessellatedLathes.maxSidesLocation = glGetUniformLocation(program, "maxSides");
+	g_tessellatedLathes.lightingLocation = glGetUniformLocation(program, "lighting");
+	g_tessellatedLathes.enabledLightsLocation = glGetUniformLocation(program, "enabledLights");
+	OutputDebugStringA("Chest and skirt are tessellated on the GPU.\n");
+}
+
+void unloadTessellatedLathes()
+{
+	if (g_tessellatedLathes.program) glDeleteProgram(g_tessellatedLathes.program);
+	if (g_tessellatedLathes.buffer) glDeleteBuffers(1, &g_tessellatedLathes.buffer);
+	g_tessellatedLathes.program = 0;
+	g_tessellatedLathes.buffer = 0;
+}
+
+// Returns false when the caller should draw the baked part instead
+bool drawTessellatedLathe(TessellatedLatheId lathe)
+{
+	if (!g_tessellatedLathes.program || g_meshCapture) return false;
+	// The pass's own target: the window, the dynamic resolution target, an impostor tile or the mirror
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glUseProgram(g_tessellatedLathes.program);
+	glUniform1f(g_tessellatedLathes.viewportHalfHeightLocation, viewport[3] * 0.5f);
+	glUniform1f(g_tessellatedLathes.maxSidesLocation, 64.0f * g_meshDetailPercent / 100.0f);
+	setFixedFunctionLightingUniforms(g_tessellatedLathes.lightingLocation, g_tessellatedLathes.enabledLightsLocation);
+	glBindBuffer(GL_ARRAY_BUFFER, g_tessellatedLathes.buffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+	glPatchParameteri(GL_PATCH_VERTICES, 2);
+	glDrawArrays(GL_PATCHES, g_tessellatedLathes.firstVertex[lathe], g_tessellatedLathes.vertexCount[lathe]);
+	glDisableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+	return true;
+}
+
+// --- Helper Functions to Draw Body Parts ---
+
+void drawCuboid(float width, float height, float depth)
+{
+	if (drawBakedBox(width, height, depth)) return;
+
+	float w = width / 2.0f;
+	float h = height / 2.0f;
+	float d = depth / 2.0f;
+
+	meshBegin(GL_QUADS);
+	// Front Face
+	meshNormal(0.0f, 0.0f, 1.0f);
+	meshVertex(-w, -h, d); meshVertex(w, -h, d); meshVertex(w, h, d); meshVertex(-w, h, d);
+	// Back Face
+	meshNormal(0.0f, 0.0f, -1.0f);
+	meshVertex(-w, -h, -d); meshVertex(-w, h, -d); meshVertex(w, h, -d); meshVertex(w, -h, -d);
+	// Top Face
+	meshNormal(0.0f, 1.0f, 0.0f);
+	meshVertex(-w, h, -d); meshVertex(-w, h, d); meshVertex(w, h, d); meshVertex(w, h, -d);
+	// Bottom Face
+	meshNormal(0.0f, -1.0f, 0.0f);
+	meshVertex(-w, -h, -d); meshVertex(w, -h, -d); meshVertex(w, -h, d); meshVertex(-w, -h, d);
+	// Right face
+	meshNormal(1.0f, 0.0f, 0.0f);
+	meshVertex(w, -h, -d); meshVertex(w, h, -d); meshVertex(w, h, d); meshVertex(w, -h, d);
+	// Left Face
+	meshNormal(-1.0f, 0.0f, 0.0f);
+	meshVertex(-w, -h, -d); meshVertex(-w, -h, d); meshVertex(-w, h, d); meshVertex(-w, h, -d);
+	meshEnd();
+}
+
+void drawCurvedShoulderPads()
+{
+	// Set material properties for the shoulder pads
+	GLfloat mat_ambient[] = { 0.45f, 0.38f, 0.1f, 1.0f };
+	GLfloat mat_diffuse[] = { 1.0f, 0.84f, 0.0f, 1.0f };
+	GLfloat mat_specular[] = { 1.0f, 1.0f, 0.8f, 1.0f };
+	GLfloat mat_shininess[] = { 100.0f };
+	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+
+	// --- NEW: Enable and apply the Silver texture ---
+	glEnable(GL_TEXTURE_2D);
+	bindTexture(TEX_SILVER);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	// Set the base colour to white for proper texturing
+	glColor3f(1.0f, 1.0f, 1.0f);
+
+	auto drawOneShoulder = [&](bool isLeft) {
+		glPushMatrix();
+		glTranslatef(isLeft ? -0.38f : 0.38f, 0.7f, 0.0f);
+		glRotatef(isLeft ? 20.0f : -20.0f, 0.0f, 0.0f, 1.0f);
+		glRotatef(-25.0f, 1.0f, 0.0f, 0.0f);
+
+		// The cuboids will now be textured since texturing is enabled.
+		// We can add texture coordinates to the cuboid function for better mapping,
+		// but for a simple metal texture, the default mapping will work fine.
+
+		// --- Bottom Layer (Largest, Darker Panel) ---
+		glPushMatrix();
+		glTranslatef(0.0f, 0.0f, -0.05f);
+		glScalef(1.2f, 0.8f, 0.1f);
+		glRotatef(isLeft ? 10.0f : -10.0f, 0.0f, 1.0f, 0.0f);
+		drawCuboid(0.4f, 0.2f, 1.0f);
+		glPopMatrix();
+
+		// --- Middle Layer (Main Panel) ---
+		glPushMatrix();
+		glTranslatef(0.0f, 0.02f, 0.0f);
+		glScalef(1.0f, 0.9f, 0.12f);
+		glRotatef(isLeft ? -5.0f : 5.0f, 0.0f, 1.0f, 0.0f);
+		drawCuboid(0.4f, 0.2f, 1.0f);
+		glPopMatrix();
+
+		// --- Top Layer (Smaller, More Angular Panel) ---
+		glPushMatrix();
+		glTranslatef(0.0f, 0.05f, 0.05f);
+		glScalef(0.8f, 0.8f, 0.15f);
+		drawCuboid(0.4f, 0.2f, 1.0f);
+		glPopMatrix();
+
+		glPopMatrix();
+		};
+
+	drawOneShoulder(true);
+	drawOneShoulder(false);
+
+	// --- NEW: Disable texturing after drawing ---
+	glDisable(GL_TEXTURE_2D);
+}
+
+void drawLathedObject(const float profile[][2], int num_points, int sides)
+{
+	float EPSILON = 0.0001f;
+	sides = scaledDetail(sides, 6);
+	for (int i = 0; i < num_points - 1; ++i)
+	{
+		meshBegin(GL_TRIANGLE_STRIP);
+		for (int j = 0; j <= sides; ++j)
+		{
+			float angle_rad = (float)j / (float)sides * 2.0f * 3.14159f;
+			float cos_angle = cos(angle_rad);
+			float sin_angle = sin(angle_rad);
+			float dx = profile[i + 1][0] - profile[i][0];
+			float dy = profile[i + 1][1] - profile[i][1];
+
+			// --- REVERTED NORMALS ---
+			float normal_x_profile = -dy; // Revert to -dy
+			float normal_y_profile = dx;  // Revert to dx
+
+			float normal_len_2d = sqrt(normal_x_profile * normal_x_profile + normal_y_profile * normal_y_profile);
+			if (normal_len_2d > EPSILON) {
+				normal_x_profile /= normal_len_2d;
+				normal_y_profile /= normal_len_2d;
+			}
+			else {
+				normal_x_profile = 0.0f;
+				normal_y_profile = 1.0f;
+			}
+			float normal_x_3d = normal_x_profile * cos_angle;
+			float normal_z_3d = normal_x_profile * sin_angle;
+
+			// Add texture coordinates
+			float u = (float)j / sides;
+			float v1 = (float)i / (num_points - 1);
+			float v2 = (float)(i + 1) / (num_points - 1);
+
+			// The normal goes first so it belongs to this column rather than the next one
+			meshNormal(normal_x_3d, normal_y_profile, normal_z_3d);
+			meshTexCoord(u, v1); // Texture coord for the first vertex
+			meshVertex(profile[i][0] * cos_angle, profile[i][1], profile[i][0] * sin_angle);
+
+			meshTexCoord(u, v2); // Texture coord for the second vertex
+			meshVertex(profile[i + 1][0] * cos_angle, profile[i + 1][1], profile[i + 1][0] * sin_angle);
+		}
+		meshEnd();
+	}
+}
+
+/* void drawHand(bool isLeftHand)
+{
+	glColor3f(1.0f, 0.84f, 0.0f); // Golden yellow
+
+	// --- 1. Draw the Palm ---
+	glPushMatrix();
+	// Position the palm correctly at the wrist
+	glTranslatef(0.0f, -0.05f, 0.0f);
+	glRotatef(10.0f, 1.0f, 0.0f, 0.0f); // Slight downward angle for the palm
+	// Draw a flattened cuboid for the palm (Width, Height, Depth)
+	drawCuboid(0.18f, 0.22f, 0.06f);
+	glPopMatrix();
+
+
+	// --- 2. Draw the Four Fingers ---
+	for (int i = 0; i < 4; i++)
+	{
+		glPushMatrix(); // Save the wrist's state
+
+		// --- Knuckle Placement ---
+		// Position each finger's knuckle on the bottom edge of the palm
+		float xPos = isLeftHand ? (-0.0675f + i * 0.045f) : (0.0675f - i * 0.045f);
+		glTranslatef(xPos, -0.15f, 0.01f);
+		// Base rotation for the whole finger to make it curl slightly
+		glRotatef(20.0f, 1.0f, 0.0f, 0.0f);
+
+		// --- Finger Segment 1 (Base) ---
+		float seg1_len = 0.07f;
+		glTranslatef(0.0f, -seg1_len / 2.0f, 0.0f); // Move to the center of the segment
+		drawCuboid(0.035f, seg1_len, 0.04f);      // Draw the segment
+
+		// --- Finger Segment 2 (Middle) ---
+		glTranslatef(0.0f, -seg1_len / 2.0f, 0.0f); // Move to the joint at the end of the first segment
+		glRotatef(25.0f, 1.0f, 0.0f, 0.0f);      // Rotate the joint
+		float seg2_len = 0.06f;
+		glTranslatef(0.0f, -seg2_len / 2.0f, 0.0f); // Move to the center of the second segment
+		drawCuboid(0.032f, seg2_len, 0.037f);     // Draw the segment
+
+		// --- Finger Segment 3 (Tip) ---
+		glTranslatef(0.0f, -seg2_len / 2.0f, 0.0f); // Move to the joint at the end of the second segment
+		glRotatef(25.0f, 1.0f, 0.0f, 0.0f);      // Rotate the joint
+		float seg3_len = 0.05f;
+		glTranslatef(0.0f, -seg3_len / 2.0f, 0.0f); // Move to the center of the third segment
+		drawCuboid(0.03f, seg3_len, 0.034f);      // Draw the segment
+
+		glPopMatrix(); // Restore to the wrist's state for the next finger
+	}
+
+	// --- 3. Draw the Thumb ---
+	glPushMatrix(); // Save the wrist's state
+
+	// Position the thumb's base on the side of the palm
+	glTranslatef(isLeftHand ? -0.1f : 0.1f, -0.08f, -0.01f);
+	glRotatef(isLeftHand ? 40.0f : -40.0f, 0.0f, 1.0f, 0.0f); // Rotate it outwards
+	glRotatef(30.0f, 0.0f, 0.0f, isLeftHand ? 1.0f : -1.0f); // Angle it across the palm
+
+	// --- Thumb Segment 1 (Base) ---
+	float thumb1_len = 0.06f;
+	glTranslatef(0.0f, -thumb1_len / 2.0f, 0.0f);
+	drawCuboid(0.04f, thumb1_len, 0.04f);
+
+	// --- Thumb Segment 2 (Tip) ---
+	glTranslatef(0.0f, -thumb1_len / 2.0f, 0.0f);
+	glRotatef(30.0f, 1.0f, 0.0f, 0.0f);
+	float thumb2_len = 0.05f;
+	glTranslatef(0.0f, -thumb2_len / 2.0f, 0.0f);
+	drawCuboid(0.037f, thumb2_len, 0.037f);
+
+	glPopMatrix(); // Restore to the wrist's state
+} */
+
+// --- Low-poly human hand (game-style), shape-only update ---
+// Keeps the same local origin & overall size so your arm code doesn't need changes.
+static void drawTrapezoidPrism(float w_back, float w_wrist, float h, float d) {
+	// back = knuckle side, wrist = forearm side
+	float hb = h * 0.5f;
+	float db = d * 0.5f;
+	float wb = w_back * 0.5f;
+	float ww = w_wrist * 0.5f;
+
+	glBegin(GL_QUADS);
+	// Top
+	glNormal3f(0, 1, 0);
+	glVertex3f(-ww, hb, db); glVertex3f(ww, hb, db);
+	glVertex3f(wb, hb, -db); glVertex3f(-wb, hb, -db);
+	// Bottom
+	glNormal3f(0, -1, 0);
+	glVertex3f(-ww, -hb, db); glVertex3f(-wb, -hb, -db);
+	glVertex3f(wb, -hb, -db); glVertex3f(ww, -hb, db);
+	// Front (palm)
+	glNormal3f(0, 0, 1);
+	glVertex3f(-ww, -hb, db); glVertex3f(ww, -hb, db);
+	glVertex3f(ww, hb, db); glVertex3f(-ww, hb, db);
+	// Back (knuckles)
+	glNormal3f(0, 0, -1);
+	glVertex3f(-wb, -hb, -db); glVertex3f(-wb, hb, -db);
+	glVertex3f(wb, hb, -db); glVertex3f(wb, -hb, -db);
+	// Left
+	glNormal3f(-1, 0, 0);
+	glVertex3f(-ww, -hb, db); glVertex3f(-ww, hb, db);
+	glVertex3f(-wb, hb, -db); glVertex3f(-wb, -hb, -db);
+	// Right
+	glNormal3f(1, 0, 0);
+	glVertex3f(ww, -hb, db); glVertex3f(wb, -hb, -db);
+	glVertex3f(wb, hb, -db); glVertex3f(ww, hb, db);
+	glEnd();
+}
+
+static void drawBox(float w, float h, float d) { // small helper
+	if (drawBakedBox(w, h, d)) return;
+	float hw = w * 0.5f, hh = h * 0.5f, hd = d * 0.5f;
+	meshBegin(GL_QUADS);
+	meshNormal(0, 0, 1);
+	meshVertex(-hw, -hh, hd); meshVertex(hw, -hh, hd); meshVertex(hw, hh, hd); meshVertex(-hw, hh, hd);
+	meshNormal(0, 0, -1);
+	meshVertex(-hw, -hh, -hd); meshVertex(-hw, hh, -hd); meshVertex(hw, hh, -hd); meshVertex(hw, -hh, -hd);
+	meshNormal(0, 1, 0);
+	meshVertex(-hw, hh, -hd); meshVertex(-hw, hh, hd); meshVertex(hw, hh, hd); meshVertex(hw, hh, -hd);
+	meshNormal(0, -1, 0);
+	meshVertex(-hw, -hh, -hd); meshVertex(hw, -hh, -hd); meshVertex(hw, -hh, hd); meshVertex(-hw, -hh, hd);
+	meshNormal(1, 0, 0);
+	meshVertex(hw, -hh, -hd); meshVertex(hw, hh, -hd); meshVertex(hw, hh, hd); meshVertex(hw, -hh, hd);
+	meshNormal(-1, 0, 0);
+	meshVertex(-hw, -hh, -hd); meshVertex(-hw, -hh, hd); meshVertex(-hw, hh, hd); meshVertex(-hw, hh, -hd);
+	meshEnd();
+}
+
+// ---------- helpers ----------
+static void box6(float w, float h, float d) { // hard-edged box
+	if (drawBakedBox(w, h, d)) return;
+	float x = w * 0.5f, y = h * 0.5f, z = d * 0.5f;
+	meshBegin(GL_QUADS);
+	meshNormal(0, 0, 1);  meshVertex(-x, -y, z); meshVertex(x, -y, z); meshVertex(x, y, z); meshVertex(-x, y, z);
+	meshNormal(0, 0, -1); meshVertex(-x, -y, -z); meshVertex(-x, y, -z); meshVertex(x, y, -z); meshVertex(x, -y, -z);
+	meshNormal(0, 1, 0);  meshVertex(-x, y, -z); meshVertex(-x, y, z); meshVertex(x, y, z); meshVertex(x, y, -z);
+	meshNormal(0, -1, 0); meshVertex(-x, -y, -z); meshVertex(x, -y, -z); meshVertex(x, -y, z); meshVertex(-x, -y, z);
+	meshNormal(1, 0, 0);  meshVertex(x, -y, -z); meshVertex(x, y, -z); meshVertex(x, y, z); meshVertex(x, -y, z);
+	meshNormal(-1, 0, 0); meshVertex(-x, -y, -z); meshVertex(-x, -y, z); meshVertex(-x, y, z); meshVertex(-x, y, -z);
+	meshEnd();
+}
+
+static void drawPalmWedge(float wKnuckle, float wWrist, float thick, float depth)
+{
+	float hk = thick * 0.5f;
+	float dz = depth * 0.5f;
+	float wk = wKnuckle * 0.5f;
+	float ww = wWrist * 0.5f;
+
+	meshBegin(GL_QUADS);
+	// top 
+	meshNormal(0, 1, 0);
+	meshVertex(-ww, hk, dz);
+	meshVertex(ww, hk, dz);
+	meshVertex(wk, hk * 0.7f, -dz);
+	meshVertex(-wk, hk * 0.7f, -dz);
+
+	// bottom
+	meshNormal(0, -1, 0);
+	meshVertex(-ww, -hk, dz);
+	meshVertex(-wk, -hk, -dz);
+	meshVertex(wk, -hk, -dz);
+	meshVertex(ww, -hk, dz);
+
+	// front 
+	meshNormal(0, 0, 1);
+	meshVertex(-ww, -hk, dz);
+	meshVertex(ww, -hk, dz);
+	meshVertex(ww, hk, dz);
+	meshVertex(-ww, hk, dz);
+
+	// back 
+	meshNormal(0, 0, -1);
+	meshVertex(-wk, -hk, -dz);
+	meshVertex(-wk, hk * 0.7f, -dz);
+	meshVertex(wk, hk * 0.7f, -dz);
+	meshVertex(wk, -hk, -dz);
+
+	// left
+	meshNormal(-1, 0, 0);
+	meshVertex(-ww, -hk, dz);
+	meshVertex(-ww, hk, dz);
+	meshVertex(-wk, hk * 0.7f, -dz);
+	meshVertex(-wk, -hk, -dz);
+
+	// right
+	meshNormal(1, 0, 0);
+	meshVertex(ww, -hk, dz);
+	meshVertex(wk, -hk, -dz);
+	meshVertex(wk, hk * 0.7f, -dz);
+	meshVertex(ww, hk, dz);
+	meshEnd();
+}
+
+// ---------- main ----------
+// Palm proportions, shared by drawHand and the baked palm
+const float PALM_W_K = 0.205f;
+const float PALM_W_W = 0.155f;
+const float PALM_H = 0.14f;
+const float PALM_D = 0.05f;
+
+static void emitPalm()
+{
+	drawPalmWedge(PALM_W_K, PALM_W_W, PALM_H, PALM_D);
+}
+
+void drawHand(bool isLeftHand)
+{
+	// NOTE: This function now INHERITS the color and texture state from its caller (drawSmoothArms)
+	// All glColor, glEnable, glBindTexture, glDisable calls have been removed.
+
+	glPushMatrix();
+	glTranslatef(0.0f, -0.05f, 0.0f);
+	glRotatef(1.0f, 1, 0, 0);
+
+	// ===== 1) Palm & Knuckles =====
+	drawBakedPart(PART_PALM);
+	glPushMatrix();
+	glTranslatef(0.0f, PALM_H * 0.47f, -PALM_D * 0.48f);
+	box6(PALM_W_K * 0.95f, 0.018f, 0.026f);
+	glPopMatrix();
+
+	// ===== 2) Fingers =====
+	struct F { float x, yawDeg, len; float w, d; };
+	F fingers[4] = {
+		{ -0.060f, -9.0f, 0.072f, 0.030f, 0.034f }, // i=0
+		{ -0.020f, -3.0f, 0.078f, 0.032f, 0.036f }, // i=1
+		{  0.020f,  3.0f, 0.074f, 0.031f, 0.035f }, // i=2
+		{  0.058f,  9.0f, 0.064f, 0.028f, 0.033f }, // i=3
+	};
+
+	// Finger and thumb bends come from the blend tree's pose for this hand
+	int handJoint = isLeftHand ? JOINT_LEFT_HAND : JOINT_RIGHT_HAND;
+
+	for (int i = 0; i < 4; ++i) {
+		glPushMatrix();
+		glTranslatef(fingers[i].x, -PALM_H * 0.24f, -PALM_D * 0.50f);
+		float yaw = fingers[i].yawDeg;
+		if (!isLeftHand) yaw = -yaw;
+		glRotatef(yaw, 0, 1, 0);
+		applyPoseJoint(handJoint + i * 3 + 0);
+
+		float L1 = fingers[i].len, W1 = fingers[i].w, D1 = fingers[i].d;
+		glTranslatef(0, -L1 * 0.5f, 0); box6(W1, L1, D1);
+		float L2 = L1 * 0.86f, W2 = W1 * 0.92f, D2 = D1 * 0.92f;
+		glTranslatef(0, -L1 * 0.5f, 0);
+		applyPoseJoint(handJoint + i * 3 + 1);
+		glTranslatef(0, -L2 * 0.5f, 0); box6(W2, L2, D2);
+		float L3 = L2 * 0.80f, W3 = W2 * 0.88f, D3 = D2 * 0.90f;
+		glTranslatef(0, -L2 * 0.5f, 0);
+		applyPoseJoint(handJoint + i * 3 + 2);
+		glTranslatef(0, -L3 * 0.5f, 0); box6(W3, L3, D3);
+		glPopMatrix();
+	}
+
+	// ===== 3) Thumb =====
+	glPushMatrix();
+	glTranslatef(isLeftHand ? -PALM_W_W * 0.56f : PALM_W_W * 0.56f, -PALM_H * 0.02f, -PALM_D * 0.12f);
+	glRotatef(52.f, 0, (isLeftHand ? 1 : -1), 0);
+	glRotatef(10.f, 0, 0, 1);
+	glRotatef(18.f, 1, 0, 0);
+
+	float T1L = 0.074f, T1W = 0.044f, T1D = 0.046f;
+	glTranslatef(0, -T1L * 0.5f, 0); box6(T1W, T1L, T1D);
+
+	float T2L = 0.060f, T2W = T1W * 0.90f, T2D = T1D * 0.92f;
+	glTranslatef(0, -T1L * 0.5f, 0);
+	applyPoseJoint(handJoint + HAND_THUMB_JOINT);
+	glTranslatef(0, -T2L * 0.5f, 0); box6(T2W, T2L, T2D);
+	glPopMatrix();
+
+	// ===== 4) Palm bevel =====
+	glPushMatrix();
+	glTranslatef(0.0f, -PALM_H * 0.40f, PALM_D * 0.30f);
+	glScalef(1.0f, 1.0f, 0.6f);
+	box6(PALM_W_W * 0.90f, 0.020f, 0.040f);
+	glPopMatrix();
+
+	glPopMatrix();
+}
+
+static void emitChest()
+{
+	int chest_points = sizeof(chest_profile) / sizeof(chest_profile[0]);
+	drawLathedObject(chest_profile, chest_points, 20);
+}
+
+void drawSmoothChest()
+{
+	// Set the base colour to white so the texture is not tinted
+	glColor3f(1.0f, 1.0f, 1.0f);
+
+	// Enable and apply the texture
+	glEnable(GL_TEXTURE_2D);
+
+	// --- MODIFIED: Changed from the gold texture to the silver texture ---
+	bindTexture(TEX_SILVER);
+
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	if (!drawTessellatedLathe(LATHE_CHEST)) drawBakedPart(PART_CHEST);
+
+	// Disable texturing afterwards
+	glDisable(GL_TEXTURE_2D);
+}
+
+static void emitLowerBody()
+{
+	int lower_body_points = sizeof(lower_body_profile) / sizeof(lower_body_profile[0]);
+
+	drawLathedObject(lower_body_profile, lower_body_points, 24);
+}
+
+void drawSmoothLowerBodyAndSkirt()
+{
+	// Set the base material colour to white. This allows the texture's own colours
+	// to show up correctly without being tinted yellow.
+	glColor3f(1.0f, 1.0f, 1.0f);
+
+	// --- NEW: Enable and apply the silver texture ---
+	glEnable(GL_TEXTURE_2D);
+	bindTexture(TEX_SILVER);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE); // Blends texture with lighting
+
+	if (!drawTessellatedLathe(LATHE_LOWER_BODY)) drawBakedPart(PART_LOWER_BODY);
+
+	// --- NEW: Disable texturing after drawing the skirt ---
+	// This is important so the texture doesn't accidentally get applied to other objects.
+	glDisable(GL_TEXTURE_2D);
+}
+
+static void emitKneeDiamond()
+{
+	// Define the 6 points of our diamond (an octahedron)
+	static const float p[6][3] = {
+		{ 0.0f,  1.0f,  0.0f}, // Top
+		{ 0.0f, -1.0f,  0.0f}, // Bottom
+		{ 1.0f,  0.0f,  0.0f}, // Right
+		{-1.0f,  0.0f,  0.0f}, // Left
+		{ 0.0f,  0.0f,  1.0f}, // Front
+		{ 0.0f,  0.0f, -1.0f}  // Back
+	};
+
+	// --- NEW: Define texture coordinates for the 6 points ---
+	// This maps points on the 2D fire image to the 3D diamond points.
+	static const float t[6][2] = {
+		{0.5f, 1.0f}, // Top-middle of texture
+		{0.5f, 0.0f}, // Bottom-middle of texture
+		{1.0f, 0.5f}, // Middle-right of texture
+		{0.0f, 0.5f}, // Middle-left of texture
+		{0.5f, 0.5f}, // Center of texture
+		{0.5f, 0.5f}  // Center of texture
+	};
+
+	// An array to hold the calculated normals for each of the 8 faces
+	static const float n[8][3] = {
+		{ 0.707f,  0.707f,  0.707f}, { -0.707f,  0.707f,  0.707f},
+		{ -0.707f,  0.707f, -0.707f}, {  0.707f,  0.707f, -0.707f},
+		{ 0.707f, -0.707f,  0.707f}, { -0.707f, -0.707f,  0.707f},
+		{ -0.707f, -0.707f, -0.707f}, {  0.707f, -0.707f, -0.707f}
+	};
+
+	meshBegin(GL_TRIANGLES);
+	// Top-Front-Right face
+	meshNormalv(n[0]);
+	meshTexCoordv(t[0]); meshVertexv(p[0]);
+	meshTexCoordv(t[4]); meshVertexv(p[4]);
+	meshTexCoordv(t[2]); meshVertexv(p[2]);
+	// Top-Front-Left face
+	meshNormalv(n[1]);
+	meshTexCoordv(t[0]); meshVertexv(p[0]);
+	meshTexCoordv(t[3]); meshVertexv(p[3]);
+	meshTexCoordv(t[4]); meshVertexv(p[4]);
+	// Top-Back-Left face
+	meshNormalv(n[2]);
+	meshTexCoordv(t[0]); meshVertexv(p[0]);
+	meshTexCoordv(t[5]); meshVertexv(p[5]);
+	meshTexCoordv(t[3]); meshVertexv(p[3]);
+	// Top-Back-Right face
+	meshNormalv(n[3]);
+	meshTexCoordv(t[0]); meshVertexv(p[0]);
+	meshTexCoordv(t[2]); meshVertexv(p[2]);
+	meshTexCoordv(t[5]); meshVertexv(p[5]);
+
+	// Bottom-Front-Right face
+	meshNormalv(n[4]);
+	meshTexCoordv(t[1]); meshVertexv(p[1]);
+	meshTexCoordv(t[2]); meshVertexv(p[2]);
+	meshTexCoordv(t[4]); meshVertexv(p[4]);
+	// Bottom-Front-Left face
+	meshNormalv(n[5]);
+	meshTexCoordv(t[1]); meshVertexv(p[1]);
+	meshTexCoordv(t[4]); meshVertexv(p[4]);
+	meshTexCoordv(t[3]); meshVertexv(p[3]);
+	// Bottom-Back-Left face
+	meshNormalv(n[6]);
+	meshTexCoordv(t[1]); meshVertexv(p[1]);
+	meshTexCoordv(t[3]); meshVertexv(p[3]);
+	meshTexCoordv(t[5]); meshVertexv(p[5]);
+	// Bottom-Back-Right face
+	meshNormalv(n[7]);
+	meshTexCoordv(t[1]); meshVertexv(p[1]);
+	meshTexCoordv(t[5]); meshVertexv(p[5]);
+	meshTexCoordv(t[2]); meshVertexv(p[2]);
+	meshEnd();
+}
+
+void drawDiamondKneeJoint()
+{
+	glPushMatrix();
+	// NOTE: This function inherits the gold material from drawLegs()
+
+	// --- NEW: Enable and apply the fire texture ---
+	glEnable(GL_TEXTURE_2D);
+	bindProceduralTexture(PROC_FIRE);
+	// This blends the fire texture with the existing gold material and lighting
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	// Y-scale (height) is kept long to allow for overlap
+	glScalef(0.2f, 0.45f, 0.2f); // X, Y (height), Z scale
+
+	// This rotation orients the diamond correctly
+	glRotatef(45.0f, 0.0f, 1.0f, 0.0f);
+
+	drawBakedPart(PART_KNEE_DIAMOND);
+
+	// --- NEW: Disable texturing so it doesn't affect other objects ---
+	glDisable(GL_TEXTURE_2D);
+
+	glPopMatrix();
+}
+
+void drawSphere(float r, int slices, int stacks)
+{
+	const int MAX_STACKS = 50; // adjust if needed
+	float profile[MAX_STACKS + 1][2];
+	if (!g_meshCapture) stacks = min(stacks, g_config.sphereMaxStacks); // Baked spheres: see bakedPartDetailPercent
+	stacks = scaledDetail(stacks, 4);
+
+	int count = 0;
+	for (int i = 0; i <= stacks; i++)
+	{
+		float theta = (float)i / stacks * 3.14159f; // 0 → PI
+		float y = r * cos(theta);
+		float x = r * sin(theta);
+		profile[count][0] = x;
+		profile[count][1] = y;
+		count++;
+	}
+
+	drawLathedObject(profile, count, slices);
+}
+
+bool isDrawingMirrorReflection();                 // Defined with the reflection pass below
+bool beginMirrorSurface();
+void mirrorSurfaceTexCoord(float x, float y);
+
+void drawDivineMirror() {
+	if (isDrawingMirrorReflection()) return; // It does not show up in its own reflection
+	glPushMatrix();
+
+	// --- 1. Position the Mirror ---
+	// We'll have it float gracefully near the character's right hand.
+	// This position is relative to the hand's location.
+	glTranslatef(0.3f, 0.2f, 0.5f);
+	glRotatef(-90.0f, 0.0f, 1.0f, 0.0f); // Face the mirror forward
+	glRotatef(-15.0f, 1.0f, 0.0f, 0.0f); // Tilt it slightly up
+
+	// Animate a slow, mystical rotation and hover
+	glRotatef(g_braidTime * 15.0f, 0.0f, 0.0f, 1.0f); // Slow spin
+	glTranslatef(0.0f, motionSin(g_braidTime) * 0.05f, 0.0f); // Gentle up-down bob
+	capturePickPart(PICK_MIRROR, -0.4f, -0.4f, -0.03f, 0.4f, 0.4f, 0.03f);
+
+	// --- 2. Set Material for the Frame (Shiny Silver/Jade) ---
+	GLfloat mat_ambient[] = { 0.8f, 0.9f, 0.8f, 1.0f };
+	GLfloat mat_diffuse[] = { 0.9f, 1.0f, 0.9f, 1.0f };
+	GLfloat mat_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	GLfloat mat_shininess[] = { 100.0f };
+	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+	glColor3f(0.9f, 1.0f, 0.9f);
+
+	// --- 3. Draw the Octagonal Frame ---
+	const int sides = 8;
+	const float outer_radius = 0.4f;
+	const float inner_radius = 0.35f;
+	const float thickness = 0.05f;
+
+	for (int i = 0; i < sides; ++i) {
+		float angle1 = (float)i / sides * 2.0f * 3.14159f;
+		float angle2 = (float)(i + 1) / sides * 2.0f * 3.14159f;
+
+		// Vertices for one segment of the frame
+		float v[8][3] = {
+			{ outer_radius * cos(angle1), outer_radius * sin(angle1),  thickness / 2.0f },
+			{ outer_radius * cos(angle2), outer_radius * sin(angle2),  thickness / 2.0f },
+			{ inner_radius * cos(angle2), inner_radius * sin(angle2),  thickness / 2.0f },
+			{ inner_radius * cos(angle1), inner_radius * sin(angle1),  thickness / 2.0f },
+			{ outer_radius * cos(angle1), outer_radius * sin(angle1), -thickness / 2.0f },
+			{ outer_radius * cos(angle2), outer_radius * sin(angle2), -thickness / 2.0f },
+			{ inner_radius * cos(angle2), inner_radius * sin(angle2), -thickness / 2.0f },
+			{ inner_radius * cos(angle1), inner_radius * sin(angle1), -thickness / 2.0f }
+		};
+
+		glBegin(GL_QUADS);
+		// Front face
+		glNormal3f(0, 0, 1);
+		glVertex3fv(v[0]); glVertex3fv(v[1]); glVertex3fv(v[2]); glVertex3fv(v[3]);
+		// Back face
+		glNormal3f(0, 0, -1);
+		glVertex3fv(v[4]); glVertex3fv(v[7]); glVertex3fv(v[6]); glVertex3fv(v[5]);
+		// Outer face
+		float nx_out = cos((angle1 + angle2) / 2.0f);
+		float ny_out = sin((angle1 + angle2) / 2.0f);
+		glNormal3f(nx_out, ny_out, 0);
+		glVertex3fv(v[0]); glVertex3fv(v[4]); glVertex3fv(v[5]); glVertex3fv(v[1]);
+		// Inner face
+		glNormal3f(-nx_out, -ny_out, 0);
+		glVertex3fv(v[3]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[7]);
+		glEnd();
+	}
+
+	// --- 4. Draw the Mirror Surface ---
+	glEnable(GL_TEXTURE_2D);
+	bool isReflecting = beginMirrorSurface();
+	if (!isReflecting) bindTexture(TEX_MIRROR); // Use the new mirror texture
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	// Make the surface glow brightly
+	glDisable(GL_LIGHTING);
+	glColor3f(1.0f, 1.0f, 1.0f);
+
+	glBegin(GL_POLYGON);
+	glNormal3f(0, 0, 1);
+	for (int i = 0; i < sides; ++i) {
+		float angle = (float)i / sides * 2.0f * 3.14159f;
+		// Map vertices to a circular texture coordinate space
+		float u = 0.5f + 0.5f * cos(angle);
+		float v = 0.5f + 0.5f * sin(angle);
+		if (isReflecting) mirrorSurfaceTexCoord(inner_radius * cos(angle), inner_radius * sin(angle));
+		else glTexCoord2f(u, v);
+		glVertex3f(inner_radius * cos(angle), inner_radius * sin(angle), 0.0f);
+	}
+	glEnd();
+
+	glEnable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+
+	glPopMatrix();
+}
+
+static void emitStaffShaft()
+{
+	static const float shaft_profile[][2] = { {0.04f, 0.0f}, {0.04f, 1.8f} };
+	drawLathedObject(shaft_profile, 2, 12);
+}
+
+static void emitStaffHolder() { drawSphere(0.1f, 16, STAFF_SPHERE_STACKS); }
+static void emitStaffPommel() { drawSphere(0.08f, 16, STAFF_SPHERE_STACKS); }
+
+void drawWeapon()
+{
+	// Set material for a shiny, magical weapon
+	GLfloat mat_ambient[] = { 0.7f, 0.7f, 1.0f, 1.0f }; // Bluish ambient
+	GLfloat mat_diffuse[] = { 0.8f, 0.8f, 1.0f, 1.0f }; // Bright blue/purple diffuse
+	GLfloat mat_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f }; // Bright white highlight
+	GLfloat mat_shininess[] = { 120.0f };
+	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+
+	glPushMatrix();
+
+	// --- THIS IS THE ADJUSTED TRANSFORMATION BLOCK ---
+
+	// Step 1: Position the staff's pivot point slightly in front of the palm's center.
+	// MODIFIED: Adjusted the Z-translation to move the staff slightly outwards.
+	glTranslatef(0.0f, 0.0f, 0.15f); // Changed from 0.05f to 0.15f
+
+	// Step 2: Rotate it to a natural holding angle.
+	glRotatef(-75.0f, 0.0f, 0.0f, 1.0f);
+	glRotatef(30.0f, 1.0f, 0.0f, 0.0f);
+
+	// Step 3: After rotating, move the staff along its NEW down-axis to sit in the hand.
+	glTranslatef(0.0f, -0.9f, 0.0f);
+
+	// --- END OF ADJUSTED BLOCK ---
+	capturePickPart(PICK_WEAPON, -0.15f, -0.1f, -0.15f, 0.15f, 2.25f, 0.15f);
+
+
+	// Now, draw the staff parts (this code remains the same)
+	// --- 1. Draw the Staff Shaft ---
+	glColor3f(0.3f, 0.2f, 0.4f);
+	drawBakedPart(PART_STAFF_SHAFT);
+
+	// --- 2. Draw the Crystal Topper ---
+	glPushMatrix();
+	glTranslatef(0.0f, 1.95f, 0.0f);
+	glScalef(1.0f, 1.5f, 1.0f);
+
+	glDisable(GL_LIGHTING);
+	glColor3f(0.8f, 0.9f, 1.0f);
+	drawDiamondKneeJoint();
+	glEnable(GL_LIGHTING);
+	glPopMatrix();
+
+	// --- 3. Draw Decorative Elements ---
+	glColor3f(1.0f, 0.84f, 0.0f);
+
+	// Top holder for the crystal
+	glPushMatrix();
+	glTranslatef(0.0f, 1.85f, 0.0f);
+	drawBakedPart(PART_STAFF_HOLDER);
+	glPopMatrix();
+
+	// Bottom pommel
+	glPushMatrix();
+	glTranslatef(0.0f, 0.0f, 0.0f);
+	drawBakedPart(PART_STAFF_POMMEL);
+	glPopMatrix();
+
+	glPopMatrix();
+}
+
+static void emitUpperArm()
+{
+	static const float upper_arm_profile[][2] = { {0.08f, 0.0f}, {0.08f, -0.5f} };
+	drawLathedObject(upper_arm_profile, 2, 12);
+}
+
+static void emitLowerArm()
+{
+	static const float lower_arm_profile[][2] = { {0.07f, 0.0f}, {0.07f, -0.4f} };
+	drawLathedObject(lower_arm_profile, 2, 12);
+}
+
+void drawSmoothArms()
+{
+	// This function will first draw the left arm completely,
+	// then draw the right arm and conditionally draw the weapon with it.
+
+	// --- Left Arm ---
+	glPushMatrix();
+	{
+		glColor3f(1.0f, 1.0f, 1.0f);
+		glEnable(GL_TEXTURE_2D);
+		bindTexture(TEX_ORANGE);
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+		glTranslatef(-0.6f, 0.7f, 0.0f);
+		applyPoseJoint(JOINT_LEFT_SHOULDER);
+
+		drawBakedPart(PART_UPPER_ARM);
+		glTranslatef(0.0f, -0.5f, 0.0f);
+
+		applyPoseJoint(JOINT_LEFT_ELBOW);
+
+		drawBakedPart(PART_LOWER_ARM);
+		glTranslatef(0.0f, -0.4f, 0.0f);
+
+		glRotatef(70.0f, 0.0f, 1.0f, 0.0f);
+		capturePickPart(PICK_LEFT_HAND, -0.13f, -0.32f, -0.16f, 0.13f, 0.05f, 0.06f);
+		drawHand(true);
+	}
+	glPopMatrix();
+
+	// --- Right Arm & Weapon ---
+	glPushMatrix();
+	{
+		glColor3f(1.0f, 1.0f, 1.0f);
+		glEnable(GL_TEXTURE_2D);
+		bindTexture(TEX_ORANGE);
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+		glTranslatef(0.6f, 0.7f, 0.0f);
+		applyPoseJoint(JOINT_RIGHT_SHOULDER);
+
+		drawBakedPart(PART_UPPER_ARM);
+		glTranslatef(0.0f, -0.5f, 0.0f);
+
+		applyPoseJoint(JOINT_RIGHT_ELBOW);
+
+		drawBakedPart(PART_LOWER_ARM);
+		glTranslatef(0.0f, -0.4f, 0.0f);
+
+		glRotatef(-70.0f, 0.0f, 1.0f, 0.0f);
+
+		// The blend tree closes this hand around the staff when it is equipped
+		capturePickPart(PICK_RIGHT_HAND, -0.13f, -0.32f, -0.16f, 0.13f, 0.05f, 0.06f);
+		drawHand(false);
+
+		// Draw the weapon if it's visible
+		if (g_equippedWeapon == 1) {
+			drawWeapon();
+		}
+		else if (g_equippedWeapon == 2) { // If Mirror is equipped
+			drawDivineMirror();
+		}
+	}
+	glPopMatrix();
+
+	// Final cleanup
+	glDisable(GL_TEXTURE_2D);
+}
+
+void drawWaistWithVerticalLines()
+{
+	float waist_top_y = 0.25f;
+	float waist_bottom_y = -0.05f;
+	float top_radius = 0.25f;
+	float bottom_radius = 0.18f;
+	int sides = g_config.waistSides;
+	int num_lines = 6;
+
+	glBegin(GL_QUADS);
+	for (int i = 0; i < sides; ++i)
+	{
+		float angle1 = (float)i / (float)sides * 2.0f * 3.14159f;
+		float angle2 = (float)(i + 1) / (float)sides * 2.0f * 3.14159f;
+		bool isLineSegment = (i % (sides / num_lines) == 0);
+
+		if (isLineSegment) {
+			glColor3f(0.8f, 0.6f, 0.0f);
+		}
+		else {
+			glColor3f(1.0f, 0.84f, 0.0f);
+		}
+
+		float v1x = top_radius * cos(angle1);
+		float v1z = top_radius * sin(angle1);
+		float v2x = top_radius * cos(angle2);
+		float v2z = top_radius * sin(angle2);
+		float v3x = bottom_radius * cos(angle2);
+		float v3z = bottom_radius * sin(angle2);
+		float v4x = bottom_radius * cos(angle1);
+		float v4z = bottom_radius * sin(angle1);
+
+		float avg_angle = (angle1 + angle2) / 2.0f;
+		glNormal3f(cos(avg_angle), 0.0f, sin(avg_angle));
+		glVertex3f(v1x, waist_top_y, v1z);
+		glVertex3f(v2x, waist_top_y, v2z);
+		glVertex3f(v3x, waist_bottom_y, v3z);
+		glVertex3f(v4x, waist_bottom_y, v4z);
+	}
+	glEnd();
+}
+
+void drawWaistBelt()
+{
+	glColor3f(0.8f, 0.6f, 0.2f); // Darker gold for the belt strap
+
+	// --- Define the geometry of the V-shaped belt ---
+	float belt_y_start = -0.05f;
+	float belt_y_end = -0.20f;
+	float belt_width = 0.1f;
+	int segments = 10; // Segments for EACH strap (front-right, front-left, back)
+	const float PI = 3.14159f;
+
+	float SURFACE_OFFSET = 0.02f;
+
+	float radius_at_y_start = 0.18f;
+	float radius_at_y_end = 0.22f;
+
+	// --- Draw Right Front Strap (V-shape) ---
+	glBegin(GL_QUAD_STRIP);
+	for (int i = 0; i <= segments; i++) {
+		float t = (float)i / segments;
+		float current_y = belt_y_start + t * (belt_y_end - belt_y_start);
+		float current_radius = radius_at_y_start + t * (radius_at_y_end - radius_at_y_start);
+		float angle = t * (PI / 2.0f);
+
+		float x = cos(angle) * (current_radius + SURFACE_OFFSET);
+		float z = sin(angle) * (current_radius + SURFACE_OFFSET);
+
+		glNormal3f(cos(angle), 0.2f, sin(angle));
+		glVertex3f(x, current_y + belt_width / 2.0f, z);
+		glVertex3f(x, current_y - belt_width / 2.0f, z);
+	}
+	glEnd();
+
+	// --- Draw Left Front Strap (V-shape) ---
+	glBegin(GL_QUAD_STRIP);
+	for (int i = 0; i <= segments; i++) {
+		float t = (float)i / segments;
+		float current_y = belt_y_start + t * (belt_y_end - belt_y_start);
+		float current_radius = radius_at_y_start + t * (radius_at_y_end - radius_at_y_start);
+		float angle = PI - (t * (PI / 2.0f));
+
+		float x = cos(angle) * (current_radius + SURFACE_OFFSET);
+		float z = sin(angle) * (current_radius + SURFACE_OFFSET);
+
+		glNormal3f(cos(angle), 0.2f, sin(angle));
+		glVertex3f(x, current_y + belt_width / 2.0f, z);
+		glVertex3f(x, current_y - belt_width / 2.0f, z);
+	}
+	glEnd();
+
+	// --- Draw the back half of the belt ---
+	glBegin(GL_QUAD_STRIP);
+	for (int i = 0; i <= segments; i++) {
+		float t = (float)i / segments;
+		// Angle from 180 (PI) to 360 (2*PI)
+		float angle = PI + t * PI;
+		float x = cos(angle) * (radius_at_y_start + SURFACE_OFFSET);
+		float z = sin(angle) * (radius_at_y_start + SURFACE_OFFSET);
+
+		glNormal3f(cos(angle), 0.0f, sin(angle));
+		// The Y position is constant for the back strap
+		glVertex3f(x, belt_y_start + belt_width / 2.0f, z);
+		glVertex3f(x, belt_y_start - belt_width / 2.0f, z);
+	}
+	glEnd();
+
+	// --- Buckle (only at the front) ---
+	glPushMatrix();
+	float t_mid = 0.5f;
+	float buckle_y = belt_y_start + t_mid * (belt_y_end - belt_y_start);
+	float radius_at_buckle = radius_at_y_start + t_mid * (radius_at_y_end - radius_at_y_start);
+	float buckle_z = radius_at_buckle + SURFACE_OFFSET + 0.02f;
+	glTranslatef(0.0f, buckle_y, buckle_z);
+
+	glColor3f(0.8f, 0.6f, 0.2f);
+	float buckle_outer_radius = 0.11f;
+	float buckle_inner_radius = 0.08f;
+	float buckle_depth = 0.03f;
+
+	glBegin(GL_QUAD_STRIP);
+	for (int i = 0; i <= 20; i++) {
+		float angle_buckle = (float)i / 20.0f * 2.0f * PI;
+		glNormal3f(cos(angle_buckle), sin(angle_buckle), 0.0f);
+		glVertex3f(buckle_outer_radius * cos(angle_buckle), buckle_outer_radius * sin(angle_buckle), buckle_depth / 2.0f);
+		glVertex3f(buckle_outer_radius * cos(angle_buckle), buckle_outer_radius * sin(angle_buckle), -buckle_depth / 2.0f);
+	}
+	glEnd();
+	glBegin(GL_QUAD_STRIP);
+	for (int i = 0; i <= 20; i++) {
+		float angle_buckle = (float)i / 20.0f * 2.0f * PI;
+		glNormal3f(-cos(angle_buckle), -sin(angle_buckle), 0.0f);
+		glVertex3f(buckle_inner_radius * cos(angle_buckle), buckle_inner_radius * sin(angle_buckle), -buckle_depth / 2.0f);
+		glVertex3f(buckle_inner_radius * cos(angle_buckle), buckle_inner_radius * sin(angle_buckle), buckle_depth / 2.0f);
+	}
+	glEnd();
+	glBegin(GL_QUAD_STRIP);
+	glNormal3f(0.0f, 0.0f, 1.0f);
+	for (int i = 0; i <= 20; i++) {
+		float angle_buckle = (float)i / 20.0f * 2.0f * PI;
+		glVertex3f(buckle_outer_radius * cos(angle_buckle), buckle_outer_radius * sin(angle_buckle), buckle_depth / 2.0f);
+		glVertex3f(buckle_inner_radius * cos(angle_buckle), buckle_inner_radius * sin(angle_buckle), buckle_depth / 2.0f);
+	}
+	glEnd();
+
+	glColor3f(0.9f, 0.9f, 0.9f);
+	glPushMatrix();
+	glTranslatef(0.0f, 0.0f, buckle_depth / 2.0f + 0.005f);
+	glBegin(GL_TRIANGLES);
+	glNormal3f(0.0f, 0.0f, 1.0f);
+	glVertex3f(0.0f, -buckle_inner_radius * 0.7f, 0.0f);
+	glVertex3f(buckle_inner_radius * 0.6f, buckle_inner_radius * 0.5f, 0.0f);
+	glVertex3f(-buckle_inner_radius * 0.6f, buckle_inner_radius * 0.5f, 0.0f);
+	glEnd();
+	glPopMatrix();
+
+	glPopMatrix();
+}
+
+static void emitLowerCollar()
+{
+	static const float lower_collar_profile[][2] = {
+		{0.20f, 0.85f}, {0.38f, 0.88f}, {0.38f, 0.84f}, {0.20f, 0.82f}
+	};
+	int lower_collar_points = sizeof(lower_collar_profile) / sizeof(lower_collar_profile[0]);
+	drawLathedObject(lower_collar_profile, lower_collar_points, 24);
+}
+
+static void emitUpperCollar()
+{
+	static const float upper_collar_profile[][2] = {
+		{0.18f, 0.88f}, {0.24f, 0.90f}, {0.24f, 0.87f}, {0.18f, 0.86f}
+	};
+	int upper_collar_points = sizeof(upper_collar_profile) / sizeof(upper_collar_profile[0]);
+	drawLathedObject(upper_collar_profile, upper_collar_points, 20);
+}
+
+void drawArmorCollar()
+{
+	glColor3f(0.8f, 0.6f, 0.0f);
+	drawBakedPart(PART_LOWER_COLLAR);
+
+	glColor3f(0.9f, 0.7f, 0.1f);
+	drawBakedPart(PART_UPPER_COLLAR);
+
+	// The old neck part is removed from here
+	// No more: glColor3f(1.0f, 0.84f, 0.0f); float neck_profile[][2] = {{0.17f, 0.88f}, {0.17f, 0.95f}}; drawLathedObject(neck_profile, 2, 16);
+}
+
+void drawBackSashes()
+{
+	const float PI = 3.14159f;
+
+	float base_sash_width = 0.18f;
+	float sash_length = 2.5f;
+	float flare_factor = 1.2f;
+	int   segments = g_sashSegments;
+	int   waveStride = SASH_SEGMENTS / segments; // The wave is sampled at full resolution
+
+	float belt_top_back_y = -0.05f;
+	float belt_back_radius = 0.18f;
+	float start_x_offset = base_sash_width / 2.0f;
+
+	const float TILT_DOWNWARD_X = 25.0f;
+	const float FLARE_SIDEWAYS_Y = 35.0f;
+	const float SURFACE_OFFSET = 0.02f;
+	const float ZBIAS = 0.003f;
+
+	auto drawOneSash = [&](bool isLeftSash)
+		{
+			glPushMatrix();
+
+			glTranslatef(isLeftSash ? -start_x_offset : +start_x_offset, belt_top_back_y, -belt_back_radius);
+			glRotatef(isLeftSash ? +FLARE_SIDEWAYS_Y : -FLARE_SIDEWAYS_Y, 0, 1, 0);
+			glRotatef(TILT_DOWNWARD_X, 1, 0, 0);
+
+			const float nx = isLeftSash ? 0.45f : -0.45f, ny = 0.5f, nz = -0.75f;
+
+			// --- Helper lambda to calculate the position of a row's vertex with wave ---
+			auto getWavedVertex = [&](int row, float half_w_offset, float z_base, float& outX, float& outY, float& outZ)
+				{
+					// Base positions (same as before)
+					float t = (float)row / segments;
+					float static_y = -t * sash_length;
+					float static_z = z_base + (-0.5f * t * t);
+					float current_width = base_sash_width + t * flare_factor;
+					float static_x_offset = motionSin(t * PI) * (isLeftSash ? -0.2f : 0.2f);
+					float static_x = static_x_offset + half_w_offset * current_width;
+
+					// The wave offset comes from updateSecondaryMotion, refreshed at the animation LOD's rate
+					outX = static_x + g_sashWaveX[row * waveStride];
+					outY = static_y;
+					outZ = static_z + g_sashWaveZ[row * waveStride];
+				};
+
+			// The rest of the function now uses the helper lambda to get vertex positions
+
+			// =============== 1) BASE CLOTH (textured red) ===============
+			glColor3f(1, 1, 1);
+			glEnable(GL_TEXTURE_2D);
+			bindTexture(TEX_RED);
+			glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+			float vx1, vy1, vz1, vx2, vy2, vz2;
+			glBegin(GL_QUAD_STRIP);
+			for (int i = 0; i <= segments; ++i) {
+				float t = (float)i / segments;
+				glNormal3f(nx, ny, nz);
+
+				getWavedVertex(i, -0.5f, SURFACE_OFFSET, vx1, vy1, vz1);
+				glTexCoord2f(0.0f, t); glVertex3f(vx1, vy1, vz1);
+
+				getWavedVertex(i, 0.5f, SURFACE_OFFSET, vx2, vy2, vz2);
+				glTexCoord2f(1.0f, t); glVertex3f(vx2, vy2, vz2);
+			}
+			glEnd();
+
+			glDisable(GL_TEXTURE_2D);
+
+			// =============== 2) GOLD EDGE TRIM ===============
+			const float trim = 0.018f;
+			glColor3f(0.95f, 0.8f, 0.2f);
+
+			// Left edge strip
+			glBegin(GL_QUAD_STRIP);
+			for (int i = 0; i <= segments; ++i) {
+				float t = (float)i / segments;
+				glNormal3f(nx, ny, nz);
+				getWavedVertex(i, -0.5f, SURFACE_OFFSET + ZBIAS, vx1, vy1, vz1);
+				getWavedVertex(i, -0.5f + (trim / (base_sash_width + t * flare_factor)), SURFACE_OFFSET + ZBIAS, vx2, vy2, vz2);
+				glVertex3f(vx1, vy1, vz1);
+				glVertex3f(vx2, vy2, vz2);
+			}
+			glEnd();
+
+			// Right edge strip
+			glBegin(GL_QUAD_STRIP);
+			for (int i = 0; i <= segments; ++i) {
+				float t = (float)i / segments;
+				glNormal3f(nx, ny, nz);
+				getWavedVertex(i, 0.5f, SURFACE_OFFSET + ZBIAS, vx1, vy1, vz1);
+				getWavedVertex(i, 0.5f - (trim / (base_sash_width + t * flare_factor)), SURFACE_OFFSET + ZBIAS, vx2, vy2, vz2);
+				glVertex3f(vx1, vy1, vz1);
+				glVertex3f(vx2, vy2, vz2);
+			}
+			glEnd();
+
+			// =============== 3) & 4) Cords and Beads also need to wave ===============
+			// (We will simplify by skipping these for now, as it requires recalculating all their waved positions. 
+			// The base cloth waving is the most important effect.)
+			// If you want to add them back, you would apply getWavedVertex to their positions too.
+
+			glPopMatrix();
+		};
+
+	drawOneSash(true);   // left sash
+	drawOneSash(false);  // right sash
+}
+
+void drawCone(float base, float height, int slices, int stacks)
+{
+	// THE FIX: The points are reversed to go from the tip to the base.
+	// This makes the normal calculation in drawLathedObject work correctly for the cone.
+	float profile[2][2] = {
+		{0.0f, height}, // Tip of the cone (Top)
+		{base, 0.0f}    // Base of the cone (Bottom)
+	};
+	drawLathedObject(profile, 2, slices);
+}
+
+static void emitNeck()
+{
+	// This multi-point profile creates a fully curved shape.
+	// The Y-values have been lowered to connect with the collar (from 0.95f down to 0.88f).
+	static const float neck_profile[][2] = {
+		{0.17f, 0.88f},  // Point 1: Base connection to the collar
+		{0.14f, 0.93f},  // Point 2: Start of the inward curve
+		{0.11f, 0.98f},  // Point 3: Thinnest part of the neck
+		{0.115f, 1.03f}, // Point 4: Start of the outward curve to the head
+		{0.12f, 1.08f}   // Point 5: Top connection to the head
+	};
+	int neck_points = sizeof(neck_profile) / sizeof(neck_profile[0]);
+
+	// Use the existing lathed object function to draw the new curved neck
+	drawLathedObject(neck_profile, neck_points, 20);
+}
+
+void drawNeck()
+{
+	glColor3f(1.0f, 0.84f, 0.0f); // Golden yellow, same as body
+	drawBakedPart(PART_NECK);
+}
+
+void drawHeadDeco()
+{
+	glPushMatrix();
+	glTranslatef(0.0f, 1.20f, 0.0f);
+
+	// Halo arc (line strip)
+	glColor3f(1.0f, 0.84f, 0.0f);
+	float radius = 0.6f;
+	glBegin(GL_LINE_STRIP);
+	for (int i = 0; i <= 180; i += 5)
+	{
+		float angle = i * 3.14159f / 180.0f;
+		float x = radius * cos(angle);
+		float y = radius * sin(angle);
+		glVertex3f(x, y, 0.0f);
+	}
+	glEnd();
+
+	// Left wing
+	glPushMatrix();
+	glTranslatef(-0.6f, 0.2f, 0.0f);
+	glRotatef(20, 0, 0, 1);
+	glScalef(0.4f, 0.15f, 0.05f);
+	drawCuboid(1, 1, 0.2f);
+	glPopMatrix();
+
+	// Right wing
+	glPushMatrix();
+	glTranslatef(0.6f, 0.2f, 0.0f);
+	glRotatef(-20, 0, 0, 1);
+	glScalef(0.4f, 0.15f, 0.05f);
+	drawCuboid(1, 1, 0.2f);
+	glPopMatrix();
+
+	// Crown spike
+	glPushMatrix();
+	glTranslatef(0.0f, 0.6f, 0.0f);
+	glRotatef(-90, 1, 0, 0);
+	glColor3f(1.0f, 0.84f, 0.0f);
+	drawCone(0.4f, 1.0f, 32, 32);
+	glPopMatrix();
+
+	glPopMatrix();
+}
+
+void drawHelmetVisor()
+{
+	glPushMatrix();
+
+	// Set up shiny material for the visor
+	GLfloat mat_ambient[] = { 0.8f, 0.7f, 0.1f, 1.0f };
+	GLfloat mat_diffuse[] = { 1.0f, 0.84f, 0.0f, 1.0f };
+	GLfloat mat_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	GLfloat mat_shininess[] = { 128.0f };
+
+	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+
+	// Enable and apply the Gold texture
+	glEnable(GL_TEXTURE_2D);
+	bindTexture(TEX_GOLD);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	// --- Define the 9 vertices of the new diamond shape ---
+	float diamond_width = 1.0f;
+	float diamond_height = 0.40f;
+
+	// Pre-calculate half dimensions for clarity
+	float w = diamond_width / 2.0f;
+	float h = diamond_height / 2.0f;
+
+	// An array to hold the 9 points of the diamond's perimeter
+	GLfloat v[9][2] = {
+		{ 0.0f,      -h },         // 0: Bottom sharp point
+		{ w * 0.55f, -h * 0.4f },  // 1: Lower-mid right
+		{ w * 0.75f,      0.15f },      // 2: Widest point right
+		{ w * 0.55f,  h * 0.2f },  // 3: Upper-mid right
+		{ w * 0.2f,   h },         // 4: Top right
+		{ -w * 0.2f,  h },         // 5: Top left
+		{ -w * 0.55f, h * 0.2f },  // 6: Upper-mid left
+		{ -w * 0.75f,     0.15f },      // 7: Widest point left
+		{ -w * 0.55f, -h * 0.4f }  // 8: Lower-mid left
+	};
+
+	// --- Draw the shape as a Triangle Fan from the centre ---
+	glBegin(GL_TRIANGLE_FAN);
+	glNormal3f(0.0f, 0.0f, 1.0f); // Normal for the front face
+
+	// Center vertex of the fan (maps to the centre of the texture)
+	glTexCoord2f(0.5f, 0.5f);
+	glVertex3f(0.0f, 0.0f, 0.0f);
+
+	// Draw the 9 perimeter vertices, calculating texture coordinates for each
+	// We add the first vertex again at the end to close the shape
+	for (int i = 0; i <= 9; ++i) {
+		int index = i % 9; // Loop back to the first vertex for the last triangle
+		float vx = v[index][0];
+		float vy = v[index][1];
+
+		// Map vertex position (from -w to w, -h to h) to texture coordinate (0 to 1)
+		float u = (vx + w) / diamond_width;
+		float v_tex = (vy + h) / diamond_height;
+
+		glTexCoord2f(u, v_tex);
+		glVertex3f(vx, vy, 0.0f);
+	}
+	glEnd();
+
+	// Disable texturing after drawing the visor
+	glDisable(GL_TEXTURE_2D);
+
+	glPopMatrix();
+}
+
+void drawHalo()
+{
+	if (!g_isHaloVisible) {
+		return; // Don't draw if it's out of range
+	}
+	if (isDrawingMirrorReflection()) return; // Its blended glow would wash over the small reflection
+
+	glPushMatrix();
+
+	// MODIFIED: Changed Z-translation to -1.2f to make the gap 4 times larger.
+	glTranslatef(0.0f, 1.5f, g_haloZ);
+	glScalef(g_haloScale, g_haloScale, g_haloScale);
+	capturePickPart(PICK_HALO, -1.2f, -1.2f, -0.05f, 1.2f, 1.2f, 0.05f);
+
+	// --- 1. Draw the Gradient Gold Rings ---
+	glDisable(GL_LIGHTING);
+	glLineWidth(3.5f);
+	for (int j = 0; j < 2; j++) {
+		float radius = 1.0f + (j * 0.2f);
+		glBegin(GL_LINE_LOOP);
+		for (int i = 0; i <= HALO_RING_SEGMENTS; i += g_haloRingStep) {
+			float angle = (float)i / HALO_RING_SEGMENTS * 2.0f * 3.14159f;
+			float brightness = g_haloBrightness[i];
+			glColor3f(1.0f * brightness, 0.84f * brightness, 0.1f * brightness);
+			glVertex3f(radius * cos(angle), radius * sin(angle), 0.0f);
+		}
+		glEnd();
+	}
+	glLineWidth(1.0f);
+
+	// --- 2. Draw the Dazzling Rainbow Glow Effect ---
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	float inner_radius = 1.2f;
+	float outer_radius = 4.0f;
+
+	const float* rainbow = g_rainbowColour;
+
+	glBegin(GL_QUAD_STRIP);
+	for (int i = 0; i <= 60; i += g_haloRingStep) {
+		float angle = (float)i / 60.0f * 2.0f * 3.14159f;
+		float cos_a = cos(angle);
+		float sin_a = sin(angle);
+
+		glColor4f(rainbow[0], rainbow[1], rainbow[2], 0.35f);
+		glVertex3f(inner_radius * cos_a, inner_radius * sin_a, 0.0f);
+
+		glColor4f(rainbow[0], rainbow[1], rainbow[2], 0.0f);
+		glVertex3f(outer_radius * cos_a, outer_radius * sin_a, 0.0f);
+	}
+	glEnd();
+
+	glDisable(GL_BLEND);
+
+	glPopMatrix();
+	glEnable(GL_LIGHTING);
+}
+
+static void emitEar()
+{
+	float ear_base_radius = 0.15f;
+	float ear_height = 0.6f;
+	drawCone(ear_base_radius, ear_height, 16, 16);
+}
+
+void drawEars()
+{
+	glPushAttrib(GL_LIGHTING_BIT | GL_ENABLE_BIT);
+
+	GLfloat bright_ear_ambient[] = { 0.6f, 0.5f, 0.2f, 1.0f };
+	GLfloat bright_ear_diffuse[] = { 1.0f, 0.9f, 0.3f, 1.0f };
+	GLfloat bright_ear_specular[] = { 1.0f, 1.0f, 0.8f, 1.0f };
+	GLfloat bright_ear_shininess[] = { 100.0f };
+
+	glMaterialfv(GL_FRONT, GL_AMBIENT, bright_ear_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, bright_ear_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, bright_ear_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, bright_ear_shininess);
+
+	glEnable(GL_TEXTURE_2D);
+	bindProceduralTexture(PROC_FIRE);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	// --- Right Ear ---
+	glPushMatrix();
+	// CORRECTED POSITIONING
+	glTranslatef(0.22f, 0.02f, 0.0f);
+	glRotatef(-90.0f, 0.0f, 0.0f, 1.0f);
+	drawBakedPart(PART_EAR);
+	glPopMatrix();
+
+	// --- Left Ear ---
+	glPushMatrix();
+	// CORRECTED POSITIONING
+	glTranslatef(-0.22f, 0.02f, 0.0f);
+	glRotatef(90.0f, 0.0f, 0.0f, 1.0f);
+	drawBakedPart(PART_EAR);
+	glPopMatrix();
+
+	glDisable(GL_TEXTURE_2D);
+	glPopAttrib();
+}
+
+void drawLipShape(const float profile[][2], int num_points, float depth) {
+	meshBegin(GL_QUAD_STRIP);
+	for (int i = 0; i < num_points; ++i) {
+		float x = profile[i][0];
+		float y = profile[i][1];
+
+		// Calculate a simple normal pointing outwards from the curve
+		if (i < num_points - 1) {
+			float next_x = profile[i + 1][0];
+			float next_y = profile[i + 1][1];
+			float dx = next_x - x;
+			float dy = next_y - y;
+			// The normal is perpendicular to the line segment, pointing slightly forward
+			meshNormal(dy, -dx, 0.5f);
+		}
+
+		// Front vertex
+		meshVertex(x, y, depth / 2.0f);
+		// Back vertex
+		meshVertex(x, y, -depth / 2.0f);
+	}
+	meshEnd();
+
+	// Draw the front face of the lips
+	meshBegin(GL_POLYGON);
+	meshNormal(0.0f, 0.0f, 1.0f);
+	for (int i = 0; i < num_points; ++i) {
+		meshVertex(profile[i][0], profile[i][1], depth / 2.0f);
+	}
+	meshEnd();
+}
+
+static void emitLips()
+{
+	// --- CHANGE: Adjusted the Y-coordinates to close the gap ---
+
+	// Define the 2D profile for the upper lip (moved down)
+	static const float upper_lip_profile[][2] = {
+		{-0.08f, 0.005f}, // Was 0.015f
+		{-0.05f, 0.025f}, // Was 0.035f
+		{ 0.00f, 0.015f}, // Was 0.025f
+		{ 0.05f, 0.025f}, // Was 0.035f
+		{ 0.08f, 0.005f}  // Was 0.015f
+	};
+
+	// Define the 2D profile for the lower lip (moved up)
+	static const float lower_lip_profile[][2] = {
+		{-0.07f, -0.005f}, // Was -0.010f
+		{-0.04f, -0.025f}, // Was -0.030f
+		{ 0.00f, -0.030f}, // Was -0.035f
+		{ 0.04f, -0.025f}, // Was -0.030f
+		{ 0.07f, -0.005f}  // Was -0.010f
+	};
+
+	float lip_depth = 0.04f;
+	drawLipShape(upper_lip_profile, sizeof(upper_lip_profile) / sizeof(upper_lip_profile[0]), lip_depth);
+	drawLipShape(lower_lip_profile, sizeof(lower_lip_profile) / sizeof(lower_lip_profile[0]), lip_depth);
+}
+
+void drawLips()
+{
+	// Material properties for the lips
+	GLfloat mat_ambient[] = { 0.5f, 0.05f, 0.05f, 1.0f };
+	GLfloat mat_diffuse[] = { 0.8f, 0.1f, 0.15f, 1.0f };
+	GLfloat mat_specular[] = { 0.2f, 0.1f, 0.1f, 1.0f };
+	GLfloat mat_shininess[] = { 20.0f };
+
+	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+
+	// The colour is set by the material's diffuse property
+	glColor3f(0.8f, 0.1f, 0.15f);
+
+	drawBakedPart(PART_LIPS);
+}
+
+static void emitHead()
+{
+	int latitudes = scaledDetail(15, 6);
+	int longitudes = scaledDetail(20, 8);
+
+	// --- STEP 1: MAKE THE HEAD TALLER ---
+	// By increasing head_height, you stretch the head vertically, creating a chin.
+	float head_height = 0.6f; // <<< CHANGED from 0.5f to 0.6f
+	float head_max_radius = 0.28f;
+	float head_base_radius = 0.10f;
+
+	for (int i = 0; i <= latitudes; ++i) {
+		float lat0 = 3.14159f * (-0.5f + (float)(i - 1) / latitudes);
+		float lat1 = 3.14159f * (-0.5f + (float)i / latitudes);
+		float y0 = sin(lat0) * head_height / 2.0f;
+		float y1 = sin(lat1) * head_height / 2.0f;
+		float r0 = cos(lat0) * head_max_radius;
+		float r1 = cos(lat1) * head_max_radius;
+		if (i == 0) r0 = head_base_radius;
+		if (i == 1) r0 = head_base_radius;
+		meshBegin(GL_QUAD_STRIP);
+		for (int j = 0; j <= longitudes; ++j) {
+			float lng = 2.0f * 3.14159f * (float)j / longitudes;
+			float x = cos(lng);
+			float z = sin(lng);
+			float nx0 = cos(lat0) * x, ny0 = sin(lat0), nz0 = cos(lat0) * z;
+			meshNormal(nx0, ny0, nz0);
+			meshVertex(r0 * x, y0, r0 * z);
+			float nx1 = cos(lat1) * x, ny1 = sin(lat1), nz1 = cos(lat1) * z;
+			meshNormal(nx1, ny1, nz1);
+			meshVertex(r1 * x, y1, r1 * z);
+		}
+		meshEnd();
+	}
+}
+
+void drawFace()
+{
+	// Define the golden material properties that the head SHOULD have
+	GLfloat head_mat_ambient[] = { 0.55f, 0.38f, 0.1f, 1.0f };
+	GLfloat head_mat_diffuse[] = { 1.0f, 0.84f, 0.0f, 1.0f };
+	GLfloat head_mat_specular[] = { 1.0f, 1.0f, 0.8f, 1.0f };
+	GLfloat head_mat_shininess[] = { 128.0f };
+
+	// --- Start of Head Group ---
+	glPushMatrix();
+	glTranslatef(0.0f, 1.18f, 0.0f);
+	capturePickPart(PICK_HEAD, -0.35f, -0.15f, -0.35f, 0.35f, 0.6f, 0.4f);
+
+	// 1. Draw Visor (uses its own gold material)
+	glMaterialfv(GL_FRONT, GL_AMBIENT, head_mat_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, head_mat_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, head_mat_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, head_mat_shininess);
+
+	glPushMatrix();
+	glTranslatef(0.0f, 0.20f, 0.28f);
+	drawHelmetVisor();
+	glPopMatrix();
+
+	// 2. Draw Lips (uses red material)
+	glPushAttrib(GL_LIGHTING_BIT);
+	glPushMatrix();
+
+	// --- STEP 2: LOWER THE LIPS ONTO THE NEW CHIN ---
+	// Now that the head is taller, you can use a negative Y value to place the lips lower.
+	// You can adjust this value to get the exact position you want.
+	glTranslatef(0.0f, -0.1f, 0.28f); // Changed Y from 0.00001f to -0.1f
+
+	drawLips();
+	glPopMatrix();
+	glPopAttrib();
+
+
+	// Re-apply the golden material to be safe
+	glMaterialfv(GL_FRONT, GL_AMBIENT, head_mat_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, head_mat_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, head_mat_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, head_mat_shininess);
+	glColor3f(1.0f, 1.0f, 1.0f);
+
+
+	// 3. Draw Main Head Shape
+	drawBakedPart(PART_HEAD);
+
+	// 4. Draw Ears
+	drawEars();
+
+	glPopMatrix(); // End of the entire head group
+}
+
+GLUquadric* g_braidQuadric = nullptr; // Created on first use and kept, rather than one per frame
+
+void drawBraid(float yOffset, float zOffset)
+{
+	if (!g_braidQuadric) {
+		g_braidQuadric = gluNewQuadric();
+		gluQuadricNormals(g_braidQuadric, GLU_SMOOTH);
+	}
+	GLUquadric* quad = g_braidQuadric;
+
+	// --- 2. DYNAMIC COLOUR CHANGE ---
+	// This logic is copied from drawHalo to sync the colours.
+	// It calculates a new colour each frame based on the global rainbow offset.
+	const float* rainbow = g_rainbowColour;
+
+	// Set the calculated rainbow colour for the braid.
+	// This works because GL_COLOR_MATERIAL is enabled in your display function.
+	glColor3f(rainbow[0], rainbow[1], rainbow[2]);
+
+	glPushMatrix();
+
+	// Position the braid's origin on the head
+	glTranslatef(0.0f, yOffset, zOffset);
+	glRotatef(180.0f, 0.0f, 1.0f, 0.0f); // Rotate to face the back
+
+	// --- 1. STRONGER CURVE ---
+	// The max angle is increased to make the braid bend more sharply.
+	const int CURVE_SEGMENTS = 5;
+	const float MAX_CURVE_ANGLE = 28.0f; // Increased from 20.0f
+
+	for (int i = 0; i < g_numBraidSegments; ++i)
+	{
+		glPushMatrix();
+
+		float swayAmplitude = 0.0f;
+		if (i >= CURVE_SEGMENTS) {
+			swayAmplitude = ((float)i - (CURVE_SEGMENTS - 1)) * 4.0f * g_windStrength;
+		}
+		float swayAngleY = g_braidSway[i * 2] * swayAmplitude;
+		float swayAngleX = g_braidSway[i * 2 + 1] * swayAmplitude;
+
+		glRotatef(swayAngleY, 0.0f, 1.0f, 0.0f);
+		glRotatef(swayAngleX, 1.0f, 0.0f, 0.0f);
+
+		const float segmentRadius = 0.1f;
+		gluCylinder(quad, segmentRadius, segmentRadius, g_braidSegmentLength, 20, 1);
+		gluDisk(quad, 0, segmentRadius, 20, 1);
+		glPushMatrix();
+		glTranslatef(0.0f, 0.0f, g_braidSegmentLength);
+		gluDisk(quad, 0, segmentRadius, 20, 1);
+		glPopMatrix();
+
+		glPopMatrix();
+
+		if (i < CURVE_SEGMENTS)
+		{
+			float curveFactor = 1.0f - ((float)i / CURVE_SEGMENTS);
+			glRotatef(MAX_CURVE_ANGLE * curveFactor, 1.0f, 0.0f, 0.0f);
+		}
+
+		glTranslatef(0.0f, 0.0f, g_braidSegmentLength + BRAID_SEGMENT_GAP);
+	}
+
+	glPopMatrix();
+}
+
+void drawLegs()
+{
+	// --- Material Properties for Golden Armour (for ALL leg parts) ---
+	GLfloat mat_ambient[] = { 0.45f, 0.38f, 0.1f, 1.0f };
+	GLfloat mat_diffuse[] = { 1.0f, 0.84f, 0.0f, 1.0f };
+	GLfloat mat_specular[] = { 1.0f, 1.0f, 0.8f, 1.0f };
+	GLfloat mat_shininess[] = { 100.0f };
+
+	// Apply the material properties for ALL leg parts
+	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
+	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
+	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
+	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+
+	glColor3f(1.0f, 0.84f, 0.0f);
+
+	// Lambda to draw a single leg, now with animation parameters
+	auto drawOneLeg = [](float hipAngle, float kneeAngle) {
+		glPushMatrix(); // Save the state at the hip joint
+
+		// --- ANIMATION: Apply rotation at the hip ---
+		glRotatef(hipAngle, 1.0f, 0.0f, 0.0f);
+
+		// --- Part 1: Upper Leg (Thigh) ---
+		float thigh_height = 0.8f;
+		glPushMatrix();
+		glTranslatef(0.0f, -thigh_height / 2.0f, 0.0f);
+		{
+			float v[8][3] = {
+				{-0.15f,  thigh_height / 2.0f,  0.12f}, { 0.15f,  thigh_height / 2.0f,  0.12f},
+				{ 0.15f,  thigh_height / 2.0f, -0.12f}, {-0.15f,  thigh_height / 2.0f, -0.12f},
+				{-0.10f, -thigh_height / 2.0f,  0.10f}, { 0.10f, -thigh_height / 2.0f,  0.10f},
+				{ 0.10f, -thigh_height / 2.0f, -0.10f}, {-0.10f, -thigh_height / 2.0f, -0.10f}
+			};
+			glBegin(GL_QUADS);
+			glNormal3f(0.0, 0.0, 1.0); glVertex3fv(v[0]); glVertex3fv(v[1]); glVertex3fv(v[5]); glVertex3fv(v[4]);
+			glNormal3f(0.0, 0.0, -1.0); glVertex3fv(v[3]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[7]);
+			glNormal3f(-1.0, 0.0, 0.0); glVertex3fv(v[0]); glVertex3fv(v[3]); glVertex3fv(v[7]); glVertex3fv(v[4]);
+			glNormal3f(1.0, 0.0, 0.0); glVertex3fv(v[1]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[5]);
+			glEnd();
+		}
+		glPopMatrix();
+
+		// --- Position for the Knee Joint ---
+		glTranslatef(0.0f, -thigh_height, 0.0f);
+
+		// --- ANIMATION: Apply rotation at the knee ---
+		glRotatef(kneeAngle, 1.0f, 0.0f, 0.0f);
+
+		// --- Draw the Diamond Knee Joint ---
+		drawDiamondKneeJoint();
+
+		// --- Part 2: Lower Leg (Shin) ---
+		glTranslatef(0.0f, -0.22f, 0.0f);
+		float shin_height = 0.7f;
+		glPushMatrix();
+		glTranslatef(0.0f, -shin_height / 2.0f, 0.0f);
+		{
+			float v[8][3] = {
+				{-0.10f,  shin_height / 2.0f,  0.10f}, { 0.10f,  shin_height / 2.0f,  0.10f},
+				{ 0.10f,  shin_height / 2.0f, -0.10f}, {-0.10f,  shin_height / 2.0f, -0.10f},
+				{-0.14f, -shin_height / 2.0f,  0.14f}, { 0.14f, -shin_height / 2.0f,  0.14f},
+				{ 0.14f, -shin_height / 2.0f, -0.14f}, {-0.14f, -shin_height / 2.0f, -0.14f}
+			};
+			glBegin(GL_QUADS);
+			glNormal3f(0.0, 0.0, 1.0); glVertex3fv(v[0]); glVertex3fv(v[1]); glVertex3fv(v[5]); glVertex3fv(v[4]);
+			glNormal3f(0.0, 0.0, -1.0); glVertex3fv(v[3]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[7]);
+			glNormal3f(-1.0, 0.0, 0.0); glVertex3fv(v[0]); glVertex3fv(v[3]); glVertex3fv(v[7]); glVertex3fv(v[4]);
+			glNormal3f(1.0, 0.0, 0.0); glVertex3fv(v[1]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[5]);
+			glEnd();
+		}
+		glPopMatrix();
+
+		// --- Part 3: Foot ---
+		glTranslatef(0.0f, -shin_height, 0.0f);
+		glRotatef(5.0f, 1.0f, 0.0f, 0.0f); // Static rotation for foot angle
+		glPushMatrix();
+		{
+			glEnable(GL_TEXTURE_2D);
+			bindTexture(TEX_SHOE);
+			glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+			float v[10][3] = {
+				{-0.12f, 0.0f,    0.14f}, {0.12f, 0.0f,    0.14f},
+				{0.12f, 0.0f, -0.25f}, {-0.12f, 0.0f, -0.25f},
+				{-0.12f, -0.15f,  0.14f}, {0.12f, -0.15f,  0.14f},
+				{0.12f, -0.15f, -0.25f}, {-0.12f, -0.15f, -0.25f},
+				{0.0f, -0.15f, 0.4f},
+				{0.0f, -0.15f, -0.4f}
+			};
+
+			glBegin(GL_QUADS);
+			// Top face
+			glNormal3f(0.0, 1.0, 0.0);
+			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[0]);
+			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[1]);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[2]);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[3]);
+			// Bottom face
+			glNormal3f(0.0, -1.0, 0.0);
+			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[4]);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[7]);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[6]);
+			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[5]);
+			// Back face
+			glNormal3f(0.0, 0.0, -1.0);
+			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[3]);
+			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[2]);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[6]);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[7]);
+			// Left face
+			glNormal3f(-1.0, 0.0, 0.0);
+			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[0]);
+			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[3]);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[7]);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[4]);
+			// Right face
+			glNormal3f(1.0, 0.0, 0.0);
+			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[1]);
+			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[2]);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[6]);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[5]);
+			glEnd();
+			glBegin(GL_TRIANGLES);
+			// Front face
+			glNormal3f(0.0, 0.0, 1.0);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[0]);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[1]);
+			glTexCoord2f(0.5f, 1.0f); glVertex3f(0.0, 0.0, 0.25);
+			// Side triangles front
+			glNormal3f(0.7, -0.3, 0.7);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[1]);
+			glTexCoord2f(1.0f, 0.5f); glVertex3fv(v[8]);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[5]);
+			glNormal3f(-0.7, -0.3, 0.7);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[0]);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[4]);
+			glTexCoord2f(0.0f, 0.5f); glVertex3fv(v[8]);
+			// Side triangles back
+			glNormal3f(0.7, -0.3, -0.7);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[2]);
+			glTexCoord2f(1.0f, 0.5f); glVertex3fv(v[6]);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[9]);
+			glNormal3f(-0.7, -0.3, -0.7);
+			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[3]);
+			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[9]);
+			glTexCoord2f(0.0f, 0.5f); glVertex3fv(v[7]);
+			glEnd();
+			glDisable(GL_TEXTURE_2D);
+		}
+		glPopMatrix();
+		glPopMatrix();
+		};
+
+	// --- Animation Calculation ---
+	float rightHipAngle = 0.0f;
+	float rightKneeAngle = 0.0f;
+	float leftHipAngle = 0.0f;
+	float leftKneeAngle = 0.0f;
+
+	// Determine the direction the legs should swing for the animation
+	float swingDirection = (float)g_forwardDirection;
+	if (g_forwardDirection == 0 && g_strafeDirection != 0) {
+		swingDirection = 1.0f; // Default to a forward swing animation when strafing
+	}
+
+	if (swingDirection != 0.0f || (g_strafeDirection != 0 && g_forwardDirection == 0)) {
+		float animationDriver = (swingDirection != 0.0f) ? swingDirection : 1.0f;
+
+		WalkSample walk;
+		sampleWalkCycle(g_animationTime * WALK_SPEED, animationDriver, walk);
+		rightHipAngle = walk.rightHip;
+		rightKneeAngle = walk.rightKnee;
+		leftHipAngle = walk.leftHip;
+		leftKneeAngle = walk.leftKnee;
+	}
+
+	// --- Draw Left Leg ---
+	glPushMatrix();
+	glTranslatef(-0.18f, -1.0f, 0.0f);
+	drawOneLeg(leftHipAngle, leftKneeAngle);
+	glPopMatrix();
+
+	// --- Draw Right Leg ---
+	glPushMatrix();
+	glTranslatef(0.18f, -1.0f, 0.0f);
+	drawOneLeg(rightHipAngle, rightKneeAngle);
+	glPopMatrix();
+}
+
+// --- Mesh Baker: "NuwaCharacter.exe --bake-meshes" ---
+static void emitUnitBox() { box6(1.0f, 1.0f, 1.0f); }
+
+// Indexed by BakedPartId
+static void (*const BAKED_PART_GENERATORS[BAKED_PART_COUNT])() = {
+	emitUnitBox,
+	emitChest,
+	emitLowerBody,
+	emitNeck,
+	emitLowerCollar,
+	emitUpperCollar,
+	emitUpperArm,
+	emitLowerArm,
+	emitStaffShaft,
+	emitStaffHolder,
+	emitStaffPommel,
+	emitEar,
+	emitKneeDiamond,
+	emitHead,
+	emitLips,
+	emitPalm,
+};
+
+void emitBakedPart(BakedPartId part)
+{
+	BAKED_PART_GENERATORS[part]();
+}
+
+// Indexed by BakedPartId, for the bake report
+static const char* BAKED_PART_NAMES[BAKED_PART_COUNT] = {
+	"box", "chest", "lower body", "neck", "lower collar", "upper collar", "upper arm", "lower arm",
+	"staff shaft", "staff holder", "staff pommel", "ear", "knee diamond", "head", "lips", "palm",
+};
+
+// --- Mesh Optimisation ---
+// Welded parts are reordered for the post-transform vertex cache (Forsyth's
+// greedy scoring), then clusters of that order are sorted to cut overdraw
+// (Sander et al.). Parts made only of strips, i.e. the lathed bands, stay
+// strips: their bands are sorted the same way and joined into one strip with
+// primitive restart. ACMR (cache misses per triangle) is reported for a FIFO
+// cache, the kind older hardware has.
+static const int VERTEX_CACHE_SIZE = 16;        // FIFO cache used to report ACMR
+static const int FORSYTH_CACHE_SIZE = 32;       // LRU cache the ordering scores against
+static const int OVERDRAW_MIN_CLUSTER = 8;      // Triangles before a cold cache may start a new cluster
+static const float OVERDRAW_ACMR_SLACK = 1.05f; // How much ACMR the overdraw order may give back
+
+// Merges corners with identical position, normal and texcoord. Vertices are
+// numbered in order of first use, so the list keeps the generator's order.
+static void weldCorners(const std::vector<BakedVertex>& corners, std::vector<BakedVertex>& vertices, std::vector<unsigned int>& indices)
+{
+	int count = (int)corners.size();
+	std::vector<int> order(count);
+	for (int i = 0; i < count; ++i) order[i] = i;
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		int c = memcmp(&corners[a], &corners[b], sizeof(BakedVertex));
+		return c < 0 || (c == 0 && a < b);
+		});
+
+	// Each corner points at the first corner with the same data
+	std::vector<int> canonical(count);
+	for (int i = 0; i < count; ++i) {
+		bool same = i > 0 && memcmp(&corners[order[i]], &corners[order[i - 1]], sizeof(BakedVertex)) == 0;
+		canonical[order[i]] = same ? canonical[order[i - 1]] : order[i];
+	}
+
+	std::vector<int> remap(count, -1);
+	vertices.clear();
+	indices.clear();
+	for (int i = 0; i < count; ++i) {
+		int c = canonical[i];
+		if (remap[c] < 0) {
+			remap[c] = (int)vertices.size();
+			vertices.push_back(corners[c]);
+		}
+		indices.push_back((unsigned int)remap[c]);
+	}
+}
+
+// Average FIFO cache misses per triangle. Strip streams count a triangle per
+// index after the first two of each band.
+static float measureACMR(const std::vector<unsigned int>& indices, bool strip)
+{
+	unsigned int cache[VERTEX_CACHE_SIZE];
+	int cached = 0, next = 0, misses = 0, triangles = 0, run = 0;
+	for (unsigned int index : indices) {
+		if (strip) {
+			if (index == MESH_RESTART_INDEX) { run = 0; continue; }
+			if (++run >= 3) ++triangles;
+		}
+		bool hit = false;
+		for (int i = 0; i < cached && !hit; ++i) hit = cache[i] == index;
+		if (!hit) {
+			++misses;
+			cache[next] = index;
+			next = (next + 1) % VERTEX_CACHE_SIZE;
+			if (cached < VERTEX_CACHE_SIZE) ++cached;
+		}
+	}
+	if (!strip) triangles = (int)indices.size() / 3;
+	return triangles > 0 ? (float)misses / (float)triangles : 0.0f;
+}
 
-				getWavedVertex(t, -0.5f, SURFACE_OFFSET, vx1, vy1, vz1);
-				glTexCoord2f(0.0f, t); glVertex3f(vx1, vy1, vz1);
+// Triangles that reuse a vertex draw nothing, and would confuse the cache scoring
+static void dropDegenerateTriangles(std::vector<unsigned int>& indices)
+{
+	size_t kept = 0;
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		unsigned int a = indices[t], b = indices[t + 1], c = indices[t + 2];
+		if (a == b || b == c || a == c) continue;
+		indices[kept++] = a;
+		indices[kept++] = b;
+		indices[kept++] = c;
+	}
+	indices.resize(kept);
+}
 
-				getWavedVertex(t, 0.5f, SURFACE_OFFSET, vx2, vy2, vz2);
-				glTexCoord2f(1.0f, t); glVertex3f(vx2, vy2, vz2);
-			}
-			glEnd();
+static float forsythVertexScore(int cachePosition, int remaining)
+{
+	if (remaining == 0) return -1.0f;
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		// The last triangle's own vertices get a fixed score so the order doesn't just fan around one vertex
+		if (cachePosition < 3) score = 0.75f;
+		else score = powf(1.0f - (float)(cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+	return score + 2.0f / sqrtf((float)remaining); // Favour finishing off vertices with few triangles left
+}
 
-			glDisable(GL_TEXTURE_2D);
+// Greedily emits the triangle whose vertices score best against a simulated
+// LRU cache. Only triangles touching cached vertices are considered, except
+// when none are left and the search falls back to every remaining triangle.
+static void optimizeVertexCache(std::vector<unsigned int>& indices, int vertexCount)
+{
+	int triangleCount = (int)indices.size() / 3;
+
+	// Live triangles of each vertex, packed: vertexTriangles[firstTriangle[v] .. + remaining[v])
+	std::vector<int> remaining(vertexCount, 0), firstTriangle(vertexCount + 1, 0);
+	for (unsigned int index : indices) ++remaining[index];
+	for (int v = 0; v < vertexCount; ++v) firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+	std::vector<int> vertexTriangles(indices.size());
+	std::vector<int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (int t = 0; t < triangleCount; ++t) {
+		for (int k = 0; k < 3; ++k) vertexTriangles[fill[indices[t * 3 + k]]++] = t;
+	}
 
-			// =============== 2) GOLD EDGE TRIM ===============
-			const float trim = 0.018f;
-			glColor3f(0.95f, 0.8f, 0.2f);
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount), triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	for (int v = 0; v < vertexCount; ++v) vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+	for (int t = 0; t < triangleCount; ++t) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
 
-			// Left edge strip
-			glBegin(GL_QUAD_STRIP);
-			for (int i = 0; i <= segments; ++i) {
-				float t = (float)i / segments;
-				glNormal3f(nx, ny, nz);
-				getWavedVertex(t, -0.5f, SURFACE_OFFSET + ZBIAS, vx1, vy1, vz1);
-				getWavedVertex(t, -0.5f + (trim / (base_sash_width + t * flare_factor)), SURFACE_OFFSET + ZBIAS, vx2, vy2, vz2);
-				glVertex3f(vx1, vy1, vz1);
-				glVertex3f(vx2, vy2, vz2);
+	std::vector<unsigned int> ordered;
+	ordered.reserve(indices.size());
+	int cache[FORSYTH_CACHE_SIZE + 3];
+	int cached = 0;
+	int best = -1;
+	for (int n = 0; n < triangleCount; ++n) {
+		if (best < 0) {
+			float bestScore = -FLT_MAX;
+			for (int t = 0; t < triangleCount; ++t) {
+				if (!emitted[t] && triangleScore[t] > bestScore) { bestScore = triangleScore[t]; best = t; }
 			}
-			glEnd();
-
-			// Right edge strip
-			glBegin(GL_QUAD_STRIP);
-			for (int i = 0; i <= segments; ++i) {
-				float t = (float)i / segments;
-				glNormal3f(nx, ny, nz);
-				getWavedVertex(t, 0.5f, SURFACE_OFFSET + ZBIAS, vx1, vy1, vz1);
-				getWavedVertex(t, 0.5f - (trim / (base_sash_width + t * flare_factor)), SURFACE_OFFSET + ZBIAS, vx2, vy2, vz2);
-				glVertex3f(vx1, vy1, vz1);
-				glVertex3f(vx2, vy2, vz2);
+		}
+		emitted[best] = 1;
+
+		// Emit it, retire it from its vertices' live lists and move them to the front of the cache
+		int newCache[FORSYTH_CACHE_SIZE + 3];
+		int newCount = 0;
+		for (int k = 0; k < 3; ++k) {
+			int v = (int)indices[best * 3 + k];
+			ordered.push_back((unsigned int)v);
+			int* live = &vertexTriangles[firstTriangle[v]];
+			for (int i = 0; i < remaining[v]; ++i) {
+				if (live[i] == best) { live[i] = live[remaining[v] - 1]; break; }
 			}
-			glEnd();
+			--remaining[v];
+			newCache[newCount++] = v;
+		}
+		for (int i = 0; i < cached; ++i) {
+			int v = cache[i];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2]) newCache[newCount++] = v;
+		}
 
-			// =============== 3) & 4) Cords and Beads also need to wave ===============
-			// (We will simplify by skipping these for now, as it requires recalculating all their waved positions. 
-			// The base cloth waving is the most important effect.)
-			// If you want to add them back, you would apply getWavedVertex to their positions too.
+		// Rescore what is still cached, let anything pushed out fall back to its uncached score
+		for (int i = 0; i < newCount; ++i) {
+			int v = newCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+			vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+		}
+		cached = min(newCount, FORSYTH_CACHE_SIZE);
+		for (int i = 0; i < cached; ++i) cache[i] = newCache[i];
+
+		best = -1;
+		float bestScore = -FLT_MAX;
+		for (int i = 0; i < newCount; ++i) {
+			int v = newCache[i];
+			for (int j = 0; j < remaining[v]; ++j) {
+				int t = vertexTriangles[firstTriangle[v] + j];
+				float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = score;
+				if (i < cached && score > bestScore) { bestScore = score; best = t; }
+			}
+		}
+	}
+	indices.swap(ordered);
+}
 
-			glPopMatrix();
-		};
+// Area-weighted normal and centroid of a run of list triangles
+static void measureCluster(const std::vector<unsigned int>& indices, const std::vector<BakedVertex>& vertices,
+	int firstTriangle, int triangleCount, float normal[3], float centroid[3], float& area)
+{
+	normal[0] = normal[1] = normal[2] = 0.0f;
+	centroid[0] = centroid[1] = centroid[2] = 0.0f;
+	area = 0.0f;
+	for (int t = firstTriangle; t < firstTriangle + triangleCount; ++t) {
+		const float* a = vertices[indices[t * 3]].position;
+		const float* b = vertices[indices[t * 3 + 1]].position;
+		const float* c = vertices[indices[t * 3 + 2]].position;
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float twiceArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		for (int k = 0; k < 3; ++k) {
+			normal[k] += n[k];
+			centroid[k] += (a[k] + b[k] + c[k]) * twiceArea;
+		}
+		area += twiceArea;
+	}
+	if (area > 0.0f) {
+		for (int k = 0; k < 3; ++k) centroid[k] /= 3.0f * area;
+	}
+	float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	if (length > 0.0f) {
+		for (int k = 0; k < 3; ++k) normal[k] /= length;
+	}
+}
 
-	drawOneSash(true);   // left sash
-	drawOneSash(false);  // right sash
+struct TriangleCluster {
+	int firstTriangle, triangleCount;
+	float occlusion; // How far the cluster faces out from the part's centre
+};
 
-	gluDeleteQuadric(quad);
+// Clusters facing away from the centre are drawn first, since they are the
+// ones that hide the rest of the part when it is seen from that side
+static void sortClustersForOverdraw(std::vector<TriangleCluster>& clusters, const std::vector<unsigned int>& indices, const std::vector<BakedVertex>& vertices)
+{
+	float normal[3], centre[3], area;
+	measureCluster(indices, vertices, 0, (int)indices.size() / 3, normal, centre, area);
+	for (TriangleCluster& cluster : clusters) {
+		float centroid[3];
+		measureCluster(indices, vertices, cluster.firstTriangle, cluster.triangleCount, normal, centroid, area);
+		cluster.occlusion = (centroid[0] - centre[0]) * normal[0] + (centroid[1] - centre[1]) * normal[1] + (centroid[2] - centre[2]) * normal[2];
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster& a, const TriangleCluster& b) {
+		return a.occlusion > b.occlusion;
+		});
 }
 
-void drawCone(float base, float height, int slices, int stacks)
+// Splits the cache-ordered list where the cache has gone cold (a triangle
+// with no cached vertex), sorts the clusters, and keeps the result unless it
+// costs more than OVERDRAW_ACMR_SLACK of the vertex reuse
+static void orderForOverdraw(std::vector<unsigned int>& indices, const std::vector<BakedVertex>& vertices)
 {
-	// THE FIX: The points are reversed to go from the tip to the base.
-	// This makes the normal calculation in drawLathedObject work correctly for the cone.
-	float profile[2][2] = {
-		{0.0f, height}, // Tip of the cone (Top)
-		{base, 0.0f}    // Base of the cone (Bottom)
-	};
-	drawLathedObject(profile, 2, slices);
+	int triangleCount = (int)indices.size() / 3;
+	std::vector<TriangleCluster> clusters;
+	unsigned int cache[VERTEX_CACHE_SIZE];
+	int cached = 0, next = 0;
+	for (int t = 0; t < triangleCount; ++t) {
+		int misses = 0;
+		for (int k = 0; k < 3; ++k) {
+			unsigned int index = indices[t * 3 + k];
+			bool hit = false;
+			for (int i = 0; i < cached && !hit; ++i) hit = cache[i] == index;
+			if (!hit) {
+				++misses;
+				cache[next] = index;
+				next = (next + 1) % VERTEX_CACHE_SIZE;
+				if (cached < VERTEX_CACHE_SIZE) ++cached;
+			}
+		}
+		if (clusters.empty() || (misses == 3 && clusters.back().triangleCount >= OVERDRAW_MIN_CLUSTER)) {
+			clusters.push_back({ t, 0, 0.0f });
+		}
+		++clusters.back().triangleCount;
+	}
+	if (clusters.size() < 2) return;
+
+	sortClustersForOverdraw(clusters, indices, vertices);
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	for (const TriangleCluster& cluster : clusters) {
+		sorted.insert(sorted.end(), indices.begin() + cluster.firstTriangle * 3, indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+	}
+	if (measureACMR(sorted, false) <= measureACMR(indices, false) * OVERDRAW_ACMR_SLACK) indices.swap(sorted);
 }
 
-void drawNeck()
+// Rebuilds each captured strip from its triangles (the first triangle, then
+// the newest corner of each one after it), sorts the bands for overdraw and
+// joins them with restart indices
+static void buildBandStrip(const std::vector<CapturedStrip>& strips, const std::vector<BakedVertex>& vertices, std::vector<unsigned int>& indices)
 {
-	glColor3f(1.0f, 0.84f, 0.0f); // Golden yellow, same as body
+	std::vector<TriangleCluster> bands;
+	for (const CapturedStrip& strip : strips) bands.push_back({ strip.firstTriangle, strip.triangleCount, 0.0f });
+	sortClustersForOverdraw(bands, indices, vertices);
+
+	std::vector<unsigned int> stream;
+	for (const TriangleCluster& band : bands) {
+		if (!stream.empty()) stream.push_back(MESH_RESTART_INDEX);
+		const unsigned int* first = &indices[band.firstTriangle * 3];
+		stream.insert(stream.end(), first, first + 3);
+		for (int t = 1; t < band.triangleCount; ++t) stream.push_back(first[t * 3 + 2]);
+	}
+	indices.swap(stream);
+}
 
-	// This multi-point profile creates a fully curved shape.
-	// The Y-values have been lowered to connect with the collar (from 0.95f down to 0.88f).
-	float neck_profile[][2] = {
-		{0.17f, 0.88f},  // Point 1: Base connection to the collar
-		{0.14f, 0.93f},  // Point 2: Start of the inward curve
-		{0.11f, 0.98f},  // Point 3: Thinnest part of the neck
-		{0.115f, 1.03f}, // Point 4: Start of the outward curve to the head
-		{0.12f, 1.08f}   // Point 5: Top connection to the head
-	};
-	int neck_points = sizeof(neck_profile) / sizeof(neck_profile[0]);
+// Appends an optimised part, renumbering its vertices in order of first use
+// so the draw reads the vertex buffer front to back
+static void appendBakedPart(const std::vector<BakedVertex>& partVertices, const std::vector<unsigned int>& partIndices, unsigned int flags,
+	std::vector<BakedVertex>& vertices, std::vector<unsigned int>& indices, MeshPartRecord& record)
+{
+	record.firstIndex = (unsigned int)indices.size();
+	record.indexCount = (unsigned int)partIndices.size();
+	record.firstVertex = (unsigned int)vertices.size();
+	record.flags = flags;
+	for (int k = 0; k < 3; ++k) {
+		record.boundsMin[k] = FLT_MAX;
+		record.boundsMax[k] = -FLT_MAX;
+	}
 
-	// Use the existing lathed object function to draw the new curved neck
-	drawLathedObject(neck_profile, neck_points, 20);
+	std::vector<int> remap(partVertices.size(), -1);
+	for (unsigned int index : partIndices) {
+		if (index == MESH_RESTART_INDEX && (flags & MESH_PART_STRIP)) {
+			indices.push_back(MESH_RESTART_INDEX);
+			continue;
+		}
+		if (remap[index] < 0) {
+			remap[index] = (int)vertices.size();
+			vertices.push_back(partVertices[index]);
+			for (int k = 0; k < 3; ++k) {
+				record.boundsMin[k] = min(record.boundsMin[k], partVertices[index].position[k]);
+				record.boundsMax[k] = max(record.boundsMax[k], partVertices[index].position[k]);
+			}
+		}
+		indices.push_back((unsigned int)remap[index]);
+	}
+	record.vertexCount = (unsigned int)vertices.size() - record.firstVertex;
 }
 
-void drawHeadDeco()
+// Runs every generator once per detail level and writes the file loadBakedMeshes() maps
+bool bakeMeshes(const char* path)
 {
-	glPushMatrix();
-	glTranslatef(0.0f, 1.20f, 0.0f);
+	MeshCapture capture;
+	std::vector<BakedVertex> vertices, partVertices, previousTriangles;
+	std::vector<unsigned int> indices, partIndices;
+	MeshPartRecord parts[MESH_RECORD_COUNT];
+	size_t cornerCount = 0;
+
+	benchLog("Mesh bake (ACMR for a %d-entry FIFO cache, generator order -> optimised):\n", VERTEX_CACHE_SIZE);
+	g_meshCapture = &capture;
+	for (int record = 0; record < MESH_RECORD_COUNT; ++record) {
+		int part = record / MESH_LOD_COUNT, lod = record % MESH_LOD_COUNT;
+		capture.triangles.clear();
+		capture.strips.clear();
+		capture.current = BakedVertex{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } }; // GL's initial state
+		capture.hasTexCoords = false;
+		capture.onlyStrips = true;
+		capture.detailPercent = MESH_LOD_PERCENT[lod];
+		emitBakedPart((BakedPartId)part);
+
+		// Parts without a detail setting (boxes, the diamond, lips, palm) share one range
+		if (lod > 0 && capture.triangles.size() == previousTriangles.size() &&
+			memcmp(capture.triangles.data(), previousTriangles.data(), previousTriangles.size() * sizeof(BakedVertex)) == 0) {
+			parts[record] = parts[record - 1];
+			continue;
+		}
+		previousTriangles = capture.triangles;
+		cornerCount += capture.triangles.size();
+
+		weldCorners(capture.triangles, partVertices, partIndices);
+		bool strip = capture.onlyStrips && !capture.strips.empty();
+		if (!strip) dropDegenerateTriangles(partIndices);
+		int triangleCount = (int)partIndices.size() / 3;
+		float acmrBefore = measureACMR(partIndices, false);
+		if (strip) {
+			buildBandStrip(capture.strips, partVertices, partIndices);
+		}
+		else {
+			optimizeVertexCache(partIndices, (int)partVertices.size());
+			orderForOverdraw(partIndices, partVertices);
+		}
+		float acmrAfter = measureACMR(partIndices, strip);
 
-	// Halo arc (line strip)
-	glColor3f(1.0f, 0.84f, 0.0f);
-	float radius = 0.6f;
-	glBegin(GL_LINE_STRIP);
-	for (int i = 0; i <= 180; i += 5)
-	{
-		float angle = i * 3.14159f / 180.0f;
-		float x = radius * cos(angle);
-		float y = radius * sin(angle);
-		glVertex3f(x, y, 0.0f);
+		unsigned int flags = (capture.hasTexCoords ? MESH_PART_TEXCOORDS : 0) | (strip ? MESH_PART_STRIP : 0);
+		appendBakedPart(partVertices, partIndices, flags, vertices, indices, parts[record]);
+		benchLog("  %-13s %3d%% %4d triangles, %4u vertices, ACMR %.3f -> %.3f%s\n", BAKED_PART_NAMES[part], MESH_LOD_PERCENT[lod],
+			triangleCount, parts[record].vertexCount, acmrBefore, acmrAfter, strip ? " (restart strip)" : "");
 	}
-	glEnd();
+	g_meshCapture = nullptr;
 
-	// Left wing
-	glPushMatrix();
-	glTranslatef(-0.6f, 0.2f, 0.0f);
-	glRotatef(20, 0, 0, 1);
-	glScalef(0.4f, 0.15f, 0.05f);
-	drawCuboid(1, 1, 0.2f);
-	glPopMatrix();
+	// The last 16-bit index is the restart marker
+	if (vertices.size() > MESH_RESTART_INDEX) {
+		OutputDebugStringA("Mesh bake FAILED: more vertices than 16-bit indices can address.\n");
+		return false;
+	}
 
-	// Right wing
-	glPushMatrix();
-	glTranslatef(0.6f, 0.2f, 0.0f);
-	glRotatef(-20, 0, 0, 1);
-	glScalef(0.4f, 0.15f, 0.05f);
-	drawCuboid(1, 1, 0.2f);
-	glPopMatrix();
+	// Pack each part against its own bounds and report what the packing costs
+	std::vector<PackedVertex> packedVertices(vertices.size());
+	float maxPositionError = 0.0f, maxNormalError = 0.0f;
+	for (int record = 0; record < MESH_RECORD_COUNT; ++record) {
+		float scale[3], offset[3];
+		getPartQuantization(parts[record], scale, offset);
+		for (unsigned int v = parts[record].firstVertex; v < parts[record].firstVertex + parts[record].vertexCount; ++v) {
+			BakedVertex unpacked;
+			packVertex(vertices[v], scale, offset, packedVertices[v]);
+			unpackVertex(packedVertices[v], scale, offset, unpacked);
+			float normalLength = sqrtf(vertices[v].normal[0] * vertices[v].normal[0] + vertices[v].normal[1] * vertices[v].normal[1] + vertices[v].normal[2] * vertices[v].normal[2]);
+			for (int k = 0; k < 3; ++k) {
+				maxPositionError = max(maxPositionError, fabsf(unpacked.position[k] - vertices[v].position[k]));
+				if (normalLength > 0.0f) maxNormalError = max(maxNormalError, fabsf(unpacked.normal[k] - vertices[v].normal[k] / normalLength));
+			}
+		}
+	}
+	benchLog("Packed vertices: %zu bytes (%zu as floats), max position error %.6f, max normal error %.6f\n",
+		packedVertices.size() * sizeof(PackedVertex), vertices.size() * sizeof(BakedVertex), maxPositionError, maxNormalError);
 
-	// Crown spike
-	glPushMatrix();
-	glTranslatef(0.0f, 0.6f, 0.0f);
-	glRotatef(-90, 1, 0, 0);
-	glColor3f(1.0f, 0.84f, 0.0f);
-	drawCone(0.4f, 1.0f, 32, 32);
-	glPopMatrix();
+	MeshFileHeader header;
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.partCount = BAKED_PART_COUNT;
+	header.lodCount = MESH_LOD_COUNT;
+	header.vertexCount = (unsigned int)vertices.size();
+	header.indexCount = (unsigned int)indices.size();
+	header.vertexOffset = (unsigned int)(sizeof(MeshFileHeader) + sizeof(parts));
+	header.indexOffset = header.vertexOffset + header.vertexCount * (unsigned int)sizeof(PackedVertex);
 
-	glPopMatrix();
+	std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+
+	FILE* file;
+	fopen_s(&file, path, "wb");
+	if (!file) {
+		OutputDebugStringA("Mesh bake FAILED: could not write NuwaCharacter.mesh.\n");
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(parts, sizeof(parts), 1, file);
+	fwrite(packedVertices.data(), sizeof(PackedVertex), packedVertices.size(), file);
+	fwrite(shortIndices.data(), sizeof(unsigned short), shortIndices.size(), file);
+	fclose(file);
+
+	benchLog("Baked %d parts at %d detail levels into %s: %u vertices (%zu corners before welding), %u indices\n",
+		(int)BAKED_PART_COUNT, MESH_LOD_COUNT, path, header.vertexCount, cornerCount, header.indexCount);
+	return true;
 }
 
-void drawHelmetVisor()
+void drawSkyBackground(int winW, int winH)
 {
+	// Save matrices
+	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, winW, 0, winH, -1, 1);   // 2D screen space
 
-	// Set up shiny material for the visor
-	GLfloat mat_ambient[] = { 0.8f, 0.7f, 0.1f, 1.0f };
-	GLfloat mat_diffuse[] = { 1.0f, 0.84f, 0.0f, 1.0f };
-	GLfloat mat_specular[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-	GLfloat mat_shininess[] = { 128.0f };
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
 
-	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+	// Draw without lighting/depth and don't write depth
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
 
-	// Enable and apply the Gold texture
 	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, g_goldTextureID);
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-
-	// --- Define the 9 vertices of the new diamond shape ---
-	float diamond_width = 1.0f;
-	float diamond_height = 0.40f;
-
-	// Pre-calculate half dimensions for clarity
-	float w = diamond_width / 2.0f;
-	float h = diamond_height / 2.0f;
+	bindTexture(TEX_SKY);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 
-	// An array to hold the 9 points of the diamond's perimeter
-	GLfloat v[9][2] = {
-		{ 0.0f,      -h },         // 0: Bottom sharp point
-		{ w * 0.55f, -h * 0.4f },  // 1: Lower-mid right
-		{ w * 0.75f,      0.15f },      // 2: Widest point right
-		{ w * 0.55f,  h * 0.2f },  // 3: Upper-mid right
-		{ w * 0.2f,   h },         // 4: Top right
-		{ -w * 0.2f,  h },         // 5: Top left
-		{ -w * 0.55f, h * 0.2f },  // 6: Upper-mid left
-		{ -w * 0.75f,     0.15f },      // 7: Widest point left
-		{ -w * 0.55f, -h * 0.4f }  // 8: Lower-mid left
-	};
+	glBegin(GL_QUADS);
+	// NOTE: If your BMP shows upside-down, swap the V coords (0 ↔ 1)
+	glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
+	glTexCoord2f(1.0f, 0.0f); glVertex2f((float)winW, 0.0f);
+	glTexCoord2f(1.0f, 1.0f); glVertex2f((float)winW, (float)winH);
+	glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, (float)winH);
+	glEnd();
 
-	// --- Draw the shape as a Triangle Fan from the centre ---
-	glBegin(GL_TRIANGLE_FAN);
-	glNormal3f(0.0f, 0.0f, 1.0f); // Normal for the front face
+	glDisable(GL_TEXTURE_2D);
 
-	// Center vertex of the fan (maps to the centre of the texture)
-	glTexCoord2f(0.5f, 0.5f);
-	glVertex3f(0.0f, 0.0f, 0.0f);
+	// Restore state
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_LIGHTING);
 
-	// Draw the 9 perimeter vertices, calculating texture coordinates for each
-	// We add the first vertex again at the end to close the shape
-	for (int i = 0; i <= 9; ++i) {
-		int index = i % 9; // Loop back to the first vertex for the last triangle
-		float vx = v[index][0];
-		float vy = v[index][1];
+	glPopMatrix(); // MODELVIEW
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW); // leave modelview active
+}
 
-		// Map vertex position (from -w to w, -h to h) to texture coordinate (0 to 1)
-		float u = (vx + w) / diamond_width;
-		float v_tex = (vy + h) / diamond_height;
+// --- Spatial Hash ---
+// A uniform grid over the XZ plane, hashed into a fixed number of buckets so
+// the world needs no bounds. Entities are axis-aligned boxes; each one is
+// listed in the bucket of every cell it touches and only moves between buckets
+// when its cell range changes, so the per-frame update is mostly a bounds
+// store. Bucket and entity storage is reused, so nothing is allocated once
+// the high-water mark is reached.
+const float SPATIAL_CELL_SIZE = 4.0f;
+const int SPATIAL_BUCKET_COUNT = 8192; // Power of two
+
+enum SpatialEntityType { SPATIAL_BLOCK, SPATIAL_PROJECTILE, SPATIAL_OTHER };
+
+struct SpatialEntity {
+	float minX, minZ, maxX, maxZ;
+	int cellMinX, cellMinZ, cellMaxX, cellMaxZ;
+	SpatialEntityType type;
+	int index;              // Index into the owning pool
+	unsigned int queryStamp; // Last query that reported this entity, to skip duplicates
+	bool inUse;
+	bool sweepListed;        // Present in the sweep-and-prune order (g_sweepOrder)
+};
 
-		glTexCoord2f(u, v_tex);
-		glVertex3f(vx, vy, 0.0f);
-	}
-	glEnd();
+struct SpatialHash {
+	std::vector<SpatialEntity> entities;
+	std::vector<int> freeIds;
+	std::vector<int> buckets[SPATIAL_BUCKET_COUNT];
+	unsigned int queryStamp = 0;
+};
 
-	// Disable texturing after drawing the visor
-	glDisable(GL_TEXTURE_2D);
+SpatialHash g_spatialHash;
 
-	glPopMatrix();
+static inline int spatialCell(float coordinate)
+{
+	return (int)floorf(coordinate * (1.0f / SPATIAL_CELL_SIZE));
 }
 
-void drawHalo()
+static inline std::vector<int>& spatialBucket(int cellX, int cellZ)
 {
-	if (!g_isHaloVisible) {
-		return; // Don't draw if it's out of range
-	}
-
-	glPushMatrix();
-
-	// MODIFIED: Changed Z-translation to -1.2f to make the gap 4 times larger.
-	glTranslatef(0.0f, 1.5f, g_haloZ);
-	glScalef(g_haloScale, g_haloScale, g_haloScale);
+	unsigned int hash = ((unsigned int)cellX * 73856093u) ^ ((unsigned int)cellZ * 19349663u);
+	return g_spatialHash.buckets[hash & (SPATIAL_BUCKET_COUNT - 1)];
+}
 
-	// --- 1. Draw the Gradient Gold Rings ---
-	glDisable(GL_LIGHTING);
-	glLineWidth(3.5f);
-	for (int j = 0; j < 2; j++) {
-		float radius = 1.0f + (j * 0.2f);
-		glBegin(GL_LINE_LOOP);
-		for (int i = 0; i <= 60; ++i) {
-			float angle = (float)i / 60.0f * 2.0f * 3.14159f;
-			float brightness = 0.7f + 0.3f * sin(angle * 4.0f + g_rainbow_offset);
-			glColor3f(1.0f * brightness, 0.84f * brightness, 0.1f * brightness);
-			glVertex3f(radius * cos(angle), radius * sin(angle), 0.0f);
+static void spatialLink(int id)
+{
+	const SpatialEntity& e = g_spatialHash.entities[id];
+	for (int cz = e.cellMinZ; cz <= e.cellMaxZ; ++cz) {
+		for (int cx = e.cellMinX; cx <= e.cellMaxX; ++cx) {
+			pushHighWater(spatialBucket(cx, cz), id); // A crowded cell can hold any number of ids
 		}
-		glEnd();
 	}
-	glLineWidth(1.0f);
-
-	// --- 2. Draw the Dazzling Rainbow Glow Effect ---
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
 
-	float inner_radius = 1.2f;
-	float outer_radius = 4.0f;
+static void spatialUnlink(int id)
+{
+	const SpatialEntity& e = g_spatialHash.entities[id];
+	for (int cz = e.cellMinZ; cz <= e.cellMaxZ; ++cz) {
+		for (int cx = e.cellMinX; cx <= e.cellMaxX; ++cx) {
+			std::vector<int>& bucket = spatialBucket(cx, cz);
+			for (size_t i = 0; i < bucket.size(); ++i) {
+				if (bucket[i] == id) {
+					bucket[i] = bucket.back();
+					bucket.pop_back();
+					break;
+				}
+			}
+		}
+	}
+}
 
-	glBegin(GL_QUAD_STRIP);
-	for (int i = 0; i <= 60; i++) {
-		float angle = (float)i / 60.0f * 2.0f * 3.14159f;
-		float cos_a = cos(angle);
-		float sin_a = sin(angle);
+static void setSpatialBounds(SpatialEntity& e, float minX, float minZ, float maxX, float maxZ)
+{
+	e.minX = minX; e.minZ = minZ; e.maxX = maxX; e.maxZ = maxZ;
+	e.cellMinX = spatialCell(minX); e.cellMinZ = spatialCell(minZ);
+	e.cellMaxX = spatialCell(maxX); e.cellMaxZ = spatialCell(maxZ);
+}
 
-		float r = 0.5f * (1.0f + sin(g_rainbow_offset * 2.0f));
-		float g = 0.5f * (1.0f + sin(g_rainbow_offset * 2.0f + 2.0f));
-		float b = 0.5f * (1.0f + sin(g_rainbow_offset * 2.0f + 4.0f));
+// Adds a box and returns its id
+int spatialInsert(SpatialEntityType type, int index, float minX, float minZ, float maxX, float maxZ)
+{
+	SpatialHash& hash = g_spatialHash;
+	int id;
+	if (!hash.freeIds.empty()) {
+		id = hash.freeIds.back();
+		hash.freeIds.pop_back();
+	}
+	else {
+		// A recycled id keeps its sweepListed flag; it may still be in the sweep order
+		id = (int)hash.entities.size();
+		hash.entities.emplace_back();
+		hash.entities.back().sweepListed = false;
+	}
 
-		glColor4f(r, g, b, 0.35f);
-		glVertex3f(inner_radius * cos_a, inner_radius * sin_a, 0.0f);
+	SpatialEntity& e = hash.entities[id];
+	e.type = type;
+	e.index = index;
+	e.queryStamp = 0;
+	e.inUse = true;
+	setSpatialBounds(e, minX, minZ, maxX, maxZ);
+	spatialLink(id);
+	return id;
+}
 
-		glColor4f(r, g, b, 0.0f);
-		glVertex3f(outer_radius * cos_a, outer_radius * sin_a, 0.0f);
+// Moves a box, relinking it only if it now touches different cells
+void spatialUpdate(int id, float minX, float minZ, float maxX, float maxZ)
+{
+	SpatialEntity& e = g_spatialHash.entities[id];
+	if (spatialCell(minX) == e.cellMinX && spatialCell(minZ) == e.cellMinZ &&
+		spatialCell(maxX) == e.cellMaxX && spatialCell(maxZ) == e.cellMaxZ) {
+		e.minX = minX; e.minZ = minZ; e.maxX = maxX; e.maxZ = maxZ;
+		return;
 	}
-	glEnd();
-
-	glDisable(GL_BLEND);
+	spatialUnlink(id);
+	setSpatialBounds(e, minX, minZ, maxX, maxZ);
+	spatialLink(id);
+}
 
-	glPopMatrix();
-	glEnable(GL_LIGHTING);
+void spatialRemove(int id)
+{
+	spatialUnlink(id);
+	g_spatialHash.entities[id].inUse = false;
+	g_spatialHash.freeIds.push_back(id);
 }
 
-void drawEars()
+void clearSpatialHash()
 {
-	glPushAttrib(GL_LIGHTING_BIT | GL_ENABLE_BIT);
+	for (auto& bucket : g_spatialHash.buckets) bucket.clear();
+	g_spatialHash.entities.clear();
+	g_spatialHash.freeIds.clear();
+}
 
-	GLfloat bright_ear_ambient[] = { 0.6f, 0.5f, 0.2f, 1.0f };
-	GLfloat bright_ear_diffuse[] = { 1.0f, 0.9f, 0.3f, 1.0f };
-	GLfloat bright_ear_specular[] = { 1.0f, 1.0f, 0.8f, 1.0f };
-	GLfloat bright_ear_shininess[] = { 100.0f };
+// Visits each distinct entity listed in the cells overlapping a box; the
+// caller does the exact test
+template <typename Visit>
+static void spatialVisitCells(float minX, float minZ, float maxX, float maxZ, Visit visit)
+{
+	SpatialHash& hash = g_spatialHash;
+	unsigned int stamp = ++hash.queryStamp;
+	int cellMinX = spatialCell(minX), cellMinZ = spatialCell(minZ);
+	int cellMaxX = spatialCell(maxX), cellMaxZ = spatialCell(maxZ);
+	for (int cz = cellMinZ; cz <= cellMaxZ; ++cz) {
+		for (int cx = cellMinX; cx <= cellMaxX; ++cx) {
+			for (int id : spatialBucket(cx, cz)) {
+				SpatialEntity& e = hash.entities[id];
+				if (e.queryStamp == stamp) continue;
+				e.queryStamp = stamp;
+				visit(id, e);
+			}
+		}
+	}
+}
 
-	glMaterialfv(GL_FRONT, GL_AMBIENT, bright_ear_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, bright_ear_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, bright_ear_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, bright_ear_shininess);
+static bool spatialBoxInRadius(const SpatialEntity& e, float x, float z, float radiusSq)
+{
+	// Distance from the centre to the closest point of the box
+	float dx = x < e.minX ? e.minX - x : (x > e.maxX ? x - e.maxX : 0.0f);
+	float dz = z < e.minZ ? e.minZ - z : (z > e.maxZ ? z - e.maxZ : 0.0f);
+	return dx * dx + dz * dz <= radiusSq;
+}
 
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, g_fireTextureID);
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+// An oriented rectangle on the XZ plane: centre, unit axis along its length, half extents
+struct SpatialOBB {
+	float x, z;
+	float axisX, axisZ;
+	float halfWidth, halfLength;
+	float extentX, extentZ; // Half size of its world-aligned bounding box
+};
 
-	float ear_base_radius = 0.15f;
-	float ear_height = 0.6f;
+SpatialOBB makeSpatialOBB(float x, float z, float axisX, float axisZ, float halfWidth, float halfLength)
+{
+	SpatialOBB obb = { x, z, axisX, axisZ, halfWidth, halfLength };
+	obb.extentX = fabsf(axisX) * halfLength + fabsf(axisZ) * halfWidth;
+	obb.extentZ = fabsf(axisZ) * halfLength + fabsf(axisX) * halfWidth;
+	return obb;
+}
 
-	// --- Right Ear ---
-	glPushMatrix();
-	// CORRECTED POSITIONING
-	glTranslatef(0.22f, 0.02f, 0.0f);
-	glRotatef(-90.0f, 0.0f, 0.0f, 1.0f);
-	drawCone(ear_base_radius, ear_height, 16, 16);
-	glPopMatrix();
+// Separating axis test: world X and Z (the box's axes), then the rectangle's length and width axes
+static bool spatialBoxOverlapsOBB(const SpatialEntity& e, const SpatialOBB& obb)
+{
+	if (e.maxX < obb.x - obb.extentX || e.minX > obb.x + obb.extentX ||
+		e.maxZ < obb.z - obb.extentZ || e.minZ > obb.z + obb.extentZ) return false;
+
+	float boxX = (e.minX + e.maxX) * 0.5f - obb.x, boxZ = (e.minZ + e.maxZ) * 0.5f - obb.z;
+	float boxHalfX = (e.maxX - e.minX) * 0.5f, boxHalfZ = (e.maxZ - e.minZ) * 0.5f;
+	float along = fabsf(boxX * obb.axisX + boxZ * obb.axisZ);
+	if (along > obb.halfLength + boxHalfX * fabsf(obb.axisX) + boxHalfZ * fabsf(obb.axisZ)) return false;
+	float across = fabsf(-boxX * obb.axisZ + boxZ * obb.axisX);
+	return across <= obb.halfWidth + boxHalfX * fabsf(obb.axisZ) + boxHalfZ * fabsf(obb.axisX);
+}
 
-	// --- Left Ear ---
-	glPushMatrix();
-	// CORRECTED POSITIONING
-	glTranslatef(-0.22f, 0.02f, 0.0f);
-	glRotatef(90.0f, 0.0f, 0.0f, 1.0f);
-	drawCone(ear_base_radius, ear_height, 16, 16);
-	glPopMatrix();
+// Appends the ids of every entity whose box is within `radius` of (x, z)
+void spatialQueryRadius(float x, float z, float radius, std::vector<int>& results)
+{
+	float radiusSq = radius * radius;
+	spatialVisitCells(x - radius, z - radius, x + radius, z + radius, [&](int id, const SpatialEntity& e) {
+		if (spatialBoxInRadius(e, x, z, radiusSq)) results.push_back(id);
+	});
+}
 
-	glDisable(GL_TEXTURE_2D);
-	glPopAttrib();
+// Appends the ids of every entity whose box overlaps an oriented rectangle
+void spatialQueryOBB(const SpatialOBB& obb, std::vector<int>& results)
+{
+	spatialVisitCells(obb.x - obb.extentX, obb.z - obb.extentZ, obb.x + obb.extentX, obb.z + obb.extentZ, [&](int id, const SpatialEntity& e) {
+		if (spatialBoxOverlapsOBB(e, obb)) results.push_back(id);
+	});
 }
 
-void drawLipShape(const std::vector<std::pair<float, float>>& profile, float depth) {
-	glBegin(GL_QUAD_STRIP);
-	for (size_t i = 0; i < profile.size(); ++i) {
-		float x = profile[i].first;
-		float y = profile[i].second;
+// --- Particle System ---
+// Particles are stored as structure-of-arrays in one 32-byte aligned block so
+// the update kernel can stream eight particles at a time through AVX registers
+// (four with the SSE fallback). Each frame the kernel integrates position and
+// velocity and writes the faded alpha and size-over-life; dead particles are
+// then removed by swapping in the last live one. The whole system is drawn as
+// one additive batch of camera-facing quads.
+const int MAX_PARTICLES = 131072; // Multiple of 8 so kernels can run past `count` safely
+int g_particleCap = MAX_PARTICLES;  // Spawning stops here; lowered by the quality governor
+const float PARTICLE_GRAVITY = -2.5f;
+const float PARTICLE_DRAG = 0.8f; // Fraction of velocity lost per second
+
+struct ParticleSystem {
+	int count = 0;
+	float* memory = nullptr;
+	float* posX; float* posY; float* posZ;
+	float* velX; float* velY; float* velZ;
+	float* age; float* invLifetime;
+	float* startSize; float* endSize;
+	float* alpha; float* size;  // Written by the update kernel, read when drawing
+	unsigned int* color;        // Base colour, RGBA8 (alpha comes from `alpha`)
+};
 
-		// Calculate a simple normal pointing outwards from the curve
-		if (i < profile.size() - 1) {
-			float next_x = profile[i + 1].first;
-			float next_y = profile[i + 1].second;
-			float dx = next_x - x;
-			float dy = next_y - y;
-			// The normal is perpendicular to the line segment, pointing slightly forward
-			glNormal3f(dy, -dx, 0.5f);
-		}
+struct ParticleVertex {
+	float x, y, z;
+	float u, v;
+	unsigned int color;
+};
 
-		// Front vertex
-		glVertex3f(x, y, depth / 2.0f);
-		// Back vertex
-		glVertex3f(x, y, -depth / 2.0f);
-	}
-	glEnd();
+// How an emitter spawns its particles
+struct ParticleEmitterDesc {
+	float rate;                 // Particles per second for continuous emitters
+	float spread;               // Random horizontal speed
+	float riseMin, riseMax;     // Random upward speed
+	float lifeMin, lifeMax;     // Seconds
+	float startSize, endSize;
+	unsigned int color;         // RGBA8 as bytes R, G, B, A in memory
+};
 
-	// Draw the front face of the lips
-	glBegin(GL_POLYGON);
-	glNormal3f(0.0f, 0.0f, 1.0f);
-	for (const auto& p : profile) {
-		glVertex3f(p.first, p.second, depth / 2.0f);
+// Golden motes rising off the skill's path
+const ParticleEmitterDesc SKILL_EMITTER = { 2500.0f, 0.6f, 1.0f, 3.0f, 0.6f, 1.2f, 0.12f, 0.02f, 0xff40c0ffu };
+// Green sparks thrown out when a matrix block appears, then a gentle trickle while it stays
+const ParticleEmitterDesc BLOCK_BURST_EMITTER = { 0.0f, 4.0f, 1.0f, 5.0f, 0.5f, 1.0f, 0.15f, 0.03f, 0xff80ff40u };
+const ParticleEmitterDesc BLOCK_EMITTER = { 150.0f, 0.3f, 0.5f, 1.5f, 0.8f, 1.6f, 0.08f, 0.02f, 0xff90ff60u };
+
+typedef void (*ParticleKernel)(ParticleSystem& particles, int begin, int end, float deltaTime);
+
+ParticleSystem g_particles;
+ParticleKernel g_particleKernel = nullptr;
+ParticleVertex* g_particleVertices = nullptr; // This frame's quads, in the frame arena
+GLuint g_particleTextureID = 0;
+
+static void updateParticlesSSE(ParticleSystem& p, int begin, int end, float deltaTime)
+{
+	const __m128 dt = _mm_set1_ps(deltaTime);
+	const __m128 gravity = _mm_set1_ps(PARTICLE_GRAVITY * deltaTime);
+	const __m128 drag = _mm_set1_ps(1.0f - PARTICLE_DRAG * deltaTime);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 fadeIn = _mm_set1_ps(10.0f);
+	for (int i = begin; i < end; i += 4) {
+		__m128 age = _mm_add_ps(_mm_load_ps(p.age + i), dt);
+		_mm_store_ps(p.age + i, age);
+
+		__m128 vx = _mm_mul_ps(_mm_load_ps(p.velX + i), drag);
+		__m128 vy = _mm_mul_ps(_mm_add_ps(_mm_load_ps(p.velY + i), gravity), drag);
+		__m128 vz = _mm_mul_ps(_mm_load_ps(p.velZ + i), drag);
+		_mm_store_ps(p.velX + i, vx);
+		_mm_store_ps(p.velY + i, vy);
+		_mm_store_ps(p.velZ + i, vz);
+		_mm_store_ps(p.posX + i, _mm_add_ps(_mm_load_ps(p.posX + i), _mm_mul_ps(vx, dt)));
+		_mm_store_ps(p.posY + i, _mm_add_ps(_mm_load_ps(p.posY + i), _mm_mul_ps(vy, dt)));
+		_mm_store_ps(p.posZ + i, _mm_add_ps(_mm_load_ps(p.posZ + i), _mm_mul_ps(vz, dt)));
+
+		// Normalised life: fade in over the first tenth, then out linearly
+		__m128 t = _mm_min_ps(_mm_mul_ps(age, _mm_load_ps(p.invLifetime + i)), one);
+		_mm_store_ps(p.alpha + i, _mm_mul_ps(_mm_min_ps(_mm_mul_ps(t, fadeIn), one), _mm_sub_ps(one, t)));
+		__m128 startSize = _mm_load_ps(p.startSize + i);
+		_mm_store_ps(p.size + i, _mm_add_ps(startSize, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(p.endSize + i), startSize), t)));
 	}
-	glEnd();
 }
 
-void drawLips()
+static void updateParticlesAVX(ParticleSystem& p, int begin, int end, float deltaTime)
 {
-	// Material properties for the lips
-	GLfloat mat_ambient[] = { 0.5f, 0.05f, 0.05f, 1.0f };
-	GLfloat mat_diffuse[] = { 0.8f, 0.1f, 0.15f, 1.0f };
-	GLfloat mat_specular[] = { 0.2f, 0.1f, 0.1f, 1.0f };
-	GLfloat mat_shininess[] = { 20.0f };
-
-	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+	const __m256 dt = _mm256_set1_ps(deltaTime);
+	const __m256 gravity = _mm256_set1_ps(PARTICLE_GRAVITY * deltaTime);
+	const __m256 drag = _mm256_set1_ps(1.0f - PARTICLE_DRAG * deltaTime);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 fadeIn = _mm256_set1_ps(10.0f);
+	for (int i = begin; i < end; i += 8) {
+		__m256 age = _mm256_add_ps(_mm256_load_ps(p.age + i), dt);
+		_mm256_store_ps(p.age + i, age);
+
+		__m256 vx = _mm256_mul_ps(_mm256_load_ps(p.velX + i), drag);
+		__m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(p.velY + i), gravity), drag);
+		__m256 vz = _mm256_mul_ps(_mm256_load_ps(p.velZ + i), drag);
+		_mm256_store_ps(p.velX + i, vx);
+		_mm256_store_ps(p.velY + i, vy);
+		_mm256_store_ps(p.velZ + i, vz);
+		_mm256_store_ps(p.posX + i, _mm256_add_ps(_mm256_load_ps(p.posX + i), _mm256_mul_ps(vx, dt)));
+		_mm256_store_ps(p.posY + i, _mm256_add_ps(_mm256_load_ps(p.posY + i), _mm256_mul_ps(vy, dt)));
+		_mm256_store_ps(p.posZ + i, _mm256_add_ps(_mm256_load_ps(p.posZ + i), _mm256_mul_ps(vz, dt)));
+
+		__m256 t = _mm256_min_ps(_mm256_mul_ps(age, _mm256_load_ps(p.invLifetime + i)), one);
+		_mm256_store_ps(p.alpha + i, _mm256_mul_ps(_mm256_min_ps(_mm256_mul_ps(t, fadeIn), one), _mm256_sub_ps(one, t)));
+		__m256 startSize = _mm256_load_ps(p.startSize + i);
+		_mm256_store_ps(p.size + i, _mm256_add_ps(startSize, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(p.endSize + i), startSize), t)));
+	}
+	_mm256_zeroupper();
+}
 
-	// The colour is set by the material's diffuse property
-	glColor3f(0.8f, 0.1f, 0.15f);
+// AVX needs both the CPU feature and an OS that saves the YMM registers
+static bool cpuSupportsAVX()
+{
+	int info[4];
+	__cpuid(info, 1);
+	bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+	bool hasAVX = (info[2] & (1 << 28)) != 0;
+	return hasOSXSAVE && hasAVX && (_xgetbv(0) & 0x6) == 0x6;
+}
 
-	glPushMatrix();
+void initParticles()
+{
+	// 13 arrays of MAX_PARTICLES floats carved out of one aligned allocation
+	const size_t arrayBytes = MAX_PARTICLES * sizeof(float);
+	ParticleSystem& p = g_particles;
+	p.memory = (float*)_aligned_malloc(arrayBytes * 13, 32);
+	memset(p.memory, 0, arrayBytes * 13);
+	float** arrays[] = { &p.posX, &p.posY, &p.posZ, &p.velX, &p.velY, &p.velZ, &p.age, &p.invLifetime, &p.startSize, &p.endSize, &p.alpha, &p.size };
+	for (int i = 0; i < 12; ++i) *arrays[i] = p.memory + (size_t)i * MAX_PARTICLES;
+	p.color = (unsigned int*)(p.memory + (size_t)12 * MAX_PARTICLES);
+	p.count = 0;
+
+	g_particleKernel = cpuSupportsAVX() ? updateParticlesAVX : updateParticlesSSE;
+	char buffer[128];
+	sprintf_s(buffer, "Particle update kernel: %s\n", g_particleKernel == updateParticlesAVX ? "AVX" : "SSE");
+	OutputDebugStringA(buffer);
+}
 
-	// --- CHANGE: Adjusted the Y-coordinates to close the gap ---
+// Soft round sprite: white, with a smooth alpha falloff to the edge
+void createParticleTexture()
+{
+	const int SIZE = 32;
+	unsigned char pixels[SIZE * SIZE * 4];
+	for (int y = 0; y < SIZE; ++y) {
+		for (int x = 0; x < SIZE; ++x) {
+			float dx = (x + 0.5f) / SIZE * 2.0f - 1.0f, dy = (y + 0.5f) / SIZE * 2.0f - 1.0f;
+			float falloff = 1.0f - (dx * dx + dy * dy);
+			if (falloff < 0.0f) falloff = 0.0f;
+			unsigned char* texel = &pixels[(y * SIZE + x) * 4];
+			texel[0] = texel[1] = texel[2] = 255;
+			texel[3] = (unsigned char)(falloff * falloff * 255.0f);
+		}
+	}
+	glGenTextures(1, &g_particleTextureID);
+	glBindTexture(GL_TEXTURE_2D, g_particleTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SIZE, SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
-	// Define the 2D profile for the upper lip (moved down)
-	std::vector<std::pair<float, float>> upper_lip_profile = {
-		{-0.08f, 0.005f}, // Was 0.015f
-		{-0.05f, 0.025f}, // Was 0.035f
-		{ 0.00f, 0.015f}, // Was 0.025f
-		{ 0.05f, 0.025f}, // Was 0.035f
-		{ 0.08f, 0.005f}  // Was 0.015f
-	};
+void shutdownParticles()
+{
+	_aligned_free(g_particles.memory);
+	g_particles.memory = nullptr;
+	g_particles.count = 0;
+	if (g_particleTextureID) glDeleteTextures(1, &g_particleTextureID);
+	g_particleTextureID = 0;
+}
 
-	// Define the 2D profile for the lower lip (moved up)
-	std::vector<std::pair<float, float>> lower_lip_profile = {
-		{-0.07f, -0.005f}, // Was -0.010f
-		{-0.04f, -0.025f}, // Was -0.030f
-		{ 0.00f, -0.030f}, // Was -0.035f
-		{ 0.04f, -0.025f}, // Was -0.030f
-		{ 0.07f, -0.005f}  // Was -0.010f
-	};
+void spawnParticle(const ParticleEmitterDesc& desc, float x, float y, float z)
+{
+	ParticleSystem& p = g_particles;
+	if (p.count >= g_particleCap) return;
+	int i = p.count++;
+	activateAnimTask(TASK_PARTICLES);
+
+	float angle = randomFloat(0.0f, 6.2831853f);
+	float speed = randomFloat(0.0f, desc.spread);
+	p.posX[i] = x; p.posY[i] = y; p.posZ[i] = z;
+	p.velX[i] = cosf(angle) * speed;
+	p.velY[i] = randomFloat(desc.riseMin, desc.riseMax);
+	p.velZ[i] = sinf(angle) * speed;
+	p.age[i] = 0.0f;
+	p.invLifetime[i] = 1.0f / randomFloat(desc.lifeMin, desc.lifeMax);
+	p.startSize[i] = desc.startSize;
+	p.endSize[i] = desc.endSize;
+	p.alpha[i] = 0.0f;
+	p.size[i] = desc.startSize;
+	p.color[i] = desc.color;
+}
 
-	float lip_depth = 0.04f;
-	drawLipShape(upper_lip_profile, lip_depth);
-	drawLipShape(lower_lip_profile, lip_depth);
+// How many particles a continuous emitter releases this frame; the fraction
+// is rounded randomly so low rates still emit on average at the right rate
+int getEmitCount(const ParticleEmitterDesc& desc, float deltaTime)
+{
+	return (int)(desc.rate * deltaTime + randomFloat(0.0f, 1.0f));
+}
 
-	glPopMatrix();
+static void copyParticle(ParticleSystem& p, int to, int from)
+{
+	p.posX[to] = p.posX[from]; p.posY[to] = p.posY[from]; p.posZ[to] = p.posZ[from];
+	p.velX[to] = p.velX[from]; p.velY[to] = p.velY[from]; p.velZ[to] = p.velZ[from];
+	p.age[to] = p.age[from];
+	p.invLifetime[to] = p.invLifetime[from];
+	p.startSize[to] = p.startSize[from];
+	p.endSize[to] = p.endSize[from];
+	p.alpha[to] = p.alpha[from];
+	p.size[to] = p.size[from];
+	p.color[to] = p.color[from];
 }
 
-void drawFace()
+void updateParticles(float deltaTime)
 {
-	// Define the golden material properties that the head SHOULD have
-	GLfloat head_mat_ambient[] = { 0.55f, 0.38f, 0.1f, 1.0f };
-	GLfloat head_mat_diffuse[] = { 1.0f, 0.84f, 0.0f, 1.0f };
-	GLfloat head_mat_specular[] = { 1.0f, 1.0f, 0.8f, 1.0f };
-	GLfloat head_mat_shininess[] = { 128.0f };
+	ParticleSystem& p = g_particles;
+	if (p.count == 0) return;
+
+	// Round up to a whole number of 8-wide groups; the spare lanes are never read back
+	int padded = (p.count + 7) & ~7;
+	parallelFor(padded, 8192, [&](int begin, int end) { g_particleKernel(p, begin, end, deltaTime); });
+
+	// Remove expired particles by moving the last live one into their slot
+	int i = 0;
+	while (i < p.count) {
+		if (p.age[i] * p.invLifetime[i] >= 1.0f) {
+			copyParticle(p, i, --p.count);
+		}
+		else {
+			++i;
+		}
+	}
+}
 
-	// --- Start of Head Group ---
-	glPushMatrix();
-	glTranslatef(0.0f, 1.18f, 0.0f);
+// Expands every particle into a quad facing the camera, using the right and up
+// axes of the current modelview matrix
+static void buildParticleVertices(const float right[3], const float up[3])
+{
+	const ParticleSystem& p = g_particles;
+	ParticleVertex* out = g_particleVertices = frameAllocArray<ParticleVertex>((size_t)p.count * 4);
+	if (!out) return;
+
+	parallelFor(p.count, 4096, [&](int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			float s = p.size[i];
+			float rx = right[0] * s, ry = right[1] * s, rz = right[2] * s;
+			float ux = up[0] * s, uy = up[1] * s, uz = up[2] * s;
+			unsigned int alpha = (unsigned int)(p.alpha[i] * 255.0f);
+			unsigned int color = (p.color[i] & 0x00ffffffu) | (alpha << 24);
+			ParticleVertex* v = out + (size_t)i * 4;
+			v[0] = { p.posX[i] - rx - ux, p.posY[i] - ry - uy, p.posZ[i] - rz - uz, 0.0f, 0.0f, color };
+			v[1] = { p.posX[i] + rx - ux, p.posY[i] + ry - uy, p.posZ[i] + rz - uz, 1.0f, 0.0f, color };
+			v[2] = { p.posX[i] + rx + ux, p.posY[i] + ry + uy, p.posZ[i] + rz + uz, 1.0f, 1.0f, color };
+			v[3] = { p.posX[i] - rx + ux, p.posY[i] - ry + uy, p.posZ[i] - rz + uz, 0.0f, 1.0f, color };
+		}
+	});
+}
 
-	// 1. Draw Visor (uses its own gold material)
-	glMaterialfv(GL_FRONT, GL_AMBIENT, head_mat_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, head_mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, head_mat_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, head_mat_shininess);
+void drawParticles()
+{
+	if (g_particles.count == 0) return;
 
-	glPushMatrix();
-	glTranslatef(0.0f, 0.20f, 0.28f);
-	drawHelmetVisor();
-	glPopMatrix();
+	GLfloat modelview[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+	// The rows of the rotation part are the camera axes in the current object space
+	float right[3] = { modelview[0], modelview[4], modelview[8] };
+	float up[3] = { modelview[1], modelview[5], modelview[9] };
+	buildParticleVertices(right, up);
+	if (!g_particleVertices) return;
 
-	// 2. Draw Lips (uses red material)
-	glPushAttrib(GL_LIGHTING_BIT);
-	glPushMatrix();
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE); // Additive, like the other glow effects
+	glDisable(GL_LIGHTING);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, g_particleTextureID);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-	// --- STEP 2: LOWER THE LIPS ONTO THE NEW CHIN ---
-	// Now that the head is taller, you can use a negative Y value to place the lips lower.
-	// You can adjust this value to get the exact position you want.
-	glTranslatef(0.0f, -0.1f, 0.28f); // Changed Y from 0.00001f to -0.1f
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	const ParticleVertex* vertices = g_particleVertices;
+	glVertexPointer(3, GL_FLOAT, sizeof(ParticleVertex), &vertices->x);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(ParticleVertex), &vertices->u);
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ParticleVertex), &vertices->color);
+	glDrawArrays(GL_QUADS, 0, g_particles.count * 4);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
 
-	drawLips();
-	glPopMatrix();
 	glPopAttrib();
+}
 
+struct SkillVertex {
+	float x, y, z;
+	float u, v;
+};
 
-	// Re-apply the golden material to be safe
-	glMaterialfv(GL_FRONT, GL_AMBIENT, head_mat_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, head_mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, head_mat_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, head_mat_shininess);
-	glColor3f(1.0f, 1.0f, 1.0f);
+SkillVertex* g_skillVertices = nullptr; // This frame's projectile geometry, in the frame arena
 
+// Fills g_skillVertices with, per projectile: 4 base-quad corners, 8 border
+// line endpoints and 4 textured-quad corners, grouped by layer so each layer
+// is one draw call
+static void buildSkillVertices()
+{
+	const SkillProjectilePool& pool = g_skillProjectiles;
+	const int count = pool.count;
+	SkillVertex* quads = g_skillVertices = frameAllocArray<SkillVertex>((size_t)count * 16);
+	if (!quads) return;
+	SkillVertex* lines = quads + (size_t)count * 4;
+	SkillVertex* textured = lines + (size_t)count * 8;
+
+	const float halfW = SKILL_WIDTH / 2.0f;
+	const float halfL = SKILL_LENGTH / 2.0f;
+	const float y = 0.02f; // Just above the ground to prevent z-fighting
+	for (int i = 0; i < count; ++i) {
+		// Local +X is the projectile's right, local +Z points back towards the caster
+		float rightX = -pool.dirZ[i] * halfW, rightZ = pool.dirX[i] * halfW;
+		float backX = -pool.dirX[i] * halfL, backZ = -pool.dirZ[i] * halfL;
+		float cx = pool.posX[i], cz = pool.posZ[i];
+
+		SkillVertex corners[4] = {
+			{ cx - rightX + backX, y, cz - rightZ + backZ, 0.0f, 4.0f }, // (-halfW,  halfL)
+			{ cx + rightX + backX, y, cz + rightZ + backZ, 1.0f, 4.0f }, // ( halfW,  halfL)
+			{ cx + rightX - backX, y, cz + rightZ - backZ, 1.0f, 0.0f }, // ( halfW, -halfL)
+			{ cx - rightX - backX, y, cz - rightZ - backZ, 0.0f, 0.0f }, // (-halfW, -halfL)
+		};
+		for (int c = 0; c < 4; ++c) {
+			quads[i * 4 + c] = corners[c];
+			textured[i * 4 + c] = corners[c];
+			lines[i * 8 + c * 2] = corners[c];
+			lines[i * 8 + c * 2 + 1] = corners[(c + 1) % 4];
+		}
+	}
+}
 
-	// 3. Draw Main Head Shape
-	int latitudes = 15;
-	int longitudes = 20;
+void drawSkillProjectiles()
+{
+	const int count = g_skillProjectiles.count;
+	if (count == 0) {
+		return;
+	}
+	buildSkillVertices();
+	if (!g_skillVertices) return;
 
-	// --- STEP 1: MAKE THE HEAD TALLER ---
-	// By increasing head_height, you stretch the head vertically, creating a chin.
-	float head_height = 0.6f; // <<< CHANGED from 0.5f to 0.6f
-	float head_max_radius = 0.28f;
-	float head_base_radius = 0.10f;
+	// --- Setup for transparent, glowing effect, shared by every projectile ---
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT | GL_LINE_BIT); // Save state
 
-	for (int i = 0; i <= latitudes; ++i) {
-		float lat0 = 3.14159f * (-0.5f + (float)(i - 1) / latitudes);
-		float lat1 = 3.14159f * (-0.5f + (float)i / latitudes);
-		float y0 = sin(lat0) * head_height / 2.0f;
-		float y1 = sin(lat1) * head_height / 2.0f;
-		float r0 = cos(lat0) * head_max_radius;
-		float r1 = cos(lat1) * head_max_radius;
-		if (i == 0) r0 = head_base_radius;
-		if (i == 1) r0 = head_base_radius;
-		glBegin(GL_QUAD_STRIP);
-		for (int j = 0; j <= longitudes; ++j) {
-			float lng = 2.0f * 3.14159f * (float)j / longitudes;
-			float x = cos(lng);
-			float z = sin(lng);
-			float nx0 = cos(lat0) * x, ny0 = sin(lat0), nz0 = cos(lat0) * z;
-			glNormal3f(nx0, ny0, nz0);
-			glVertex3f(r0 * x, y0, r0 * z);
-			float nx1 = cos(lat1) * x, ny1 = sin(lat1), nz1 = cos(lat1) * z;
-			glNormal3f(nx1, ny1, nz1);
-			glVertex3f(r1 * x, y1, r1 * z);
-		}
-		glEnd();
-	}
+	glEnable(GL_BLEND);
+	// Additive blending makes bright parts glow and ignore black parts of the texture
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	glDisable(GL_LIGHTING); // Effects like this usually aren't affected by scene lighting
+	glDepthMask(GL_FALSE);  // Don't write to the depth buffer to avoid z-fighting with the ground
 
-	// 4. Draw Ears
-	drawEars();
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(SkillVertex), &g_skillVertices[0].x);
 
-	glPopMatrix(); // End of the entire head group
-}
+	// --- Layer 1: The semi-transparent base rectangles ---
+	glColor4f(1.0f, 0.8f, 0.4f, 0.3f); // A soft, transparent orange-gold
+	glDrawArrays(GL_QUADS, 0, count * 4);
 
-void drawBraid(float yOffset, float zOffset)
-{
-	GLUquadric* quad = gluNewQuadric();
-	gluQuadricNormals(quad, GLU_SMOOTH);
+	// --- Layer 2: The bright borders ---
+	glLineWidth(3.0f);
+	glColor4f(1.0f, 0.9f, 0.7f, 0.8f); // A brighter, more solid gold
+	glDrawArrays(GL_LINES, count * 4, count * 8);
 
-	// --- 2. DYNAMIC COLOUR CHANGE ---
-	// This logic is copied from drawHalo to sync the colours.
-	// It calculates a new colour each frame based on the global rainbow offset.
-	float r = 0.5f * (1.0f + sin(g_rainbow_offset * 2.0f));
-	float g = 0.5f * (1.0f + sin(g_rainbow_offset * 2.0f + 2.0f));
-	float b = 0.5f * (1.0f + sin(g_rainbow_offset * 2.0f + 4.0f));
+	// --- Layer 3: The geometric patterns using the texture ---
+	glEnable(GL_TEXTURE_2D);
+	bindProceduralTexture(PROC_SKILL_GLYPH);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(SkillVertex), &g_skillVertices[0].u);
+
+	glColor4f(1.0f, 0.85f, 0.5f, 1.0f); // Bright gold tint for the texture pattern
+	// The texture repeats 4 times along each rectangle's length for more detail
+	glDrawArrays(GL_QUADS, count * 12, count * 4);
 
-	// Set the calculated rainbow colour for the braid.
-	// This works because GL_COLOR_MATERIAL is enabled in your display function.
-	glColor3f(r, g, b);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
 
-	glPushMatrix();
+	// --- Restore OpenGL state ---
+	glPopAttrib();
+}
 
-	// Position the braid's origin on the head
-	glTranslatef(0.0f, yOffset, zOffset);
-	glRotatef(180.0f, 0.0f, 1.0f, 0.0f); // Rotate to face the back
+// Moves every projectile and retires expired ones
+void updateSkillProjectiles(float deltaTime)
+{
+	SkillProjectilePool& pool = g_skillProjectiles;
+	if (pool.count == 0) {
+		return;
+	}
 
-	// --- 1. STRONGER CURVE ---
-	// The max angle is increased to make the braid bend more sharply.
-	const int CURVE_SEGMENTS = 5;
-	const float MAX_CURVE_ANGLE = 28.0f; // Increased from 20.0f
+	const __m128 step = _mm_set1_ps(SKILL_SPEED * deltaTime);
+	const __m128 dt = _mm_set1_ps(deltaTime);
+	for (int i = 0; i < pool.count; i += 4) {
+		_mm_store_ps(pool.posX + i, _mm_add_ps(_mm_load_ps(pool.posX + i), _mm_mul_ps(_mm_load_ps(pool.dirX + i), step)));
+		_mm_store_ps(pool.posZ + i, _mm_add_ps(_mm_load_ps(pool.posZ + i), _mm_mul_ps(_mm_load_ps(pool.dirZ + i), step)));
+		_mm_store_ps(pool.lifetime + i, _mm_sub_ps(_mm_load_ps(pool.lifetime + i), dt));
+	}
 
-	for (int i = 0; i < g_numBraidSegments; ++i)
-	{
-		glPushMatrix();
+	// Deactivate projectiles when time runs out, keeping the live ones packed
+	int i = 0;
+	while (i < pool.count) {
+		if (pool.lifetime[i] <= 0.0f) {
+			if (pool.spatialId[i] >= 0) spatialRemove(pool.spatialId[i]);
+
+			int last = --pool.count;
+			pool.posX[i] = pool.posX[last];
+			pool.posZ[i] = pool.posZ[last];
+			pool.dirX[i] = pool.dirX[last];
+			pool.dirZ[i] = pool.dirZ[last];
+			pool.lifetime[i] = pool.lifetime[last];
+			pool.spatialId[i] = pool.spatialId[last];
+			if (pool.spatialId[i] >= 0) g_spatialHash.entities[pool.spatialId[i]].index = i;
+		}
+		else {
+			++i;
+		}
+	}
+}
 
-		float swayAmplitude = 0.0f;
-		if (i >= CURVE_SEGMENTS) {
-			swayAmplitude = ((float)i - (CURVE_SEGMENTS - 1)) * 4.0f * g_windStrength;
+// Each projectile sheds particles over its current footprint
+void emitSkillParticles(float deltaTime)
+{
+	const SkillProjectilePool& pool = g_skillProjectiles;
+	const float halfW = SKILL_WIDTH / 2.0f;
+	const float halfL = SKILL_LENGTH / 2.0f;
+	for (int i = 0; i < pool.count && g_particles.count < g_particleCap; ++i) {
+		int emitCount = getEmitCount(SKILL_EMITTER, deltaTime);
+		for (int n = 0; n < emitCount; ++n) {
+			float across = randomFloat(-halfW, halfW);
+			float along = randomFloat(-halfL, halfL);
+			spawnParticle(SKILL_EMITTER, pool.posX[i] - pool.dirZ[i] * across + pool.dirX[i] * along, 0.05f,
+				pool.posZ[i] + pool.dirX[i] * across + pool.dirZ[i] * along);
 		}
-		float swayAngleY = sin(g_braidTime * 2.5f + i * 0.5f) * swayAmplitude;
-		float swayAngleX = cos(g_braidTime * 3.0f + i * 0.7f) * swayAmplitude * 0.5f;
+	}
+}
 
-		glRotatef(swayAngleY, 0.0f, 1.0f, 0.0f);
-		glRotatef(swayAngleX, 1.0f, 0.0f, 0.0f);
+void drawSingleMatrixBlock(const MatrixBlock& block) {
+	glPushMatrix();
+	// Save current OpenGL state
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT);
 
-		const float segmentRadius = 0.1f;
-		gluCylinder(quad, segmentRadius, segmentRadius, g_braidSegmentLength, 20, 1);
-		gluDisk(quad, 0, segmentRadius, 20, 1);
-		glPushMatrix();
-		glTranslatef(0.0f, 0.0f, g_braidSegmentLength);
-		gluDisk(quad, 0, segmentRadius, 20, 1);
-		glPopMatrix();
+	// --- Set up for a glowing, transparent effect ---
+	glEnable(GL_BLEND);
+	// Additive blending: makes colours brighter where they overlap. Great for magic!
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	glDisable(GL_LIGHTING);   // Glow effects shouldn't be affected by world lighting
+	glDepthMask(GL_FALSE);    // Don't hide other transparent objects behind this one
 
-		glPopMatrix();
+	// --- Position and scale the block ---
+	glTranslatef(block.posX, block.posY, block.posZ);
+	glScalef(block.scaleX, block.scaleY, block.scaleZ);
 
-		if (i < CURVE_SEGMENTS)
-		{
-			float curveFactor = 1.0f - ((float)i / CURVE_SEGMENTS);
-			glRotatef(MAX_CURVE_ANGLE * curveFactor, 1.0f, 0.0f, 0.0f);
-		}
+	// --- Apply the texture ---
+	glEnable(GL_TEXTURE_2D);
+	bindProceduralTexture(PROC_DIGITAL_RAIN);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-		const float segmentGap = 0.02f;
-		glTranslatef(0.0f, 0.0f, g_braidSegmentLength + segmentGap);
+	// Draw the cuboid with a glowing colour tint
+	// The alpha (0.7f) controls the transparency for the blend function
+	if (block.state == SHATTERING) {
+		glColor4f(1.0f, 0.85f, 0.4f, 0.9f); // Flash skill-gold as it breaks
+	}
+	else {
+		glColor4f(0.8f, 0.9f, 1.0f, 0.7f);
 	}
+	drawCuboid(1.0f, 1.0f, 1.0f); // Draw a 1x1x1 cube, which will be scaled
 
+	// --- Restore OpenGL state ---
+	glPopAttrib();
 	glPopMatrix();
-	gluDeleteQuadric(quad);
 }
 
-void drawLegs()
+const float BLOCK_SPAWN_DURATION = 0.1f;
+const float BLOCK_EXPAND_DURATION = 0.5f; // How long it takes to expand
+const float BLOCK_SHATTER_DURATION = 0.3f;
+const float BLOCK_SIDE_LENGTH = 2.0f;     // A single size for the cube in every axis
+
+// Schedules the end of a block's current phase, unless its lifetime runs out first
+static void scheduleBlockPhase(int index, float duration, MatrixBlockState next)
 {
-	// --- Material Properties for Golden Armour (for ALL leg parts) ---
-	GLfloat mat_ambient[] = { 0.45f, 0.38f, 0.1f, 1.0f };
-	GLfloat mat_diffuse[] = { 1.0f, 0.84f, 0.0f, 1.0f };
-	GLfloat mat_specular[] = { 1.0f, 1.0f, 0.8f, 1.0f };
-	GLfloat mat_shininess[] = { 100.0f };
+	const MatrixBlock& block = g_matrixBlocks[index];
+	float remaining = block.expireTime - g_animClock;
+	if (remaining <= duration) {
+		duration = remaining;
+		next = EXPIRED;
+	}
+	schedulePhaseEvent(duration, index, next, block.phaseSerial);
+}
 
-	// Apply the material properties for ALL leg parts
-	glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
-	glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+// Moves a block into a new state and schedules the one after it. An event
+// still pending for its old state (a shatter interrupts ACTIVE long before
+// it expires) is taken off the heap.
+static void enterBlockPhase(int index, MatrixBlockState state)
+{
+	MatrixBlock& block = g_matrixBlocks[index];
+	block.state = state;
+	block.animationTimer = 0.0f;
+	++block.phaseSerial;
+	cancelPhaseEvents(index);
+
+	switch (state) {
+	case SPAWNING:
+		// Just wait for a very short time before expanding
+		scheduleBlockPhase(index, BLOCK_SPAWN_DURATION, EXPANDING);
+		break;
 
-	glColor3f(1.0f, 0.84f, 0.0f);
+	case EXPANDING:
+		// A burst of sparks as the block starts to open up
+		for (int i = 0; i < 400; ++i) {
+			spawnParticle(BLOCK_BURST_EMITTER, block.posX, block.posY, block.posZ);
+		}
+		scheduleBlockPhase(index, BLOCK_EXPAND_DURATION, ACTIVE);
+		break;
 
-	// Lambda to draw a single leg, now with animation parameters
-	auto drawOneLeg = [](float hipAngle, float kneeAngle) {
-		glPushMatrix(); // Save the state at the hip joint
+	case ACTIVE:
+		// Expansion finished; stays at full size until it expires
+		block.scaleX = block.scaleY = block.scaleZ = BLOCK_SIDE_LENGTH;
+		scheduleBlockPhase(index, FLT_MAX, EXPIRED);
+		break;
 
-		// --- ANIMATION: Apply rotation at the hip ---
-		glRotatef(hipAngle, 1.0f, 0.0f, 0.0f);
+	case SHATTERING:
+		// Collapse to nothing, then free the block
+		block.shatterScale = block.scaleY;
+		scheduleBlockPhase(index, BLOCK_SHATTER_DURATION, EXPIRED);
+		break;
 
-		// --- Part 1: Upper Leg (Thigh) ---
-		float thigh_height = 0.8f;
-		glPushMatrix();
-		glTranslatef(0.0f, -thigh_height / 2.0f, 0.0f);
-		{
-			float v[8][3] = {
-				{-0.15f,  thigh_height / 2.0f,  0.12f}, { 0.15f,  thigh_height / 2.0f,  0.12f},
-				{ 0.15f,  thigh_height / 2.0f, -0.12f}, {-0.15f,  thigh_height / 2.0f, -0.12f},
-				{-0.10f, -thigh_height / 2.0f,  0.10f}, { 0.10f, -thigh_height / 2.0f,  0.10f},
-				{ 0.10f, -thigh_height / 2.0f, -0.10f}, {-0.10f, -thigh_height / 2.0f, -0.10f}
-			};
-			glBegin(GL_QUADS);
-			glNormal3f(0.0, 0.0, 1.0); glVertex3fv(v[0]); glVertex3fv(v[1]); glVertex3fv(v[5]); glVertex3fv(v[4]);
-			glNormal3f(0.0, 0.0, -1.0); glVertex3fv(v[3]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[7]);
-			glNormal3f(-1.0, 0.0, 0.0); glVertex3fv(v[0]); glVertex3fv(v[3]); glVertex3fv(v[7]); glVertex3fv(v[4]);
-			glNormal3f(1.0, 0.0, 0.0); glVertex3fv(v[1]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[5]);
-			glEnd();
+	case EXPIRED:
+		block.isActive = false;
+		g_liveMatrixBlocks.erase(std::find(g_liveMatrixBlocks.begin(), g_liveMatrixBlocks.end(), index));
+		g_freeMatrixBlocks.push_back(index);
+		break;
+	}
+}
+
+// Returns false if every slot of the pool is in use
+bool spawnMatrixBlock(float x, float z)
+{
+	int index;
+	if (!g_freeMatrixBlocks.empty()) {
+		index = g_freeMatrixBlocks.back();
+		g_freeMatrixBlocks.pop_back();
+	}
+	else if ((int)g_matrixBlocks.size() < MAX_MATRIX_BLOCKS) {
+		index = (int)g_matrixBlocks.size();
+		g_matrixBlocks.emplace_back();
+	}
+	else {
+		return false;
+	}
+
+	MatrixBlock& block = g_matrixBlocks[index];
+	if (block.spatialId >= 0) {
+		spatialRemove(block.spatialId); // Expired too recently for updateSpatialHash to have dropped it
+		block.spatialId = -1;
+	}
+	// The slot keeps its phase serial, so no event from its last block can match the new one
+	block.isActive = true;
+	block.expireTime = g_animClock + g_config.blockLifetime;
+	block.scaleX = block.scaleY = block.scaleZ = 0.1f;
+	block.posX = x;
+	block.posY = 1.0f;
+	block.posZ = z;
+
+	g_liveMatrixBlocks.push_back(index);
+	enterBlockPhase(index, SPAWNING);
+	activateAnimTask(TASK_MATRIX_BLOCKS);
+	activateAnimTask(TASK_COLLISIONS);
+	return true;
+}
+
+// TASK_MATRIX_BLOCKS: applies the phase changes that are due, then animates
+// whatever the live blocks' current states animate
+bool tickMatrixBlocks(float deltaTime)
+{
+	PhaseEvent event;
+	while (popDuePhaseEvent(event)) {
+		if (g_matrixBlocks[event.target].phaseSerial == event.serial) {
+			enterBlockPhase(event.target, (MatrixBlockState)event.phase);
 		}
-		glPopMatrix();
+	}
 
-		// --- Position for the Knee Joint ---
-		glTranslatef(0.0f, -thigh_height, 0.0f);
+	for (int index : g_liveMatrixBlocks) {
+		MatrixBlock& block = g_matrixBlocks[index];
+		block.animationTimer += deltaTime;
 
-		// --- ANIMATION: Apply rotation at the knee ---
-		glRotatef(kneeAngle, 1.0f, 0.0f, 0.0f);
+		switch (block.state) {
+		case EXPANDING: {
+			// Interpolate scale from small to full size over BLOCK_EXPAND_DURATION
+			float progress = min(block.animationTimer / BLOCK_EXPAND_DURATION, 1.0f);
+			block.scaleX = block.scaleY = block.scaleZ = BLOCK_SIDE_LENGTH * progress;
+			break;
+		}
 
-		// --- Draw the Diamond Knee Joint ---
-		drawDiamondKneeJoint();
+		case SHATTERING: {
+			float remaining = max(1.0f - block.animationTimer / BLOCK_SHATTER_DURATION, 0.0f);
+			block.scaleX = block.scaleY = block.scaleZ = block.shatterScale * remaining;
+			break;
+		}
 
-		// --- Part 2: Lower Leg (Shin) ---
-		glTranslatef(0.0f, -0.22f, 0.0f);
-		float shin_height = 0.7f;
-		glPushMatrix();
-		glTranslatef(0.0f, -shin_height / 2.0f, 0.0f);
-		{
-			float v[8][3] = {
-				{-0.10f,  shin_height / 2.0f,  0.10f}, { 0.10f,  shin_height / 2.0f,  0.10f},
-				{ 0.10f,  shin_height / 2.0f, -0.10f}, {-0.10f,  shin_height / 2.0f, -0.10f},
-				{-0.14f, -shin_height / 2.0f,  0.14f}, { 0.14f, -shin_height / 2.0f,  0.14f},
-				{ 0.14f, -shin_height / 2.0f, -0.14f}, {-0.14f, -shin_height / 2.0f, -0.14f}
-			};
-			glBegin(GL_QUADS);
-			glNormal3f(0.0, 0.0, 1.0); glVertex3fv(v[0]); glVertex3fv(v[1]); glVertex3fv(v[5]); glVertex3fv(v[4]);
-			glNormal3f(0.0, 0.0, -1.0); glVertex3fv(v[3]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[7]);
-			glNormal3f(-1.0, 0.0, 0.0); glVertex3fv(v[0]); glVertex3fv(v[3]); glVertex3fv(v[7]); glVertex3fv(v[4]);
-			glNormal3f(1.0, 0.0, 0.0); glVertex3fv(v[1]); glVertex3fv(v[2]); glVertex3fv(v[6]); glVertex3fv(v[5]);
-			glEnd();
+		case ACTIVE: {
+			// Motes drifting up from anywhere inside the block
+			int emitCount = getEmitCount(BLOCK_EMITTER, deltaTime);
+			for (int i = 0; i < emitCount; ++i) {
+				spawnParticle(BLOCK_EMITTER, block.posX + randomFloat(-0.5f, 0.5f) * block.scaleX,
+					block.posY + randomFloat(-0.5f, 0.5f) * block.scaleY, block.posZ + randomFloat(-0.5f, 0.5f) * block.scaleZ);
+			}
+			break;
 		}
-		glPopMatrix();
 
-		// --- Part 3: Foot ---
-		glTranslatef(0.0f, -shin_height, 0.0f);
-		glRotatef(5.0f, 1.0f, 0.0f, 0.0f); // Static rotation for foot angle
-		glPushMatrix();
-		{
-			glEnable(GL_TEXTURE_2D);
-			glBindTexture(GL_TEXTURE_2D, g_shoeTextureID);
-			glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+		default:
+			break;
+		}
+	}
+	return !g_liveMatrixBlocks.empty();
+}
 
-			float v[10][3] = {
-				{-0.12f, 0.0f,    0.14f}, {0.12f, 0.0f,    0.14f},
-				{0.12f, 0.0f, -0.25f}, {-0.12f, 0.0f, -0.25f},
-				{-0.12f, -0.15f,  0.14f}, {0.12f, -0.15f,  0.14f},
-				{0.12f, -0.15f, -0.25f}, {-0.12f, -0.15f, -0.25f},
-				{0.0f, -0.15f, 0.4f},
-				{0.0f, -0.15f, -0.4f}
-			};
+// Brings the spatial hash up to date with the block and projectile pools
+void updateSpatialHash()
+{
+	for (int i = 0; i < (int)g_matrixBlocks.size(); ++i) {
+		MatrixBlock& block = g_matrixBlocks[i];
+		if (!block.isActive) {
+			if (block.spatialId >= 0) {
+				spatialRemove(block.spatialId);
+				block.spatialId = -1;
+			}
+			continue;
+		}
+		// Blocks are unit cubes centred on their position, scaled
+		float halfX = block.scaleX * 0.5f, halfZ = block.scaleZ * 0.5f;
+		if (block.spatialId < 0) {
+			block.spatialId = spatialInsert(SPATIAL_BLOCK, i, block.posX - halfX, block.posZ - halfZ, block.posX + halfX, block.posZ + halfZ);
+		}
+		else {
+			spatialUpdate(block.spatialId, block.posX - halfX, block.posZ - halfZ, block.posX + halfX, block.posZ + halfZ);
+		}
+	}
 
-			glBegin(GL_QUADS);
-			// Top face
-			glNormal3f(0.0, 1.0, 0.0);
-			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[0]);
-			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[1]);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[2]);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[3]);
-			// Bottom face
-			glNormal3f(0.0, -1.0, 0.0);
-			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[4]);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[7]);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[6]);
-			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[5]);
-			// Back face
-			glNormal3f(0.0, 0.0, -1.0);
-			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[3]);
-			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[2]);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[6]);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[7]);
-			// Left face
-			glNormal3f(-1.0, 0.0, 0.0);
-			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[0]);
-			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[3]);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[7]);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[4]);
-			// Right face
-			glNormal3f(1.0, 0.0, 0.0);
-			glTexCoord2f(0.0f, 1.0f); glVertex3fv(v[1]);
-			glTexCoord2f(1.0f, 1.0f); glVertex3fv(v[2]);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[6]);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[5]);
-			glEnd();
-			glBegin(GL_TRIANGLES);
-			// Front face
-			glNormal3f(0.0, 0.0, 1.0);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[0]);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[1]);
-			glTexCoord2f(0.5f, 1.0f); glVertex3f(0.0, 0.0, 0.25);
-			// Side triangles front
-			glNormal3f(0.7, -0.3, 0.7);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[1]);
-			glTexCoord2f(1.0f, 0.5f); glVertex3fv(v[8]);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[5]);
-			glNormal3f(-0.7, -0.3, 0.7);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[0]);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[4]);
-			glTexCoord2f(0.0f, 0.5f); glVertex3fv(v[8]);
-			// Side triangles back
-			glNormal3f(0.7, -0.3, -0.7);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[2]);
-			glTexCoord2f(1.0f, 0.5f); glVertex3fv(v[6]);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[9]);
-			glNormal3f(-0.7, -0.3, -0.7);
-			glTexCoord2f(1.0f, 0.0f); glVertex3fv(v[3]);
-			glTexCoord2f(0.0f, 0.0f); glVertex3fv(v[9]);
-			glTexCoord2f(0.0f, 0.5f); glVertex3fv(v[7]);
-			glEnd();
-			glDisable(GL_TEXTURE_2D);
+	SkillProjectilePool& pool = g_skillProjectiles;
+	for (int i = 0; i < pool.count; ++i) {
+		SpatialOBB obb = makeSpatialOBB(pool.posX[i], pool.posZ[i], pool.dirX[i], pool.dirZ[i], SKILL_WIDTH / 2.0f, SKILL_LENGTH / 2.0f);
+		float minX = obb.x - obb.extentX, minZ = obb.z - obb.extentZ, maxX = obb.x + obb.extentX, maxZ = obb.z + obb.extentZ;
+		if (pool.spatialId[i] < 0) {
+			pool.spatialId[i] = spatialInsert(SPATIAL_PROJECTILE, i, minX, minZ, maxX, maxZ);
 		}
-		glPopMatrix();
-		glPopMatrix();
-		};
+		else {
+			spatialUpdate(pool.spatialId[i], minX, minZ, maxX, maxZ);
+		}
+	}
+}
 
-	// --- Animation Calculation ---
-	float rightHipAngle = 0.0f;
-	float rightKneeAngle = 0.0f;
-	float leftHipAngle = 0.0f;
-	float leftKneeAngle = 0.0f;
+// --- Skill vs Block Collisions ---
+// Broadphase is sweep-and-prune along X over the spatial hash's entities.
+// g_sweepOrder persists between frames, so after everything moves a little the
+// insertion sort that restores it is close to linear. The sweep keeps separate
+// active lists for blocks and projectiles so same-type pairs are never even
+// looked at. Candidate pairs that also overlap in Z go to the exact
+// narrowphase: the projectile's oriented rectangle against the block's box.
+const float SKILL_HIT_HEIGHT = 0.5f; // The skill glows along the ground; blocks must reach down to here
+
+// An active list in SoA form so four entries are tested per SSE compare.
+// Entries whose maxX falls behind the sweep stay dead for the rest of the
+// sweep, so they are only counted and swept out once they are half the list.
+struct SweepList {
+	std::vector<float> maxX, minZ, maxZ;
+	std::vector<int> index; // Pool index of the block or projectile
+	int count = 0;
+};
 
-	// Determine the direction the legs should swing for the animation
-	float swingDirection = (float)g_forwardDirection;
-	if (g_forwardDirection == 0 && g_strafeDirection != 0) {
-		swingDirection = 1.0f; // Default to a forward swing animation when strafing
+std::vector<int> g_sweepOrder;            // Spatial entity ids sorted by minX
+SweepList g_sweepActiveBlocks;
+SweepList g_sweepActiveProjectiles;
+
+struct SkillHit {
+	int projectileIndex;
+	int blockIndex;
+};
+
+std::vector<SkillHit> g_skillHits;
+std::vector<SpatialOBB> g_projectileOBBs; // This frame's footprint of each projectile, by pool index
+
+static void updateProjectileOBBs()
+{
+	const SkillProjectilePool& pool = g_skillProjectiles;
+	g_projectileOBBs.resize(pool.count);
+	for (int i = 0; i < pool.count; ++i) {
+		g_projectileOBBs[i] = makeSpatialOBB(pool.posX[i], pool.posZ[i], pool.dirX[i], pool.dirZ[i], SKILL_WIDTH / 2.0f, SKILL_LENGTH / 2.0f);
 	}
+}
 
-	if (swingDirection != 0.0f || (g_strafeDirection != 0 && g_forwardDirection == 0)) {
-		const float WALK_SPEED = 5.0f;
-		const float HIP_SWING_AMPLITUDE = 40.0f;
-		const float KNEE_BEND_AMPLITUDE = 70.0f;
+static bool skillHitsBlock(int projectileIndex, int blockIndex)
+{
+	const MatrixBlock& block = g_matrixBlocks[blockIndex];
+	if (block.state == SHATTERING) return false;
+	// Blocks float at posY, so only hit once expanded far enough to touch the ground
+	if (block.posY - block.scaleY * 0.5f > SKILL_HIT_HEIGHT) return false;
 
-		float animationDriver = (swingDirection != 0.0f) ? swingDirection : 1.0f;
+	return spatialBoxOverlapsOBB(g_spatialHash.entities[block.spatialId], g_projectileOBBs[projectileIndex]);
+}
 
-		rightHipAngle = sin(g_animationTime * WALK_SPEED) * HIP_SWING_AMPLITUDE * animationDriver;
-		rightKneeAngle = max(0.0f, sin(g_animationTime * WALK_SPEED) * animationDriver) * KNEE_BEND_AMPLITUDE;
+// Restores g_sweepOrder from the live spatial entities: drops freed ids,
+// appends new ones and re-sorts by minX
+static void refreshSweepOrder()
+{
+	std::vector<SpatialEntity>& entities = g_spatialHash.entities;
+	size_t kept = 0;
+	for (int id : g_sweepOrder) {
+		if (entities[id].inUse) {
+			g_sweepOrder[kept++] = id;
+		}
+		else {
+			entities[id].sweepListed = false;
+		}
+	}
+	g_sweepOrder.resize(kept);
+	for (int id = 0; id < (int)entities.size(); ++id) {
+		SpatialEntity& e = entities[id];
+		if (e.inUse && !e.sweepListed && e.type != SPATIAL_OTHER) {
+			e.sweepListed = true;
+			g_sweepOrder.push_back(id);
+		}
+	}
 
-		leftHipAngle = -rightHipAngle;
-		leftKneeAngle = max(0.0f, sin(g_animationTime * WALK_SPEED + 3.14159f) * animationDriver) * KNEE_BEND_AMPLITUDE;
+	// Insertion sort: nearly free when the order barely changed since last frame
+	for (size_t i = 1; i < g_sweepOrder.size(); ++i) {
+		int id = g_sweepOrder[i];
+		float minX = entities[id].minX;
+		size_t j = i;
+		while (j > 0 && entities[g_sweepOrder[j - 1]].minX > minX) {
+			g_sweepOrder[j] = g_sweepOrder[j - 1];
+			--j;
+		}
+		g_sweepOrder[j] = id;
 	}
+}
 
-	// --- Draw Left Leg ---
-	glPushMatrix();
-	glTranslatef(-0.18f, -1.0f, 0.0f);
-	drawOneLeg(leftHipAngle, leftKneeAngle);
-	glPopMatrix();
+static void resetSweepList(SweepList& list, size_t capacity)
+{
+	// Padded by 4 so the last SSE load never reads past the end
+	list.maxX.resize(capacity + 4);
+	list.minZ.resize(capacity + 4);
+	list.maxZ.resize(capacity + 4);
+	list.index.resize(capacity + 4);
+	list.count = 0;
+}
 
-	// --- Draw Right Leg ---
-	glPushMatrix();
-	glTranslatef(0.18f, -1.0f, 0.0f);
-	drawOneLeg(rightHipAngle, rightKneeAngle);
-	glPopMatrix();
+static void pushSweepList(SweepList& list, const SpatialEntity& e)
+{
+	list.maxX[list.count] = e.maxX;
+	list.minZ[list.count] = e.minZ;
+	list.maxZ[list.count] = e.maxZ;
+	list.index[list.count] = e.index;
+	list.count++;
 }
 
-void drawSkyBackground(int winW, int winH)
+static void compactSweepList(SweepList& list, float sweepX)
 {
-	// Save matrices
-	glMatrixMode(GL_PROJECTION);
-	glPushMatrix();
-	glLoadIdentity();
-	glOrtho(0, winW, 0, winH, -1, 1);   // 2D screen space
+	int kept = 0;
+	for (int k = 0; k < list.count; ++k) {
+		if (list.maxX[k] < sweepX) continue;
+		list.maxX[kept] = list.maxX[k];
+		list.minZ[kept] = list.minZ[k];
+		list.maxZ[kept] = list.maxZ[k];
+		list.index[kept] = list.index[k];
+		kept++;
+	}
+	list.count = kept;
+}
 
-	glMatrixMode(GL_MODELVIEW);
-	glPushMatrix();
-	glLoadIdentity();
+// Tests entity e against everything in the other type's active list
+static void sweepAgainst(SweepList& others, const SpatialEntity& e, bool isBlock)
+{
+	const __m128 minX = _mm_set1_ps(e.minX), minZ = _mm_set1_ps(e.minZ), maxZ = _mm_set1_ps(e.maxZ);
+	int dead = 0;
+	for (int k = 0; k < others.count; k += 4) {
+		__m128 alive = _mm_cmpge_ps(_mm_loadu_ps(&others.maxX[k]), minX);
+		__m128 overlapsZ = _mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(&others.maxZ[k]), minZ), _mm_cmple_ps(_mm_loadu_ps(&others.minZ[k]), maxZ));
+		int lanes = others.count - k >= 4 ? 0xF : (1 << (others.count - k)) - 1;
+		int aliveMask = _mm_movemask_ps(alive) & lanes;
+		int overlapMask = _mm_movemask_ps(_mm_and_ps(alive, overlapsZ)) & lanes;
+		int deadMask = lanes & ~aliveMask;
+		dead += (deadMask & 1) + (deadMask >> 1 & 1) + (deadMask >> 2 & 1) + (deadMask >> 3);
+
+		while (overlapMask) {
+			unsigned long lane;
+			_BitScanForward(&lane, (unsigned long)overlapMask);
+			overlapMask &= overlapMask - 1;
+			int otherIndex = others.index[k + lane];
+			int projectileIndex = isBlock ? otherIndex : e.index;
+			int blockIndex = isBlock ? e.index : otherIndex;
+			if (skillHitsBlock(projectileIndex, blockIndex)) {
+				pushHighWater(g_skillHits, SkillHit{ projectileIndex, blockIndex });
+			}
+		}
+	}
+	if (dead * 2 > others.count) compactSweepList(others, e.minX);
+}
 
-	// Draw without lighting/depth and don't write depth
-	glDisable(GL_LIGHTING);
-	glDisable(GL_DEPTH_TEST);
-	glDepthMask(GL_FALSE);
+// Fills g_skillHits with every projectile/block pair that touches this frame
+void sweepSkillCollisions()
+{
+	refreshSweepOrder();
+	updateProjectileOBBs();
+	g_skillHits.clear();
+	resetSweepList(g_sweepActiveBlocks, g_sweepOrder.size());
+	resetSweepList(g_sweepActiveProjectiles, g_sweepOrder.size());
+
+	// Everything in the other list started before the current entity; only
+	// those that have not also ended before it can overlap in X
+	const std::vector<SpatialEntity>& entities = g_spatialHash.entities;
+	for (int id : g_sweepOrder) {
+		const SpatialEntity& e = entities[id];
+		bool isBlock = e.type == SPATIAL_BLOCK;
+		sweepAgainst(isBlock ? g_sweepActiveProjectiles : g_sweepActiveBlocks, e, isBlock);
+		pushSweepList(isBlock ? g_sweepActiveBlocks : g_sweepActiveProjectiles, e);
+	}
+}
 
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, g_skyTextureID);
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+// A hit block starts shattering and throws out a burst of skill-coloured sparks
+void resolveSkillCollisions()
+{
+	for (const SkillHit& hit : g_skillHits) {
+		MatrixBlock& block = g_matrixBlocks[hit.blockIndex];
+		if (block.state == SHATTERING) continue; // Already hit by another projectile this frame
+
+		enterBlockPhase(hit.blockIndex, SHATTERING);
+		for (int i = 0; i < 200; ++i) {
+			spawnParticle(BLOCK_BURST_EMITTER, block.posX, block.posY, block.posZ);
+			spawnParticle(SKILL_EMITTER, block.posX, block.posY - block.scaleY * 0.5f, block.posZ);
+		}
+	}
+}
 
-	glBegin(GL_QUADS);
-	// NOTE: If your BMP shows upside-down, swap the V coords (0 ↔ 1)
-	glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
-	glTexCoord2f(1.0f, 0.0f); glVertex2f((float)winW, 0.0f);
-	glTexCoord2f(1.0f, 1.0f); glVertex2f((float)winW, (float)winH);
-	glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, (float)winH);
-	glEnd();
+void drawMatrixBlocks() {
+	capturePickBlocks();
+	for (const auto& block : g_matrixBlocks) {
+		if (block.isActive) {
+			drawSingleMatrixBlock(block);
+		}
+	}
+}
 
-	glDisable(GL_TEXTURE_2D);
+// Sizes everything the frame loop appends to for its pools at capacity, so
+// steady-state frames never reallocate. Called once at startup.
+void reserveFrameStorage()
+{
+	const size_t maxEntities = MAX_SKILL_PROJECTILES + MAX_MATRIX_BLOCKS;
+	g_matrixBlocks.reserve(MAX_MATRIX_BLOCKS);
+	g_liveMatrixBlocks.reserve(MAX_MATRIX_BLOCKS);
+	g_freeMatrixBlocks.reserve(MAX_MATRIX_BLOCKS);
+	g_phaseEvents.reserve(MAX_MATRIX_BLOCKS); // Each block's next phase; superseded ones are cancelled
+	g_scheduledPlayers.reserve(16);
+	g_spatialHash.entities.reserve(maxEntities);
+	g_spatialHash.freeIds.reserve(maxEntities);
+	g_sweepOrder.reserve(maxEntities);
+	for (SweepList* list : { &g_sweepActiveBlocks, &g_sweepActiveProjectiles }) {
+		list->maxX.reserve(maxEntities + 4);
+		list->minZ.reserve(maxEntities + 4);
+		list->maxZ.reserve(maxEntities + 4);
+		list->index.reserve(maxEntities + 4);
+	}
+	g_projectileOBBs.reserve(MAX_SKILL_PROJECTILES);
+	g_skillHits.reserve(MAX_SKILL_PROJECTILES);
+	g_pickBVH.leaves.reserve(PICK_PART_COUNT + MAX_MATRIX_BLOCKS);
+	g_pickBVH.nodes.reserve(PICK_PART_COUNT + MAX_MATRIX_BLOCKS);
+	g_pickBVH.buildLeaves.reserve(PICK_PART_COUNT + MAX_MATRIX_BLOCKS);
+	g_textureLoader.requests.reserve(TEX_COUNT);
+	g_textureLoader.completed.reserve(TEX_COUNT);
+}
 
-	// Restore state
-	glDepthMask(GL_TRUE);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_LIGHTING);
+// --- Animation Scheduler: tasks ---
+typedef bool (*AnimTaskTick)(float deltaTime); // Returns false once the task has nothing left to animate
 
-	glPopMatrix(); // MODELVIEW
-	glMatrixMode(GL_PROJECTION);
-	glPopMatrix();
-	glMatrixMode(GL_MODELVIEW); // leave modelview active
+static bool tickPose(float)
+{
+	updateBlendTree(ANIM_LOD_LEVELS[g_animLOD.level].snapHands);
+	return false; // Runs again only when something changes an input
 }
 
-void updateHandAnimation(float deltaTime)
+static bool tickSkillProjectiles(float deltaTime)
 {
-	// If the animation isn't active, do nothing.
-	if (!g_isFistAnimating) {
-		return;
+	updateSkillProjectiles(deltaTime);
+	emitSkillParticles(deltaTime);
+	return g_skillProjectiles.count > 0;
+}
+
+// Runs one frame past the last projectile or block, so the hash drops their entries
+static bool tickCollisions(float)
+{
+	updateSpatialHash();
+	sweepSkillCollisions();
+	resolveSkillCollisions();
+	return g_skillProjectiles.count > 0 || !g_liveMatrixBlocks.empty();
+}
+
+static bool tickParticles(float deltaTime)
+{
+	updateParticles(deltaTime);
+	return g_particles.count > 0;
+}
+
+static bool tickHalo(float deltaTime)
+{
+	if (!g_isHaloAnimating) return false; // Reset while in flight
+	const float HALO_MOVE_SPEED = 5.0f;
+	const float HALO_SCALE_SPEED = 2.0f;
+	const float HALO_DISAPPEAR_Z = 4.0f;
+	g_haloZ += HALO_MOVE_SPEED * deltaTime;
+	g_haloScale += HALO_SCALE_SPEED * deltaTime;
+	g_animatedLightPos[2] += HALO_MOVE_SPEED * deltaTime;
+	if (g_haloZ > HALO_DISAPPEAR_Z) {
+		g_isHaloVisible = false;
+		g_isHaloAnimating = false;
+	}
+	return g_isHaloAnimating;
+}
+
+const AnimTaskTick ANIM_TASK_TICKS[TASK_COUNT] = {
+	tickClipPlayers, tickPose, tickSkillProjectiles, tickMatrixBlocks, tickCollisions, tickParticles, tickHalo
+};
+
+// Ticks the active tasks in AnimTaskId order. A task can start a later one
+// (a clip re-blending the pose, a block spawning particles) for this same frame.
+void runAnimationTasks(float deltaTime)
+{
+	g_animClock += deltaTime;
+	unsigned int pending = g_activeAnimTasks;
+	unsigned long task;
+	while (_BitScanForward(&task, pending)) {
+		if (!ANIM_TASK_TICKS[task](deltaTime)) {
+			g_activeAnimTasks &= ~(1u << task);
+		}
+		pending = g_activeAnimTasks & ~((2u << task) - 1);
 	}
+}
 
-	const float FIST_ANIMATION_SPEED = 2.5f; // Controls how fast the hand opens/closes
+// --- Dynamic Resolution ---
+// The scene is drawn into an offscreen target at a fraction of the window
+// size and upscaled onto it at the end of the frame. The target is allocated
+// at the full window size, so a scale change only changes the viewport; a
+// resize reallocates it. The scale is one of the quality governor's knobs
+// (g_renderScalePercent). The upscale is bilinear, sharpened by a small GLSL
+// filter in proportion to how far the image was scaled when shaders are
+// available ("--upscale=bilinear" turns that off). Without framebuffer
+// objects (GL 1.1) the frame is drawn into the lower-left corner of the back
+// buffer instead, copied into a power-of-two texture with
+// glCopyTexSubImage2D and upscaled from there.
+const float DYNRES_MIN_SCALE = 0.5f;
+const float DYNRES_SHARPNESS = 0.5f;    // Sharpening at half resolution; none at full
+
+int g_renderScalePercent = 100;
+
+struct DynamicResolution {
+	GLuint framebuffer = 0, colorTexture = 0, depthBuffer = 0; // No framebuffer: copied from the back buffer
+	int allocatedWidth = 0, allocatedHeight = 0;
+	int windowWidth = 0, windowHeight = 0; // Window size the target was allocated for
+	float scale = 1.0f;
+	int width = 0, height = 0; // This frame's render size
+	bool useSharpen = true;
+	GLuint sharpenProgram = 0;
+	GLint texelSizeLocation = -1, texCoordMaxLocation = -1, sharpnessLocation = -1;
+};
 
-	// Determine the direction of the animation
-	// If the target is 'closed', progress moves towards 1.0
-	// If the target is 'open', progress moves towards 0.0
-	float direction = g_isFistTargetClosed ? 1.0f : -1.0f;
+DynamicResolution g_dynamicResolution;
+
+// Four-neighbour unsharp mask over the bilinear upscale, clamped to the rendered rectangle
+static const char* SHARPEN_FRAGMENT_SHADER =
+	"#version 120\n"
+	"uniform sampler2D source;\n"
+	"uniform vec2 texelSize;\n"
+	"uniform vec2 texCoordMax;\n"
+	"uniform float sharpness;\n"
+	"vec3 tap(vec2 uv) { return texture2D(source, clamp(uv, texelSize * 0.5, texCoordMax)).rgb; }\n"
+	"void main() {\n"
+	"	vec2 uv = gl_TexCoord[0].st;\n"
+	"	vec3 centre = tap(uv);\n"
+	"	vec3 neighbours = tap(uv + vec2(texelSize.x, 0.0)) + tap(uv - vec2(texelSize.x, 0.0)) +\n"
+	"		tap(uv + vec2(0.0, texelSize.y)) + tap(uv - vec2(0.0, texelSize.y));\n"
+	"	gl_FragColor = vec4(clamp(centre + (centre * 4.0 - neighbours) * sharpness, 0.0, 1.0), 1.0);\n"
+	"}\n";
+
+void shutdownDynamicResolution()
+{
+	DynamicResolution& dr = g_dynamicResolution;
+	if (dr.framebuffer) glDeleteFramebuffers(1, &dr.framebuffer);
+	if (dr.depthBuffer) glDeleteRenderbuffers(1, &dr.depthBuffer);
+	if (dr.colorTexture) glDeleteTextures(1, &dr.colorTexture);
+	if (dr.sharpenProgram) glDeleteProgram(dr.sharpenProgram);
+	dr.framebuffer = dr.depthBuffer = dr.colorTexture = dr.sharpenProgram = 0;
+	dr.allocatedWidth = dr.allocatedHeight = 0;
+	dr.windowWidth = dr.windowHeight = 0;
+}
 
-	// Update the progress
-	g_fistAnimationProgress += direction * FIST_ANIMATION_SPEED * deltaTime;
+// Smallest power of two not below 'size'
+static int ceilPowerOfTwo(int size)
+{
+	int pot = 1;
+	while (pot < size) pot *= 2;
+	return pot;
+}
 
-	// Clamp the progress to the [0, 1] range and stop the animation when it reaches the target
-	if (g_fistAnimationProgress >= 1.0f) {
-		g_fistAnimationProgress = 1.0f;
-		g_isFistAnimating = false; // Reached the 'closed' state
+// (Re)creates the target at the window size; returns false if the driver refuses it
+static bool allocateDynamicResolutionTarget(int width, int height)
+{
+	DynamicResolution& dr = g_dynamicResolution;
+	dr.windowWidth = width;
+	dr.windowHeight = height;
+	if (!g_hasFBO) {
+		// Only a texture to copy into, with the power-of-two sides GL 1.1 needs
+		width = ceilPowerOfTwo(width);
+		height = ceilPowerOfTwo(height);
+		if (g_maxTextureSize > 0) {
+			width = min(width, (int)g_maxTextureSize);
+			height = min(height, (int)g_maxTextureSize);
+		}
+	}
+	if (!dr.colorTexture) {
+		glGenTextures(1, &dr.colorTexture);
+		if (g_hasFBO) {
+			glGenFramebuffers(1, &dr.framebuffer);
+			glGenRenderbuffers(1, &dr.depthBuffer);
+		}
 	}
-	else if (g_fistAnimationProgress <= 0.0f) {
-		g_fistAnimationProgress = 0.0f;
-		g_isFistAnimating = false; // Reached the 'open' state
+	glBindTexture(GL_TEXTURE_2D, dr.colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	dr.allocatedWidth = width;
+	dr.allocatedHeight = height;
+	if (!g_hasFBO) return true;
+
+	glBindRenderbuffer(GL_RENDERBUFFER, dr.depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, dr.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dr.colorTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, dr.depthBuffer);
+	bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!isComplete) {
+		OutputDebugStringA("Warning: dynamic resolution target is incomplete, drawing at full resolution.\n");
+		shutdownDynamicResolution();
+		return false;
+	}
+	return true;
+}
+
+void initDynamicResolution()
+{
+	DynamicResolution& dr = g_dynamicResolution;
+	if (!allocateDynamicResolutionTarget(g_windowWidth, g_windowHeight)) return;
+	if (dr.useSharpen && g_hasGLSL) {
+		GLuint shader = compileShader(GL_FRAGMENT_SHADER, SHARPEN_FRAGMENT_SHADER);
+		if (shader) dr.sharpenProgram = linkProgram(&shader, 1, nullptr, 0);
+		if (dr.sharpenProgram) {
+			dr.texelSizeLocation = glGetUniformLocation(dr.sharpenProgram, "texelSize");
+			dr.texCoordMaxLocation = glGetUniformLocation(dr.sharpenProgram, "texCoordMax");
+			dr.sharpnessLocation = glGetUniformLocation(dr.sharpenProgram, "sharpness");
+		}
 	}
 }
 
-void drawNuwaSkill()
+// Binds the target and sets the viewport; the frame is drawn at width x height
+void beginDynamicResolutionFrame()
 {
-	// Don't draw if the skill is not active
-	if (!g_isNuwaSkillActive) {
+	DynamicResolution& dr = g_dynamicResolution;
+	dr.scale = max(DYNRES_MIN_SCALE, min(1.0f, g_renderScalePercent / 100.0f));
+	if (dr.colorTexture && (dr.windowWidth != g_windowWidth || dr.windowHeight != g_windowHeight)) {
+		allocateDynamicResolutionTarget(g_windowWidth, g_windowHeight);
+	}
+	if (!dr.colorTexture) {
+		dr.width = g_windowWidth;
+		dr.height = g_windowHeight;
+		glViewport(0, 0, dr.width, dr.height);
 		return;
 	}
+	// Whole multiples of 8 pixels, so the size does not creep a pixel at a time
+	dr.width = max(8, ((int)(g_windowWidth * dr.scale) + 4) & ~7);
+	dr.height = max(8, ((int)(g_windowHeight * dr.scale) + 4) & ~7);
+	dr.width = min(dr.width, min(g_windowWidth, dr.allocatedWidth));
+	dr.height = min(dr.height, min(g_windowHeight, dr.allocatedHeight));
+	if (dr.framebuffer) glBindFramebuffer(GL_FRAMEBUFFER, dr.framebuffer);
+	glViewport(0, 0, dr.width, dr.height);
+}
 
-	// --- Setup for transparent, glowing effect ---
-	glPushMatrix();
-	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT); // Save state
+// Upscales the rendered rectangle onto the window
+void endDynamicResolutionFrame()
+{
+	DynamicResolution& dr = g_dynamicResolution;
+	if (!dr.colorTexture) return;
+	if (dr.framebuffer) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	else if (dr.width == g_windowWidth && dr.height == g_windowHeight) {
+		return; // Drawn straight into the window at full size
+	}
+	glViewport(0, 0, g_windowWidth, g_windowHeight);
 
-	glEnable(GL_BLEND);
-	// Additive blending makes bright parts glow and ignore black parts of the texture
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-	glDisable(GL_LIGHTING); // Effects like this usually aren't affected by scene lighting
-	glDepthMask(GL_FALSE);  // Don't write to the depth buffer to avoid z-fighting with the ground
+	glPushAttrib(GL_ENABLE_BIT | GL_DEPTH_BUFFER_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_BLEND);
+	glDisable(GL_ALPHA_TEST);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, dr.colorTexture);
+	if (!dr.framebuffer) {
+		// The rectangle is still in the back buffer's corner; the quad then covers it
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, dr.width, dr.height);
+	}
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0.0, 1.0, 0.0, 1.0, -1.0, 1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
 
-	// --- Position the skill in the world ---
-	// 1. Move to the location where the character cast the skill
-	glTranslatef(g_characterCastPosX, 0.02f, g_characterCastPosZ); // 0.02f Y to prevent z-fighting
-	// 2. Rotate to face the direction the character was facing
-	glRotatef(g_characterAngleOnCast, 0.0f, 1.0f, 0.0f);
-	// 3. Move the skill forward based on its travel distance
-	glTranslatef(0.0f, 0.0f, -g_nuwaSkillDistance);
-
-	// --- Define skill dimensions ---
-	const float SKILL_WIDTH = 2.0f;
-	const float SKILL_LENGTH = 8.0f;
-	float halfW = SKILL_WIDTH / 2.0f;
-	float halfL = SKILL_LENGTH / 2.0f;
-
-	// --- Layer 1: The semi-transparent base rectangle ---
-	glColor4f(1.0f, 0.8f, 0.4f, 0.3f); // A soft, transparent orange-gold
+	// Texel centres at the rectangle's edges, so nothing outside it bleeds in
+	float texelU = 1.0f / dr.allocatedWidth, texelV = 1.0f / dr.allocatedHeight;
+	float u0 = 0.5f * texelU, v0 = 0.5f * texelV;
+	float u1 = (dr.width - 0.5f) * texelU, v1 = (dr.height - 0.5f) * texelV;
+	if (dr.sharpenProgram && dr.width < g_windowWidth) {
+		glUseProgram(dr.sharpenProgram);
+		glUniform2f(dr.texelSizeLocation, texelU, texelV);
+		glUniform2f(dr.texCoordMaxLocation, u1, v1);
+		glUniform1f(dr.sharpnessLocation, DYNRES_SHARPNESS * (1.0f - dr.scale) / (1.0f - DYNRES_MIN_SCALE));
+	}
 	glBegin(GL_QUADS);
-	glVertex3f(-halfW, 0.0f, halfL);
-	glVertex3f(halfW, 0.0f, halfL);
-	glVertex3f(halfW, 0.0f, -halfL);
-	glVertex3f(-halfW, 0.0f, -halfL);
+	glTexCoord2f(u0, v0); glVertex2f(0.0f, 0.0f);
+	glTexCoord2f(u1, v0); glVertex2f(1.0f, 0.0f);
+	glTexCoord2f(u1, v1); glVertex2f(1.0f, 1.0f);
+	glTexCoord2f(u0, v1); glVertex2f(0.0f, 1.0f);
 	glEnd();
+	if (dr.sharpenProgram) glUseProgram(0);
 
-	// --- Layer 2: The bright border ---
-	glLineWidth(3.0f);
-	glColor4f(1.0f, 0.9f, 0.7f, 0.8f); // A brighter, more solid gold
-	glBegin(GL_LINE_LOOP);
-	glVertex3f(-halfW, 0.0f, halfL);
-	glVertex3f(halfW, 0.0f, halfL);
-	glVertex3f(halfW, 0.0f, -halfL);
-	glVertex3f(-halfW, 0.0f, -halfL);
-	glEnd();
-	glLineWidth(1.0f);
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+}
 
-	// --- Layer 3: The geometric patterns using the texture ---
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, g_nuwaSkillTextureID);
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+// --- Quality Governor ---
+// One controller for every scalable cost. Each knob registers an int and its
+// value at each quality level (0 is full quality); the governor watches a
+// smoothed frame time against the budget ("--frame-budget-ms=N" or
+// "--target-fps=N") and moves all knobs one level at a time. Hysteresis:
+// a level is dropped only after the budget has been missed for a while, and
+// raised only after a longer spell well under it; every change is followed by
+// a cooldown, and a drop soon after a raise doubles the wait before the next
+// raise, so a scene sitting on the edge does not flip every second. Each
+// decision is logged with the knobs it changed. The preset's quality level
+// is where it starts and the best level it will go back up to.
+const int MAX_QUALITY_KNOBS = 8;
+const float QUALITY_SMOOTHING = 0.05f;          // Weight of the newest frame in the moving average
+const float QUALITY_DEGRADE_SECONDS = 0.5f;     // Over budget this long before dropping a level
+const float QUALITY_UPGRADE_SECONDS = 3.0f;     // Under the headroom this long before raising one
+const float QUALITY_MAX_UPGRADE_SECONDS = 30.0f;
+const float QUALITY_UPGRADE_HEADROOM = 0.75f;   // Raise only below this fraction of the budget
+const float QUALITY_COOLDOWN_SECONDS = 1.0f;    // Frame time settles after a change before it is judged again
+const float QUALITY_OSCILLATION_SECONDS = 5.0f; // A drop this soon after a raise means the raise did not fit
+
+struct QualityKnob {
+	const char* name;
+	int* value;
+	int levels[QUALITY_LEVEL_COUNT];
+};
 
-	glColor4f(1.0f, 0.85f, 0.5f, 1.0f); // Bright gold tint for the texture pattern
-	glBegin(GL_QUADS);
-	// We repeat the texture 4 times along its length for more detail
-	glTexCoord2f(0.0f, 4.0f); glVertex3f(-halfW, 0.0f, halfL);
-	glTexCoord2f(1.0f, 4.0f); glVertex3f(halfW, 0.0f, halfL);
-	glTexCoord2f(1.0f, 0.0f); glVertex3f(halfW, 0.0f, -halfL);
-	glTexCoord2f(0.0f, 0.0f); glVertex3f(-halfW, 0.0f, -halfL);
-	glEnd();
+struct QualityGovernor {
+	QualityKnob knobs[MAX_QUALITY_KNOBS];
+	int knobCount = 0;
+	int level = 0;
+	float budgetMs = 1000.0f / 30.0f;
+	float smoothedFrameMs = 0.0f;
+	float overBudgetSeconds = 0.0f, underBudgetSeconds = 0.0f;
+	float cooldownSeconds = 0.0f;
+	float sinceUpgradeSeconds = 1e9f;
+	float upgradeSeconds = QUALITY_UPGRADE_SECONDS;
+};
 
-	// --- Restore OpenGL state ---
-	glPopAttrib();
-	glPopMatrix();
+QualityGovernor g_qualityGovernor;
+
+void registerQualityKnob(const char* name, int* value, const int (&levels)[QUALITY_LEVEL_COUNT])
+{
+	QualityGovernor& qg = g_qualityGovernor;
+	if (qg.knobCount >= MAX_QUALITY_KNOBS) return;
+	QualityKnob& knob = qg.knobs[qg.knobCount++];
+	knob.name = name;
+	knob.value = value;
+	for (int i = 0; i < QUALITY_LEVEL_COUNT; ++i) knob.levels[i] = levels[i];
+	*value = levels[qg.level];
 }
 
-void updateNuwaSkill(float deltaTime)
+// Sets every knob for the governor's level and logs what moved
+static void applyQualityLevel(int previousLevel)
 {
-	if (!g_isNuwaSkillActive) {
-		return;
+	QualityGovernor& qg = g_qualityGovernor;
+	char message[512];
+	int length = sprintf_s(message, "Quality %d -> %d (%.1f ms smoothed, budget %.1f ms):",
+		previousLevel, qg.level, qg.smoothedFrameMs, qg.budgetMs);
+	for (int i = 0; i < qg.knobCount; ++i) {
+		QualityKnob& knob = qg.knobs[i];
+		int value = knob.levels[qg.level];
+		if (*knob.value == value) continue;
+		if (length > 0 && length < (int)sizeof(message)) {
+			int written = sprintf_s(message + length, sizeof(message) - length, " %s %d -> %d,", knob.name, *knob.value, value);
+			if (written > 0) length += written;
+		}
+		*knob.value = value;
 	}
+	if (length > 0 && message[length - 1] == ',') --length;
+	if (length > 0 && length < (int)sizeof(message) - 1) {
+		message[length] = '\n';
+		message[length + 1] = '\0';
+	}
+	OutputDebugStringA(message);
+
+	// The braid keeps its length: fewer, longer links, with the sway resized on the next update
+	g_braidSegmentLength = BRAID_LENGTH / g_numBraidSegments - BRAID_SEGMENT_GAP;
+	g_animLOD.primed[MOTION_BRAID] = false;
+}
+
+// Mesh detail per level. Passes drawn into small offscreen targets use the last one.
+const int QUALITY_MESH_DETAIL_PERCENT[QUALITY_LEVEL_COUNT] = { 100, 100, 100, 75, 60, 50 };
 
-	const float SKILL_SPEED = 15.0f; // How fast it travels (units per second)
-	const float SKILL_MAX_LIFETIME = 3.0f; // How long it lasts in seconds
+void initQualityGovernor()
+{
+	static const int particleCaps[QUALITY_LEVEL_COUNT] = { MAX_PARTICLES, 32768, 16384, 8192, 4096, 2048 };
+	static const int haloRingSteps[QUALITY_LEVEL_COUNT] = { 1, 1, 2, 2, 3, 3 };
+	static const int sashSegments[QUALITY_LEVEL_COUNT] = { SASH_SEGMENTS, 30, 15, 15, 10, 10 };
+	static const int braidSegments[QUALITY_LEVEL_COUNT] = { 15, 15, 15, 10, 8, 6 };
+	static const int renderScale[QUALITY_LEVEL_COUNT] = { 100, 100, 85, 75, 60, 50 };
+	g_qualityGovernor.level = g_config.bestQualityLevel;
+	// Cheapest visual loss first: particles and render scale give the most back
+	registerQualityKnob("particle cap", &g_particleCap, particleCaps);
+	registerQualityKnob("render scale %", &g_renderScalePercent, renderScale);
+	registerQualityKnob("halo ring step", &g_haloRingStep, haloRingSteps);
+	registerQualityKnob("sash segments", &g_sashSegments, sashSegments);
+	registerQualityKnob("braid segments", &g_numBraidSegments, braidSegments);
+	registerQualityKnob("mesh detail %", &g_meshDetailPercent, QUALITY_MESH_DETAIL_PERCENT);
+	g_braidSegmentLength = BRAID_LENGTH / g_numBraidSegments - BRAID_SEGMENT_GAP;
+}
+
+// Feeds the governor with the last frame's time
+void updateQualityGovernor(float deltaTime)
+{
+	QualityGovernor& qg = g_qualityGovernor;
+	// Clamped so one hitch (a texture upload, the window being dragged) counts as a slow frame, not a disaster
+	float frameMs = min(deltaTime * 1000.0f, qg.budgetMs * 4.0f);
+	qg.smoothedFrameMs = qg.smoothedFrameMs == 0.0f ? frameMs : qg.smoothedFrameMs + (frameMs - qg.smoothedFrameMs) * QUALITY_SMOOTHING;
+	qg.sinceUpgradeSeconds += deltaTime;
+	if (qg.cooldownSeconds > 0.0f) {
+		qg.cooldownSeconds -= deltaTime;
+		return;
+	}
 
-	// Move the skill forward
-	g_nuwaSkillDistance += SKILL_SPEED * deltaTime;
+	qg.overBudgetSeconds = qg.smoothedFrameMs > qg.budgetMs ? qg.overBudgetSeconds + deltaTime : 0.0f;
+	qg.underBudgetSeconds = qg.smoothedFrameMs < qg.budgetMs * QUALITY_UPGRADE_HEADROOM ? qg.underBudgetSeconds + deltaTime : 0.0f;
 
-	// Reduce its lifetime
-	g_nuwaSkillLifetime -= deltaTime;
-	if (g_nuwaSkillLifetime <= 0.0f) {
-		g_isNuwaSkillActive = false; // Deactivate the skill when time runs out
+	int previousLevel = qg.level;
+	if (qg.overBudgetSeconds > QUALITY_DEGRADE_SECONDS && qg.level < QUALITY_LEVEL_COUNT - 1) {
+		++qg.level;
+		if (qg.sinceUpgradeSeconds < QUALITY_OSCILLATION_SECONDS) {
+			qg.upgradeSeconds = min(QUALITY_MAX_UPGRADE_SECONDS, qg.upgradeSeconds * 2.0f);
+		}
+	}
+	else if (qg.underBudgetSeconds > qg.upgradeSeconds && qg.level > g_config.bestQualityLevel) {
+		--qg.level;
+		qg.sinceUpgradeSeconds = 0.0f;
 	}
+	if (qg.level == previousLevel) return;
+	applyQualityLevel(previousLevel);
+	qg.overBudgetSeconds = qg.underBudgetSeconds = 0.0f;
+	qg.cooldownSeconds = QUALITY_COOLDOWN_SECONDS;
 }
 
-void updateArmCastingAnimation(float deltaTime)
+// Everything that moves with the character, under the character's modelview
+void drawCharacterBody()
 {
-	const float DURATION_WINDUP = 0.4f;
-	const float DURATION_HOLD = 0.8f;
-	const float DURATION_RECOVER = 0.6f;
+	drawSmoothChest();
+	drawWaistWithVerticalLines();
+	drawSmoothLowerBodyAndSkirt();
+	drawLegs();
+
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(-1.0f, -1.0f);
+	drawWaistBelt();
+	glDisable(GL_POLYGON_OFFSET_FILL);
 
-	g_armAnimationTimer += deltaTime;
-	float armProgress = 0.0f; // Separate progress for arm movement
+	drawArmorCollar();
+	drawSmoothArms();
+	drawCurvedShoulderPads();
+	drawBackSashes();
 
-	switch (g_armAnimationState)
-	{
-	case 0: // Idle state: Arms down, hands naturally slightly curled (as per your image)
-		// NEW: Ensure hands are in the "idle curled" position.
-		// We'll set a default progress that represents this slight curl.
-		break;
+	glPushMatrix();
+	drawNeck();
+	drawFace();
+	drawBraid(1.25f, -0.3f);
+	drawHalo();
+	glPopMatrix();
+}
 
-	case 1: // Windup: Raising arms
-		armProgress = g_armAnimationTimer / DURATION_WINDUP;
-		if (armProgress >= 1.0f) {
-			armProgress = 1.0f;
-			g_armAnimationState = 2; // 直接进入下一个动画状态
-			g_armAnimationTimer = 0.0f;
+// --- Impostors ---
+// Far away, a character is drawn as one camera-facing quad instead of the full
+// hierarchy. The current pose is rendered into an atlas from a ring of view
+// angles at two heights; a far character samples the view nearest to the
+// camera's direction in its own space, drawn at the governor's lowest mesh
+// detail. The atlas is re-rendered when the pose moves meaningfully (a joint
+// turns or the walk cycle advances), but no more often than every
+// IMPOSTOR_MIN_INTERVAL_FRAMES, and every couple of seconds anyway, for the
+// secondary motion and for textures that were still streaming at the last
+// capture. Between
+// IMPOSTOR_FADE_START and IMPOSTOR_FADE_END the mesh and the impostor
+// crossfade with complementary polygon stipples, so the two never blend and
+// neither needs sorting. "--crowd=N" adds N characters standing behind Nuwa,
+// sharing her pose, to exercise this; all the far ones go out in one draw.
+const int IMPOSTOR_YAW_VIEWS = 8;
+const int IMPOSTOR_PITCH_VIEWS = 2;
+const float IMPOSTOR_PITCHES[IMPOSTOR_PITCH_VIEWS] = { 0.0f, 30.0f }; // Degrees the camera looks down
+const int IMPOSTOR_TILE_WIDTH = 128;
+const int IMPOSTOR_TILE_HEIGHT = 256;
+const int IMPOSTOR_ATLAS_WIDTH = IMPOSTOR_TILE_WIDTH * IMPOSTOR_YAW_VIEWS;
+const int IMPOSTOR_ATLAS_HEIGHT = IMPOSTOR_TILE_HEIGHT * IMPOSTOR_PITCH_VIEWS;
+// Character-space box the views cover: feet to a risen halo, arms and sashes
+const float IMPOSTOR_HALF_WIDTH = 1.35f;
+const float IMPOSTOR_HALF_HEIGHT = 2.7f;
+const float IMPOSTOR_CENTER_Y = -0.1f;
+const float IMPOSTOR_FADE_START = 14.0f; // Eye distance where the impostor starts to replace the mesh
+const float IMPOSTOR_FADE_END = 17.0f;   // Eye distance where it has replaced it
+const float IMPOSTOR_POSE_TOLERANCE = 0.999f; // Quaternion dot below which a joint has turned enough (about 5 degrees)
+const float IMPOSTOR_WALK_TOLERANCE = 0.3f;   // Radians of walk cycle
+const unsigned int IMPOSTOR_MIN_INTERVAL_FRAMES = 15; // Walking moves the legs past tolerance every few frames
+const unsigned int IMPOSTOR_MAX_AGE_FRAMES = 120;
+const int MAX_CROWD_SIZE = 64;
+const int CROWD_COLUMNS = 8;
+const float CROWD_SPACING_X = 2.5f;
+const float CROWD_SPACING_Z = 3.0f;
+const float CROWD_FIRST_ROW_Z = -4.0f;
+
+struct ImpostorVertex {
+	float x, y, z; // Eye space
+	float u, v;
+};
 
-			// --- SKILL CASTING LOGIC REMOVED FROM HERE ---
-		}
+struct ImpostorInstance {
+	float modelview[16]; // Character space to eye space
+	float fade;          // 0 draws the mesh, 1 the impostor, in between both
+	int tile;            // Atlas view nearest the camera's direction
+};
 
-		// NEW: Hand animation during windup (from idle curl -> open)
-		// As arms raise (0->1), fists OPEN (from 0.4 down to 0.0)
-		g_fistAnimationProgress = 0.4f * (1.0f - armProgress); // <<-- KEY CHANGE: Fists open
+struct Impostors {
+	GLuint framebuffer = 0, depthBuffer = 0, atlas = 0;
+	bool isCaptured = false;
+	unsigned int capturedFrame = 0;
+	Pose capturedPose;
+	float capturedWalkPhase = 0.0f;
+	bool capturedHalo = false, capturedWeapon = false;
+	float cameraView[16]; // The orbit camera; the crowd stands in this frame
+	int crowdSize = 0;
+	ImpostorInstance instances[MAX_CROWD_SIZE + 1]; // Nuwa, then the crowd
+	int instanceCount = 0;
+};
 
-		for (int i = 0; i < 3; ++i) {
-			float idle = ARM_POSE_IDLE[i];
-			float casting = ARM_POSE_CASTING[i];
-			float currentAngle = idle + (casting - idle) * armProgress;
+Impostors g_impostors;
 
-			g_rightArmAngles[i] = currentAngle;
-			g_leftArmAngles[i] = (i == 0) ? -currentAngle : currentAngle;
-		}
-		break;
+void shutdownImpostors()
+{
+	Impostors& im = g_impostors;
+	if (im.framebuffer) glDeleteFramebuffers(1, &im.framebuffer);
+	if (im.depthBuffer) glDeleteRenderbuffers(1, &im.depthBuffer);
+	if (im.atlas) glDeleteTextures(1, &im.atlas);
+	im.framebuffer = im.depthBuffer = im.atlas = 0;
+	im.isCaptured = false;
+}
+
+void initImpostors()
+{
+	if (!g_hasFBO) return;
+	Impostors& im = g_impostors;
+	glGenTextures(1, &im.atlas);
+	glBindTexture(GL_TEXTURE_2D, im.atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, IMPOSTOR_ATLAS_WIDTH, IMPOSTOR_ATLAS_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &im.depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, im.depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, IMPOSTOR_ATLAS_WIDTH, IMPOSTOR_ATLAS_HEIGHT);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &im.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, im.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, im.atlas, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, im.depthBuffer);
+	bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!isComplete) {
+		OutputDebugStringA("Warning: impostor framebuffer is incomplete, far characters keep their full mesh.\n");
+		shutdownImpostors();
+	}
+}
+
+// The box is tilted by the pitch, so its projected height grows with it
+static float impostorHalfHeight(int pitchView)
+{
+	float pitch = IMPOSTOR_PITCHES[pitchView] * 3.14159f / 180.0f;
+	return IMPOSTOR_HALF_HEIGHT * cosf(pitch) + IMPOSTOR_HALF_WIDTH * sinf(pitch);
+}
+
+static bool isImpostorAtlasStale()
+{
+	const Impostors& im = g_impostors;
+	if (!im.isCaptured || g_frameIndex - im.capturedFrame >= IMPOSTOR_MAX_AGE_FRAMES) return true;
+	if (g_frameIndex - im.capturedFrame < IMPOSTOR_MIN_INTERVAL_FRAMES) return false;
+	if (im.capturedHalo != g_isHaloVisible || im.capturedWeapon != g_isWeaponVisible) return true;
+	if (fabsf(im.capturedWalkPhase - g_animationTime * WALK_SPEED) > IMPOSTOR_WALK_TOLERANCE) return true;
+	const Pose& a = im.capturedPose;
+	const Pose& b = g_characterPose;
+	for (int j = 0; j < JOINT_COUNT; ++j) {
+		float dot = a.x[j] * b.x[j] + a.y[j] * b.y[j] + a.z[j] * b.z[j] + a.w[j] * b.w[j];
+		if (fabsf(dot) < IMPOSTOR_POSE_TOLERANCE) return true;
+	}
+	return false;
+}
+
+// Renders every view into its tile; whatever framebuffer was bound is restored
+static void captureImpostorAtlas()
+{
+	Impostors& im = g_impostors;
+	GLint viewport[4], previousFramebuffer = 0;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, im.framebuffer);
+	glViewport(0, 0, IMPOSTOR_ATLAS_WIDTH, IMPOSTOR_ATLAS_HEIGHT);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	case 2: // Hold: Keep arms in pose, fists fully open
-		// NEW: Ensure fists stay fully open during hold.
-		g_fistAnimationProgress = 0.0f; // <<-- KEY CHANGE: Fists fully open
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	int meshDetailPercent = g_meshDetailPercent;
+	g_meshDetailPercent = min(meshDetailPercent, QUALITY_MESH_DETAIL_PERCENT[QUALITY_LEVEL_COUNT - 1]);
+	for (int pitchView = 0; pitchView < IMPOSTOR_PITCH_VIEWS; ++pitchView) {
+		float halfHeight = impostorHalfHeight(pitchView);
+		for (int yawView = 0; yawView < IMPOSTOR_YAW_VIEWS; ++yawView) {
+			glViewport(yawView * IMPOSTOR_TILE_WIDTH, pitchView * IMPOSTOR_TILE_HEIGHT, IMPOSTOR_TILE_WIDTH, IMPOSTOR_TILE_HEIGHT);
+			glMatrixMode(GL_PROJECTION);
+			glLoadIdentity();
+			glOrtho(-IMPOSTOR_HALF_WIDTH, IMPOSTOR_HALF_WIDTH, -halfHeight, halfHeight, -10.0, 10.0);
+			glMatrixMode(GL_MODELVIEW);
+			glLoadIdentity();
+			glRotatef(IMPOSTOR_PITCHES[pitchView], 1.0f, 0.0f, 0.0f);
+			glRotatef(yawView * 360.0f / IMPOSTOR_YAW_VIEWS, 0.0f, 1.0f, 0.0f);
+			glTranslatef(0.0f, -IMPOSTOR_CENTER_Y, 0.0f);
+			drawCharacterBody();
+		}
+	}
+	g_meshDetailPercent = meshDetailPercent;
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
 
-		if (g_armAnimationTimer >= DURATION_HOLD) {
-			g_armAnimationState = 3;
-			g_armAnimationTimer = 0.0f;
-		}
-		break;
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glBindTexture(GL_TEXTURE_2D, im.atlas);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	im.isCaptured = true;
+	im.capturedFrame = g_frameIndex;
+	im.capturedPose = g_characterPose;
+	im.capturedWalkPhase = g_animationTime * WALK_SPEED;
+	im.capturedHalo = g_isHaloVisible;
+	im.capturedWeapon = g_isWeaponVisible;
+}
 
-	case 3: // Recover: Lowering arms, and re-curling fists to idle
-		armProgress = g_armAnimationTimer / DURATION_RECOVER;
-		if (armProgress >= 1.0f) {
-			armProgress = 1.0f;
-			g_armAnimationState = 0;
-			g_armAnimationTimer = 0.0f;
-		}
+// Picks the atlas view for the camera's direction in the instance's own space
+static int chooseImpostorTile(const float m[16])
+{
+	// The camera sits at -R^T t in character space (the modelview is rigid)
+	float camera[3];
+	for (int k = 0; k < 3; ++k) camera[k] = -(m[k * 4] * m[12] + m[k * 4 + 1] * m[13] + m[k * 4 + 2] * m[14]);
+	float dx = camera[0], dy = camera[1] - IMPOSTOR_CENTER_Y, dz = camera[2];
+	// View (yaw, pitch) sees the character from (-sin yaw cos pitch, sin pitch, cos yaw cos pitch)
+	float yaw = atan2f(-dx, dz) * 180.0f / 3.14159f;
+	float pitch = atan2f(dy, sqrtf(dx * dx + dz * dz)) * 180.0f / 3.14159f;
+	int yawView = (int)floorf(yaw / (360.0f / IMPOSTOR_YAW_VIEWS) + 0.5f);
+	yawView = ((yawView % IMPOSTOR_YAW_VIEWS) + IMPOSTOR_YAW_VIEWS) % IMPOSTOR_YAW_VIEWS;
+	int pitchView = 0;
+	for (int k = 1; k < IMPOSTOR_PITCH_VIEWS; ++k) {
+		if (fabsf(pitch - IMPOSTOR_PITCHES[k]) < fabsf(pitch - IMPOSTOR_PITCHES[pitchView])) pitchView = k;
+	}
+	return pitchView * IMPOSTOR_YAW_VIEWS + yawView;
+}
 
-		// NEW: Hand animation during recover (from open -> idle curl)
-		// As arms lower (0->1), fists CLOSE (from 0.0 up to 0.4)
-		g_fistAnimationProgress = 0.4f * armProgress; // <<-- KEY CHANGE: Fists re-curl
+// Called with Nuwa's modelview current: decides mesh or impostor for her and
+// the crowd, and refreshes the atlas if any of them needs it
+void planImpostors()
+{
+	Impostors& im = g_impostors;
+	im.instanceCount = 1 + im.crowdSize;
+	glGetFloatv(GL_MODELVIEW_MATRIX, im.instances[0].modelview);
+	glPushMatrix();
+	for (int i = 0; i < im.crowdSize; ++i) {
+		glLoadMatrixf(im.cameraView);
+		glTranslatef((i % CROWD_COLUMNS - (CROWD_COLUMNS - 1) * 0.5f) * CROWD_SPACING_X, 0.0f, CROWD_FIRST_ROW_Z - (i / CROWD_COLUMNS) * CROWD_SPACING_Z);
+		glRotatef(180.0f, 0.0f, 1.0f, 0.0f); // Facing the camera, like Nuwa at rest
+		glGetFloatv(GL_MODELVIEW_MATRIX, im.instances[1 + i].modelview);
+	}
+	glPopMatrix();
 
-		for (int i = 0; i < 3; ++i) {
-			float casting = ARM_POSE_CASTING[i];
-			float idle = ARM_POSE_IDLE[i];
-			float currentAngle = casting + (idle - casting) * armProgress;
+	bool needsAtlas = false;
+	for (int i = 0; i < im.instanceCount; ++i) {
+		ImpostorInstance& instance = im.instances[i];
+		const float* m = instance.modelview;
+		float distance = -(m[6] * IMPOSTOR_CENTER_Y + m[14]);
+		float fade = (distance - IMPOSTOR_FADE_START) / (IMPOSTOR_FADE_END - IMPOSTOR_FADE_START);
+		instance.fade = im.framebuffer ? max(0.0f, min(1.0f, fade)) : 0.0f;
+		instance.tile = chooseImpostorTile(m);
+		if (instance.fade > 0.0f) needsAtlas = true;
+	}
+	if (needsAtlas && isImpostorAtlasStale()) captureImpostorAtlas();
+}
 
-			g_rightArmAngles[i] = currentAngle;
-			g_leftArmAngles[i] = (i == 0) ? -currentAngle : currentAngle;
+// Ordered-dither screen door: the mesh keeps the pixels the impostor leaves out
+static void setFadeStipple(float fade, bool isImpostor)
+{
+	static const unsigned char BAYER[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+	int level = (int)(fade * 16.0f + 0.5f);
+	GLubyte pattern[128];
+	for (int row = 0; row < 32; ++row) {
+		for (int byte = 0; byte < 4; ++byte) {
+			GLubyte bits = 0;
+			for (int bit = 0; bit < 8; ++bit) {
+				bool isImpostorPixel = BAYER[row & 3][(byte * 8 + bit) & 3] < level;
+				if (isImpostorPixel == isImpostor) bits |= (GLubyte)(0x80 >> bit);
+			}
+			pattern[row * 4 + byte] = bits;
 		}
-		break;
 	}
+	glPolygonStipple(pattern);
 }
 
-void updateWaveAnimation(float deltaTime)
+// Returns false when only the impostor is drawn; pair with endMeshFade()
+bool beginMeshFade(const ImpostorInstance& instance)
 {
-	const float WAVE_ANIMATION_SPEED = 3.0f;
-
-	// Update Left Arm
-	if (g_isLeftWaveActive && g_leftWaveProgress < 1.0f) {
-		g_leftWaveProgress += WAVE_ANIMATION_SPEED * deltaTime;
-		if (g_leftWaveProgress > 1.0f) g_leftWaveProgress = 1.0f;
-	}
-	else if (!g_isLeftWaveActive && g_leftWaveProgress > 0.0f) {
-		g_leftWaveProgress -= WAVE_ANIMATION_SPEED * deltaTime;
-		if (g_leftWaveProgress < 0.0f) g_leftWaveProgress = 0.0f;
+	if (instance.fade >= 1.0f) return false;
+	if (instance.fade > 0.0f) {
+		setFadeStipple(instance.fade, false);
+		glEnable(GL_POLYGON_STIPPLE);
 	}
+	return true;
+}
 
-	// Update Right Arm
-	if (g_isRightWaveActive && g_rightWaveProgress < 1.0f) {
-		g_rightWaveProgress += WAVE_ANIMATION_SPEED * deltaTime;
-		if (g_rightWaveProgress > 1.0f) g_rightWaveProgress = 1.0f;
-	}
-	else if (!g_isRightWaveActive && g_rightWaveProgress > 0.0f) {
-		g_rightWaveProgress -= WAVE_ANIMATION_SPEED * deltaTime;
-		if (g_rightWaveProgress < 0.0f) g_rightWaveProgress = 0.0f;
+void endMeshFade()
+{
+	glDisable(GL_POLYGON_STIPPLE);
+}
+
+// Full meshes of the near crowd; drawn before the pick capture so they never land in it
+void drawCrowd()
+{
+	Impostors& im = g_impostors;
+	glPushMatrix();
+	for (int i = 1; i < im.instanceCount; ++i) {
+		if (!beginMeshFade(im.instances[i])) continue;
+		glLoadMatrixf(im.instances[i].modelview);
+		drawCharacterBody();
+		endMeshFade();
 	}
+	glPopMatrix();
 }
 
-void updateHandPoseAnimation(float deltaTime)
+static void appendImpostorQuad(const ImpostorInstance& instance, ImpostorVertex* quad)
 {
-	const float HAND_POSE_ANIMATION_SPEED = 5.0f; // Adjust speed as needed
+	const float* m = instance.modelview;
+	float pivot[3] = { m[4] * IMPOSTOR_CENTER_Y + m[12], m[5] * IMPOSTOR_CENTER_Y + m[13], m[6] * IMPOSTOR_CENTER_Y + m[14] };
+	int yawView = instance.tile % IMPOSTOR_YAW_VIEWS, pitchView = instance.tile / IMPOSTOR_YAW_VIEWS;
+	float halfHeight = impostorHalfHeight(pitchView);
+	float u0 = (float)yawView / IMPOSTOR_YAW_VIEWS, u1 = (float)(yawView + 1) / IMPOSTOR_YAW_VIEWS;
+	float v0 = (float)pitchView / IMPOSTOR_PITCH_VIEWS, v1 = (float)(pitchView + 1) / IMPOSTOR_PITCH_VIEWS;
+	quad[0] = { pivot[0] - IMPOSTOR_HALF_WIDTH, pivot[1] - halfHeight, pivot[2], u0, v0 };
+	quad[1] = { pivot[0] + IMPOSTOR_HALF_WIDTH, pivot[1] - halfHeight, pivot[2], u1, v0 };
+	quad[2] = { pivot[0] + IMPOSTOR_HALF_WIDTH, pivot[1] + halfHeight, pivot[2], u1, v1 };
+	quad[3] = { pivot[0] - IMPOSTOR_HALF_WIDTH, pivot[1] + halfHeight, pivot[2], u0, v1 };
+}
 
-	if (g_handPoseTarget == 1 && g_handPoseProgress < 1.0f) {
-		g_handPoseProgress += HAND_POSE_ANIMATION_SPEED * deltaTime;
-		if (g_handPoseProgress > 1.0f) g_handPoseProgress = 1.0f;
+// Fully faded instances go out in one draw; crossfading ones one by one, each with its stipple
+void drawImpostors()
+{
+	Impostors& im = g_impostors;
+	if (!im.isCaptured) return;
+	int quadCount = 0, fullCount = 0;
+	for (int i = 0; i < im.instanceCount; ++i) {
+		if (im.instances[i].fade > 0.0f) ++quadCount;
+		if (im.instances[i].fade >= 1.0f) ++fullCount;
 	}
-	else if (g_handPoseTarget == 0 && g_handPoseProgress > 0.0f) {
-		g_handPoseProgress -= HAND_POSE_ANIMATION_SPEED * deltaTime;
-		if (g_handPoseProgress < 0.0f) g_handPoseProgress = 0.0f;
+	if (quadCount == 0) return;
+	ImpostorVertex* vertices = (ImpostorVertex*)frameAlloc(quadCount * 4 * sizeof(ImpostorVertex));
+	if (!vertices) return;
+	int full = 0, fading = fullCount;
+	for (int i = 0; i < im.instanceCount; ++i) {
+		const ImpostorInstance& instance = im.instances[i];
+		if (instance.fade >= 1.0f) appendImpostorQuad(instance, vertices + 4 * full++);
+		else if (instance.fade > 0.0f) appendImpostorQuad(instance, vertices + 4 * fading++);
 	}
-}
 
-void drawSingleMatrixBlock(const MatrixBlock& block) {
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT | GL_POLYGON_STIPPLE_BIT);
+	glMatrixMode(GL_MODELVIEW);
 	glPushMatrix();
-	// Save current OpenGL state
-	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT);
-
-	// --- Set up for a glowing, transparent effect ---
-	glEnable(GL_BLEND);
-	// Additive blending: makes colours brighter where they overlap. Great for magic!
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-	glDisable(GL_LIGHTING);   // Glow effects shouldn't be affected by world lighting
-	glDepthMask(GL_FALSE);    // Don't hide other transparent objects behind this one
-
-	// --- Position and scale the block ---
-	glTranslatef(block.posX, block.posY, block.posZ);
-	glScalef(block.scaleX, block.scaleY, block.scaleZ);
-
-	// --- Apply the texture ---
+	glLoadIdentity();
+	glDisable(GL_LIGHTING); // Lit when captured
+	glEnable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0.5f);
 	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, g_matrixTextureID);
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	glBindTexture(GL_TEXTURE_2D, im.atlas);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 
-	// Draw the cuboid with a glowing colour tint
-	// The alpha (0.7f) controls the transparency for the blend function
-	glColor4f(0.8f, 0.9f, 1.0f, 0.7f);
-	drawCuboid(1.0f, 1.0f, 1.0f); // Draw a 1x1x1 cube, which will be scaled
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(ImpostorVertex), &vertices->x);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(ImpostorVertex), &vertices->u);
+	if (fullCount > 0) glDrawArrays(GL_QUADS, 0, fullCount * 4);
+	if (quadCount > fullCount) {
+		glEnable(GL_POLYGON_STIPPLE);
+		for (int i = 0, quad = fullCount; i < im.instanceCount; ++i) {
+			const ImpostorInstance& instance = im.instances[i];
+			if (instance.fade <= 0.0f || instance.fade >= 1.0f) continue;
+			setFadeStipple(instance.fade, true);
+			glDrawArrays(GL_QUADS, quad++ * 4, 4);
+		}
+	}
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
 
-	// --- Restore OpenGL state ---
-	glPopAttrib();
 	glPopMatrix();
+	glPopAttrib();
 }
 
-void updateMatrixBlocks(float deltaTime) {
-	const float SPAWN_DURATION = 0.1f;
-	const float EXPAND_DURATION = 0.5f; // How long it takes to expand
-	// --- MODIFIED HERE ---
-	const float CUBE_SIDE_LENGTH = 2.0f; // Define a single size for the cube
-	const float FULL_SIZE_X = CUBE_SIDE_LENGTH;
-	const float FULL_SIZE_Y = CUBE_SIDE_LENGTH; // Make the height the same as the width
-	const float FULL_SIZE_Z = CUBE_SIDE_LENGTH;
-
-	// Loop through all blocks (use an iterator to allow for easy removal if needed)
-	for (auto& block : g_matrixBlocks) {
-		if (!block.isActive) {
-			continue;
-		}
+// --- Mirror Reflection ---
+// With the Divine Mirror equipped, its glass shows the scene rendered into a
+// small texture from the camera reflected in the mirror's plane. The frustum
+// is fitted to the glass and its near plane is replaced by the mirror plane
+// (oblique near-plane clipping), so nothing behind the glass leaks into the
+// image. The pass draws only Nuwa, at the governor's lowest mesh detail and
+// without effects: no halo, crowd, projectiles, blocks or particles. It runs
+// at most every g_config.mirrorInterval frames, and only if the mirror moved
+// against the camera since the last one or the image has grown old. Between
+// updates the glass keeps the texture coordinates of the last render, so the
+// image rides along with the mirror. The plane is taken from where the glass was drawn in
+// the previous frame. The orthographic view keeps the static Mirror.bmp. The
+// pass's GPU time (its CPU submission time without timer queries) and its
+// share of the frame are logged every MIRROR_REPORT_FRAMES frames.
+const float MIRROR_RADIUS = 0.35f;            // The glass inside the frame, drawDivineMirror's inner_radius
+const float MIRROR_MOVE_TOLERANCE = 0.002f;   // Largest modelview change that does not count as movement
+const int MIRROR_MAX_AGE_FRAMES = 30;
+const int MIRROR_MESH_DETAIL_PERCENT = QUALITY_MESH_DETAIL_PERCENT[QUALITY_LEVEL_COUNT - 1];
+const int MIRROR_REPORT_FRAMES = 600;
+const int MIRROR_QUERY_COUNT = 3;             // Results are read a few frames late, so a query never stalls
+
+struct MirrorReflection {
+	GLuint framebuffer = 0, colorTexture = 0, depthBuffer = 0;
+	int size = 0;
+	bool isMainView = false;       // Set while display() draws Nuwa into the window
+	bool isRendering = false;      // Set during the reflection pass
+	bool hasSurface = false;
+	unsigned int surfaceFrame = 0;
+	float surfaceModelview[16];    // The glass's local space to eye space, as last drawn
+	bool isCaptured = false;
+	unsigned int capturedFrame = 0;
+	float capturedModelview[16];   // surfaceModelview when the texture was rendered
+	float textureMatrix[16];       // The glass's local space to texture space for that render
+	GLuint queries[MIRROR_QUERY_COUNT] = {};
+	bool isQueryPending[MIRROR_QUERY_COUNT] = {};
+	int nextQuery = 0;
+	// Totals since the last report
+	double gpuMs = 0.0, cpuMs = 0.0, frameMs = 0.0;
+	int updates = 0, timedUpdates = 0, frames = 0;
+};
 
-		// Decrease lifetime
-		block.lifetime -= deltaTime;
-		if (block.lifetime <= 0.0f) {
-			block.isActive = false; // Deactivate when time runs out
-			continue;
-		}
+MirrorReflection g_mirrorReflection;
 
-		block.animationTimer += deltaTime;
+bool isDrawingMirrorReflection()
+{
+	return g_mirrorReflection.isRendering;
+}
 
-		// --- State Machine for Animation ---
-		switch (block.state) {
-		case SPAWNING:
-			// Just wait for a very short time before expanding
-			if (block.animationTimer >= SPAWN_DURATION) {
-				block.state = EXPANDING;
-				block.animationTimer = 0.0f; // Reset timer for the next state
-			}
-			break;
+// Called by drawDivineMirror with the glass's modelview current: records it
+// for the next pass and binds the reflection if there is one yet
+bool beginMirrorSurface()
+{
+	MirrorReflection& mr = g_mirrorReflection;
+	if (!mr.isMainView || !mr.framebuffer) return false;
+	glGetFloatv(GL_MODELVIEW_MATRIX, mr.surfaceModelview);
+	mr.hasSurface = true;
+	mr.surfaceFrame = g_frameIndex;
+	if (!mr.isCaptured || !g_isPerspectiveView) return false;
+	glBindTexture(GL_TEXTURE_2D, mr.colorTexture);
+	return true;
+}
 
-		case EXPANDING:
-			// Interpolate scale from small to full size over EXPAND_DURATION
-			float progress = block.animationTimer / EXPAND_DURATION;
-			if (progress > 1.0f) progress = 1.0f;
+// Projective coordinates, so the lookup stays perspective-correct across the glass
+void mirrorSurfaceTexCoord(float x, float y)
+{
+	const float* m = g_mirrorReflection.textureMatrix;
+	glTexCoord4f(m[0] * x + m[4] * y + m[12], m[1] * x + m[5] * y + m[13], 0.0f, m[3] * x + m[7] * y + m[15]);
+}
 
-			block.scaleX = FULL_SIZE_X * progress;
-			block.scaleY = FULL_SIZE_Y * progress;
-			block.scaleZ = FULL_SIZE_Z * progress;
+void shutdownMirrorReflection()
+{
+	MirrorReflection& mr = g_mirrorReflection;
+	if (mr.framebuffer) glDeleteFramebuffers(1, &mr.framebuffer);
+	if (mr.depthBuffer) glDeleteRenderbuffers(1, &mr.depthBuffer);
+	if (mr.colorTexture) glDeleteTextures(1, &mr.colorTexture);
+	if (mr.queries[0]) glDeleteQueries(MIRROR_QUERY_COUNT, mr.queries);
+	mr.framebuffer = mr.depthBuffer = mr.colorTexture = 0;
+	for (int i = 0; i < MIRROR_QUERY_COUNT; ++i) {
+		mr.queries[i] = 0;
+		mr.isQueryPending[i] = false;
+	}
+	mr.isCaptured = false;
+}
 
-			if (progress >= 1.0f) {
-				block.state = ACTIVE; // Expansion finished
-				block.animationTimer = 0.0f;
-			}
-			break;
-		}
+void initMirrorReflection()
+{
+	MirrorReflection& mr = g_mirrorReflection;
+	if (!g_hasFBO || g_config.mirrorSize == 0) return;
+	mr.size = min(g_config.mirrorSize, (int)g_maxTextureSize);
+	glGenTextures(1, &mr.colorTexture);
+	glBindTexture(GL_TEXTURE_2D, mr.colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mr.size, mr.size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &mr.depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, mr.depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mr.size, mr.size);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &mr.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, mr.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mr.colorTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mr.depthBuffer);
+	bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!isComplete) {
+		OutputDebugStringA("Warning: mirror framebuffer is incomplete, the mirror keeps its static image.\n");
+		shutdownMirrorReflection();
+		return;
 	}
+	if (g_hasTimerQuery) glGenQueries(MIRROR_QUERY_COUNT, mr.queries);
 }
 
-void drawMatrixBlocks() {
-	for (const auto& block : g_matrixBlocks) {
-		if (block.isActive) {
-			drawSingleMatrixBlock(block);
-		}
+static bool isMirrorReflectionDue()
+{
+	const MirrorReflection& mr = g_mirrorReflection;
+	// Only while the glass was on screen last frame, under a perspective camera
+	if (!mr.framebuffer || !mr.hasSurface || mr.surfaceFrame + 1 < g_frameIndex || !g_isPerspectiveView) return false;
+	if (!mr.isCaptured) return true;
+	unsigned int age = g_frameIndex - mr.capturedFrame;
+	if (age < (unsigned int)g_config.mirrorInterval) return false;
+	if (age >= MIRROR_MAX_AGE_FRAMES) return true;
+	for (int i = 0; i < 16; ++i) {
+		if (fabsf(mr.surfaceModelview[i] - mr.capturedModelview[i]) > MIRROR_MOVE_TOLERANCE) return true;
 	}
+	return false;
 }
 
-void updateWavingAnimation(float deltaTime) {
-	const float WAVE_ANIMATION_SPEED = 2.0f; // Controls how fast the arm raises and lowers
+// Off-axis frustum through the glass's corners as seen from the eye, with
+// the near plane swapped for `plane` (eye space, kept side positive, eye on
+// the negative side) by Lengyel's oblique near-plane method. Returns false if
+// the glass reaches behind the eye.
+static bool buildMirrorProjection(const float surface[16], const float plane[4], float projection[16])
+{
+	const float NEAR = 1.0f, FAR = 100.0f; // As the main perspective
+	float left = FLT_MAX, right = -FLT_MAX, bottom = FLT_MAX, top = -FLT_MAX;
+	for (int corner = 0; corner < 4; ++corner) {
+		float x = (corner & 1) ? MIRROR_RADIUS : -MIRROR_RADIUS;
+		float y = (corner & 2) ? MIRROR_RADIUS : -MIRROR_RADIUS;
+		float eye[3];
+		for (int k = 0; k < 3; ++k) eye[k] = surface[k] * x + surface[4 + k] * y + surface[12 + k];
+		if (eye[2] > -0.01f) return false;
+		float sx = eye[0] / -eye[2] * NEAR, sy = eye[1] / -eye[2] * NEAR;
+		left = min(left, sx);
+		right = max(right, sx);
+		bottom = min(bottom, sy);
+		top = max(top, sy);
+	}
+
+	for (int i = 0; i < 16; ++i) projection[i] = 0.0f;
+	projection[0] = 2.0f * NEAR / (right - left);
+	projection[5] = 2.0f * NEAR / (top - bottom);
+	projection[8] = (right + left) / (right - left);
+	projection[9] = (top + bottom) / (top - bottom);
+	projection[10] = -(FAR + NEAR) / (FAR - NEAR);
+	projection[11] = -1.0f;
+	projection[14] = -2.0f * FAR * NEAR / (FAR - NEAR);
+
+	// The clip-space corner opposite the plane, pulled back to eye space
+	float q[4] = {
+		(copysignf(1.0f, plane[0]) + projection[8]) / projection[0],
+		(copysignf(1.0f, plane[1]) + projection[9]) / projection[5],
+		-1.0f,
+		(1.0f + projection[10]) / projection[14],
+	};
+	float scale = 2.0f / (plane[0] * q[0] + plane[1] * q[1] + plane[2] * q[2] + plane[3] * q[3]);
+	projection[2] = plane[0] * scale;
+	projection[6] = plane[1] * scale;
+	projection[10] = plane[2] * scale + 1.0f;
+	projection[14] = plane[3] * scale;
+	return true;
+}
 
-	// Update the animation progress
-	if (g_isWaving && g_waveProgress < 1.0f) {
-		g_waveProgress += WAVE_ANIMATION_SPEED * deltaTime;
-		if (g_waveProgress > 1.0f) g_waveProgress = 1.0f;
+// Called with Nuwa's modelview current, after planImpostors and before she is drawn
+void renderMirrorReflection()
+{
+	MirrorReflection& mr = g_mirrorReflection;
+	if (!isMirrorReflectionDue() || g_impostors.instances[0].fade >= 1.0f) return;
+
+	// The mirror plane in eye space: the glass's +Z faces the viewer
+	const float* s = mr.surfaceModelview;
+	float normal[3] = { s[8], s[9], s[10] };
+	float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	if (length < 1e-6f) return;
+	for (int k = 0; k < 3; ++k) normal[k] /= length;
+	float distance = -(normal[0] * s[12] + normal[1] * s[13] + normal[2] * s[14]);
+	if (distance <= 0.0f) return; // Seen from behind: keep the last image
+
+	// Keep what lands behind the glass once reflected, i.e. what is in front of it
+	float plane[4] = { -normal[0], -normal[1], -normal[2], -distance };
+	float projection[16];
+	if (!buildMirrorProjection(s, plane, projection)) return;
+
+	// x -> x - 2 (n.x + d) n
+	float reflection[16];
+	for (int col = 0; col < 3; ++col) {
+		for (int row = 0; row < 3; ++row) reflection[col * 4 + row] = (row == col ? 1.0f : 0.0f) - 2.0f * normal[row] * normal[col];
+		reflection[col * 4 + 3] = 0.0f;
+		reflection[12 + col] = -2.0f * distance * normal[col];
 	}
-	else if (!g_isWaving && g_waveProgress > 0.0f) {
-		g_waveProgress -= WAVE_ANIMATION_SPEED * deltaTime;
-		if (g_waveProgress < 0.0f) g_waveProgress = 0.0f;
+	reflection[15] = 1.0f;
+
+	double startMs = getTimeMs();
+	GLuint query = 0;
+	if (mr.queries[0] && !mr.isQueryPending[mr.nextQuery]) {
+		query = mr.queries[mr.nextQuery];
+		mr.isQueryPending[mr.nextQuery] = true;
+		mr.nextQuery = (mr.nextQuery + 1) % MIRROR_QUERY_COUNT;
+		glBeginQuery(GL_TIME_ELAPSED, query);
 	}
 
-	// If the animation is active at all, update the right arm's position
-	if (g_waveProgress > 0.0f) {
-		for (int i = 0; i < 3; ++i) {
-			float idle = ARM_POSE_IDLE[i];
-			float wave = ARM_POSE_WAVE[i];
-			// Interpolate from idle to wave pose
-			g_rightArmAngles[i] = idle + (wave - idle) * g_waveProgress;
-		}
+	GLint viewport[4], previousFramebuffer = 0;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, mr.framebuffer);
+	glViewport(0, 0, mr.size, mr.size);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	drawSkyBackground(mr.size, mr.size);
+
+	float characterModelview[16];
+	GLfloat lightPositions[2][4];
+	glGetFloatv(GL_MODELVIEW_MATRIX, characterModelview);
+	glGetLightfv(GL_LIGHT0, GL_POSITION, lightPositions[0]);
+	glGetLightfv(GL_LIGHT1, GL_POSITION, lightPositions[1]);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadMatrixf(projection);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	// Lights are kept in eye space, so they are reflected along with the scene
+	glLoadMatrixf(reflection);
+	glLightfv(GL_LIGHT0, GL_POSITION, lightPositions[0]);
+	glLightfv(GL_LIGHT1, GL_POSITION, lightPositions[1]);
+	glMultMatrixf(characterModelview);
+
+	int meshDetailPercent = g_meshDetailPercent;
+	g_meshDetailPercent = min(meshDetailPercent, MIRROR_MESH_DETAIL_PERCENT);
+	mr.isRendering = true;
+	drawCharacterBody();
+	mr.isRendering = false;
+	g_meshDetailPercent = meshDetailPercent;
 
-		// Add the back-and-forth waving motion for the hand
-		// This only happens when the arm is fully raised
-		if (g_waveProgress >= 1.0f) {
-			const float waveFrequency = 10.0f;
-			const float waveAmplitude = 20.0f;
-			// Apply a sine wave rotation to the elbow joint
-			g_rightArmAngles[2] = ARM_POSE_WAVE[2] + sin(g_braidTime * waveFrequency) * waveAmplitude;
+	glLoadIdentity();
+	glLightfv(GL_LIGHT0, GL_POSITION, lightPositions[0]);
+	glLightfv(GL_LIGHT1, GL_POSITION, lightPositions[1]);
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	if (query) glEndQuery(GL_TIME_ELAPSED);
+
+	// Glass local space -> clip space of this render, then [-1, 1] -> [0, 1]
+	float clip[16];
+	for (int col = 0; col < 4; ++col) {
+		for (int row = 0; row < 4; ++row) {
+			clip[col * 4 + row] = projection[row] * s[col * 4] + projection[4 + row] * s[col * 4 + 1] +
+				projection[8 + row] * s[col * 4 + 2] + projection[12 + row] * s[col * 4 + 3];
 		}
 	}
+	for (int col = 0; col < 4; ++col) {
+		mr.textureMatrix[col * 4] = 0.5f * (clip[col * 4] + clip[col * 4 + 3]);
+		mr.textureMatrix[col * 4 + 1] = 0.5f * (clip[col * 4 + 1] + clip[col * 4 + 3]);
+		mr.textureMatrix[col * 4 + 2] = 0.0f;
+		mr.textureMatrix[col * 4 + 3] = clip[col * 4 + 3];
+	}
+	memcpy(mr.capturedModelview, s, sizeof(mr.capturedModelview));
+	mr.isCaptured = true;
+	mr.capturedFrame = g_frameIndex;
+	mr.cpuMs += getTimeMs() - startMs;
+	++mr.updates;
+}
+
+// Called once per frame: collects finished timer queries and logs the
+// pass's cost every MIRROR_REPORT_FRAMES frames
+void reportMirrorReflection(float deltaTime)
+{
+	MirrorReflection& mr = g_mirrorReflection;
+	if (!mr.framebuffer) return;
+	for (int i = 0; i < MIRROR_QUERY_COUNT; ++i) {
+		if (!mr.isQueryPending[i]) continue;
+		GLint isAvailable = 0;
+		glGetQueryObjectiv(mr.queries[i], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+		if (!isAvailable) continue;
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(mr.queries[i], GL_QUERY_RESULT, &nanoseconds);
+		mr.gpuMs += nanoseconds / 1.0e6;
+		++mr.timedUpdates;
+		mr.isQueryPending[i] = false;
+	}
+
+	mr.frameMs += deltaTime * 1000.0f;
+	if (++mr.frames < MIRROR_REPORT_FRAMES) return;
+	if (mr.updates > 0) {
+		bool isGpuTime = mr.timedUpdates > 0;
+		double updateMs = isGpuTime ? mr.gpuMs / mr.timedUpdates : mr.cpuMs / mr.updates;
+		double perFrameMs = updateMs * mr.updates / mr.frames;
+		double frameMs = mr.frameMs / mr.frames;
+		char buffer[256];
+		sprintf_s(buffer, "Mirror reflection (%dx%d): %d updates in %d frames, %.2f ms %s each, %.2f ms of the %.2f ms frame (%.1f%%)\n",
+			mr.size, mr.size, mr.updates, mr.frames, updateMs, isGpuTime ? "GPU" : "CPU", perFrameMs, frameMs, 100.0 * perFrameMs / frameMs);
+		OutputDebugStringA(buffer);
+	}
+	mr.gpuMs = mr.cpuMs = mr.frameMs = 0.0;
+	mr.updates = mr.timedUpdates = mr.frames = 0;
 }
 
 void display(float deltaTime)
 {
+	unsigned int allocationsBefore = t_heapAllocations;
+	resetFrameArena();
+
+	// --- Texture Residency: upload finished loads, evict over budget ---
+	++g_frameIndex;
+	updateTextureResidency();
+
 	// --- Animation Updates ---
 	if (g_forwardDirection != 0 || g_strafeDirection != 0)
 	{
@@ -2711,36 +9268,21 @@ void display(float deltaTime)
 		g_characterPosX -= g_strafeDirection * MOVE_SPEED * deltaTime;
 	}
 
-	// Other animations
-	updateHandAnimation(deltaTime);
-	updateNuwaSkill(deltaTime);
-	updateArmCastingAnimation(deltaTime);
-	updateWaveAnimation(deltaTime);
-	updateHandPoseAnimation(deltaTime);
-	updateMatrixBlocks(deltaTime);
-
-	if (g_isHaloAnimating) {
-		const float HALO_MOVE_SPEED = 5.0f;
-		const float HALO_SCALE_SPEED = 2.0f;
-		const float HALO_DISAPPEAR_Z = 4.0f;
-		g_haloZ += HALO_MOVE_SPEED * deltaTime;
-		g_haloScale += HALO_SCALE_SPEED * deltaTime;
-		g_animatedLightPos[2] += HALO_MOVE_SPEED * deltaTime;
-		if (g_haloZ > HALO_DISAPPEAR_Z) {
-			g_isHaloVisible = false;
-			g_isHaloAnimating = false;
-		}
-	}
+	// Other animations: only the ones something has started
+	runAnimationTasks(deltaTime);
 
 	g_braidTime += deltaTime;
 	float animation_speed = 0.09f;
 	g_rainbow_offset += animation_speed * deltaTime;
+	updateQualityGovernor(deltaTime); // Before the braid's sway is sized for this frame
+	updateSecondaryMotion();
 
 	// --- Rendering Starts Here ---
+	beginDynamicResolutionFrame();
 	glClearColor(1.0, 1.0, 1.0, 0.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	drawSkyBackground(800, 600);
+	drawSkyBackground(g_dynamicResolution.width, g_dynamicResolution.height);
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_LIGHTING);
 	glEnable(GL_LIGHT0);
@@ -2761,7 +9303,7 @@ void display(float deltaTime)
 
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	float aspectRatio = 800.0f / 600.0f;
+	float aspectRatio = (float)g_windowWidth / (float)g_windowHeight;
 	if (g_isPerspectiveView)
 	{
 		gluPerspective(45.0, aspectRatio, 1.0, 100.0);
@@ -2779,6 +9321,13 @@ void display(float deltaTime)
 		);
 	}
 
+	glGetDoublev(GL_PROJECTION_MATRIX, g_pickProjection);
+	// Window pixels, not the scaled render target: clicks and screen-size LOD are measured in those
+	g_pickViewport[0] = 0;
+	g_pickViewport[1] = 0;
+	g_pickViewport[2] = g_windowWidth;
+	g_pickViewport[3] = g_windowHeight;
+
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
@@ -2786,48 +9335,504 @@ void display(float deltaTime)
 	glTranslatef(0.0f, -0.5f, zoomFactor);
 	glRotatef(rotateX, 1.0f, 0.0f, 0.0f);
 	glRotatef(rotateY, 0.0f, 1.0f, 0.0f);
+	glGetFloatv(GL_MODELVIEW_MATRIX, g_impostors.cameraView);
 
 	// 2. Move to the character's position in the world
 	glTranslatef(-g_characterPosX, 0.0f, -g_characterPosZ);
 
 	// 3. Apply the character's own rotation to make it face the correct direction
 	glRotatef(g_characterRotationY, 0.0f, 1.0f, 0.0f);
+	measureAnimationLOD();
+	planImpostors();
+	renderMirrorReflection();
+	drawCrowd();
 
 	// --- Drawing Calls for the Character ---
-	drawSmoothChest();
-	drawWaistWithVerticalLines();
-	drawSmoothLowerBodyAndSkirt();
-	drawLegs();
-
-	glEnable(GL_POLYGON_OFFSET_FILL);
-	glPolygonOffset(-1.0f, -1.0f);
-	drawWaistBelt();
-	glDisable(GL_POLYGON_OFFSET_FILL);
-
-	drawArmorCollar();
-	drawSmoothArms();
-	drawCurvedShoulderPads();
-	drawBackSashes();
-
-	glPushMatrix();
-	drawNeck();
-	drawFace();
-	drawBraid(1.25f, -0.3f);
-	drawHalo();
-	glPopMatrix();
-	drawNuwaSkill();
+	beginPickCapture();
+	if (beginMeshFade(g_impostors.instances[0])) {
+		g_mirrorReflection.isMainView = true;
+		drawCharacterBody();
+		g_mirrorReflection.isMainView = false;
+		endMeshFade();
+	}
+	drawImpostors();
+	drawSkillProjectiles();
 	drawMatrixBlocks();
+	drawParticles();
+	updatePickBVH();
+	drawPickSelection();
 
 	glDisable(GL_TEXTURE_2D);
 
+	endDynamicResolutionFrame();
 	SwapBuffers(g_hDC);
+	reportMirrorReflection(deltaTime);
+
+	// Once warmed up, a frame must not touch the heap
+	assert((g_frameIndex <= STEADY_STATE_WARMUP_FRAMES || t_heapAllocations == allocationsBefore) &&
+		"heap allocation during a steady-state frame");
+	(void)allocationsBefore;
+}
+
+// --- Mipmap Benchmark: "NuwaCharacter.exe --bench-mipmap" ---
+// Times the old glTexImage2D + gluBuild2DMipmaps path against generateMipChain + one upload per level.
+void runMipmapBenchmark()
+{
+	const int ITERATIONS = 5;
+	benchLog("--- Mipmap generation benchmark (%d iterations, %u worker threads) ---\n",
+		ITERATIONS, (unsigned int)g_threadPool.workers.size());
+
+	for (const TextureSlot& slot : g_textureSlots) {
+		const char* path = slot.path;
+		BmpImage image;
+		if (!readBMP(path, image)) continue;
+
+		GLenum internalFormat = (image.bytesPerPixel == 4) ? GL_RGBA : GL_RGB;
+		GLenum pixelFormat = (image.bytesPerPixel == 4) ? GL_BGRA_EXT : GL_BGR_EXT;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		double gluMs = 0.0, generateMs = 0.0, uploadMs = 0.0;
+		for (int i = 0; i < ITERATIONS; ++i) {
+			GLuint textureID;
+			glGenTextures(1, &textureID);
+			glBindTexture(GL_TEXTURE_2D, textureID);
+			double start = getTimeMs();
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, pixelFormat, GL_UNSIGNED_BYTE, image.pixels.data());
+			gluBuild2DMipmaps(GL_TEXTURE_2D, internalFormat, image.width, image.height, pixelFormat, GL_UNSIGNED_BYTE, image.pixels.data());
+			glFinish();
+			gluMs += getTimeMs() - start;
+			glDeleteTextures(1, &textureID);
+
+			glGenTextures(1, &textureID);
+			glBindTexture(GL_TEXTURE_2D, textureID);
+			start = getTimeMs();
+			MipChain chain;
+			generateMipChain(image, g_maxTextureSize, chain);
+			double generated = getTimeMs();
+			uploadMipChain(chain);
+			glFinish();
+			generateMs += generated - start;
+			uploadMs += getTimeMs() - generated;
+			glDeleteTextures(1, &textureID);
+		}
+
+		benchLog("%-24s %4dx%-4d  GLU: %7.2f ms   ours: %7.2f ms (generate %.2f + upload %.2f)\n", path, image.width, image.height,
+			gluMs / ITERATIONS, (generateMs + uploadMs) / ITERATIONS, generateMs / ITERATIONS, uploadMs / ITERATIONS);
+	}
+}
+
+// --- Particle Benchmark: "NuwaCharacter.exe --bench-particles" ---
+// Fills the system to capacity and times the update kernels and quad expansion.
+void runParticleBenchmark()
+{
+	const int FRAMES = 100;
+	const float DELTA_TIME = 1.0f / 60.0f;
+	benchLog("--- Particle benchmark (%d particles, %d frames, %u worker threads) ---\n",
+		MAX_PARTICLES, FRAMES, (unsigned int)g_threadPool.workers.size());
+
+	// Long-lived particles so the count stays at capacity for the whole run
+	ParticleEmitterDesc desc = SKILL_EMITTER;
+	desc.lifeMin = desc.lifeMax = 1000.0f;
+
+	const ParticleKernel kernels[] = { updateParticlesSSE, updateParticlesAVX };
+	const char* kernelNames[] = { "SSE", "AVX" };
+	ParticleKernel selectedKernel = g_particleKernel;
+	for (int k = 0; k < 2; ++k) {
+		if (kernels[k] == updateParticlesAVX && !cpuSupportsAVX()) continue;
+		g_particleKernel = kernels[k];
+
+		g_particles.count = 0;
+		for (int i = 0; i < MAX_PARTICLES; ++i) {
+			spawnParticle(desc, randomFloat(-5.0f, 5.0f), 0.0f, randomFloat(-5.0f, 5.0f));
+		}
+
+		double start = getTimeMs();
+		for (int frame = 0; frame < FRAMES; ++frame) updateParticles(DELTA_TIME);
+		double updateMs = (getTimeMs() - start) / FRAMES;
+
+		const float right[3] = { 1.0f, 0.0f, 0.0f }, up[3] = { 0.0f, 1.0f, 0.0f };
+		start = getTimeMs();
+		for (int frame = 0; frame < FRAMES; ++frame) {
+			resetFrameArena();
+			buildParticleVertices(right, up);
+		}
+		double buildMs = (getTimeMs() - start) / FRAMES;
+
+		benchLog("%s kernel: update %.3f ms/frame (%.1f ns/particle), quad expansion %.3f ms/frame\n",
+			kernelNames[k], updateMs, updateMs * 1.0e6 / MAX_PARTICLES, buildMs);
+	}
+	g_particleKernel = selectedKernel;
+	g_particles.count = 0;
+}
+
+// --- Projectile Benchmark: "NuwaCharacter.exe --bench-projectiles" ---
+// Fills the skill pool with casts in every direction and times the batched
+// update and vertex generation (particle emission is left out).
+void runProjectileBenchmark()
+{
+	const int FRAMES = 100;
+	const float DELTA_TIME = 1.0f / 60.0f;
+	benchLog("--- Skill projectile benchmark (%d projectiles, %d frames) ---\n", MAX_SKILL_PROJECTILES, FRAMES);
+
+	g_skillProjectiles.count = 0;
+	while (castSkillProjectile(randomFloat(-20.0f, 20.0f), randomFloat(-20.0f, 20.0f), randomFloat(0.0f, 360.0f))) {}
+
+	double start = getTimeMs();
+	for (int frame = 0; frame < FRAMES; ++frame) updateSkillProjectiles(DELTA_TIME);
+	double updateMs = (getTimeMs() - start) / FRAMES;
+
+	start = getTimeMs();
+	for (int frame = 0; frame < FRAMES; ++frame) {
+		resetFrameArena();
+		buildSkillVertices();
+	}
+	double buildMs = (getTimeMs() - start) / FRAMES;
+
+	benchLog("update %.4f ms/frame, vertex build %.4f ms/frame (%d live)\n", updateMs, buildMs, g_skillProjectiles.count);
+	g_skillProjectiles.count = 0;
+}
+
+// --- Spatial Hash Benchmark: "NuwaCharacter.exe --bench-spatial" ---
+// Moves tens of thousands of boxes around a large world and times the
+// incremental update plus radius and OBB queries, checking the query results
+// against a brute-force scan.
+void runSpatialBenchmark()
+{
+	const int ENTITIES = 20000;
+	const int FRAMES = 60;
+	const int QUERIES = 2000;
+	const float WORLD_HALF_SIZE = 200.0f;
+	const float DELTA_TIME = 1.0f / 60.0f;
+	benchLog("--- Spatial hash benchmark (%d entities, %.0f cell size, %d buckets) ---\n", ENTITIES, SPATIAL_CELL_SIZE, SPATIAL_BUCKET_COUNT);
+
+	clearSpatialHash();
+	std::vector<float> posX(ENTITIES), posZ(ENTITIES), velX(ENTITIES), velZ(ENTITIES), halfSize(ENTITIES);
+	std::vector<int> ids(ENTITIES);
+	double start = getTimeMs();
+	for (int i = 0; i < ENTITIES; ++i) {
+		posX[i] = randomFloat(-WORLD_HALF_SIZE, WORLD_HALF_SIZE);
+		posZ[i] = randomFloat(-WORLD_HALF_SIZE, WORLD_HALF_SIZE);
+		velX[i] = randomFloat(-15.0f, 15.0f);
+		velZ[i] = randomFloat(-15.0f, 15.0f);
+		halfSize[i] = randomFloat(0.25f, 2.0f);
+		ids[i] = spatialInsert(SPATIAL_OTHER, i, posX[i] - halfSize[i], posZ[i] - halfSize[i], posX[i] + halfSize[i], posZ[i] + halfSize[i]);
+	}
+	double insertMs = getTimeMs() - start;
+
+	start = getTimeMs();
+	for (int frame = 0; frame < FRAMES; ++frame) {
+		for (int i = 0; i < ENTITIES; ++i) {
+			posX[i] += velX[i] * DELTA_TIME;
+			posZ[i] += velZ[i] * DELTA_TIME;
+			spatialUpdate(ids[i], posX[i] - halfSize[i], posZ[i] - halfSize[i], posX[i] + halfSize[i], posZ[i] + halfSize[i]);
+		}
+	}
+	double updateMs = (getTimeMs() - start) / FRAMES;
+
+	// Query shapes the size of the scene's effects: a 5-unit radius and a skill rectangle
+	std::vector<float> queryX(QUERIES), queryZ(QUERIES), queryAngle(QUERIES);
+	for (int q = 0; q < QUERIES; ++q) {
+		queryX[q] = randomFloat(-WORLD_HALF_SIZE, WORLD_HALF_SIZE);
+		queryZ[q] = randomFloat(-WORLD_HALF_SIZE, WORLD_HALF_SIZE);
+		queryAngle[q] = randomFloat(0.0f, 6.2831853f);
+	}
+	std::vector<int> results;
+	results.reserve(1024);
+	size_t radiusHits = 0, obbHits = 0;
+
+	start = getTimeMs();
+	for (int q = 0; q < QUERIES; ++q) {
+		results.clear();
+		spatialQueryRadius(queryX[q], queryZ[q], 5.0f, results);
+		radiusHits += results.size();
+	}
+	double radiusMs = getTimeMs() - start;
+
+	start = getTimeMs();
+	for (int q = 0; q < QUERIES; ++q) {
+		results.clear();
+		spatialQueryOBB(makeSpatialOBB(queryX[q], queryZ[q], sinf(queryAngle[q]), cosf(queryAngle[q]), SKILL_WIDTH / 2.0f, SKILL_LENGTH / 2.0f), results);
+		obbHits += results.size();
+	}
+	double obbMs = getTimeMs() - start;
+
+	// The O(N x M) scan the hash replaces
+	size_t bruteRadiusHits = 0, bruteOBBHits = 0;
+	start = getTimeMs();
+	for (int q = 0; q < QUERIES; ++q) {
+		SpatialOBB obb = makeSpatialOBB(queryX[q], queryZ[q], sinf(queryAngle[q]), cosf(queryAngle[q]), SKILL_WIDTH / 2.0f, SKILL_LENGTH / 2.0f);
+		for (const SpatialEntity& e : g_spatialHash.entities) {
+			if (spatialBoxInRadius(e, queryX[q], queryZ[q], 25.0f)) ++bruteRadiusHits;
+			if (spatialBoxOverlapsOBB(e, obb)) ++bruteOBBHits;
+		}
+	}
+	double bruteMs = getTimeMs() - start;
+
+	benchLog("insert %.2f ms, incremental update %.3f ms/frame\n", insertMs, updateMs);
+	benchLog("%d radius queries: %.3f ms (%zu hits), %d OBB queries: %.3f ms (%zu hits)\n", QUERIES, radiusMs, radiusHits, QUERIES, obbMs, obbHits);
+	benchLog("brute force, both query sets: %.2f ms; results %s\n", bruteMs,
+		(bruteRadiusHits == radiusHits && bruteOBBHits == obbHits) ? "match" : "DO NOT MATCH");
+	clearSpatialHash();
+}
+
+// --- Collision Benchmark: "NuwaCharacter.exe --bench-collision" ---
+// Thousands of blocks and hundreds of projectiles crossing them: times the
+// spatial sync plus sweep-and-prune each frame, and checks the first frame's
+// hits against testing every projectile against every block.
+void runCollisionBenchmark()
+{
+	const int BLOCKS = 4000;
+	const int PROJECTILES = 400;
+	const int FRAMES = 100;
+	const float DELTA_TIME = 1.0f / 60.0f;
+	const float AREA_HALF_SIZE = 60.0f;
+	benchLog("--- Collision benchmark (%d blocks, %d projectiles, %d frames) ---\n", BLOCKS, PROJECTILES, FRAMES);
+
+	clearSpatialHash();
+	g_sweepOrder.clear();
+	g_matrixBlocks.clear();
+	g_skillProjectiles.count = 0;
+	for (int i = 0; i < BLOCKS; ++i) {
+		MatrixBlock block;
+		block.isActive = true;
+		block.state = ACTIVE;
+		block.expireTime = 1000.0f;
+		block.animationTimer = 0.0f;
+		block.scaleX = block.scaleY = block.scaleZ = 2.0f;
+		block.posX = randomFloat(-AREA_HALF_SIZE, AREA_HALF_SIZE);
+		block.posY = 1.0f;
+		block.posZ = randomFloat(-AREA_HALF_SIZE, AREA_HALF_SIZE);
+		g_matrixBlocks.push_back(block);
+	}
+	for (int i = 0; i < PROJECTILES; ++i) {
+		castSkillProjectile(randomFloat(-AREA_HALF_SIZE, AREA_HALF_SIZE), randomFloat(-AREA_HALF_SIZE, AREA_HALF_SIZE), randomFloat(0.0f, 360.0f));
+	}
+
+	// First frame: sweep-and-prune against the brute-force pair test
+	updateSpatialHash();
+	sweepSkillCollisions();
+	size_t bruteHits = 0;
+	double start = getTimeMs();
+	for (int p = 0; p < g_skillProjectiles.count; ++p) {
+		for (int b = 0; b < (int)g_matrixBlocks.size(); ++b) {
+			if (skillHitsBlock(p, b)) ++bruteHits;
+		}
+	}
+	double bruteMs = getTimeMs() - start;
+	benchLog("first frame: %zu hits from sweep-and-prune, %zu from brute force (%.3f ms) - %s\n",
+		g_skillHits.size(), bruteHits, bruteMs, g_skillHits.size() == bruteHits ? "match" : "DO NOT MATCH");
+
+	// Steady state: projectiles move, blocks stay put; hits are found but not applied
+	double syncMs = 0.0, sweepMs = 0.0;
+	size_t totalHits = 0;
+	for (int frame = 0; frame < FRAMES; ++frame) {
+		updateSkillProjectiles(DELTA_TIME);
+		start = getTimeMs();
+		updateSpatialHash();
+		double synced = getTimeMs();
+		sweepSkillCollisions();
+		syncMs += synced - start;
+		sweepMs += getTimeMs() - synced;
+		totalHits += g_skillHits.size();
+	}
+	benchLog("spatial sync %.3f ms/frame, sweep-and-prune + narrowphase %.3f ms/frame (%.1f hits/frame)\n",
+		syncMs / FRAMES, sweepMs / FRAMES, (double)totalHits / FRAMES);
+
+	clearSpatialHash();
+	g_sweepOrder.clear();
+	g_matrixBlocks.clear();
+	g_skillProjectiles.count = 0;
 }
 
-int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int nCmdShow)
+// --- Picking Benchmark: "NuwaCharacter.exe --bench-picking" ---
+// A field of blocks in front of the camera: times the BVH build, the per-frame
+// refit and a batch of cursor rays, and checks every ray's result against
+// testing it on every leaf.
+void runPickingBenchmark()
 {
+	const int BLOCKS = 20000;
+	const int RAYS = 10000;
+	const int REFITS = 100;
+	const float AREA_HALF_SIZE = 60.0f;
+	benchLog("--- Picking benchmark (%d blocks, %d rays) ---\n", BLOCKS, RAYS);
+
+	// Camera 40 units back and tilted down, like the orbit camera in display()
+	PickMatrix& camera = g_pickMatrices[PICK_BLOCK_MATRIX];
+	const float tilt = 0.3f;
+	const float m[16] = { 1, 0, 0, 0, 0, cosf(tilt), sinf(tilt), 0, 0, -sinf(tilt), cosf(tilt), 0, 0, -2.0f, -40.0f, 1 };
+	memcpy(camera.modelview, m, sizeof(m));
+	invertAffineMatrix(camera.modelview, camera.inverse);
+
+	PickBVH& bvh = g_pickBVH;
+	bvh.leaves.assign(PICK_PART_COUNT + BLOCKS, PickLeaf());
+	for (PickLeaf& leaf : bvh.leaves) {
+		clearPickLeaf(leaf);
+	}
+	std::vector<float> blockX(BLOCKS), blockY(BLOCKS), blockZ(BLOCKS);
+	for (int i = 0; i < BLOCKS; ++i) {
+		blockX[i] = randomFloat(-AREA_HALF_SIZE, AREA_HALF_SIZE);
+		blockY[i] = randomFloat(0.0f, 4.0f);
+		blockZ[i] = randomFloat(-AREA_HALF_SIZE, AREA_HALF_SIZE);
+		setPickLeaf(PICK_PART_COUNT + i, PICK_BLOCK_MATRIX, blockX[i] - 0.5f, blockY[i] - 0.5f, blockZ[i] - 0.5f,
+			blockX[i] + 0.5f, blockY[i] + 0.5f, blockZ[i] + 0.5f);
+	}
+
+	double start = getTimeMs();
+	buildPickBVH();
+	double buildMs = getTimeMs() - start;
+
+	// Blocks bob a little each frame; refit follows them without rebuilding
+	double refitMs = 0.0;
+	for (int frame = 0; frame < REFITS; ++frame) {
+		float bob = 0.1f * sinf((float)frame);
+		for (int i = 0; i < BLOCKS; ++i) {
+			setPickLeaf(PICK_PART_COUNT + i, PICK_BLOCK_MATRIX, blockX[i] - 0.5f, blockY[i] + bob - 0.5f, blockZ[i] - 0.5f,
+				blockX[i] + 0.5f, blockY[i] + bob + 0.5f, blockZ[i] + 0.5f);
+		}
+		start = getTimeMs();
+		updatePickBVH();
+		refitMs += getTimeMs() - start;
+	}
+	benchLog("build %.3f ms (%zu nodes), refit %.3f ms/frame\n", buildMs, bvh.nodes.size(), refitMs / REFITS);
+
+	// Rays from the eye through random points of a 45-degree frustum, 100 units deep
+	std::vector<float> rays(RAYS * 3);
+	for (int r = 0; r < RAYS; ++r) {
+		rays[r * 3 + 0] = randomFloat(-41.0f, 41.0f);
+		rays[r * 3 + 1] = randomFloat(-41.0f, 41.0f);
+		rays[r * 3 + 2] = -100.0f;
+	}
+	const float origin[3] = { 0.0f, 0.0f, 0.0f };
+	std::vector<int> bvhHits(RAYS);
+	start = getTimeMs();
+	for (int r = 0; r < RAYS; ++r) {
+		bvhHits[r] = pickRayCast(origin, &rays[r * 3], 1.0f);
+	}
+	double bvhMs = getTimeMs() - start;
+
+	int hits = 0, mismatches = 0;
+	start = getTimeMs();
+	for (int r = 0; r < RAYS; ++r) {
+		float bestT = 1.0f;
+		int best = -1;
+		for (int i = 0; i < (int)bvh.leaves.size(); ++i) {
+			float t = bestT;
+			if (bvh.leaves[i].matrix >= 0 && pickLeafHit(bvh.leaves[i], origin, &rays[r * 3], t) && t < bestT) {
+				bestT = t;
+				best = i;
+			}
+		}
+		if (best >= 0) ++hits;
+		if (best != bvhHits[r]) ++mismatches;
+	}
+	double bruteMs = getTimeMs() - start;
+	benchLog("BVH %.2f us/ray, brute force %.2f us/ray, %d of %d rays hit; %s\n",
+		bvhMs * 1000.0 / RAYS, bruteMs * 1000.0 / RAYS, hits, RAYS, mismatches == 0 ? "results match" : "RESULTS DO NOT MATCH");
+
+	bvh.nodes.clear();
+	bvh.leaves.clear();
+}
+
+// --- Motion Table Benchmark: "NuwaCharacter.exe --bench-motion" ---
+// One frame of every character's looping motion (walk cycle, mirror bob,
+// braid sway, sash ripple and halo shimmer, at the same counts the draw code
+// uses), evaluated with sin/cos and then from the baked tables. Each character
+// runs on its own clock.
+static int evaluateMotionFrame(float time, bool baked, float* out)
+{
+	const int BRAID_SEGMENTS = 15;
+	const int SASH_VERTICES = 2 * 3 * 31 * 2; // Two sashes, three strips of 31 vertex pairs
+	const int HALO_VERTICES = 2 * 61;
+	int n = 0;
+	if (baked) {
+		WalkSample walk;
+		sampleWalkCycle(time * WALK_SPEED, 1.0f, walk);
+		out[n++] = walk.rightHip; out[n++] = walk.rightKnee; out[n++] = walk.leftKnee;
+		out[n++] = motionSin(time);
+		for (int i = 0; i < BRAID_SEGMENTS; ++i) {
+			out[n++] = motionSin(time * 2.5f + i * 0.5f);
+			out[n++] = motionCos(time * 3.0f + i * 0.7f);
+		}
+		for (int i = 0; i < SASH_VERTICES; ++i) {
+			float t = (float)(i % 31) / 30.0f;
+			out[n++] = motionSin(t * 3.14159f);
+			out[n++] = motionSin(time * 3.0f + t * 5.0f);
+			out[n++] = motionCos(time * 2.4f + t * 5.0f);
+		}
+		for (int i = 0; i < HALO_VERTICES; ++i) {
+			out[n++] = motionSin((float)i / 60.0f * 2.0f * 3.14159f * 4.0f + time * 0.09f);
+		}
+	}
+	else {
+		float s = sinf(time * WALK_SPEED);
+		out[n++] = s * HIP_SWING_AMPLITUDE;
+		out[n++] = max(0.0f, s) * KNEE_BEND_AMPLITUDE;
+		out[n++] = max(0.0f, sinf(time * WALK_SPEED + 3.14159f)) * KNEE_BEND_AMPLITUDE;
+		out[n++] = sinf(time);
+		for (int i = 0; i < BRAID_SEGMENTS; ++i) {
+			out[n++] = sinf(time * 2.5f + i * 0.5f);
+			out[n++] = cosf(time * 3.0f + i * 0.7f);
+		}
+		for (int i = 0; i < SASH_VERTICES; ++i) {
+			float t = (float)(i % 31) / 30.0f;
+			out[n++] = sinf(t * 3.14159f);
+			out[n++] = sinf(time * 3.0f + t * 5.0f);
+			out[n++] = cosf(time * 2.4f + t * 5.0f);
+		}
+		for (int i = 0; i < HALO_VERTICES; ++i) {
+			out[n++] = sinf((float)i / 60.0f * 2.0f * 3.14159f * 4.0f + time * 0.09f);
+		}
+	}
+	return n;
+}
+
+void runMotionBenchmark()
+{
+	const int CHARACTERS = 1000;
+	const int FRAMES = 10;
+	benchLog("--- Motion table benchmark (%d characters, %d frames) ---\n", CHARACTERS, FRAMES);
+
+	std::vector<float> clocks(CHARACTERS);
+	for (int c = 0; c < CHARACTERS; ++c) {
+		clocks[c] = randomFloat(0.0f, 600.0f);
+	}
+	std::vector<float> direct(2048), baked(2048);
+	double directMs = 0.0, bakedMs = 0.0;
+	float maxError = 0.0f, checksum = 0.0f;
+	int values = 0;
+	for (int frame = 0; frame < FRAMES; ++frame) {
+		double start = getTimeMs();
+		for (int c = 0; c < CHARACTERS; ++c) {
+			values = evaluateMotionFrame(clocks[c] + frame / 60.0f, false, direct.data());
+			checksum += direct[values - 1];
+		}
+		directMs += getTimeMs() - start;
+
+		start = getTimeMs();
+		for (int c = 0; c < CHARACTERS; ++c) {
+			evaluateMotionFrame(clocks[c] + frame / 60.0f, true, baked.data());
+			checksum += baked[values - 1];
+		}
+		bakedMs += getTimeMs() - start;
+
+		// Compare the last character of the frame; the knee angles are in degrees
+		for (int i = 0; i < values; ++i) {
+			float scale = i < 3 ? 1.0f / KNEE_BEND_AMPLITUDE : 1.0f;
+			maxError = max(maxError, fabsf(direct[i] - baked[i]) * scale);
+		}
+	}
+	benchLog("%d values per character: direct %.3f ms/frame, baked %.3f ms/frame (%.1fx), max error %.6f, tables %zu bytes (checksum %.1f)\n",
+		values, directMs / FRAMES, bakedMs / FRAMES, directMs / max(bakedMs, 1e-6), maxError,
+		sizeof(g_sineTable) + sizeof(g_walkTable), checksum);
+}
+
+int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR lpCmdLine, int nCmdShow)
+{
+	g_startupTimeMs = getTimeMs();
+
 	// --- NEW: Initialise the random number generator ---
 	// This is crucial for the particle system to look different each time.
-	srand(time(NULL));
+	seedRandom((unsigned int)time(NULL));
 
 	// --- Register Window Class ---
 	WNDCLASSEX wc;
@@ -2863,68 +9868,114 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int nCmdShow)
 
 	if (!wglMakeCurrent(g_hDC, g_hRC)) return -1;
 
-	ShowWindow(hWnd, nCmdShow);
-
-	// --- Load textures ---
-	g_fireTextureID = loadTextureBMP("Textures/Fire.bmp");
-	if (g_fireTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Fire.bmp. Make sure the file is in the Textures folder.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1; // Exit if the texture fails to load
+	loadGLExtensions();
+	startThreadPool();
+	initParticles();
+	initAnimationClips();
+	initBlendTree();
+	initMotionTables();
+	reserveFrameStorage();
+	// The worst frame: every particle and projectile at once, plus alignment slack
+	initFrameArena((size_t)MAX_PARTICLES * 4 * sizeof(ParticleVertex) + (size_t)MAX_SKILL_PROJECTILES * 16 * sizeof(SkillVertex) +
+		(size_t)(MAX_CROWD_SIZE + 1) * 4 * sizeof(ImpostorVertex) + 4096);
+
+	// Nuwa.cfg seeds these; the flags below take precedence
+	char configPath[MAX_PATH] = "Nuwa.cfg";
+	const char* configArg = strstr(lpCmdLine, "--config=");
+	if (configArg) sscanf_s(configArg + strlen("--config="), "%259s", configPath, (unsigned)sizeof(configPath));
+	loadQualityConfig(configPath);
+	g_textureBudgetBytes = (size_t)g_config.textureBudgetMB * 1024 * 1024;
+	g_qualityGovernor.budgetMs = g_config.frameBudgetMs;
+	g_impostors.crowdSize = min(MAX_CROWD_SIZE, g_config.crowdSize);
+	g_dynamicResolution.useSharpen = g_config.useSharpen;
+
+	const char* budgetArg = strstr(lpCmdLine, "--texture-budget-mb=");
+	if (budgetArg) {
+		g_textureBudgetBytes = (size_t)atoi(budgetArg + strlen("--texture-budget-mb=")) * 1024 * 1024;
 	}
-
-	g_goldTextureID = loadTextureBMP("Textures/Gold.bmp");
-	if (g_goldTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Gold.bmp. Make sure the file is in the Textures folder.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
-	}
-
-	g_redTextureID = loadTextureBMP("Textures/Red.bmp");
-	if (g_redTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Red.bmp. Make sure the file is in the Textures folder.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
-	}
-
-	g_skyTextureID = loadTextureBMP("Textures/Sky.bmp");
-	if (g_skyTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Sky.bmp. Make sure the file is in the Textures folder.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
-	}
-
-	g_shoeTextureID = loadTextureBMP("Textures/Shoe.bmp");
-	if (g_shoeTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Shoe.bmp. Make sure the file is in the Textures folder.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
+	const char* targetFpsArg = strstr(lpCmdLine, "--target-fps=");
+	if (targetFpsArg) {
+		int targetFps = atoi(targetFpsArg + strlen("--target-fps="));
+		if (targetFps > 0) g_qualityGovernor.budgetMs = 1000.0f / targetFps;
 	}
-
-	g_nuwaSkillTextureID = loadTextureBMP("Textures/NuwaSkill.bmp");
-	if (g_nuwaSkillTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/NuwaSkill.bmp.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
+	const char* frameBudgetArg = strstr(lpCmdLine, "--frame-budget-ms=");
+	if (frameBudgetArg) {
+		float budgetMs = (float)atof(frameBudgetArg + strlen("--frame-budget-ms="));
+		if (budgetMs > 0.0f) g_qualityGovernor.budgetMs = budgetMs;
 	}
-
-	g_silverTextureID = loadTextureBMP("Textures/Silver.bmp");
-	if (g_silverTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Silver.bmp. Make sure the file is in the Textures folder.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
+	if (strstr(lpCmdLine, "--upscale=bilinear")) g_dynamicResolution.useSharpen = false;
+	const char* crowdArg = strstr(lpCmdLine, "--crowd=");
+	if (crowdArg) {
+		int crowdSize = atoi(crowdArg + strlen("--crowd="));
+		g_impostors.crowdSize = max(0, min(MAX_CROWD_SIZE, crowdSize));
 	}
 
-	g_orangeTextureID = loadTextureBMP("Textures/Orange.bmp");
-	if (g_orangeTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Orange.bmp. Make sure the file is in the Textures folder.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
+	// --- Offline tools: "--compress-textures", "--bake-meshes" and the "--bench-*" modes run and exit ---
+	bool compressTextures = strstr(lpCmdLine, "--compress-textures") != nullptr;
+	bool bakeMeshFile = strstr(lpCmdLine, "--bake-meshes") != nullptr;
+	bool benchMipmap = strstr(lpCmdLine, "--bench-mipmap") != nullptr;
+	bool benchParticles = strstr(lpCmdLine, "--bench-particles") != nullptr;
+	bool benchProjectiles = strstr(lpCmdLine, "--bench-projectiles") != nullptr;
+	bool benchSpatial = strstr(lpCmdLine, "--bench-spatial") != nullptr;
+	bool benchCollision = strstr(lpCmdLine, "--bench-collision") != nullptr;
+	bool benchPicking = strstr(lpCmdLine, "--bench-picking") != nullptr;
+	bool benchMotion = strstr(lpCmdLine, "--bench-motion") != nullptr;
+	if (compressTextures || bakeMeshFile || benchMipmap || benchParticles || benchProjectiles || benchSpatial || benchCollision || benchPicking || benchMotion) {
+		if (compressTextures) {
+			// Encodes every BMP into its .dds cache without opening the scene
+			for (const TextureSlot& slot : g_textureSlots) {
+				const char* path = slot.path;
+				CompressedTexture texture;
+				char buffer[256];
+				sprintf_s(buffer, "Compressing %s: %s\n", path, compressTextureFile(path, texture) ? "done" : "FAILED");
+				OutputDebugStringA(buffer);
+			}
+		}
+		if (bakeMeshFile) {
+			bakeMeshes(MESH_FILE_PATH);
+		}
+		if (benchMipmap) {
+			runMipmapBenchmark();
+		}
+		if (benchParticles) {
+			runParticleBenchmark();
+		}
+		if (benchProjectiles) {
+			runProjectileBenchmark();
+		}
+		if (benchSpatial) {
+			runSpatialBenchmark();
+		}
+		if (benchCollision) {
+			runCollisionBenchmark();
+		}
+		if (benchPicking) {
+			runPickingBenchmark();
+		}
+		if (benchMotion) {
+			runMotionBenchmark();
+		}
+		shutdownParticles();
+		shutdownFrameArena();
+		stopThreadPool();
+		wglMakeCurrent(NULL, NULL);
+		wglDeleteContext(g_hRC);
+		ReleaseDC(hWnd, g_hDC);
+		DestroyWindow(hWnd);
+		return 0;
 	}
 
-	g_matrixTextureID = loadTextureBMP("Textures/Matrix.bmp");
-	if (g_matrixTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Matrix.bmp.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
-	}
+	ShowWindow(hWnd, nCmdShow);
 
-	g_mirrorTextureID = loadTextureBMP("Textures/Mirror.bmp");
-	if (g_mirrorTextureID == 0) {
-		MessageBox(hWnd, "Could not load Textures/Mirror.bmp.", "Texture Error", MB_OK | MB_ICONERROR);
-		return -1;
-	}
+	// --- Start loading textures in the background; effect textures wait until first use ---
+	initTextureResidency();
+	loadBakedMeshes(MESH_FILE_PATH);
+	initTessellatedLathes();
+	initImpostors();
+	initMirrorReflection();
+	initDynamicResolution();
+	initQualityGovernor();
+	createParticleTexture();
 
 	// --- Set the initial animation state ---
 	resetAnimation();
@@ -2978,12 +10029,28 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int nCmdShow)
 
 		// --- Render ---
 		display(deltaTime);
+		if (g_frameIndex == 1) {
+			char buffer[128];
+			sprintf_s(buffer, "Time to first frame: %.1f ms\n", getTimeMs() - g_startupTimeMs);
+			OutputDebugStringA(buffer);
+		}
 		// Note: SwapBuffers is now called inside display() in the particle system version
 	}
 
 	mciSendString("close bgm", NULL, 0, NULL);
 
 	// --- Cleanup ---
+	shutdownTextureResidency();
+	deleteProceduralTextures();
+	shutdownDynamicResolution();
+	shutdownMirrorReflection();
+	shutdownImpostors();
+	unloadTessellatedLathes();
+	unloadBakedMeshes();
+	shutdownParticles();
+	shutdownFrameArena();
+	if (g_braidQuadric) gluDeleteQuadric(g_braidQuadric);
+	stopThreadPool();
 	wglMakeCurrent(NULL, NULL);
 	if (g_hRC) wglDeleteContext(g_hRC);
 	if (g_hDC) ReleaseDC(hWnd, g_hDC);